@@ -86,6 +86,7 @@ LOCAL_SRC_FILES := \
     src/common/android/breakpad_getcontext.S \
     src/common/convert_UTF.c \
     src/common/md5.cc src/common/string_conversion.cc \
+    src/common/minidump_compression.cc \
     src/common/linux/elfutils.cc \
     src/common/linux/file_id.cc \
     src/common/linux/guid_creator.cc \
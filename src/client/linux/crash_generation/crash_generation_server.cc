@@ -31,12 +31,13 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <limits.h>
-#include <poll.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <vector>
@@ -50,6 +51,16 @@
 #include "common/linux/safe_readlink.h"
 
 static const char kCommandQuit = 'x';
+static const char kCommandResume = 'r';
+
+// The current CLOCK_MONOTONIC time in milliseconds.
+static u_int64_t
+NowMs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<u_int64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
 
 static bool
 GetInodeForFileDescriptor(ino_t* inode_out, int fd)
@@ -177,24 +188,46 @@ CrashGenerationServer::CrashGenerationServer(
     exit_callback_(exit_callback),
     exit_context_(exit_context),
     generate_dumps_(generate_dumps),
-    started_(false)
+    started_(false),
+    epoll_fd_(-1),
+    worker_count_(1),
+    max_pending_dumps_(64),
+    client_timeout_ms_(-1),
+    reads_paused_(false),
+    stopping_(false)
 {
   if (dump_path)
     dump_dir_ = *dump_path;
   else
     dump_dir_ = "/tmp";
+
+  pthread_mutex_init(&queue_mutex_, NULL);
+  pthread_cond_init(&queue_cond_, NULL);
+  memset(&stats_, 0, sizeof(stats_));
 }
 
 CrashGenerationServer::~CrashGenerationServer()
 {
   if (started_)
     Stop();
+
+  pthread_cond_destroy(&queue_cond_);
+  pthread_mutex_destroy(&queue_mutex_);
+}
+
+void
+CrashGenerationServer::GetStats(Stats* stats) const
+{
+  pthread_mutex_lock(&queue_mutex_);
+  *stats = stats_;
+  pthread_mutex_unlock(&queue_mutex_);
 }
 
 bool
 CrashGenerationServer::Start()
 {
-  if (started_ || 0 > server_fd_)
+  if (started_ || 0 > server_fd_ || worker_count_ < 1 ||
+      max_pending_dumps_ < 1)
     return false;
 
   int control_pipe[2];
@@ -212,10 +245,45 @@ CrashGenerationServer::Start()
   control_pipe_in_ = control_pipe[0];
   control_pipe_out_ = control_pipe[1];
 
-  if (pthread_create(&thread_, NULL,
-                     ThreadMain, reinterpret_cast<void*>(this)))
+  epoll_fd_ = epoll_create(2);
+  if (epoll_fd_ < 0)
+    return false;
+  if (fcntl(epoll_fd_, F_SETFD, FD_CLOEXEC))
+    return false;
+
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.fd = server_fd_;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, server_fd_, &event))
+    return false;
+  event.data.fd = control_pipe_in_;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, control_pipe_in_, &event))
     return false;
 
+  stopping_ = false;
+  reads_paused_ = false;
+  for (int i = 0; i < worker_count_; ++i) {
+    pthread_t worker;
+    if (pthread_create(&worker, NULL,
+                       WorkerMain, reinterpret_cast<void*>(this)))
+      break;
+    workers_.push_back(worker);
+  }
+
+  if (workers_.empty() ||
+      pthread_create(&thread_, NULL,
+                     ThreadMain, reinterpret_cast<void*>(this))) {
+    pthread_mutex_lock(&queue_mutex_);
+    stopping_ = true;
+    pthread_cond_broadcast(&queue_cond_);
+    pthread_mutex_unlock(&queue_mutex_);
+    for (size_t i = 0; i < workers_.size(); ++i)
+      pthread_join(workers_[i], NULL);
+    workers_.clear();
+    return false;
+  }
+
   started_ = true;
   return true;
 }
@@ -233,6 +301,28 @@ CrashGenerationServer::Stop()
   void* dummy;
   pthread_join(thread_, &dummy);
 
+  // Let the workers finish the dumps they are writing, and release the
+  // clients whose requests are still waiting.
+  pthread_mutex_lock(&queue_mutex_);
+  stopping_ = true;
+  pthread_cond_broadcast(&queue_cond_);
+  pthread_mutex_unlock(&queue_mutex_);
+  for (size_t i = 0; i < workers_.size(); ++i)
+    pthread_join(workers_[i], &dummy);
+  workers_.clear();
+
+  for (std::deque<PendingDump>::const_iterator i = pending_.begin();
+       i != pending_.end(); ++i) {
+    ReleaseClient(i->signal_fd, false);
+  }
+  pending_.clear();
+  stats_.pending_dumps = 0;
+
+  HANDLE_EINTR(close(epoll_fd_));
+  epoll_fd_ = -1;
+  HANDLE_EINTR(close(control_pipe_in_));
+  HANDLE_EINTR(close(control_pipe_out_));
+
   started_ = false;
 }
 
@@ -265,18 +355,12 @@ CrashGenerationServer::CreateReportChannel(int* server_fd, int* client_fd)
 void
 CrashGenerationServer::Run()
 {
-  struct pollfd pollfds[2];
-  memset(&pollfds, 0, sizeof(pollfds));
-
-  pollfds[0].fd = server_fd_;
-  pollfds[0].events = POLLIN;
-
-  pollfds[1].fd = control_pipe_in_;
-  pollfds[1].events = POLLIN;
+  struct epoll_event events[2];
 
   while (true) {
-    // infinite timeout
-    int nevents = poll(pollfds, sizeof(pollfds)/sizeof(pollfds[0]), -1);
+    const int timeout_ms = ExpireRequests();
+    int nevents = epoll_wait(epoll_fd_, events,
+                             sizeof(events)/sizeof(events[0]), timeout_ms);
     if (-1 == nevents) {
       if (EINTR == errno) {
         continue;
@@ -285,21 +369,47 @@ CrashGenerationServer::Run()
       }
     }
 
-    if (pollfds[0].revents && !ClientEvent(pollfds[0].revents))
-      return;
-
-    if (pollfds[1].revents && !ControlEvent(pollfds[1].revents))
-      return;
+    for (int i = 0; i < nevents; ++i) {
+      if (events[i].data.fd == server_fd_) {
+        if (!ClientEvent(events[i].events))
+          return;
+      } else if (!ControlEvent(events[i].events)) {
+        return;
+      }
+    }
   }
 }
 
 bool
-CrashGenerationServer::ClientEvent(short revents)
+CrashGenerationServer::ClientEvent(u_int32_t events)
 {
-  if (POLLHUP & revents)
+  if (EPOLLHUP & events)
     return false;
-  assert(POLLIN & revents);
+  assert(EPOLLIN & events);
+
+  // Take every request that has arrived, as long as there is room for it.
+  while (true) {
+    pthread_mutex_lock(&queue_mutex_);
+    const bool full = pending_.size() >= max_pending_dumps_;
+    if (full) {
+      reads_paused_ = true;
+      ++stats_.reads_paused;
+    }
+    pthread_mutex_unlock(&queue_mutex_);
+
+    if (full) {
+      // Leave the rest in the socket until a worker takes a request.
+      WatchReportChannel(false);
+      return true;
+    }
+    if (!ReceiveRequest())
+      return true;
+  }
+}
 
+bool
+CrashGenerationServer::ReceiveRequest()
+{
   // A process has crashed and has signaled us by writing a datagram
   // to the death signal socket. The datagram contains the crash context needed
   // for writing the minidump as well as a file descriptor and a credentials
@@ -308,24 +418,24 @@ CrashGenerationServer::ClientEvent(short revents)
   // The length of the control message:
   static const unsigned kControlMsgSize =
       CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(struct ucred));
-  // The length of the regular payload:
-  static const unsigned kCrashContextSize =
-      sizeof(google_breakpad::ExceptionHandler::CrashContext);
 
+  PendingDump request;
   struct msghdr msg = {0};
   struct iovec iov[1];
-  char crash_context[kCrashContextSize];
   char control[kControlMsgSize];
-  const ssize_t expected_msg_size = sizeof(crash_context);
+  const ssize_t expected_msg_size = sizeof(request.crash_context);
 
-  iov[0].iov_base = crash_context;
-  iov[0].iov_len = sizeof(crash_context);
+  iov[0].iov_base = request.crash_context;
+  iov[0].iov_len = sizeof(request.crash_context);
   msg.msg_iov = iov;
   msg.msg_iovlen = sizeof(iov)/sizeof(iov[0]);
   msg.msg_control = control;
   msg.msg_controllen = kControlMsgSize;
 
-  const ssize_t msg_size = HANDLE_EINTR(recvmsg(server_fd_, &msg, 0));
+  const ssize_t msg_size =
+      HANDLE_EINTR(recvmsg(server_fd_, &msg, MSG_DONTWAIT));
+  if (msg_size < 0)
+    return false;
   if (msg_size != expected_msg_size)
     return true;
 
@@ -367,6 +477,143 @@ CrashGenerationServer::ClientEvent(short revents)
     return true;
   }
 
+  request.claimed_pid = crashing_pid;
+  request.signal_fd = signal_fd;
+  request.deadline_ms = client_timeout_ms_ < 0 ? 0 :
+      NowMs() + client_timeout_ms_;
+
+  pthread_mutex_lock(&queue_mutex_);
+  pending_.push_back(request);
+  stats_.pending_dumps = pending_.size();
+  if (stats_.pending_dumps > stats_.max_pending_dumps)
+    stats_.max_pending_dumps = stats_.pending_dumps;
+  pthread_cond_signal(&queue_cond_);
+  pthread_mutex_unlock(&queue_mutex_);
+  return true;
+}
+
+bool
+CrashGenerationServer::ControlEvent(u_int32_t events)
+{
+  if (EPOLLHUP & events)
+    return false;
+  assert(EPOLLIN & events);
+
+  char command;
+  while (HANDLE_EINTR(read(control_pipe_in_, &command, 1)) == 1) {
+    switch (command) {
+    case kCommandQuit:
+      return false;
+    case kCommandResume:
+      WatchReportChannel(true);
+      break;
+    default:
+      assert(0);
+    }
+  }
+
+  return true;
+}
+
+int
+CrashGenerationServer::ExpireRequests()
+{
+  if (client_timeout_ms_ < 0)
+    return -1;
+
+  const u_int64_t now = NowMs();
+  std::vector<int> expired;
+  int timeout_ms = -1;
+  pthread_mutex_lock(&queue_mutex_);
+  // Requests are queued in the order they arrive, so their deadlines are
+  // in order too.
+  while (!pending_.empty() && pending_.front().deadline_ms <= now) {
+    expired.push_back(pending_.front().signal_fd);
+    pending_.pop_front();
+  }
+  if (!pending_.empty())
+    timeout_ms = static_cast<int>(pending_.front().deadline_ms - now);
+  stats_.pending_dumps = pending_.size();
+  stats_.requests_timed_out += expired.size();
+  const bool resume = reads_paused_ && !expired.empty();
+  if (resume)
+    reads_paused_ = false;
+  pthread_mutex_unlock(&queue_mutex_);
+
+  for (size_t i = 0; i < expired.size(); ++i)
+    ReleaseClient(expired[i], false);
+  if (resume)
+    WatchReportChannel(true);
+  return timeout_ms;
+}
+
+void
+CrashGenerationServer::WatchReportChannel(bool watch)
+{
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = watch ? EPOLLIN : 0;
+  event.data.fd = server_fd_;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, server_fd_, &event);
+}
+
+// The following methods execute on the worker threads
+
+void
+CrashGenerationServer::RunWorker()
+{
+  pthread_mutex_lock(&queue_mutex_);
+  while (true) {
+    while (!stopping_ && pending_.empty())
+      pthread_cond_wait(&queue_cond_, &queue_mutex_);
+    if (stopping_)
+      break;
+
+    const PendingDump request = pending_.front();
+    pending_.pop_front();
+    stats_.pending_dumps = pending_.size();
+    ++stats_.active_dumps;
+    if (reads_paused_) {
+      reads_paused_ = false;
+      HANDLE_EINTR(write(control_pipe_out_, &kCommandResume, 1));
+    }
+    pthread_mutex_unlock(&queue_mutex_);
+
+    const RequestOutcome outcome = HandleRequest(request);
+
+    pthread_mutex_lock(&queue_mutex_);
+    --stats_.active_dumps;
+    switch (outcome) {
+    case DUMP_WRITTEN:
+      ++stats_.dumps_written;
+      break;
+    case DUMP_FAILED:
+      ++stats_.dumps_failed;
+      break;
+    case REQUEST_REJECTED:
+      ++stats_.requests_rejected;
+      break;
+    case REQUEST_TIMED_OUT:
+      ++stats_.requests_timed_out;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&queue_mutex_);
+}
+
+CrashGenerationServer::RequestOutcome
+CrashGenerationServer::HandleRequest(const PendingDump& request)
+{
+  const int signal_fd = request.signal_fd;
+  pid_t crashing_pid = request.claimed_pid;
+
+  // The server thread only expires requests still in the queue; one taken
+  // just as its deadline passed is caught here.
+  if (TimedOut(request)) {
+    ReleaseClient(signal_fd, false);
+    return REQUEST_TIMED_OUT;
+  }
+
   // Kernel bug workaround (broken in 2.6.30 at least):
   // The kernel doesn't translate PIDs in SCM_CREDENTIALS across PID
   // namespaces. Thus |crashing_pid| might be garbage from our point of view.
@@ -374,25 +621,25 @@ CrashGenerationServer::ClientEvent(short revents)
   // of years to be sure that it's worked its way out into the world.
 
   ino_t inode_number;
-  if (!GetInodeForFileDescriptor(&inode_number, signal_fd)) {
-    HANDLE_EINTR(close(signal_fd));
-    return true;
+  if (!GetInodeForFileDescriptor(&inode_number, signal_fd) ||
+      !FindProcessHoldingSocket(&crashing_pid, inode_number - 1)) {
+    ReleaseClient(signal_fd, false);
+    return REQUEST_REJECTED;
   }
 
-  if (!FindProcessHoldingSocket(&crashing_pid, inode_number - 1)) {
-    HANDLE_EINTR(close(signal_fd));
-    return true;
+  // Scanning /proc can take a while on a busy machine.
+  if (TimedOut(request)) {
+    ReleaseClient(signal_fd, false);
+    return REQUEST_TIMED_OUT;
   }
 
   string minidump_filename;
-  if (!MakeMinidumpFilename(minidump_filename))
-    return true;
-
-  if (!google_breakpad::WriteMinidump(minidump_filename.c_str(),
-                                      crashing_pid, crash_context,
-                                      kCrashContextSize)) {
-    HANDLE_EINTR(close(signal_fd));
-    return true;
+  if (!MakeMinidumpFilename(minidump_filename) ||
+      !google_breakpad::WriteMinidump(minidump_filename.c_str(),
+                                      crashing_pid, request.crash_context,
+                                      sizeof(request.crash_context))) {
+    ReleaseClient(signal_fd, false);
+    return DUMP_FAILED;
   }
 
   if (dump_callback_) {
@@ -402,38 +649,35 @@ CrashGenerationServer::ClientEvent(short revents)
   }
 
   // Send the done signal to the process: it can exit now.
-  memset(&msg, 0, sizeof(msg));
-  struct iovec done_iov;
-  done_iov.iov_base = const_cast<char*>("\x42");
-  done_iov.iov_len = 1;
-  msg.msg_iov = &done_iov;
-  msg.msg_iovlen = 1;
-
-  HANDLE_EINTR(sendmsg(signal_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL));
-  HANDLE_EINTR(close(signal_fd));
-
-  return true;
+  ReleaseClient(signal_fd, true);
+  return DUMP_WRITTEN;
 }
 
+// static
 bool
-CrashGenerationServer::ControlEvent(short revents)
+CrashGenerationServer::TimedOut(const PendingDump& request)
 {
-  if (POLLHUP & revents)
-    return false;
-  assert(POLLIN & revents);
-
-  char command;
-  if (read(control_pipe_in_, &command, 1))
-    return false;
+  return request.deadline_ms != 0 && request.deadline_ms <= NowMs();
+}
 
-  switch (command) {
-  case kCommandQuit:
-    return false;
-  default:
-    assert(0);
+// static
+void
+CrashGenerationServer::ReleaseClient(int signal_fd, bool send_done)
+{
+  // Closing the socket alone also wakes the client up, but only the done
+  // signal tells it that a dump was written.
+  if (send_done) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    struct iovec done_iov;
+    done_iov.iov_base = const_cast<char*>("\x42");
+    done_iov.iov_len = 1;
+    msg.msg_iov = &done_iov;
+    msg.msg_iovlen = 1;
+
+    HANDLE_EINTR(sendmsg(signal_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL));
   }
-
-  return true;
+  HANDLE_EINTR(close(signal_fd));
 }
 
 bool
@@ -461,4 +705,12 @@ CrashGenerationServer::ThreadMain(void *arg)
   return NULL;
 }
 
+// static
+void*
+CrashGenerationServer::WorkerMain(void *arg)
+{
+  reinterpret_cast<CrashGenerationServer*>(arg)->RunWorker();
+  return NULL;
+}
+
 }  // namespace google_breakpad
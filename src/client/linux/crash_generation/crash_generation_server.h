@@ -31,9 +31,13 @@
 #define CLIENT_LINUX_CRASH_GENERATION_CRASH_GENERATION_SERVER_H_
 
 #include <pthread.h>
+#include <sys/types.h>
 
+#include <deque>
 #include <string>
+#include <vector>
 
+#include "client/linux/handler/exception_handler.h"
 #include "common/using_std_string.h"
 
 namespace google_breakpad {
@@ -44,7 +48,8 @@ class CrashGenerationServer {
 public:
   // WARNING: callbacks may be invoked on a different thread
   // than that which creates the CrashGenerationServer.  They must
-  // be thread safe.
+  // be thread safe.  With more than one worker (see set_worker_count),
+  // dump callbacks for different clients may run at the same time.
   typedef void (*OnClientDumpRequestCallback)(void* context,
                                               const ClientInfo* client_info,
                                               const string* file_path);
@@ -75,6 +80,46 @@ public:
 
   ~CrashGenerationServer();
 
+  // What the server has been doing, for monitoring.
+  struct Stats {
+    // Requests waiting for a worker now, and the most that ever were.
+    size_t pending_dumps;
+    size_t max_pending_dumps;
+    // Requests a worker is handling now.
+    size_t active_dumps;
+    // Requests handled so far, by outcome: dumps written, dumps that could
+    // not be written, requests whose sender could not be identified, and
+    // requests whose client timeout ran out before their dump was started.
+    u_int64_t dumps_written;
+    u_int64_t dumps_failed;
+    u_int64_t requests_rejected;
+    u_int64_t requests_timed_out;
+    // How often the server stopped reading requests because
+    // max_pending_dumps of them were already waiting.
+    u_int64_t reads_paused;
+  };
+
+  // The following must be called before Start().
+
+  // Sets how many threads write minidumps at once.  Defaults to 1.
+  void set_worker_count(int count) { worker_count_ = count; }
+
+  // Sets how many requests may wait for a worker.  While that many do, the
+  // server stops reading the report channel, so further clients block in
+  // RequestDump until there is room.  Defaults to 64.
+  void set_max_pending_dumps(size_t max) { max_pending_dumps_ = max; }
+
+  // Sets how long, in milliseconds, the server may take from receiving a
+  // request to starting its dump.  A request still waiting for a worker, or
+  // whose client is still being identified, when that runs out is dropped
+  // and the client released without a dump; a dump already being written
+  // is finished.  Defaults to -1, which waits as long as it takes.
+  void set_client_timeout_ms(int timeout) { client_timeout_ms_ = timeout; }
+
+  // Copies the current statistics into |stats|.  Can be called from any
+  // thread.
+  void GetStats(Stats* stats) const;
+
   // Perform initialization steps needed to start listening to clients.
   //
   // Return true if initialization is successful; false otherwise.
@@ -90,23 +135,70 @@ public:
   static bool CreateReportChannel(int* server_fd, int* client_fd);
 
 private:
+  // A dump request received from a client, waiting for a worker.
+  struct PendingDump {
+    char crash_context[sizeof(ExceptionHandler::CrashContext)];
+    // The pid the client's credentials claim, and the socket on which it
+    // waits to be told the dump is done.
+    pid_t claimed_pid;
+    int signal_fd;
+    // When the client timeout runs out, in CLOCK_MONOTONIC milliseconds,
+    // or 0 if there is no timeout.
+    u_int64_t deadline_ms;
+  };
+
   // Run the server's event loop
   void Run();
 
   // Invoked when an child process (client) event occurs
   // Returning true => "keep running", false => "exit loop"
-  bool ClientEvent(short revents);
+  bool ClientEvent(u_int32_t events);
+
+  // Receives one request from the report channel and queues it.
+  // Returns false once there is nothing left to read.
+  bool ReceiveRequest();
 
   // Invoked when the controlling thread (main) event occurs
   // Returning true => "keep running", false => "exit loop"
-  bool ControlEvent(short revents);
+  bool ControlEvent(u_int32_t events);
+
+  // Releases the clients whose requests waited too long.  Returns how many
+  // milliseconds the next request may still wait, or -1 if none may time
+  // out.
+  int ExpireRequests();
+
+  // Stops or resumes reading the report channel.
+  void WatchReportChannel(bool watch);
+
+  // What became of a request.
+  enum RequestOutcome {
+    DUMP_WRITTEN,
+    DUMP_FAILED,
+    REQUEST_REJECTED,
+    REQUEST_TIMED_OUT
+  };
+
+  // Writes the minidump |request| asks for and releases its client.
+  RequestOutcome HandleRequest(const PendingDump& request);
+
+  // Returns true if the client timeout of |request| has run out.
+  static bool TimedOut(const PendingDump& request);
+
+  // Lets a client which is waiting for its dump carry on.
+  static void ReleaseClient(int signal_fd, bool send_done);
 
   // Return a unique filename at which a minidump can be written
   bool MakeMinidumpFilename(string& outFilename);
 
+  // Takes requests off |pending_| until the server stops.
+  void RunWorker();
+
   // Trampoline to |Run()|
   static void* ThreadMain(void* arg);
 
+  // Trampoline to |RunWorker()|
+  static void* WorkerMain(void* arg);
+
   int server_fd_;
 
   OnClientDumpRequestCallback dump_callback_;
@@ -124,6 +216,25 @@ private:
   pthread_t thread_;
   int control_pipe_in_;
   int control_pipe_out_;
+  int epoll_fd_;
+
+  int worker_count_;
+  size_t max_pending_dumps_;
+  int client_timeout_ms_;
+
+  std::vector<pthread_t> workers_;
+
+  // Guards the members below, which the server thread and the workers
+  // share.
+  mutable pthread_mutex_t queue_mutex_;
+  pthread_cond_t queue_cond_;
+  std::deque<PendingDump> pending_;
+  // Set by the server thread when it stops reading the report channel;
+  // the next worker to take a request clears it and tells the server
+  // thread to read again.
+  bool reads_paused_;
+  bool stopping_;
+  Stats stats_;
 
   // disable these
   CrashGenerationServer(const CrashGenerationServer&);
@@ -0,0 +1,277 @@
+// Copyright (c) 2012 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <dirent.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "client/linux/crash_generation/client_info.h"
+#include "client/linux/crash_generation/crash_generation_client.h"
+#include "client/linux/crash_generation/crash_generation_server.h"
+#include "client/linux/handler/exception_handler.h"
+#include "common/linux/eintr_wrapper.h"
+#include "common/tests/auto_tempdir.h"
+#include "common/using_std_string.h"
+
+using namespace google_breakpad;
+
+namespace {
+
+// Counts the dumps the server reports, and can hold up the worker which
+// reports one until the test releases it.
+struct DumpRecorder {
+  pthread_mutex_t mutex;
+  std::vector<pid_t> pids;
+  // If not -1, the callback writes a byte here, then reads one from
+  // |release_fd| before returning.
+  int entered_fd;
+  int release_fd;
+};
+
+void DumpRequested(void* context, const ClientInfo* client_info,
+                   const string* file_path) {
+  DumpRecorder* recorder = reinterpret_cast<DumpRecorder*>(context);
+  pthread_mutex_lock(&recorder->mutex);
+  recorder->pids.push_back(client_info->pid());
+  pthread_mutex_unlock(&recorder->mutex);
+
+  if (recorder->entered_fd != -1) {
+    char byte = 0;
+    ASSERT_EQ(1, HANDLE_EINTR(write(recorder->entered_fd, &byte, 1)));
+    ASSERT_EQ(1, HANDLE_EINTR(read(recorder->release_fd, &byte, 1)));
+  }
+}
+
+// Forks a process which asks the server listening on |client_fd| for a dump
+// of itself, writes a byte to |done_fd| once the server lets it go, and
+// exits.
+pid_t StartClient(int client_fd, int done_fd) {
+  const pid_t child = fork();
+  if (child == 0) {
+    CrashGenerationClient* client = CrashGenerationClient::TryCreate(client_fd);
+    ExceptionHandler::CrashContext context;
+    memset(&context, 0, sizeof(context));
+    getcontext(&context.context);
+    context.tid = getpid();
+    context.siginfo.si_signo = MD_EXCEPTION_CODE_LIN_DUMP_REQUESTED;
+    const char requested = client->RequestDump(&context, sizeof(context));
+    _exit(HANDLE_EINTR(write(done_fd, &requested, 1)) == 1 ? 0 : 1);
+  }
+  return child;
+}
+
+// Waits until |count| clients have been let go by the server.  Until then
+// the server may be tracing them, and waitpid() here would see their
+// ptrace stops.
+void WaitForClientsReleased(int done_fd, int count) {
+  for (int i = 0; i < count; ++i) {
+    char requested;
+    ASSERT_EQ(1, HANDLE_EINTR(read(done_fd, &requested, 1)));
+    ASSERT_TRUE(requested);
+  }
+}
+
+void WaitForClient(pid_t child) {
+  int status;
+  ASSERT_EQ(child, HANDLE_EINTR(waitpid(child, &status, 0)));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+}
+
+int CountMinidumps(const string& directory) {
+  DIR* dir = opendir(directory.c_str());
+  if (!dir)
+    return -1;
+  int count = 0;
+  while (struct dirent* entry = readdir(dir)) {
+    const size_t length = strlen(entry->d_name);
+    if (length > 4 && strcmp(entry->d_name + length - 4, ".dmp") == 0)
+      ++count;
+  }
+  closedir(dir);
+  return count;
+}
+
+class CrashGenerationServerTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    ASSERT_TRUE(CrashGenerationServer::CreateReportChannel(&server_fd_,
+                                                           &client_fd_));
+    pthread_mutex_init(&recorder_.mutex, NULL);
+    recorder_.entered_fd = -1;
+    recorder_.release_fd = -1;
+    dump_path_ = temp_dir_.path();
+    ASSERT_EQ(0, pipe(done_fds_));
+  }
+
+  void TearDown() {
+    close(server_fd_);
+    close(client_fd_);
+    close(done_fds_[0]);
+    close(done_fds_[1]);
+    pthread_mutex_destroy(&recorder_.mutex);
+  }
+
+  AutoTempDir temp_dir_;
+  string dump_path_;
+  int server_fd_;
+  int client_fd_;
+  int done_fds_[2];
+  DumpRecorder recorder_;
+};
+
+}  // namespace
+
+// Many clients ask for a dump at once: every one of them gets its dump,
+// while no more requests than allowed wait for a worker.
+TEST_F(CrashGenerationServerTest, ManySimultaneousClients) {
+  const int kClients = 48;
+  const size_t kMaxPendingDumps = 4;
+
+  CrashGenerationServer server(server_fd_, DumpRequested, &recorder_,
+                               NULL, NULL, true, &dump_path_);
+  server.set_worker_count(4);
+  server.set_max_pending_dumps(kMaxPendingDumps);
+  ASSERT_TRUE(server.Start());
+
+  std::vector<pid_t> children;
+  for (int i = 0; i < kClients; ++i) {
+    const pid_t child = StartClient(client_fd_, done_fds_[1]);
+    ASSERT_NE(-1, child);
+    children.push_back(child);
+  }
+  ASSERT_NO_FATAL_FAILURE(WaitForClientsReleased(done_fds_[0], kClients));
+  for (int i = 0; i < kClients; ++i)
+    ASSERT_NO_FATAL_FAILURE(WaitForClient(children[i]));
+  server.Stop();
+
+  CrashGenerationServer::Stats stats;
+  server.GetStats(&stats);
+  EXPECT_EQ(static_cast<u_int64_t>(kClients), stats.dumps_written);
+  EXPECT_EQ(0U, stats.dumps_failed);
+  EXPECT_EQ(0U, stats.requests_rejected);
+  EXPECT_EQ(0U, stats.requests_timed_out);
+  EXPECT_EQ(0U, stats.pending_dumps);
+  EXPECT_EQ(0U, stats.active_dumps);
+  EXPECT_LE(stats.max_pending_dumps, kMaxPendingDumps);
+
+  EXPECT_EQ(kClients, CountMinidumps(dump_path_));
+  std::sort(children.begin(), children.end());
+  std::sort(recorder_.pids.begin(), recorder_.pids.end());
+  EXPECT_EQ(children, recorder_.pids);
+}
+
+// Requests which wait longer than the client timeout are dropped, and
+// their clients released without a dump.
+TEST_F(CrashGenerationServerTest, ClientTimeout) {
+  const int kWaitingClients = 3;
+
+  int entered[2], release[2];
+  ASSERT_EQ(0, pipe(entered));
+  ASSERT_EQ(0, pipe(release));
+  recorder_.entered_fd = entered[1];
+  recorder_.release_fd = release[0];
+
+  CrashGenerationServer server(server_fd_, DumpRequested, &recorder_,
+                               NULL, NULL, true, &dump_path_);
+  server.set_worker_count(1);
+  server.set_client_timeout_ms(100);
+  ASSERT_TRUE(server.Start());
+
+  // Keep the only worker busy with a first client...
+  const pid_t first = StartClient(client_fd_, done_fds_[1]);
+  ASSERT_NE(-1, first);
+  char byte;
+  ASSERT_EQ(1, HANDLE_EINTR(read(entered[0], &byte, 1)));
+
+  // ...so that the others time out, and are let go.
+  for (int i = 0; i < kWaitingClients; ++i) {
+    const pid_t child = StartClient(client_fd_, done_fds_[1]);
+    ASSERT_NE(-1, child);
+    ASSERT_NO_FATAL_FAILURE(WaitForClientsReleased(done_fds_[0], 1));
+    ASSERT_NO_FATAL_FAILURE(WaitForClient(child));
+  }
+
+  ASSERT_EQ(1, HANDLE_EINTR(write(release[1], &byte, 1)));
+  ASSERT_NO_FATAL_FAILURE(WaitForClientsReleased(done_fds_[0], 1));
+  ASSERT_NO_FATAL_FAILURE(WaitForClient(first));
+  server.Stop();
+
+  CrashGenerationServer::Stats stats;
+  server.GetStats(&stats);
+  EXPECT_EQ(1U, stats.dumps_written);
+  EXPECT_EQ(static_cast<u_int64_t>(kWaitingClients),
+            stats.requests_timed_out);
+  EXPECT_EQ(0U, stats.pending_dumps);
+  EXPECT_EQ(1, CountMinidumps(dump_path_));
+
+  close(entered[0]);
+  close(entered[1]);
+  close(release[0]);
+  close(release[1]);
+}
+
+// With no time allowed, no dump is started, even when a worker takes the
+// request before the server thread can expire it.
+TEST_F(CrashGenerationServerTest, ZeroClientTimeout) {
+  const int kClients = 8;
+
+  CrashGenerationServer server(server_fd_, DumpRequested, &recorder_,
+                               NULL, NULL, true, &dump_path_);
+  server.set_worker_count(4);
+  server.set_client_timeout_ms(0);
+  ASSERT_TRUE(server.Start());
+
+  std::vector<pid_t> children;
+  for (int i = 0; i < kClients; ++i) {
+    const pid_t child = StartClient(client_fd_, done_fds_[1]);
+    ASSERT_NE(-1, child);
+    children.push_back(child);
+  }
+  ASSERT_NO_FATAL_FAILURE(WaitForClientsReleased(done_fds_[0], kClients));
+  for (int i = 0; i < kClients; ++i)
+    ASSERT_NO_FATAL_FAILURE(WaitForClient(children[i]));
+  server.Stop();
+
+  CrashGenerationServer::Stats stats;
+  server.GetStats(&stats);
+  EXPECT_EQ(0U, stats.dumps_written);
+  EXPECT_EQ(static_cast<u_int64_t>(kClients), stats.requests_timed_out);
+  EXPECT_EQ(0, CountMinidumps(dump_path_));
+  EXPECT_TRUE(recorder_.pids.empty());
+}
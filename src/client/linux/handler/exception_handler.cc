@@ -73,6 +73,7 @@
 #include <stdio.h>
 #include <sys/mman.h>
 #include <sys/prctl.h>
+#include <sys/socket.h>
 #include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -89,6 +90,7 @@
 #include "common/linux/linux_libc_support.h"
 #include "common/memory.h"
 #include "client/linux/log/log.h"
+#include "client/linux/minidump_writer/directory_reader.h"
 #include "client/linux/minidump_writer/linux_dumper.h"
 #include "client/linux/minidump_writer/minidump_writer.h"
 #include "common/linux/eintr_wrapper.h"
@@ -126,6 +128,9 @@ stack_t old_stack;
 stack_t new_stack;
 bool stack_installed = false;
 
+// The stack of a process cloned to write a minidump.
+const unsigned kChildStackSize = 8000;
+
 // Create an alternative stack to run the signal handlers on. This is done since
 // the signal might have been caused by a stack overflow.
 // Runs before crashing: normal context.
@@ -202,7 +207,14 @@ ExceptionHandler::ExceptionHandler(const MinidumpDescriptor& descriptor,
       callback_(callback),
       callback_context_(callback_context),
       minidump_descriptor_(descriptor),
-      crash_handler_(NULL) {
+      crash_handler_(NULL),
+      dump_helper_pid_(-1),
+      dump_helper_parent_(-1),
+      dump_helper_fd_(-1),
+      dump_helper_stack_(NULL),
+      dump_helper_context_(NULL),
+      dump_helper_busy_(0) {
+  pthread_mutex_init(&write_minidump_mutex_, NULL);
   if (server_fd >= 0)
     crash_generation_client_.reset(CrashGenerationClient::TryCreate(server_fd));
 
@@ -218,10 +230,15 @@ ExceptionHandler::ExceptionHandler(const MinidumpDescriptor& descriptor,
   }
   handler_stack_->push_back(this);
   pthread_mutex_unlock(&handler_stack_mutex_);
+
+  UpdateDumpHelper();
 }
 
 // Runs before crashing: normal context.
 ExceptionHandler::~ExceptionHandler() {
+  StopDumpHelper();
+  pthread_mutex_destroy(&write_minidump_mutex_);
+
   pthread_mutex_lock(&handler_stack_mutex_);
   std::vector<ExceptionHandler*>::iterator handler =
       std::find(handler_stack_->begin(), handler_stack_->end(), this);
@@ -378,6 +395,81 @@ int ExceptionHandler::ThreadEntry(void *arg) {
                                      thread_arg->context_size) == false;
 }
 
+struct DumpHelperArgument {
+  ExceptionHandler* handler;
+  int fd;  // the helper's end of the socket
+};
+
+// The dump helper's stack, with a guard page below it.
+static size_t DumpHelperStackMappingSize() {
+  return getpagesize() + kChildStackSize;
+}
+
+// The dump helper has its own copy of every file descriptor the program
+// had open when the helper started.  Closes all of them but |socket_fd|,
+// |minidump_fd| and stderr, which logging uses, so that the helper does not
+// keep the program's pipes, sockets and files open.
+static void CloseInheritedFds(int socket_fd, int minidump_fd) {
+  const int dir_fd = sys_open("/proc/self/fd", O_RDONLY | O_DIRECTORY, 0);
+  if (dir_fd < 0)
+    return;
+  DirectoryReader reader(dir_fd);
+  const char* name;
+  while (reader.GetNextEntry(&name)) {
+    int fd;
+    if (my_strtoui(&fd, name) && fd != dir_fd && fd != socket_fd &&
+        fd != minidump_fd && fd != STDERR_FILENO) {
+      sys_close(fd);
+    }
+    reader.PopEntry();
+  }
+  sys_close(dir_fd);
+}
+
+// This is the entry function for the dump helper process.  It waits for
+// dump requests alongside the program, and serves them in a compromised
+// context: see the top of the file.
+// static
+int ExceptionHandler::DumpHelperEntry(void* arg) {
+  const DumpHelperArgument* helper_arg =
+      reinterpret_cast<DumpHelperArgument*>(arg);
+  ExceptionHandler* const handler = helper_arg->handler;
+  const int fd = helper_arg->fd;
+  CloseInheritedFds(fd, handler->minidump_descriptor_.fd());
+
+  // Our copies of the program's signal handlers must not run here: block
+  // every signal, and let a crash of the helper itself kill it, so that the
+  // handler sees the socket close and clones a process instead.
+  sigset_t signals;
+  sigfillset(&signals);
+  sigprocmask(SIG_BLOCK, &signals, NULL);
+  for (int i = 0; i < kNumHandledSignals; ++i)
+    signal(kExceptionSignals[i], SIG_DFL);
+  // Do not keep the program's memory alive once the thread which started
+  // us is gone.
+  sys_prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+  // |arg| is not valid once StartDumpHelper() has read this.
+  static const char kReadyMessage = 'r';
+  if (HANDLE_EINTR(sys_write(fd, &kReadyMessage, sizeof(kReadyMessage))) !=
+      sizeof(kReadyMessage)) {
+    return 1;
+  }
+
+  char request;
+  while (HANDLE_EINTR(sys_read(fd, &request, sizeof(request))) ==
+         sizeof(request)) {
+    const char result = handler->DoDump(handler->dump_helper_parent_,
+                                        handler->dump_helper_context_,
+                                        sizeof(CrashContext));
+    if (HANDLE_EINTR(sys_write(fd, &result, sizeof(result))) !=
+        sizeof(result)) {
+      break;
+    }
+  }
+  return 0;
+}
+
 // This function runs in a compromised context: see the top of the file.
 // Runs on the crashing thread.
 bool ExceptionHandler::HandleSignal(int sig, siginfo_t* info, void* uc) {
@@ -427,7 +519,61 @@ bool ExceptionHandler::GenerateDump(CrashContext *context) {
   if (IsOutOfProcess())
     return crash_generation_client_->RequestDump(context, sizeof(*context));
 
-  static const unsigned kChildStackSize = 8000;
+  bool success;
+  if (!RequestDumpFromHelper(context, &success))
+    success = CloneAndDump(context);
+  if (callback_)
+    success = callback_(minidump_descriptor_, callback_context_, success);
+  return success;
+}
+
+// This function may run in a compromised context: see the top of the file.
+// Returns false, leaving |succeeded| alone, if there is no helper to ask.
+bool ExceptionHandler::RequestDumpFromHelper(CrashContext *context,
+                                             bool* succeeded) {
+  if (dump_helper_pid_ <= 0 || sys_getpid() != dump_helper_parent_)
+    return false;
+  // A lock could deadlock if this thread crashed while holding it.
+  if (!__sync_bool_compare_and_swap(&dump_helper_busy_, 0, 1)) {
+    static const char busy_msg[] = "ExceptionHandler::RequestDumpFromHelper \
+                                    the dump helper is busy\n";
+    logger::write(busy_msg, sizeof(busy_msg) - 1);
+    return false;
+  }
+
+  dump_helper_context_ = context;
+  // Allow the helper to ptrace us
+  sys_prctl(PR_SET_PTRACER, dump_helper_pid_);
+
+  static const char kDumpRequest = 'd';
+  struct kernel_msghdr msg;
+  my_memset(&msg, 0, sizeof(msg));
+  struct kernel_iovec iov[1];
+  iov[0].iov_base = const_cast<char*>(&kDumpRequest);
+  iov[0].iov_len = sizeof(kDumpRequest);
+  msg.msg_iov = iov;
+  msg.msg_iovlen = sizeof(iov) / sizeof(iov[0]);
+
+  // If the helper has died, the socket is closed: MSG_NOSIGNAL keeps that
+  // from raising SIGPIPE.
+  char result;
+  if (HANDLE_EINTR(sys_sendmsg(dump_helper_fd_, &msg, MSG_NOSIGNAL)) !=
+          sizeof(kDumpRequest) ||
+      HANDLE_EINTR(sys_read(dump_helper_fd_, &result, sizeof(result))) !=
+          sizeof(result)) {
+    static const char gone_msg[] = "ExceptionHandler::RequestDumpFromHelper \
+                                    the dump helper is gone\n";
+    logger::write(gone_msg, sizeof(gone_msg) - 1);
+    __sync_lock_release(&dump_helper_busy_);
+    return false;
+  }
+  __sync_lock_release(&dump_helper_busy_);
+  *succeeded = result != 0;
+  return true;
+}
+
+// This function may run in a compromised context: see the top of the file.
+bool ExceptionHandler::CloneAndDump(CrashContext *context) {
   PageAllocator allocator;
   uint8_t* stack = (uint8_t*) allocator.Alloc(kChildStackSize);
   if (!stack)
@@ -480,10 +626,7 @@ bool ExceptionHandler::GenerateDump(CrashContext *context) {
     logger::write("\n", 1);
   }
 
-  bool success = r != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
-  if (callback_)
-    success = callback_(minidump_descriptor_, callback_context_, success);
-  return success;
+  return r != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
 }
 
 // This function runs in a compromised context: see the top of the file.
@@ -519,17 +662,24 @@ void ExceptionHandler::WaitForContinueSignal() {
 // Runs on the cloned process.
 bool ExceptionHandler::DoDump(pid_t crashing_process, const void* context,
                               size_t context_size) {
-  if (minidump_descriptor_.IsFD()) {
-    return google_breakpad::WriteMinidump(minidump_descriptor_.fd(),
-                                          minidump_descriptor_.size_limit(),
+  const MinidumpDescriptor& descriptor = minidump_descriptor_;
+  MinidumpWriterOptions options;
+  options.compress = descriptor.compress();
+  options.thread_capture_tasks = descriptor.thread_capture_tasks();
+  options.stack_policy = &descriptor.stack_policy();
+  if (descriptor.IsFD()) {
+    return google_breakpad::WriteMinidump(descriptor.fd(),
+                                          descriptor.size_limit(),
+                                          options,
                                           crashing_process,
                                           context,
                                           context_size,
                                           mapping_list_,
                                           app_memory_list_);
   }
-  return google_breakpad::WriteMinidump(minidump_descriptor_.path(),
-                                        minidump_descriptor_.size_limit(),
+  return google_breakpad::WriteMinidump(descriptor.path(),
+                                        descriptor.size_limit(),
+                                        options,
                                         crashing_process,
                                         context,
                                         context_size,
@@ -537,6 +687,88 @@ bool ExceptionHandler::DoDump(pid_t crashing_process, const void* context,
                                         app_memory_list_);
 }
 
+// Runs before crashing: normal context.
+void ExceptionHandler::UpdateDumpHelper() {
+  // Restart a running helper too: it has our files as they were when it
+  // started, and the descriptor's file may be new.
+  StopDumpHelper();
+  if (!IsOutOfProcess() && minidump_descriptor_.prefork_dump_helper())
+    StartDumpHelper();
+}
+
+// Runs before crashing: normal context.
+bool ExceptionHandler::StartDumpHelper() {
+  int fds[2];
+  if (sys_socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == -1)
+    return false;
+  // The helper lives in our address space, so a stack overflow must fault
+  // on the guard page rather than run into our memory.
+  void* const stack = mmap(NULL, DumpHelperStackMappingSize(),
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (stack == MAP_FAILED) {
+    sys_close(fds[0]);
+    sys_close(fds[1]);
+    return false;
+  }
+  if (mprotect(stack, getpagesize(), PROT_NONE) != 0) {
+    munmap(stack, DumpHelperStackMappingSize());
+    sys_close(fds[0]);
+    sys_close(fds[1]);
+    return false;
+  }
+
+  DumpHelperArgument helper_arg;
+  helper_arg.handler = this;
+  helper_arg.fd = fds[1];
+  dump_helper_parent_ = getpid();
+
+  // Without CLONE_FILES, the helper sees its socket close once we are gone,
+  // or have exec()ed.
+  const pid_t helper = sys_clone(
+      DumpHelperEntry,
+      static_cast<uint8_t*>(stack) + DumpHelperStackMappingSize(),
+      CLONE_VM | CLONE_FS | CLONE_UNTRACED, &helper_arg, NULL, NULL, NULL);
+  sys_close(fds[1]);
+
+  char ready;
+  if (helper == -1 ||
+      HANDLE_EINTR(sys_read(fds[0], &ready, sizeof(ready))) != sizeof(ready)) {
+    if (helper != -1)
+      HANDLE_EINTR(sys_waitpid(helper, NULL, __WALL));
+    sys_close(fds[0]);
+    munmap(stack, DumpHelperStackMappingSize());
+    return false;
+  }
+
+  dump_helper_pid_ = helper;
+  dump_helper_fd_ = fds[0];
+  dump_helper_stack_ = stack;
+  return true;
+}
+
+// Runs before crashing: normal context.
+void ExceptionHandler::StopDumpHelper() {
+  if (dump_helper_pid_ <= 0)
+    return;
+
+  if (getpid() == dump_helper_parent_) {
+    // Children we forked share our end of the socket, so shut the
+    // connection down rather than just closing it.
+    shutdown(dump_helper_fd_, SHUT_RDWR);
+    sys_close(dump_helper_fd_);
+    HANDLE_EINTR(sys_waitpid(dump_helper_pid_, NULL, __WALL));
+  } else {
+    // We were forked from the process which started the helper.
+    sys_close(dump_helper_fd_);
+  }
+  munmap(dump_helper_stack_, DumpHelperStackMappingSize());
+
+  dump_helper_pid_ = -1;
+  dump_helper_fd_ = -1;
+  dump_helper_stack_ = NULL;
+}
+
 // static
 bool ExceptionHandler::WriteMinidump(const string& dump_path,
                                      MinidumpCallback callback,
@@ -547,6 +779,13 @@ bool ExceptionHandler::WriteMinidump(const string& dump_path,
 }
 
 bool ExceptionHandler::WriteMinidump() {
+  pthread_mutex_lock(&write_minidump_mutex_);
+  const bool success = WriteMinidumpLocked();
+  pthread_mutex_unlock(&write_minidump_mutex_);
+  return success;
+}
+
+bool ExceptionHandler::WriteMinidumpLocked() {
   if (!IsOutOfProcess() && !minidump_descriptor_.IsFD()) {
     // Update the path of the minidump so that this can be called multiple times
     // and new files are created for each minidump.  This is done before the
@@ -138,8 +138,11 @@ class ExceptionHandler {
     return minidump_descriptor_;
   }
 
+  // Also starts or stops the dump helper process, as the new descriptor's
+  // prefork_dump_helper() asks.
   void set_minidump_descriptor(const MinidumpDescriptor& descriptor) {
     minidump_descriptor_ = descriptor;
+    UpdateDumpHelper();
   }
 
   void set_crash_handler(HandlerCallback callback) {
@@ -158,7 +161,8 @@ class ExceptionHandler {
   // descriptor is repositioned to its beginning and the previous generated
   // minidump is overwritten.
   // Note that this method is not supposed to be called from a compromised
-  // context as it uses the heap.
+  // context as it uses the heap.  Concurrent calls write their minidumps
+  // one after the other.
   bool WriteMinidump();
 
   // Convenience form of WriteMinidump which does not require an
@@ -226,16 +230,26 @@ class ExceptionHandler {
   static void RestoreHandlersLocked();
 
   void PreresolveSymbols();
+  bool WriteMinidumpLocked();
   bool GenerateDump(CrashContext *context);
+  bool CloneAndDump(CrashContext *context);
+  bool RequestDumpFromHelper(CrashContext *context, bool* succeeded);
   void SendContinueSignalToChild();
   void WaitForContinueSignal();
 
   static void SignalHandler(int sig, siginfo_t* info, void* uc);
   bool HandleSignal(int sig, siginfo_t* info, void* uc);
   static int ThreadEntry(void* arg);
+  static int DumpHelperEntry(void* arg);
   bool DoDump(pid_t crashing_process, const void* context,
               size_t context_size);
 
+  // Starts or stops the dump helper process to match
+  // minidump_descriptor_.prefork_dump_helper().
+  void UpdateDumpHelper();
+  bool StartDumpHelper();
+  void StopDumpHelper();
+
   const FilterCallback filter_;
   const MinidumpCallback callback_;
   void* const callback_context_;
@@ -259,6 +273,31 @@ class ExceptionHandler {
   // ptrace. This is used to store the file descriptors for the pipe
   int fdes[2];
 
+  // When the descriptor asks for it, a process is cloned with CLONE_VM when
+  // the handler is set up and waits on dump_helper_fd_, a socket, for dump
+  // requests.  Sharing our memory, it finds the crash context, the
+  // descriptor and the lists below as they are when a dump is requested, so
+  // nothing needs to be cloned or copied at crash time.  Should the helper
+  // be gone, dumps fall back to cloning a process as usual.
+  // The helper shares the thread-local storage (errno, mostly) of the
+  // thread that started it; it only runs while a dump is being written.
+  pid_t dump_helper_pid_;
+  // The process which started the helper: a child forked since then
+  // cannot use it.
+  pid_t dump_helper_parent_;
+  int dump_helper_fd_;
+  void* dump_helper_stack_;
+  // The crash context of the dump being requested from the helper.
+  const CrashContext* dump_helper_context_;
+  // Non-zero while a dump is being requested from the helper, which serves
+  // one at a time.  A dump asked for meanwhile, by a thread crashing during
+  // WriteMinidump(), clones a process instead of waiting.
+  int dump_helper_busy_;
+
+  // Serializes WriteMinidump() callers, which update the descriptor's path
+  // and share the pipe above.
+  pthread_mutex_t write_minidump_mutex_;
+
   // Callers can add extra info about mappings for cases where the
   // dumper code cannot extract enough information from /proc/<pid>/maps.
   MappingList mapping_list_;
@@ -27,6 +27,7 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <pthread.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <signal.h>
@@ -36,6 +37,7 @@
 #include <sys/uio.h>
 #include <sys/wait.h>
 
+#include <set>
 #include <string>
 
 #include "breakpad_googletest_includes.h"
@@ -155,7 +157,7 @@ static bool DoneCallback(const MinidumpDescriptor& descriptor,
   return true;
 }
 
-void ChildCrash(bool use_fd) {
+void ChildCrash(bool use_fd, bool prefork_dump_helper) {
   AutoTempDir temp_dir;
   int fds[2] = {0};
   int minidump_fd = -1;
@@ -171,12 +173,16 @@ void ChildCrash(bool use_fd) {
     {
       google_breakpad::scoped_ptr<ExceptionHandler> handler;
       if (use_fd) {
-        handler.reset(new ExceptionHandler(MinidumpDescriptor(minidump_fd),
+        MinidumpDescriptor descriptor(minidump_fd);
+        descriptor.set_prefork_dump_helper(prefork_dump_helper);
+        handler.reset(new ExceptionHandler(descriptor,
                                            NULL, NULL, NULL, true, -1));
       } else {
         close(fds[0]);  // Close the reading end.
         void* fd_param = reinterpret_cast<void*>(fds[1]);
-        handler.reset(new ExceptionHandler(MinidumpDescriptor(temp_dir.path()),
+        MinidumpDescriptor descriptor(temp_dir.path());
+        descriptor.set_prefork_dump_helper(prefork_dump_helper);
+        handler.reset(new ExceptionHandler(descriptor,
                                            NULL, DoneCallback, fd_param,
                                            true, -1));
       }
@@ -199,11 +205,19 @@ void ChildCrash(bool use_fd) {
 }
 
 TEST(ExceptionHandlerTest, ChildCrashWithPath) {
-  ASSERT_NO_FATAL_FAILURE(ChildCrash(false));
+  ASSERT_NO_FATAL_FAILURE(ChildCrash(false, false));
 }
 
 TEST(ExceptionHandlerTest, ChildCrashWithFD) {
-  ASSERT_NO_FATAL_FAILURE(ChildCrash(true));
+  ASSERT_NO_FATAL_FAILURE(ChildCrash(true, false));
+}
+
+TEST(ExceptionHandlerTest, ChildCrashWithDumpHelperWithPath) {
+  ASSERT_NO_FATAL_FAILURE(ChildCrash(false, true));
+}
+
+TEST(ExceptionHandlerTest, ChildCrashWithDumpHelperWithFD) {
+  ASSERT_NO_FATAL_FAILURE(ChildCrash(true, true));
 }
 
 static bool DoneCallbackReturnFalse(const MinidumpDescriptor& descriptor,
@@ -1039,6 +1053,113 @@ TEST(ExceptionHandlerTest, AdditionalMemory) {
   delete[] memory;
 }
 
+// Test that the dump helper sees memory registered after it started, and
+// writes each dump to a new file.
+TEST(ExceptionHandlerTest, DumpHelperAdditionalMemory) {
+  const u_int32_t kMemorySize = sysconf(_SC_PAGESIZE);
+
+  u_int8_t* memory = new u_int8_t[kMemorySize];
+  const uintptr_t kMemoryAddress = reinterpret_cast<uintptr_t>(memory);
+  for (u_int32_t i = 0; i < kMemorySize; ++i) {
+    memory[i] = i % 255;
+  }
+
+  AutoTempDir temp_dir;
+  MinidumpDescriptor descriptor(temp_dir.path());
+  descriptor.set_prefork_dump_helper(true);
+  ExceptionHandler handler(descriptor, NULL, NULL, NULL, false, -1);
+
+  handler.RegisterAppMemory(memory, kMemorySize);
+  ASSERT_TRUE(handler.WriteMinidump());
+  string minidump_1_path(handler.minidump_descriptor().path());
+  ASSERT_TRUE(handler.WriteMinidump());
+  string minidump_2_path(handler.minidump_descriptor().path());
+  ASSERT_STRNE(minidump_1_path.c_str(), minidump_2_path.c_str());
+
+  Minidump minidump(minidump_2_path);
+  ASSERT_TRUE(minidump.Read());
+  MinidumpMemoryList* dump_memory_list = minidump.GetMemoryList();
+  ASSERT_TRUE(dump_memory_list);
+  const MinidumpMemoryRegion* region =
+    dump_memory_list->GetMemoryRegionForAddress(kMemoryAddress);
+  ASSERT_TRUE(region);
+  EXPECT_EQ(kMemorySize, region->GetSize());
+  EXPECT_EQ(0, memcmp(region->GetMemory(), memory, kMemorySize));
+
+  unlink(minidump_1_path.c_str());
+  unlink(minidump_2_path.c_str());
+  delete[] memory;
+}
+
+const int kConcurrentDumpThreads = 4;
+const int kConcurrentDumpsPerThread = 3;
+
+// Collects the minidumps written by ConcurrentWriteMinidump.
+struct ConcurrentDumps {
+  ExceptionHandler* handler;
+  pthread_mutex_t mutex;
+  std::set<string> paths;
+  int failures;
+};
+
+bool ConcurrentDumpCallback(const MinidumpDescriptor& descriptor,
+                            void* context,
+                            bool succeeded) {
+  ConcurrentDumps* dumps = reinterpret_cast<ConcurrentDumps*>(context);
+  pthread_mutex_lock(&dumps->mutex);
+  if (succeeded)
+    dumps->paths.insert(descriptor.path());
+  pthread_mutex_unlock(&dumps->mutex);
+  return succeeded;
+}
+
+void* ConcurrentDumpThread(void* arg) {
+  ConcurrentDumps* dumps = reinterpret_cast<ConcurrentDumps*>(arg);
+  for (int i = 0; i < kConcurrentDumpsPerThread; ++i) {
+    if (!dumps->handler->WriteMinidump()) {
+      pthread_mutex_lock(&dumps->mutex);
+      ++dumps->failures;
+      pthread_mutex_unlock(&dumps->mutex);
+    }
+  }
+  return NULL;
+}
+
+// Test that minidumps requested from several threads at once, with the
+// dump helper, are all written, each to its own file.
+TEST(ExceptionHandlerTest, ConcurrentWriteMinidump) {
+  AutoTempDir temp_dir;
+  MinidumpDescriptor descriptor(temp_dir.path());
+  descriptor.set_prefork_dump_helper(true);
+  ConcurrentDumps dumps;
+  pthread_mutex_init(&dumps.mutex, NULL);
+  dumps.failures = 0;
+  ExceptionHandler handler(descriptor, NULL, ConcurrentDumpCallback, &dumps,
+                           false, -1);
+  dumps.handler = &handler;
+
+  pthread_t threads[kConcurrentDumpThreads];
+  for (int i = 0; i < kConcurrentDumpThreads; ++i) {
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, ConcurrentDumpThread,
+                                &dumps));
+  }
+  for (int i = 0; i < kConcurrentDumpThreads; ++i)
+    ASSERT_EQ(0, pthread_join(threads[i], NULL));
+  pthread_mutex_destroy(&dumps.mutex);
+
+  EXPECT_EQ(0, dumps.failures);
+  ASSERT_EQ(static_cast<size_t>(kConcurrentDumpThreads *
+                                kConcurrentDumpsPerThread),
+            dumps.paths.size());
+  for (std::set<string>::const_iterator path = dumps.paths.begin();
+       path != dumps.paths.end(); ++path) {
+    Minidump minidump(*path);
+    ASSERT_TRUE(minidump.Read());
+    ASSERT_TRUE(minidump.GetThreadList());
+    unlink(path->c_str());
+  }
+}
+
 // Test that a memory region that was previously registered
 // can be unregistered.
 TEST(ExceptionHandlerTest, AdditionalMemoryRemove) {
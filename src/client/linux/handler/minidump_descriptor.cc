@@ -38,7 +38,12 @@ namespace google_breakpad {
 MinidumpDescriptor::MinidumpDescriptor(const MinidumpDescriptor& descriptor)
     : fd_(descriptor.fd_),
       directory_(descriptor.directory_),
-      c_path_(NULL) {
+      c_path_(NULL),
+      size_limit_(descriptor.size_limit_),
+      compress_(descriptor.compress_),
+      thread_capture_tasks_(descriptor.thread_capture_tasks_),
+      stack_policy_(descriptor.stack_policy_),
+      prefork_dump_helper_(descriptor.prefork_dump_helper_) {
   // The copy constructor is not allowed to be called on a MinidumpDescriptor
   // with a valid path_, as getting its c_path_ would require the heap which
   // can cause problems in compromised environments.
@@ -51,6 +56,11 @@ MinidumpDescriptor& MinidumpDescriptor::operator=(
 
   fd_ = descriptor.fd_;
   directory_ = descriptor.directory_;
+  size_limit_ = descriptor.size_limit_;
+  compress_ = descriptor.compress_;
+  thread_capture_tasks_ = descriptor.thread_capture_tasks_;
+  stack_policy_ = descriptor.stack_policy_;
+  prefork_dump_helper_ = descriptor.prefork_dump_helper_;
   path_.clear();
   if (c_path_) {
     // This descriptor already had a path set, so generate a new one.
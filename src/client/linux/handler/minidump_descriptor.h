@@ -35,6 +35,7 @@
 
 #include <string>
 
+#include "client/linux/minidump_writer/thread_stack_policy.h"
 #include "common/using_std_string.h"
 
 // The MinidumpDescriptor describes how to access a minidump: it can contain
@@ -45,20 +46,30 @@ namespace google_breakpad {
 
 class MinidumpDescriptor {
  public:
-  MinidumpDescriptor() : fd_(-1) {}
+  MinidumpDescriptor()
+      : fd_(-1),
+        compress_(false),
+        thread_capture_tasks_(1),
+        prefork_dump_helper_(false) {}
 
   explicit MinidumpDescriptor(const string& directory)
       : fd_(-1),
         directory_(directory),
         c_path_(NULL),
-        size_limit_(-1) {
+        size_limit_(-1),
+        compress_(false),
+        thread_capture_tasks_(1),
+        prefork_dump_helper_(false) {
     assert(!directory.empty());
   }
 
   explicit MinidumpDescriptor(int fd)
       : fd_(fd),
         c_path_(NULL),
-        size_limit_(-1) {
+        size_limit_(-1),
+        compress_(false),
+        thread_capture_tasks_(1),
+        prefork_dump_helper_(false) {
     assert(fd != -1);
   }
 
@@ -80,6 +91,31 @@ class MinidumpDescriptor {
   off_t size_limit() const { return size_limit_; }
   void set_size_limit(off_t limit) { size_limit_ = limit; }
 
+  // Whether the minidump is written as a compressed container, which the
+  // processor reads like any other minidump.
+  bool compress() const { return compress_; }
+  void set_compress(bool compress) { compress_ = compress; }
+
+  // How many tasks may copy thread stacks out of the crashed process at
+  // once.  The minidump is the same whatever the number.
+  int thread_capture_tasks() const { return thread_capture_tasks_; }
+  void set_thread_capture_tasks(int tasks) { thread_capture_tasks_ = tasks; }
+
+  // Limits on how much of the thread stacks is written.
+  const ThreadStackPolicy& stack_policy() const { return stack_policy_; }
+  void set_stack_policy(const ThreadStackPolicy& policy) {
+    stack_policy_ = policy;
+  }
+
+  // Whether the ExceptionHandler starts the process that writes its
+  // minidumps when it is given this descriptor, instead of cloning one when
+  // the dump is requested.  With a file descriptor, the file must already be
+  // open by then.
+  bool prefork_dump_helper() const { return prefork_dump_helper_; }
+  void set_prefork_dump_helper(bool prefork) {
+    prefork_dump_helper_ = prefork;
+  }
+
  private:
   // The file descriptor where the minidump is generated.
   int fd_;
@@ -93,6 +129,14 @@ class MinidumpDescriptor {
   const char* c_path_;
 
   off_t size_limit_;
+
+  bool compress_;
+
+  int thread_capture_tasks_;
+
+  ThreadStackPolicy stack_policy_;
+
+  bool prefork_dump_helper_;
 };
 
 }  // namespace google_breakpad
@@ -46,7 +46,25 @@ class LineReader {
   LineReader(int fd)
       : fd_(fd),
         hit_eof_(false),
-        buf_used_(0) {
+        buf_(inline_buf_),
+        buf_size_(sizeof(inline_buf_)),
+        buf_start_(0),
+        buf_used_(0),
+        scanned_(0) {
+  }
+
+  // Reads through |buf|, which holds |buf_size| bytes, instead of the
+  // reader's own kMaxLineLen byte buffer.  A larger buffer lets long files
+  // be read in fewer read() calls, and allows lines of up to |buf_size| - 1
+  // bytes.  The buffer can be reused once the reader is done with it.
+  LineReader(int fd, char* buf, unsigned buf_size)
+      : fd_(fd),
+        hit_eof_(false),
+        buf_(buf),
+        buf_size_(buf_size),
+        buf_start_(0),
+        buf_used_(0),
+        scanned_(0) {
   }
 
   // The maximum length of a line.
@@ -66,37 +84,46 @@ class LineReader {
       if (buf_used_ == 0 && hit_eof_)
         return false;
 
-      for (unsigned i = 0; i < buf_used_; ++i) {
-        if (buf_[i] == '\n' || buf_[i] == 0) {
-          buf_[i] = 0;
-          *len = i;
-          *line = buf_;
+      // Only the bytes that arrived since the last call need scanning.
+      char* const start = buf_ + buf_start_;
+      for (; scanned_ < buf_used_; ++scanned_) {
+        if (start[scanned_] == '\n' || start[scanned_] == 0) {
+          start[scanned_] = 0;
+          *len = scanned_;
+          *line = start;
           return true;
         }
       }
 
-      if (buf_used_ == sizeof(buf_)) {
+      if (buf_used_ == buf_size_) {
         // we scanned the whole buffer and didn't find an end-of-line marker.
         // This line is too long to process.
         return false;
       }
 
+      // Move the partial line to the front of the buffer, to make room for
+      // more data or for the NUL below.
+      if (buf_start_ + buf_used_ == buf_size_) {
+        my_memmove(buf_, start, buf_used_);
+        buf_start_ = 0;
+      }
+
       // We didn't find any end-of-line terminators in the buffer. However, if
       // this is the last line in the file it might not have one:
       if (hit_eof_) {
         assert(buf_used_);
-        // There's room for the NUL because of the buf_used_ == sizeof(buf_)
+        // There's room for the NUL because of the buf_used_ == buf_size_
         // check above.
-        buf_[buf_used_] = 0;
+        buf_[buf_start_ + buf_used_] = 0;
         *len = buf_used_;
         buf_used_ += 1;  // since we appended the NUL.
-        *line = buf_;
+        *line = buf_ + buf_start_;
         return true;
       }
 
       // Otherwise, we should pull in more data from the file
-      const ssize_t n = sys_read(fd_, buf_ + buf_used_,
-                                 sizeof(buf_) - buf_used_);
+      char* const end = buf_ + buf_start_ + buf_used_;
+      const ssize_t n = sys_read(fd_, end, buf_ + buf_size_ - end);
       if (n < 0) {
         return false;
       } else if (n == 0) {
@@ -115,15 +142,23 @@ class LineReader {
 
     assert(buf_used_ >= len + 1);
     buf_used_ -= len + 1;
-    my_memmove(buf_, buf_ + len + 1, buf_used_);
+    buf_start_ = buf_used_ ? buf_start_ + len + 1 : 0;
+    scanned_ = 0;
   }
 
  private:
   const int fd_;
 
   bool hit_eof_;
+  // The buffer lines are read through, and its size.
+  char* const buf_;
+  const unsigned buf_size_;
+  // The unconsumed bytes are buf_[buf_start_, buf_start_ + buf_used_).
+  unsigned buf_start_;
   unsigned buf_used_;
-  char buf_[kMaxLineLen];
+  // How many of the unconsumed bytes are known not to end a line.
+  unsigned scanned_;
+  char inline_buf_[kMaxLineLen];
 };
 
 }  // namespace google_breakpad
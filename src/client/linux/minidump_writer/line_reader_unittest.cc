@@ -195,3 +195,52 @@ TEST(LineReaderTest, TooLong) {
 
   close(fd);
 }
+
+TEST(LineReaderTest, SmallBuffer) {
+  const int fd = TemporaryFile();
+  static const char kData[] = "abc\ndefg\n\nhijklm\nno";
+  const int r = HANDLE_EINTR(write(fd, kData, sizeof(kData) - 1));
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(kData) - 1), r);
+  lseek(fd, 0, SEEK_SET);
+  // Lines straddle the buffer's end and have to be moved to its front.
+  char buffer[8];
+  LineReader reader(fd, buffer, sizeof(buffer));
+
+  static const char* const kLines[] = { "abc", "defg", "", "hijklm", "no" };
+  for (size_t i = 0; i < sizeof(kLines) / sizeof(kLines[0]); ++i) {
+    const char *line;
+    unsigned len;
+    ASSERT_TRUE(reader.GetNextLine(&line, &len));
+    ASSERT_EQ(strlen(kLines[i]), len);
+    ASSERT_STREQ(kLines[i], line);
+    // Asking again gives the same line.
+    ASSERT_TRUE(reader.GetNextLine(&line, &len));
+    ASSERT_STREQ(kLines[i], line);
+    reader.PopLine(len);
+  }
+
+  const char *line;
+  unsigned len;
+  ASSERT_FALSE(reader.GetNextLine(&line, &len));
+
+  close(fd);
+}
+
+TEST(LineReaderTest, SmallBufferTooLong) {
+  const int fd = TemporaryFile();
+  static const char kData[] = "abc\nlonger than the buffer\n";
+  const int r = HANDLE_EINTR(write(fd, kData, sizeof(kData) - 1));
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(kData) - 1), r);
+  lseek(fd, 0, SEEK_SET);
+  char buffer[8];
+  LineReader reader(fd, buffer, sizeof(buffer));
+
+  const char *line;
+  unsigned len;
+  ASSERT_TRUE(reader.GetNextLine(&line, &len));
+  ASSERT_STREQ("abc", line);
+  reader.PopLine(len);
+  ASSERT_FALSE(reader.GetNextLine(&line, &len));
+
+  close(fd);
+}
@@ -76,7 +76,8 @@ LinuxDumper::LinuxDumper(pid_t pid)
       crash_thread_(0),
       threads_(&allocator_, 8),
       mappings_(&allocator_),
-      auxv_(&allocator_, AT_MAX + 1) {
+      auxv_(&allocator_, AT_MAX + 1),
+      proc_read_buffer_(NULL) {
 }
 
 LinuxDumper::~LinuxDumper() {
@@ -161,6 +162,14 @@ bool LinuxDumper::ReadAuxv() {
   return res;
 }
 
+char* LinuxDumper::ProcReadBuffer() {
+  if (!proc_read_buffer_) {
+    proc_read_buffer_ =
+        reinterpret_cast<char*>(allocator_.Alloc(kProcReadBufferSize));
+  }
+  return proc_read_buffer_;
+}
+
 bool LinuxDumper::EnumerateMappings() {
   char maps_path[NAME_MAX];
   if (!BuildProcPath(maps_path, pid_, "maps"))
@@ -180,14 +189,17 @@ bool LinuxDumper::EnumerateMappings() {
   // actual entry point to find the mapping.
   const void* entry_point_loc = reinterpret_cast<void *>(auxv_[AT_ENTRY]);
 
+  char* const buffer = ProcReadBuffer();
+  if (!buffer)
+    return false;
   const int fd = sys_open(maps_path, O_RDONLY, 0);
   if (fd < 0)
     return false;
-  LineReader* const line_reader = new(allocator_) LineReader(fd);
+  LineReader line_reader(fd, buffer, kProcReadBufferSize);
 
   const char* line;
   unsigned line_len;
-  while (line_reader->GetNextLine(&line, &line_len)) {
+  while (line_reader.GetNextLine(&line, &line_len)) {
     uintptr_t start_addr, end_addr, offset;
 
     const char* i1 = my_read_hex_ptr(&start_addr, line);
@@ -198,22 +210,28 @@ bool LinuxDumper::EnumerateMappings() {
         if (*i3 == ' ') {
           const char* name = NULL;
           // Only copy name if the name is a valid path name, or if
-          // it's the VDSO image.
-          if (((name = my_strchr(line, '/')) == NULL) &&
+          // it's the VDSO image.  No '/' can appear in the fields already
+          // parsed, so the search starts after the offset.
+          if (((name = my_strchr(i3, '/')) == NULL) &&
               linux_gate_loc &&
               reinterpret_cast<void*>(start_addr) == linux_gate_loc) {
             name = kLinuxGateLibraryName;
             offset = 0;
           }
+          // The name runs to the end of the line, unless it is the VDSO's.
+          const unsigned name_len = !name ? 0 :
+              name == kLinuxGateLibraryName ? my_strlen(name) :
+              line + line_len - name;
           // Merge adjacent mappings with the same name into one module,
           // assuming they're a single library mapped by the dynamic linker
           if (name && !mappings_.empty()) {
             MappingInfo* module = mappings_.back();
             if ((start_addr == module->start_addr + module->size) &&
-                (my_strlen(name) == my_strlen(module->name)) &&
-                (my_strncmp(name, module->name, my_strlen(name)) == 0)) {
+                (name_len < sizeof(module->name)) &&
+                (module->name[name_len] == '\0') &&
+                (my_strncmp(name, module->name, name_len) == 0)) {
               module->size = end_addr - module->start_addr;
-              line_reader->PopLine(line_len);
+              line_reader.PopLine(line_len);
               continue;
             }
           }
@@ -222,11 +240,8 @@ bool LinuxDumper::EnumerateMappings() {
           module->start_addr = start_addr;
           module->size = end_addr - start_addr;
           module->offset = offset;
-          if (name != NULL) {
-            const unsigned l = my_strlen(name);
-            if (l < sizeof(module->name))
-              my_memcpy(module->name, name, l);
-          }
+          if (name != NULL && name_len < sizeof(module->name))
+            my_memcpy(module->name, name, name_len);
           // If this is the entry-point mapping, and it's not already the
           // first one, then we need to make it be first.  This is because
           // the minidump format assumes the first module is the one that
@@ -249,7 +264,7 @@ bool LinuxDumper::EnumerateMappings() {
         }
       }
     }
-    line_reader->PopLine(line_len);
+    line_reader.PopLine(line_len);
   }
 
   sys_close(fd);
@@ -257,6 +272,15 @@ bool LinuxDumper::EnumerateMappings() {
   return !mappings_.empty();
 }
 
+// Copy the ranges one after another, ignoring |max_tasks|.
+void LinuxDumper::CopyRangesFromProcess(const ProcessMemoryRange* ranges,
+                                        size_t count, int max_tasks) {
+  for (size_t i = 0; i < count; ++i) {
+    CopyFromProcess(ranges[i].dest, ranges[i].child, ranges[i].src,
+                    ranges[i].length);
+  }
+}
+
 // Get information about the stack, given the stack pointer. We don't try to
 // walk the stack since we might not have all the information needed to do
 // unwind. So we just grab, up to, 32k of stack.
@@ -74,6 +74,7 @@ struct ThreadInfo {
 
   uintptr_t stack_pointer;  // thread stack pointer
 
+  char name[16];  // thread name from /proc, empty if unknown
 
 #if defined(__i386) || defined(__x86_64)
   user_regs_struct regs;
@@ -100,6 +101,15 @@ struct MappingInfo {
   char name[NAME_MAX];
 };
 
+// A block of memory to copy out of the process with
+// LinuxDumper::CopyRangesFromProcess().
+struct ProcessMemoryRange {
+  void* dest;       // where to copy to
+  pid_t child;      // thread to copy from
+  const void* src;  // address in the process
+  size_t length;    // bytes to copy
+};
+
 class LinuxDumper {
  public:
   explicit LinuxDumper(pid_t pid);
@@ -139,6 +149,12 @@ class LinuxDumper {
   virtual void CopyFromProcess(void* dest, pid_t child, const void* src,
                                size_t length) = 0;
 
+  // Copies each of the |count| blocks in |ranges| as CopyFromProcess()
+  // would.  Implementations may use up to |max_tasks| tasks to copy blocks
+  // concurrently; this one copies them one after another.
+  virtual void CopyRangesFromProcess(const ProcessMemoryRange* ranges,
+                                     size_t count, int max_tasks);
+
   // Builds a proc path for a certain pid for a node (/proc/<pid>/<node>).
   // |path| is a character array of at least NAME_MAX bytes to return the
   // result.|node| is the final node without any slashes. Returns true on
@@ -181,6 +197,15 @@ class LinuxDumper {
   // Returns true if |path| is modified.
   bool HandleDeletedFileInMapping(char* path) const;
 
+  // The size of the buffer returned by ProcReadBuffer().  Most /proc files
+  // fit in it whole, and /proc/<pid>/maps takes a few reads.
+  static const unsigned kProcReadBufferSize = 64 * 1024;
+
+  // Returns a buffer for reading /proc files through a LineReader, or NULL
+  // if it cannot be allocated.  The same buffer is returned every time, so
+  // only one file can be read through it at once.
+  char* ProcReadBuffer();
+
    // ID of the crashed process.
   const pid_t pid_;
 
@@ -203,6 +228,9 @@ class LinuxDumper {
 
   // Info from /proc/<pid>/auxv
   wasteful_vector<elf_aux_val_t> auxv_;
+
+  // See ProcReadBuffer().
+  char* proc_read_buffer_;
 };
 
 }  // namespace google_breakpad
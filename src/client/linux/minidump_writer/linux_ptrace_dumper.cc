@@ -43,11 +43,17 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
+#include <unistd.h>
 
 #include "client/linux/minidump_writer/directory_reader.h"
 #include "client/linux/minidump_writer/line_reader.h"
@@ -96,6 +102,197 @@ static bool ResumeThread(pid_t pid) {
   return sys_ptrace(PTRACE_DETACH, pid, NULL, NULL) >= 0;
 }
 
+// The number of remote pages handed to a single process_vm_readv call.
+// Each page gets its own iovec so that a partial transfer ends exactly at
+// the first unreadable page. The array lives on what may be a small
+// alternate signal stack, so keep it modest.
+static const size_t kMaxRemoteIovecs = 64;
+
+#if defined(__NR_process_vm_readv)
+// Makes one process_vm_readv call copying up to kMaxRemoteIovecs pages, and
+// at most |length| bytes, starting at |src| in process |child| into |dest|.
+// Stores the number of bytes asked for in |batch| and returns the result of
+// the call.
+static long ReadProcessVMBatch(uint8_t* dest, pid_t child, uintptr_t src,
+                               size_t length, size_t page_size,
+                               size_t* batch) {
+  struct iovec remote[kMaxRemoteIovecs];
+  unsigned long count = 0;
+  *batch = 0;
+  while (count < kMaxRemoteIovecs && *batch < length) {
+    const uintptr_t from = src + *batch;
+    size_t chunk = page_size - (from % page_size);
+    if (chunk > length - *batch)
+      chunk = length - *batch;
+    remote[count].iov_base = reinterpret_cast<void*>(from);
+    remote[count].iov_len = chunk;
+    *batch += chunk;
+    ++count;
+  }
+  struct iovec local;
+  local.iov_base = dest;
+  local.iov_len = *batch;
+  return syscall(__NR_process_vm_readv, child, &local, 1UL, remote, count,
+                 0UL);
+}
+#endif
+
+// Copies up to |length| bytes starting at |src| in process |child| into
+// |dest| using process_vm_readv. Stores the number of bytes copied before
+// the first unreadable page in |copied| and returns true, or returns false
+// if process_vm_readv is not usable for this process.
+static bool CopyUsingProcessVMReadv(void* dest, pid_t child, uintptr_t src,
+                                    size_t length, size_t page_size,
+                                    size_t* copied) {
+#if defined(__NR_process_vm_readv)
+  uint8_t* const local_bytes = static_cast<uint8_t*>(dest);
+  size_t done = 0;
+  while (done < length) {
+    size_t batch;
+    const long r = ReadProcessVMBatch(local_bytes + done, child, src + done,
+                                      length - done, page_size, &batch);
+    if (r < 0) {
+      if (errno == EINTR)
+        continue;
+      // EFAULT means the first page of this batch is unreadable; anything
+      // else means process_vm_readv cannot be used at all.
+      if (errno != EFAULT && done == 0)
+        return false;
+      break;
+    }
+    done += r;
+    if (static_cast<size_t>(r) < batch)
+      break;
+  }
+  *copied = done;
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Copies up to |length| bytes starting at |src| in the process whose
+// /proc/<pid>/mem is open as |mem_fd| into |dest|. Stores the number of
+// bytes copied before the first unreadable page in |copied| and returns
+// true, or returns false if the file cannot be read at all.
+static bool CopyUsingProcMem(void* dest, int mem_fd, uintptr_t src,
+                             size_t length, size_t* copied) {
+  size_t done = 0;
+  while (done < length) {
+    const ssize_t r = sys_pread64(mem_fd, static_cast<uint8_t*>(dest) + done,
+                                  length - done, src + done);
+    if (r > 0) {
+      done += r;
+      continue;
+    }
+    if (r < 0 && errno == EINTR)
+      continue;
+    // EIO means the next page is unreadable; anything else means the file
+    // cannot be used at all.
+    if (r < 0 && errno != EIO && done == 0)
+      return false;
+    break;
+  }
+  *copied = done;
+  return true;
+}
+
+// Copies |length| bytes starting at |src| in process |child| into |dest|
+// one word at a time with PTRACE_PEEKDATA. Words that cannot be read are
+// filled with zeros.
+static void CopyUsingPtrace(uint8_t* dest, pid_t child, const uint8_t* src,
+                            size_t length) {
+  unsigned long tmp = 55;
+  size_t done = 0;
+  static const size_t word_size = sizeof(tmp);
+
+  while (done < length) {
+    const size_t l = (length - done > word_size) ? word_size : (length - done);
+    if (sys_ptrace(PTRACE_PEEKDATA, child, const_cast<uint8_t*>(src + done),
+                   &tmp) == -1) {
+      tmp = 0;
+    }
+    my_memcpy(dest + done, &tmp, l);
+    done += l;
+  }
+}
+
+#if defined(__NR_process_vm_readv)
+// The most helper tasks CopyRangesFromProcess() starts, and the size of
+// each one's stack. Every stack has an inaccessible guard page below it.
+static const int kMaxCopyTasks = 16;
+static const size_t kCopyTaskStackSize = 32 * 1024;
+
+// Work shared by the tasks of CopyRangesFromProcess().
+struct CopyTaskState {
+  const google_breakpad::ProcessMemoryRange* ranges;
+  size_t count;
+  size_t* copied;  // bytes of each range read so far
+  size_t next;     // the next range to claim
+  size_t page_size;
+};
+
+// Claims ranges from |state| until none are left, copying each with
+// process_vm_readv up to the first byte it cannot read. Helper tasks are
+// cloned without CLONE_SETTLS and so share the dumper's errno: this never
+// reads errno, only what the calls return, and the dumper does not read it
+// until the helpers have exited.
+static void CopyClaimedRanges(CopyTaskState* state) {
+  for (;;) {
+    const size_t i = __sync_fetch_and_add(&state->next, 1);
+    if (i >= state->count)
+      return;
+    const google_breakpad::ProcessMemoryRange& range = state->ranges[i];
+    uint8_t* const dest = static_cast<uint8_t*>(range.dest);
+    const uintptr_t src = reinterpret_cast<uintptr_t>(range.src);
+    size_t done = 0;
+    while (done < range.length) {
+      size_t batch;
+      const long r = ReadProcessVMBatch(dest + done, range.child, src + done,
+                                        range.length - done, state->page_size,
+                                        &batch);
+      if (r <= 0)
+        break;
+      done += r;
+      if (static_cast<size_t>(r) < batch)
+        break;
+    }
+    state->copied[i] = done;
+  }
+}
+
+static int CopyTaskEntry(void* arg) {
+  CopyClaimedRanges(static_cast<CopyTaskState*>(arg));
+  return 0;
+}
+
+// Maps |tasks| stacks of kCopyTaskStackSize bytes, each above a PROT_NONE
+// guard page, so that a helper overflowing its stack faults instead of
+// scribbling over its neighbour's. Returns NULL if the memory cannot be had.
+static uint8_t* MapCopyTaskStacks(int tasks, size_t page_size,
+                                  size_t* mapped_size) {
+  const size_t stride = page_size + kCopyTaskStackSize;
+  *mapped_size = tasks * stride;
+#ifdef __x86_64
+  void* stacks = sys_mmap(NULL, *mapped_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#else
+  void* stacks = sys_mmap2(NULL, *mapped_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#endif
+  if (stacks == MAP_FAILED)
+    return NULL;
+  uint8_t* const base = static_cast<uint8_t*>(stacks);
+  for (int i = 0; i < tasks; ++i) {
+    if (sys_mprotect(base + i * stride, page_size, PROT_NONE) != 0) {
+      sys_munmap(stacks, *mapped_size);
+      return NULL;
+    }
+  }
+  return base;
+}
+#endif
+
 namespace google_breakpad {
 
 LinuxPtraceDumper::LinuxPtraceDumper(pid_t pid)
@@ -127,19 +324,150 @@ bool LinuxPtraceDumper::BuildProcPath(char* path, pid_t pid,
 
 void LinuxPtraceDumper::CopyFromProcess(void* dest, pid_t child,
                                         const void* src, size_t length) {
-  unsigned long tmp = 55;
-  size_t done = 0;
-  static const size_t word_size = sizeof(tmp);
   uint8_t* const local = (uint8_t*) dest;
-  uint8_t* const remote = (uint8_t*) src;
+  const uint8_t* const remote = (const uint8_t*) src;
+  size_t done = 0;
 
-  while (done < length) {
-    const size_t l = (length - done > word_size) ? word_size : (length - done);
-    if (sys_ptrace(PTRACE_PEEKDATA, child, remote + done, &tmp) == -1) {
-      tmp = 0;
+  // Anything larger than a word is copied in bulk: with process_vm_readv
+  // where the kernel has it, then by reading /proc/<pid>/mem, which like
+  // PTRACE_PEEKDATA can also see mapped pages that lack PROT_READ. A page
+  // neither can read is handed to the word-by-word loop, so it ends up
+  // zero-filled exactly as before.
+  if (length > sizeof(unsigned long)) {
+    const size_t page_size = getpagesize();
+    bool use_process_vm_readv = true;
+    bool use_proc_mem = true;
+    int mem_fd = -1;
+    while (done < length) {
+      size_t copied;
+      if (use_process_vm_readv) {
+        if (CopyUsingProcessVMReadv(local + done, child,
+                                    reinterpret_cast<uintptr_t>(remote + done),
+                                    length - done, page_size, &copied)) {
+          done += copied;
+          if (done == length)
+            break;
+        } else {
+          use_process_vm_readv = false;
+        }
+      }
+      if (use_proc_mem && mem_fd < 0) {
+        char mem_path[NAME_MAX];
+        if (BuildProcPath(mem_path, child, "mem"))
+          mem_fd = sys_open(mem_path, O_RDONLY, 0);
+        use_proc_mem = mem_fd >= 0;
+      }
+      if (use_proc_mem) {
+        if (CopyUsingProcMem(local + done, mem_fd,
+                             reinterpret_cast<uintptr_t>(remote + done),
+                             length - done, &copied)) {
+          done += copied;
+          if (done == length)
+            break;
+        } else {
+          use_proc_mem = false;
+        }
+      }
+      if (!use_process_vm_readv && !use_proc_mem)
+        break;
+
+      // Neither bulk path could read the page at |remote + done|.
+      const uintptr_t bad = reinterpret_cast<uintptr_t>(remote + done);
+      size_t rest_of_page = page_size - (bad % page_size);
+      if (rest_of_page > length - done)
+        rest_of_page = length - done;
+      CopyUsingPtrace(local + done, child, remote + done, rest_of_page);
+      done += rest_of_page;
+    }
+    if (mem_fd >= 0)
+      sys_close(mem_fd);
+  }
+
+  CopyUsingPtrace(local + done, child, remote + done, length - done);
+}
+
+void LinuxPtraceDumper::CopyRangesFromProcess(const ProcessMemoryRange* ranges,
+                                              size_t count, int max_tasks) {
+  size_t* copied = NULL;
+#if defined(__NR_process_vm_readv)
+  int tasks = 0;
+  if (max_tasks > 1 && count > 1) {
+    tasks = max_tasks - 1;
+    if (static_cast<size_t>(tasks) > count - 1)
+      tasks = count - 1;
+    if (tasks > kMaxCopyTasks)
+      tasks = kMaxCopyTasks;
+  }
+
+  // The kernel stores each task's ID in |task_ids| when it starts and
+  // clears it, waking any futex waiter, when it exits.
+  int* task_ids = NULL;
+  pid_t* pids = NULL;
+  uint8_t* stacks = NULL;
+  size_t stacks_size = 0;
+  const size_t page_size = getpagesize();
+  if (tasks > 0) {
+    copied = reinterpret_cast<size_t*>(
+        allocator_.Alloc(count * sizeof(*copied)));
+    task_ids = reinterpret_cast<int*>(
+        allocator_.Alloc(tasks * sizeof(*task_ids)));
+    pids = reinterpret_cast<pid_t*>(allocator_.Alloc(tasks * sizeof(*pids)));
+    if (copied && task_ids && pids)
+      stacks = MapCopyTaskStacks(tasks, page_size, &stacks_size);
+    if (!stacks)
+      tasks = 0;
+  }
+
+  int started = 0;
+  if (tasks > 0) {
+    my_memset(copied, 0, count * sizeof(*copied));
+    my_memset(task_ids, 0, tasks * sizeof(*task_ids));
+
+    CopyTaskState state;
+    state.ranges = ranges;
+    state.count = count;
+    state.copied = copied;
+    state.next = 0;
+    state.page_size = page_size;
+
+    for (; started < tasks; ++started) {
+      // Stacks grow down, so each task starts at the top of its own.
+      uint8_t* stack =
+          stacks + (started + 1) * (page_size + kCopyTaskStackSize);
+      const pid_t pid = sys_clone(
+          CopyTaskEntry, stack,
+          CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_UNTRACED |
+          CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID,
+          &state, &task_ids[started], NULL, &task_ids[started]);
+      if (pid <= 0)
+        break;
+      pids[started] = pid;
+    }
+    if (started > 0) {
+      CopyClaimedRanges(&state);
+      for (int i = 0; i < started; ++i) {
+        int id;
+        while ((id = *static_cast<volatile int*>(&task_ids[i])) != 0)
+          sys_futex(&task_ids[i], FUTEX_WAIT, id, NULL);
+        sys_waitpid(pids[i], NULL, __WALL);
+      }
+    }
+    sys_munmap(stacks, stacks_size);
+  }
+  if (started == 0)
+    copied = NULL;
+#endif
+
+  // Only this task can use ptrace, so it copies whatever the helpers could
+  // not read.
+  for (size_t i = 0; i < count; ++i) {
+    const size_t done = copied ? copied[i] : 0;
+    if (done < ranges[i].length) {
+      CopyFromProcess(static_cast<uint8_t*>(ranges[i].dest) + done,
+                      ranges[i].child,
+                      static_cast<const uint8_t*>(ranges[i].src) + done,
+                      ranges[i].length - done);
     }
-    my_memcpy(local + done, &tmp, l);
-    done += l;
   }
 }
 
@@ -158,24 +486,33 @@ bool LinuxPtraceDumper::GetThreadInfoByIndex(size_t index, ThreadInfo* info) {
   if (!BuildProcPath(status_path, tid, "status"))
     return false;
 
+  char* const buffer = ProcReadBuffer();
+  if (!buffer)
+    return false;
   const int fd = sys_open(status_path, O_RDONLY, 0);
   if (fd < 0)
     return false;
 
-  LineReader* const line_reader = new(allocator_) LineReader(fd);
+  LineReader line_reader(fd, buffer, kProcReadBufferSize);
   const char* line;
   unsigned line_len;
 
   info->ppid = info->tgid = -1;
+  info->name[0] = '\0';
 
-  while (line_reader->GetNextLine(&line, &line_len)) {
+  // Name: comes before Tgid: and PPid:, so the rest of the file can be
+  // skipped once they are found.
+  while ((info->ppid == -1 || info->tgid == -1) &&
+         line_reader.GetNextLine(&line, &line_len)) {
     if (my_strncmp("Tgid:\t", line, 6) == 0) {
       my_strtoui(&info->tgid, line + 6);
     } else if (my_strncmp("PPid:\t", line, 6) == 0) {
       my_strtoui(&info->ppid, line + 6);
+    } else if (my_strncmp("Name:\t", line, 6) == 0) {
+      my_strlcpy(info->name, line + 6, sizeof(info->name));
     }
 
-    line_reader->PopLine(line_len);
+    line_reader.PopLine(line_len);
   }
   sys_close(fd);
 
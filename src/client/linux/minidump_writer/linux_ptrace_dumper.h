@@ -54,11 +54,21 @@ class LinuxPtraceDumper : public LinuxDumper {
 
   // Implements LinuxDumper::CopyFromProcess().
   // Copies content of |length| bytes from a given process |child|,
-  // starting from |src|, into |dest|. This method uses ptrace to extract
-  // the content from the target process.
+  // starting from |src|, into |dest|. Large copies use process_vm_readv
+  // or /proc/<pid>/mem and fall back to ptrace; bytes that cannot be read
+  // are set to zero.
   virtual void CopyFromProcess(void* dest, pid_t child, const void* src,
                                size_t length);
 
+  // Implements LinuxDumper::CopyRangesFromProcess().
+  // Up to |max_tasks| - 1 helper tasks, cloned into this address space,
+  // read blocks alongside the calling task with process_vm_readv.  Only
+  // this task can use ptrace, so it copies whatever they could not read
+  // afterwards.  The result is the same as copying each block with
+  // CopyFromProcess().
+  virtual void CopyRangesFromProcess(const ProcessMemoryRange* ranges,
+                                     size_t count, int max_tasks);
+
   // Implements LinuxDumper::GetThreadInfoByIndex().
   // Reads information about the |index|-th thread of |threads_|.
   // Returns true on success. One must have called |ThreadsSuspend| first.
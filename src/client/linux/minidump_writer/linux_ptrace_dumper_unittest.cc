@@ -263,6 +263,65 @@ TEST(LinuxPtraceDumperTest, VerifyStackReadWithMultipleThreads) {
   ASSERT_EQ(SIGKILL, WTERMSIG(status));
 }
 
+TEST(LinuxPtraceDumperTest, CopyFromProcessSpansUnreadablePages) {
+  // Lay out eight pages of known data with a hole in the middle and a
+  // page that is mapped but not readable, then copy them out of a child.
+  const size_t kPageSize = sysconf(_SC_PAGESIZE);
+  const size_t kMappingSize = 8 * kPageSize;
+  uint8_t* mapping =
+    reinterpret_cast<uint8_t*>(mmap(NULL,
+                                    kMappingSize,
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS,
+                                    -1,
+                                    0));
+  ASSERT_NE(MAP_FAILED, mapping);
+  for (size_t i = 0; i < kMappingSize; ++i)
+    mapping[i] = static_cast<uint8_t>(i * 7 + 1);
+  ASSERT_EQ(0, munmap(mapping + 3 * kPageSize, kPageSize));
+  ASSERT_EQ(0, mprotect(mapping + 5 * kPageSize, kPageSize, PROT_NONE));
+
+  int fds[2];
+  ASSERT_NE(-1, pipe(fds));
+
+  // Fork a child so ptrace works.
+  const pid_t child = fork();
+  if (child == 0) {
+    close(fds[1]);
+    // Now wait forever for the parent.
+    char b;
+    IGNORE_RET(HANDLE_EINTR(read(fds[0], &b, sizeof(b))));
+    close(fds[0]);
+    syscall(__NR_exit);
+  }
+  close(fds[0]);
+
+  LinuxPtraceDumper dumper(child);
+  ASSERT_TRUE(dumper.Init());
+  ASSERT_TRUE(dumper.ThreadsSuspend());
+
+  // Start and end part way through a page.
+  const size_t kOffset = 13;
+  const size_t kLength = kMappingSize - 2 * kOffset;
+  uint8_t* copy = new uint8_t[kLength];
+  memset(copy, 0xab, kLength);
+  dumper.CopyFromProcess(copy, child, mapping + kOffset, kLength);
+  EXPECT_TRUE(dumper.ThreadsResume());
+  close(fds[1]);
+
+  for (size_t i = 0; i < kLength; ++i) {
+    const size_t offset = kOffset + i;
+    const uint8_t expected = offset / kPageSize == 3 ?
+        0 : static_cast<uint8_t>(offset * 7 + 1);
+    ASSERT_EQ(expected, copy[i]) << "at offset " << offset;
+  }
+  delete[] copy;
+
+  // Leave the hole alone; the dumper's allocator may have been given it.
+  munmap(mapping, 3 * kPageSize);
+  munmap(mapping + 4 * kPageSize, kMappingSize - 4 * kPageSize);
+}
+
 TEST(LinuxPtraceDumperTest, BuildProcPath) {
   const pid_t pid = getpid();
   LinuxPtraceDumper dumper(pid);
@@ -50,6 +50,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <link.h>
 #include <stdio.h>
 #if defined(__ANDROID__)
@@ -76,6 +77,7 @@ namespace {
 
 using google_breakpad::AppMemoryList;
 using google_breakpad::ExceptionHandler;
+using google_breakpad::IdleThreadSignatureList;
 using google_breakpad::LineReader;
 using google_breakpad::LinuxDumper;
 using google_breakpad::LinuxPtraceDumper;
@@ -83,8 +85,11 @@ using google_breakpad::MappingEntry;
 using google_breakpad::MappingInfo;
 using google_breakpad::MappingList;
 using google_breakpad::MinidumpFileWriter;
+using google_breakpad::MinidumpWriterOptions;
 using google_breakpad::PageAllocator;
+using google_breakpad::ProcessMemoryRange;
 using google_breakpad::ThreadInfo;
+using google_breakpad::ThreadStackPolicy;
 using google_breakpad::TypedMDRVA;
 using google_breakpad::UntypedMDRVA;
 using google_breakpad::wasteful_vector;
@@ -409,7 +414,12 @@ class MinidumpWriter {
 #endif
         dumper_(dumper),
         minidump_size_limit_(-1),
+        compress_(false),
+        thread_capture_tasks_(1),
+        stack_policy_(NULL),
+        crashing_thread_context_(),
         memory_blocks_(dumper_->allocator()),
+        pending_memory_(dumper_->allocator()),
         mapping_list_(mappings),
         app_memory_list_(appmem) {
     // Assert there should be either a valid fd or a valid path, not both.
@@ -426,6 +436,9 @@ class MinidumpWriter {
     else if (!minidump_writer_.Open(path_))
       return false;
 
+    if (compress_ && !minidump_writer_.EnableCompression())
+      return false;
+
     return dumper_->ThreadsSuspend();
   }
 
@@ -456,6 +469,10 @@ class MinidumpWriter {
     header.get()->stream_count = kNumWriters;
     header.get()->stream_directory_rva = dir.position();
 
+    // Size the file once, up front. Most of a minidump is thread stacks.
+    minidump_writer_.Reserve(kLimitMinidumpFudgeFactor +
+        dumper_->threads().size() * kLimitAverageThreadStackLength);
+
     unsigned dir_index = 0;
     MDRawDirectory dirent;
 
@@ -526,13 +543,19 @@ class MinidumpWriter {
     // above.
 
     dumper_->ThreadsResume();
-    return true;
+
+    // The header is otherwise only written when it goes out of scope, after
+    // the last chance to report a failed write.
+    if (!header.Flush())
+      return false;
+    return minidump_writer_.Flush();
   }
 
   // Check if the top of the stack is part of a system call that has been
   // redirected by the seccomp sandbox. If so, try to pop the stack frames
   // all the way back to the point where the interception happened.
-  void PopSeccompStackFrame(RawContextCPU* cpu, const MDRawThread& thread,
+  // Returns true if |cpu| was changed.
+  bool PopSeccompStackFrame(RawContextCPU* cpu, const MDRawThread& thread,
                             uint8_t* stack_copy) {
 #if defined(__x86_64)
     u_int64_t bp = cpu->rbp;
@@ -594,7 +617,7 @@ class MinidumpWriter {
         cpu->r14 = seccomp_stackframe.r14;
         cpu->r15 = seccomp_stackframe.r15;
         cpu->rip = seccomp_stackframe.fakeret;
-        return;
+        return true;
       }
     }
 #elif defined(__i386)
@@ -640,33 +663,102 @@ class MinidumpWriter {
         cpu->ebp = seccomp_stackframe.ebp;
         cpu->esp = top + 4*sizeof(void*);
         cpu->eip = seccomp_stackframe.fakeret;
-        return;
+        return true;
       }
     }
 #endif
+    return false;
+  }
+
+  // A block of the process's memory, copied to |copy|, to be written with
+  // the memory list stream.
+  struct MemoryBlock {
+    uintptr_t start;
+    size_t length;
+    uint8_t* copy;
+    // Where to write the location of the block once it is written, or 0.
+    MDRVA location_rva;
+  };
+
+  // Queues |length| bytes at |src| in thread |child| to be copied by
+  // CopyPendingMemory(), and written with the memory list stream.  If
+  // |location_rva| is not 0, the MDLocationDescriptor there is pointed at
+  // the bytes once they are written.  Returns the buffer they will be
+  // copied to, or NULL on failure.
+  uint8_t* QueueMemoryCopy(pid_t child, const void* src, size_t length,
+                           MDRVA location_rva) {
+    uint8_t* copy = reinterpret_cast<uint8_t*>(Alloc(length));
+    if (!copy)
+      return NULL;
+    ProcessMemoryRange range = { copy, child, src, length };
+    pending_memory_.push_back(range);
+    MemoryBlock block = {
+      reinterpret_cast<uintptr_t>(src), length, copy, location_rva
+    };
+    memory_blocks_.push_back(block);
+    return copy;
+  }
+
+  // Copies the memory queued by QueueMemoryCopy() out of the process, using
+  // up to thread_capture_tasks_ tasks.
+  void CopyPendingMemory() {
+    if (pending_memory_.empty())
+      return;
+    dumper_->CopyRangesFromProcess(&pending_memory_[0], pending_memory_.size(),
+                                   thread_capture_tasks_);
+    pending_memory_.resize(0);
   }
 
-  bool FillThreadStack(MDRawThread* thread, uintptr_t stack_pointer,
-                       int max_stack_len, uint8_t** stack_copy) {
+  // A thread context that was written before the thread's stack was
+  // copied, to be checked with PopSeccompStackFrame() afterwards.
+  struct PendingContext {
+    RawContextCPU* cpu;
+    MDRVA rva;
+    MDRawThread thread;
+    uint8_t* stack_copy;
+  };
+
+  // Keeps a copy of |cpu| so that it can be fixed up once |stack_copy|
+  // holds the stack of |thread|.  If there is no memory for the copy, the
+  // context is written as it is, without the check.
+  void QueueSeccompCheck(TypedMDRVA<RawContextCPU>* cpu,
+                         const MDRawThread& thread, uint8_t* stack_copy,
+                         wasteful_vector<PendingContext>* pending_contexts) {
+    PendingContext pending;
+    pending.cpu = reinterpret_cast<RawContextCPU*>(
+        Alloc(sizeof(RawContextCPU)));
+    if (!pending.cpu)
+      return;
+    my_memcpy(pending.cpu, cpu->get(), sizeof(RawContextCPU));
+    pending.rva = cpu->position();
+    pending.thread = thread;
+    pending.stack_copy = stack_copy;
+    pending_contexts->push_back(pending);
+  }
+
+  // |location_rva| is where the minidump holds the location of |thread|'s
+  // stack.
+  bool FillThreadStack(MDRawThread* thread, MDRVA location_rva,
+                       uintptr_t stack_pointer, int max_stack_len,
+                       uint8_t** stack_copy) {
     *stack_copy = NULL;
     const void* stack;
     size_t stack_len;
-    if (dumper_->GetStackInfo(&stack, &stack_len, stack_pointer)) {
-      UntypedMDRVA memory(&minidump_writer_);
+    if (max_stack_len != 0 &&
+        dumper_->GetStackInfo(&stack, &stack_len, stack_pointer)) {
       if (max_stack_len >= 0 &&
           stack_len > static_cast<unsigned int>(max_stack_len)) {
         stack_len = max_stack_len;
       }
-      if (!memory.Allocate(stack_len))
+      *stack_copy = QueueMemoryCopy(thread->thread_id, stack, stack_len,
+                                    location_rva);
+      if (!*stack_copy)
         return false;
-      *stack_copy = reinterpret_cast<uint8_t*>(Alloc(stack_len));
-      dumper_->CopyFromProcess(*stack_copy, thread->thread_id, stack,
-                               stack_len);
-      memory.Copy(*stack_copy, stack_len);
       thread->stack.start_of_memory_range =
           reinterpret_cast<uintptr_t>(stack);
-      thread->stack.memory = memory.location();
-      memory_blocks_.push_back(thread->stack);
+      // The stack is placed when the memory list stream is written.
+      thread->stack.memory.data_size = stack_len;
+      thread->stack.memory.rva = 0;
     } else {
       thread->stack.start_of_memory_range = stack_pointer;
       thread->stack.memory.data_size = 0;
@@ -675,6 +767,42 @@ class MinidumpWriter {
     return true;
   }
 
+  // Returns the tighter of two stack length limits, where a negative limit
+  // means none.
+  static int MinStackLen(int limit, off_t other) {
+    if (other < 0 || (limit >= 0 && limit <= other))
+      return limit;
+    return other < INT_MAX ? static_cast<int>(other) : INT_MAX;
+  }
+
+  // Returns true if |info| matches one of the idle thread signatures of
+  // |stack_policy_|.
+  bool IsIdleThread(const ThreadInfo& info) {
+    const IdleThreadSignatureList& idle_threads = stack_policy_->idle_threads;
+    if (idle_threads.empty())
+      return false;
+
+    const char* module_name = "";
+    const MappingInfo* mapping = dumper_->FindMapping(
+        reinterpret_cast<const void*>(GetInstructionPointer(info)));
+    if (mapping) {
+      module_name = my_strrchr(mapping->name, '/');
+      module_name = module_name ? module_name + 1 : mapping->name;
+    }
+
+    for (IdleThreadSignatureList::const_iterator iter = idle_threads.begin();
+         iter != idle_threads.end();
+         ++iter) {
+      if (my_strncmp(info.name, iter->thread_name.c_str(),
+                     iter->thread_name.size()) == 0 &&
+          my_strncmp(module_name, iter->module_name.c_str(),
+                     iter->module_name.size()) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   // Write information about the threads.
   bool WriteThreadListStream(MDRawDirectory* dirent) {
     const unsigned num_threads = dumper_->threads().size();
@@ -694,9 +822,30 @@ class MinidumpWriter {
     // that any thread beyond the first kLimitBaseThreadCount threads will
     // have only kLimitMaxExtraThreadStackLen bytes dumped.
     int extra_thread_stack_len = -1;  // default to no maximum
+    wasteful_vector<PendingContext> pending_contexts(dumper_->allocator(),
+                                                     num_threads);
+
+    // The threads other than the crashing one share the stack policy's
+    // total budget, if it has one.
+    off_t stack_budget = -1;
+    unsigned stack_budget_threads = 0;
+    if (stack_policy_ && stack_policy_->max_total_stack_len >= 0) {
+      stack_budget = stack_policy_->max_total_stack_len;
+      for (unsigned i = 0; i < num_threads; ++i) {
+        if (dumper_->threads()[i] != GetCrashThread())
+          ++stack_budget_threads;
+      }
+    }
+
     if (minidump_size_limit_ >= 0) {
-      const unsigned estimated_total_stack_size = num_threads *
+      off_t estimated_total_stack_size = num_threads *
           kLimitAverageThreadStackLength;
+      if (stack_budget >= 0 &&
+          stack_budget + kLimitAverageThreadStackLength <
+              estimated_total_stack_size) {
+        estimated_total_stack_size =
+            stack_budget + kLimitAverageThreadStackLength;
+      }
       const off_t estimated_minidump_size = minidump_writer_.position() +
           estimated_total_stack_size + kLimitMinidumpFudgeFactor;
       if (estimated_minidump_size > minidump_size_limit_)
@@ -707,6 +856,8 @@ class MinidumpWriter {
       MDRawThread thread;
       my_memset(&thread, 0, sizeof(thread));
       thread.thread_id = dumper_->threads()[i];
+      const MDRVA stack_location_rva = list.position() + sizeof(uint32_t) +
+          i * sizeof(MDRawThread) + offsetof(MDRawThread, stack.memory);
 
       // We have a different source of information for the crashing thread. If
       // we used the actual state of the thread we would find it running in the
@@ -716,7 +867,8 @@ class MinidumpWriter {
           ucontext_ &&
           !dumper_->IsPostMortem()) {
         uint8_t* stack_copy;
-        if (!FillThreadStack(&thread, GetStackPointer(), -1, &stack_copy))
+        if (!FillThreadStack(&thread, stack_location_rva, GetStackPointer(), -1,
+                             &stack_copy))
           return false;
 
         // Copy 256 bytes around crashing instruction pointer to minidump.
@@ -747,19 +899,12 @@ class MinidumpWriter {
         }
 
         if (ip_is_mapped) {
-          UntypedMDRVA ip_memory(&minidump_writer_);
-          if (!ip_memory.Allocate(ip_memory_d.memory.data_size))
+          if (!QueueMemoryCopy(
+                  thread.thread_id,
+                  reinterpret_cast<void*>(ip_memory_d.start_of_memory_range),
+                  ip_memory_d.memory.data_size, 0)) {
             return false;
-          uint8_t* memory_copy =
-              reinterpret_cast<uint8_t*>(Alloc(ip_memory_d.memory.data_size));
-          dumper_->CopyFromProcess(
-              memory_copy,
-              thread.thread_id,
-              reinterpret_cast<void*>(ip_memory_d.start_of_memory_range),
-              ip_memory_d.memory.data_size);
-          ip_memory.Copy(memory_copy, ip_memory_d.memory.data_size);
-          ip_memory_d.memory = ip_memory.location();
-          memory_blocks_.push_back(ip_memory_d);
+          }
         }
 
         TypedMDRVA<RawContextCPU> cpu(&minidump_writer_);
@@ -768,7 +913,7 @@ class MinidumpWriter {
         my_memset(cpu.get(), 0, sizeof(RawContextCPU));
         CPUFillFromUContext(cpu.get(), ucontext_, float_state_);
         if (stack_copy)
-          PopSeccompStackFrame(cpu.get(), thread, stack_copy);
+          QueueSeccompCheck(&cpu, thread, stack_copy, &pending_contexts);
         thread.thread_context = cpu.location();
         crashing_thread_context_ = cpu.location();
       } else {
@@ -780,9 +925,25 @@ class MinidumpWriter {
         int max_stack_len = -1;  // default to no maximum for this thread
         if (minidump_size_limit_ >= 0 && i >= kLimitBaseThreadCount)
           max_stack_len = extra_thread_stack_len;
-        if (!FillThreadStack(&thread, info.stack_pointer, max_stack_len,
-            &stack_copy))
+        const bool use_stack_policy =
+            stack_policy_ && dumper_->threads()[i] != GetCrashThread();
+        if (use_stack_policy) {
+          if (IsIdleThread(info))
+            max_stack_len = 0;
+          max_stack_len = MinStackLen(max_stack_len,
+                                      stack_policy_->max_thread_stack_len);
+          if (stack_budget >= 0) {
+            max_stack_len = MinStackLen(max_stack_len,
+                                        stack_budget / stack_budget_threads);
+          }
+        }
+        if (!FillThreadStack(&thread, stack_location_rva, info.stack_pointer,
+                             max_stack_len, &stack_copy))
           return false;
+        if (use_stack_policy && stack_budget >= 0) {
+          stack_budget -= thread.stack.memory.data_size;
+          --stack_budget_threads;
+        }
 
         TypedMDRVA<RawContextCPU> cpu(&minidump_writer_);
         if (!cpu.Allocate())
@@ -790,7 +951,7 @@ class MinidumpWriter {
         my_memset(cpu.get(), 0, sizeof(RawContextCPU));
         CPUFillFromThreadInfo(cpu.get(), info);
         if (stack_copy)
-          PopSeccompStackFrame(cpu.get(), thread, stack_copy);
+          QueueSeccompCheck(&cpu, thread, stack_copy, &pending_contexts);
         thread.thread_context = cpu.location();
         if (dumper_->threads()[i] == GetCrashThread()) {
           crashing_thread_context_ = cpu.location();
@@ -806,29 +967,35 @@ class MinidumpWriter {
       list.CopyIndexAfterObject(i, &thread, sizeof(thread));
     }
 
+    // The stacks are only read now, all together, which lets the dumper
+    // read them concurrently.  They are written with the memory list.
+    CopyPendingMemory();
+    for (size_t i = 0; i < pending_contexts.size(); ++i) {
+      PendingContext& pending = pending_contexts[i];
+      if (PopSeccompStackFrame(pending.cpu, pending.thread,
+                               pending.stack_copy)) {
+        minidump_writer_.Copy(pending.rva, pending.cpu, sizeof(RawContextCPU));
+      }
+      Free(pending.cpu, sizeof(RawContextCPU));
+    }
+
     return true;
   }
 
-  // Write application-provided memory regions.
+  // Copy application-provided memory regions, to be written with the memory
+  // list.
   bool WriteAppMemory() {
     for (AppMemoryList::const_iterator iter = app_memory_list_.begin();
          iter != app_memory_list_.end();
          ++iter) {
-      uint8_t* data_copy =
-        reinterpret_cast<uint8_t*>(dumper_->allocator()->Alloc(iter->length));
-      dumper_->CopyFromProcess(data_copy, GetCrashThread(), iter->ptr,
-                               iter->length);
-
-      UntypedMDRVA memory(&minidump_writer_);
-      if (!memory.Allocate(iter->length)) {
+      // ExceptionHandler::RegisterAppMemory accepts empty regions, but
+      // there is nothing to write for them.
+      if (!iter->length)
+        continue;
+      if (!QueueMemoryCopy(GetCrashThread(), iter->ptr, iter->length, 0))
         return false;
-      }
-      memory.Copy(data_copy, iter->length);
-      MDMemoryDescriptor desc;
-      desc.start_of_memory_range = reinterpret_cast<uintptr_t>(iter->ptr);
-      desc.memory = memory.location();
-      memory_blocks_.push_back(desc);
     }
+    CopyPendingMemory();
 
     return true;
   }
@@ -973,11 +1140,43 @@ class MinidumpWriter {
     return true;
   }
 
+  static bool MemoryBlockStartsBefore(const MemoryBlock& a,
+                                     const MemoryBlock& b) {
+    return a.start < b.start;
+  }
+
+  // Returns the index of the first block after |first| which neither
+  // overlaps nor touches the ones from |first| up to it, and sets |end| to
+  // where those end.  The blocks must be sorted by address.
+  size_t FindMemoryRangeEnd(size_t first, uintptr_t* end) {
+    *end = memory_blocks_[first].start + memory_blocks_[first].length;
+    size_t next = first + 1;
+    for (; next < memory_blocks_.size() &&
+           memory_blocks_[next].start <= *end; ++next) {
+      *end = std::max(*end,
+                      memory_blocks_[next].start + memory_blocks_[next].length);
+    }
+    return next;
+  }
+
+  // Writes the blocks of memory copied so far, and a memory list stream
+  // describing them.  Blocks that overlap or touch are written as one
+  // range, so no byte of the process is written twice, and the ranges are
+  // listed in address order.
   bool WriteMemoryListStream(MDRawDirectory* dirent) {
+    const size_t num_blocks = memory_blocks_.size();
+    size_t num_ranges = 0;
+    if (num_blocks) {
+      std::sort(&memory_blocks_[0], &memory_blocks_[0] + num_blocks,
+                MemoryBlockStartsBefore);
+      uintptr_t end;
+      for (size_t i = 0; i < num_blocks; i = FindMemoryRangeEnd(i, &end))
+        ++num_ranges;
+    }
+
     TypedMDRVA<uint32_t> list(&minidump_writer_);
-    if (memory_blocks_.size()) {
-      if (!list.AllocateObjectAndArray(memory_blocks_.size(),
-                                       sizeof(MDMemoryDescriptor)))
+    if (num_ranges) {
+      if (!list.AllocateObjectAndArray(num_ranges, sizeof(MDMemoryDescriptor)))
         return false;
     } else {
       // Still create the memory list stream, although it will have zero
@@ -989,12 +1188,35 @@ class MinidumpWriter {
     dirent->stream_type = MD_MEMORY_LIST_STREAM;
     dirent->location = list.location();
 
-    *list.get() = memory_blocks_.size();
+    *list.get() = num_ranges;
 
-    for (size_t i = 0; i < memory_blocks_.size(); ++i) {
-      list.CopyIndexAfterObject(i, &memory_blocks_[i],
-                                sizeof(MDMemoryDescriptor));
+    size_t range = 0;
+    for (size_t first = 0; first < num_blocks; ++range) {
+      uintptr_t end;
+      const size_t next = FindMemoryRangeEnd(first, &end);
+      const uintptr_t start = memory_blocks_[first].start;
+      UntypedMDRVA memory(&minidump_writer_);
+      if (!memory.Allocate(end - start))
+        return false;
+
+      for (; first < next; ++first) {
+        const MemoryBlock& block = memory_blocks_[first];
+        MDLocationDescriptor location;
+        location.data_size = block.length;
+        location.rva = memory.position() + (block.start - start);
+        minidump_writer_.Copy(location.rva, block.copy, block.length);
+        if (block.location_rva)
+          minidump_writer_.Copy(block.location_rva, &location,
+                                sizeof(location));
+        Free(block.copy, block.length);
+      }
+
+      MDMemoryDescriptor desc;
+      desc.start_of_memory_range = start;
+      desc.memory = memory.location();
+      list.CopyIndexAfterObject(range, &desc, sizeof(desc));
     }
+    memory_blocks_.resize(0);
     return true;
   }
 
@@ -1154,12 +1376,21 @@ class MinidumpWriter {
   }
 
   void set_minidump_size_limit(off_t limit) { minidump_size_limit_ = limit; }
+  void set_compress(bool compress) { compress_ = compress; }
+  void set_thread_capture_tasks(int tasks) { thread_capture_tasks_ = tasks; }
+  void set_stack_policy(const ThreadStackPolicy* policy) {
+    stack_policy_ = policy;
+  }
 
  private:
   void* Alloc(unsigned bytes) {
     return dumper_->allocator()->Alloc(bytes);
   }
 
+  void Free(void* p, unsigned bytes) {
+    dumper_->allocator()->Free(p, bytes);
+  }
+
   pid_t GetCrashThread() const {
     return dumper_->crash_thread();
   }
@@ -1380,18 +1611,21 @@ class MinidumpWriter {
     UntypedMDRVA memory(&minidump_writer_);
     if (!memory.Allocate(total))
       return false;
-    for (MDRVA pos = memory.position(); buffers; buffers = buffers->next) {
+    for (MDRVA pos = memory.position(); buffers;) {
+      Buffers* const next = buffers->next;
       // Check for special case of a zero-length buffer.  This should only
       // occur if a file's size happens to be a multiple of the buffer's
       // size, in which case the final sys_read() will have resulted in
       // zero bytes being read after the final buffer was just allocated.
       if (buffers->len == 0) {
         // This can only occur with final buffer.
-        assert(buffers->next == NULL);
-        continue;
+        assert(next == NULL);
+      } else {
+        memory.Copy(pos, &buffers->data, buffers->len);
+        pos += buffers->len;
       }
-      memory.Copy(pos, &buffers->data, buffers->len);
-      pos += buffers->len;
+      Free(buffers, sizeof(Buffers));
+      buffers = next;
     }
     *result = memory.location();
     return true;
@@ -1481,11 +1715,16 @@ class MinidumpWriter {
   LinuxDumper* dumper_;
   MinidumpFileWriter minidump_writer_;
   off_t minidump_size_limit_;
+  bool compress_;  // Whether to write a compressed container.
+  // How many tasks may copy thread stacks at once.
+  int thread_capture_tasks_;
+  // Limits on the thread stacks written, or NULL for none.
+  const ThreadStackPolicy* stack_policy_;
   MDLocationDescriptor crashing_thread_context_;
-  // Blocks of memory written to the dump. These are all currently
-  // written while writing the thread list stream, but saved here
-  // so a memory list stream can be written afterwards.
-  wasteful_vector<MDMemoryDescriptor> memory_blocks_;
+  // Blocks of memory to write to the dump, with the memory list stream.
+  wasteful_vector<MemoryBlock> memory_blocks_;
+  // Memory queued by QueueMemoryCopy() and not yet copied.
+  wasteful_vector<ProcessMemoryRange> pending_memory_;
   // Additional information about some mappings provided by the caller.
   const MappingList& mapping_list_;
   // Additional memory regions to be included in the dump,
@@ -1497,6 +1736,7 @@ class MinidumpWriter {
 bool WriteMinidumpImpl(const char* minidump_path,
                        int minidump_fd,
                        off_t minidump_size_limit,
+                       const MinidumpWriterOptions& options,
                        pid_t crashing_process,
                        const void* blob, size_t blob_size,
                        const MappingList& mappings,
@@ -1516,6 +1756,9 @@ bool WriteMinidumpImpl(const char* minidump_path,
                         appmem, &dumper);
   // Set desired limit for file size of minidump (-1 means no limit).
   writer.set_minidump_size_limit(minidump_size_limit);
+  writer.set_compress(options.compress);
+  writer.set_thread_capture_tasks(options.thread_capture_tasks);
+  writer.set_stack_policy(options.stack_policy);
   if (!writer.Init())
     return false;
   return writer.Dump();
@@ -1527,14 +1770,14 @@ namespace google_breakpad {
 
 bool WriteMinidump(const char* minidump_path, pid_t crashing_process,
                    const void* blob, size_t blob_size) {
-  return WriteMinidumpImpl(minidump_path, -1, -1,
+  return WriteMinidumpImpl(minidump_path, -1, -1, MinidumpWriterOptions(),
                            crashing_process, blob, blob_size,
                            MappingList(), AppMemoryList());
 }
 
 bool WriteMinidump(int minidump_fd, pid_t crashing_process,
                    const void* blob, size_t blob_size) {
-  return WriteMinidumpImpl(NULL, minidump_fd, -1,
+  return WriteMinidumpImpl(NULL, minidump_fd, -1, MinidumpWriterOptions(),
                            crashing_process, blob, blob_size,
                            MappingList(), AppMemoryList());
 }
@@ -1556,8 +1799,8 @@ bool WriteMinidump(const char* minidump_path, pid_t crashing_process,
                    const void* blob, size_t blob_size,
                    const MappingList& mappings,
                    const AppMemoryList& appmem) {
-  return WriteMinidumpImpl(minidump_path, -1, -1, crashing_process,
-                           blob, blob_size,
+  return WriteMinidumpImpl(minidump_path, -1, -1, MinidumpWriterOptions(),
+                           crashing_process, blob, blob_size,
                            mappings, appmem);
 }
 
@@ -1565,8 +1808,8 @@ bool WriteMinidump(int minidump_fd, pid_t crashing_process,
                    const void* blob, size_t blob_size,
                    const MappingList& mappings,
                    const AppMemoryList& appmem) {
-  return WriteMinidumpImpl(NULL, minidump_fd, -1, crashing_process,
-                           blob, blob_size,
+  return WriteMinidumpImpl(NULL, minidump_fd, -1, MinidumpWriterOptions(),
+                           crashing_process, blob, blob_size,
                            mappings, appmem);
 }
 
@@ -1576,16 +1819,38 @@ bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
                    const MappingList& mappings,
                    const AppMemoryList& appmem) {
   return WriteMinidumpImpl(minidump_path, -1, minidump_size_limit,
+                           MinidumpWriterOptions(), crashing_process,
+                           blob, blob_size, mappings, appmem);
+}
+
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem) {
+  return WriteMinidumpImpl(NULL, minidump_fd, minidump_size_limit,
+                           MinidumpWriterOptions(), crashing_process,
+                           blob, blob_size, mappings, appmem);
+}
+
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   const MinidumpWriterOptions& options,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem) {
+  return WriteMinidumpImpl(minidump_path, -1, minidump_size_limit, options,
                            crashing_process, blob, blob_size,
                            mappings, appmem);
 }
 
 bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   const MinidumpWriterOptions& options,
                    pid_t crashing_process,
                    const void* blob, size_t blob_size,
                    const MappingList& mappings,
                    const AppMemoryList& appmem) {
-  return WriteMinidumpImpl(NULL, minidump_fd, minidump_size_limit,
+  return WriteMinidumpImpl(NULL, minidump_fd, minidump_size_limit, options,
                            crashing_process, blob, blob_size,
                            mappings, appmem);
 }
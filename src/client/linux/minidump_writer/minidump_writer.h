@@ -35,9 +35,12 @@
 #include <unistd.h>
 
 #include <list>
+#include <string>
 #include <utility>
 
 #include "client/linux/minidump_writer/linux_dumper.h"
+#include "client/linux/minidump_writer/thread_stack_policy.h"
+#include "common/using_std_string.h"
 #include "google_breakpad/common/minidump_format.h"
 
 namespace google_breakpad {
@@ -115,6 +118,40 @@ bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
                    const MappingList& mappings,
                    const AppMemoryList& appdata);
 
+// How WriteMinidump() writes the minidump, beyond what goes into it.  The
+// defaults give the same minidump as the overloads above.
+struct MinidumpWriterOptions {
+  MinidumpWriterOptions()
+      : compress(false),
+        thread_capture_tasks(1),
+        stack_policy(NULL) {}
+
+  // Whether to write the minidump as a compressed container (see
+  // common/minidump_compression.h).  The processor's Minidump class reads
+  // these directly.
+  bool compress;
+  // How many tasks may copy thread stacks out of the process at once.  The
+  // minidump is the same as with one task.
+  int thread_capture_tasks;
+  // Limits on how much of the thread stacks is written, or NULL for none.
+  // Not copied, so that the options can be filled in without allocating.
+  const ThreadStackPolicy* stack_policy;
+};
+
+// These overloads also take the options above.
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   const MinidumpWriterOptions& options,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata);
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   const MinidumpWriterOptions& options,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata);
+
 bool WriteMinidump(const char* filename,
                    const MappingList& mappings,
                    const AppMemoryList& appdata,
@@ -35,6 +35,7 @@
 #include <ucontext.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <string>
 
 #include "breakpad_googletest_includes.h"
@@ -500,6 +501,112 @@ TEST(MinidumpWriterTest, AdditionalMemory) {
   close(fds[1]);
 }
 
+// Test that overlapping and adjacent memory regions are written once, as
+// one region, and that thread stacks still point at the right memory.
+TEST(MinidumpWriterTest, CoalescedMemory) {
+  int fds[2];
+  ASSERT_NE(-1, pipe(fds));
+
+  const u_int32_t kPageSize = sysconf(_SC_PAGESIZE);
+  const u_int32_t kMemorySize = 3 * kPageSize;
+  u_int8_t* memory = new u_int8_t[kMemorySize];
+  const uintptr_t kMemoryAddress = reinterpret_cast<uintptr_t>(memory);
+  for (u_int32_t i = 0; i < kMemorySize; ++i) {
+    memory[i] = i % 255;
+  }
+  // Something on this thread's stack, which the child's stack shares.
+  u_int8_t stack_bytes[64];
+  memset(stack_bytes, 0x5a, sizeof(stack_bytes));
+
+  const pid_t child = fork();
+  if (child == 0) {
+    close(fds[1]);
+    char b;
+    HANDLE_EINTR(read(fds[0], &b, sizeof(b)));
+    close(fds[0]);
+    syscall(__NR_exit);
+  }
+  close(fds[0]);
+
+  ExceptionHandler::CrashContext context;
+  ASSERT_EQ(0, getcontext(&context.context));
+  context.tid = child;
+
+  AutoTempDir temp_dir;
+  string templ = temp_dir.path() + kMDWriterUnitTestFileName;
+
+  // The first two pages, as two adjacent regions and one overlapping both,
+  // the bytes on the stack, and an empty region, which is skipped.
+  AppMemoryList memory_list;
+  AppMemory app_memory;
+  app_memory.ptr = memory + kPageSize;
+  app_memory.length = kPageSize;
+  memory_list.push_back(app_memory);
+  app_memory.ptr = memory;
+  app_memory.length = kPageSize;
+  memory_list.push_back(app_memory);
+  app_memory.ptr = memory + kPageSize / 2;
+  app_memory.length = kPageSize;
+  memory_list.push_back(app_memory);
+  app_memory.ptr = stack_bytes;
+  app_memory.length = sizeof(stack_bytes);
+  memory_list.push_back(app_memory);
+  app_memory.ptr = memory + 2 * kPageSize + 16;
+  app_memory.length = 0;
+  memory_list.push_back(app_memory);
+  ASSERT_TRUE(WriteMinidump(templ.c_str(), child, &context, sizeof(context),
+                            MappingList(), memory_list));
+
+  Minidump minidump(templ.c_str());
+  ASSERT_TRUE(minidump.Read());
+  // The streams after the memory list were written.
+  ASSERT_TRUE(minidump.GetSystemInfo());
+
+  // The regions are sorted, and neither overlap nor touch.
+  MinidumpMemoryList* dump_memory_list = minidump.GetMemoryList();
+  ASSERT_TRUE(dump_memory_list);
+  for (unsigned int i = 1; i < dump_memory_list->region_count(); ++i) {
+    MinidumpMemoryRegion* previous =
+        dump_memory_list->GetMemoryRegionAtIndex(i - 1);
+    MinidumpMemoryRegion* region = dump_memory_list->GetMemoryRegionAtIndex(i);
+    ASSERT_TRUE(previous);
+    ASSERT_TRUE(region);
+    EXPECT_LT(previous->GetBase() + previous->GetSize(), region->GetBase());
+  }
+
+  MinidumpMemoryRegion* region =
+      dump_memory_list->GetMemoryRegionForAddress(kMemoryAddress);
+  ASSERT_TRUE(region);
+  EXPECT_EQ(kMemoryAddress, region->GetBase());
+  EXPECT_EQ(2 * kPageSize, region->GetSize());
+  EXPECT_EQ(0, memcmp(region->GetMemory(), memory, 2 * kPageSize));
+  EXPECT_FALSE(dump_memory_list->GetMemoryRegionForAddress(
+      kMemoryAddress + 2 * kPageSize + 16));
+
+  // The stack bytes were written with the child's stack.
+  MinidumpThreadList* dump_thread_list = minidump.GetThreadList();
+  ASSERT_TRUE(dump_thread_list);
+  MinidumpThread* thread = dump_thread_list->GetThreadByID(child);
+  ASSERT_TRUE(thread);
+  MinidumpMemoryRegion* stack = thread->GetMemory();
+  ASSERT_TRUE(stack);
+  region = dump_memory_list->GetMemoryRegionForAddress(
+      reinterpret_cast<uintptr_t>(stack_bytes));
+  ASSERT_TRUE(region);
+  ASSERT_LE(region->GetBase(), stack->GetBase());
+  ASSERT_GE(region->GetBase() + region->GetSize(),
+            stack->GetBase() + stack->GetSize());
+  EXPECT_EQ(0, memcmp(region->GetMemory() +
+                          (stack->GetBase() - region->GetBase()),
+                      stack->GetMemory(), stack->GetSize()));
+  const u_int8_t* stack_bytes_copy = region->GetMemory() +
+      (reinterpret_cast<uintptr_t>(stack_bytes) - region->GetBase());
+  EXPECT_EQ(0, memcmp(stack_bytes_copy, stack_bytes, sizeof(stack_bytes)));
+
+  delete[] memory;
+  close(fds[1]);
+}
+
 // Test that an invalid thread stack pointer still results in a minidump.
 TEST(MinidumpWriterTest, InvalidStackPointer) {
   int fds[2];
@@ -754,4 +861,214 @@ TEST(MinidumpWriterTest, MinidumpSizeLimit) {
   kill(child_pid, SIGKILL);
 }
 
+// Starts the helper program with |num_threads| threads and waits until
+// they are all running.
+static void StartHelperProgram(int num_threads, pid_t* child_pid) {
+  char number_of_threads_arg[3];
+  sprintf(number_of_threads_arg, "%d", num_threads);
+
+  string helper_path(GetHelperBinary());
+  if (helper_path.empty()) {
+    FAIL() << "Couldn't find helper binary";
+    exit(1);
+  }
+
+  int fds[2];
+  ASSERT_NE(-1, pipe(fds));
+
+  *child_pid = fork();
+  if (*child_pid == 0) {
+    // In child process.
+    close(fds[0]);
+
+    // Pass the pipe fd and the number of threads as arguments.
+    char pipe_fd_string[8];
+    sprintf(pipe_fd_string, "%d", fds[1]);
+    execl(helper_path.c_str(),
+          helper_path.c_str(),
+          pipe_fd_string,
+          number_of_threads_arg,
+          NULL);
+  }
+  close(fds[1]);
+
+  // Wait for all child threads to indicate that they have started
+  for (int threads = 0; threads < num_threads; threads++) {
+    struct pollfd pfd;
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = fds[0];
+    pfd.events = POLLIN | POLLERR;
+
+    const int r = HANDLE_EINTR(poll(&pfd, 1, 1000));
+    ASSERT_EQ(1, r);
+    ASSERT_TRUE(pfd.revents & POLLIN);
+    uint8_t junk;
+    ASSERT_EQ(read(fds[0], &junk, sizeof(junk)),
+              static_cast<ssize_t>(sizeof(junk)));
+  }
+  close(fds[0]);
+
+  // See MinidumpSizeLimit above.
+  usleep(100000);
+}
+
+// Test that copying thread stacks with several tasks writes the same
+// thread list as copying them with one.
+TEST(MinidumpWriterTest, ThreadCaptureTasks) {
+  static const int kNumberOfThreadsInHelperProgram = 40;
+
+  pid_t child_pid;
+  ASSERT_NO_FATAL_FAILURE(
+      StartHelperProgram(kNumberOfThreadsInHelperProgram, &child_pid));
+
+  AutoTempDir temp_dir;
+  string serial_dump = temp_dir.path() +
+      "/minidump-writer-unittest-serial.dmp";
+  string parallel_dump = temp_dir.path() +
+      "/minidump-writer-unittest-parallel.dmp";
+  MinidumpWriterOptions options;
+  ASSERT_TRUE(WriteMinidump(serial_dump.c_str(), -1, options,
+                            child_pid, NULL, 0,
+                            MappingList(), AppMemoryList()));
+  options.thread_capture_tasks = 4;
+  ASSERT_TRUE(WriteMinidump(parallel_dump.c_str(), -1, options,
+                            child_pid, NULL, 0,
+                            MappingList(), AppMemoryList()));
+
+  struct stat serial_st, parallel_st;
+  ASSERT_EQ(0, stat(serial_dump.c_str(), &serial_st));
+  ASSERT_EQ(0, stat(parallel_dump.c_str(), &parallel_st));
+  EXPECT_EQ(serial_st.st_size, parallel_st.st_size);
+
+  Minidump serial(serial_dump.c_str());
+  ASSERT_TRUE(serial.Read());
+  Minidump parallel(parallel_dump.c_str());
+  ASSERT_TRUE(parallel.Read());
+  MinidumpThreadList* serial_threads = serial.GetThreadList();
+  ASSERT_TRUE(serial_threads);
+  MinidumpThreadList* parallel_threads = parallel.GetThreadList();
+  ASSERT_TRUE(parallel_threads);
+  ASSERT_EQ(serial_threads->thread_count(), parallel_threads->thread_count());
+  for (unsigned int i = 0; i < serial_threads->thread_count(); i++) {
+    MinidumpThread* serial_thread = serial_threads->GetThreadAtIndex(i);
+    MinidumpThread* parallel_thread = parallel_threads->GetThreadAtIndex(i);
+    const MDRawThread* serial_raw = serial_thread->thread();
+    const MDRawThread* parallel_raw = parallel_thread->thread();
+    ASSERT_TRUE(serial_raw != NULL);
+    ASSERT_TRUE(parallel_raw != NULL);
+    EXPECT_EQ(serial_raw->thread_id, parallel_raw->thread_id);
+    EXPECT_EQ(serial_raw->stack.memory.rva, parallel_raw->stack.memory.rva);
+    EXPECT_EQ(serial_raw->thread_context.rva,
+              parallel_raw->thread_context.rva);
+
+    MinidumpMemoryRegion* serial_memory = serial_thread->GetMemory();
+    MinidumpMemoryRegion* parallel_memory = parallel_thread->GetMemory();
+    ASSERT_TRUE(serial_memory != NULL);
+    ASSERT_TRUE(parallel_memory != NULL);
+    ASSERT_EQ(serial_memory->GetSize(), parallel_memory->GetSize());
+    EXPECT_EQ(0, memcmp(serial_memory->GetMemory(),
+                        parallel_memory->GetMemory(),
+                        serial_memory->GetSize()));
+  }
+
+  // Kill the helper program.
+  kill(child_pid, SIGKILL);
+}
+
+// Adds up the stack sizes of the threads in |minidump_path|, and the
+// largest of them.
+static void GetStackSizes(const string& minidump_path,
+                          int* total_stack_size, int* max_stack_size) {
+  *total_stack_size = *max_stack_size = 0;
+  Minidump minidump(minidump_path.c_str());
+  ASSERT_TRUE(minidump.Read());
+  MinidumpThreadList* dump_thread_list = minidump.GetThreadList();
+  ASSERT_TRUE(dump_thread_list);
+  for (unsigned int i = 0; i < dump_thread_list->thread_count(); i++) {
+    MinidumpThread* thread = dump_thread_list->GetThreadAtIndex(i);
+    ASSERT_TRUE(thread->thread() != NULL);
+    const int stack_size = thread->thread()->stack.memory.data_size;
+    *total_stack_size += stack_size;
+    *max_stack_size = std::max(*max_stack_size, stack_size);
+  }
+}
+
+// Test that each limit of a ThreadStackPolicy is honoured.
+TEST(MinidumpWriterTest, ThreadStackPolicy) {
+  static const int kNumberOfThreadsInHelperProgram = 40;
+
+  pid_t child_pid;
+  ASSERT_NO_FATAL_FAILURE(
+      StartHelperProgram(kNumberOfThreadsInHelperProgram, &child_pid));
+
+  AutoTempDir temp_dir;
+  int total_stack_size, max_stack_size;
+
+  // With no limits, every thread has a stack of its own.
+  ThreadStackPolicy policy;
+  MinidumpWriterOptions options;
+  options.stack_policy = &policy;
+  string normal_dump = temp_dir.path() + "/minidump-writer-unittest.dmp";
+  ASSERT_TRUE(WriteMinidump(normal_dump.c_str(), -1, options,
+                            child_pid, NULL, 0,
+                            MappingList(), AppMemoryList()));
+  ASSERT_NO_FATAL_FAILURE(
+      GetStackSizes(normal_dump, &total_stack_size, &max_stack_size));
+  const int normal_total_stack_size = total_stack_size;
+  ASSERT_GT(max_stack_size, 1024);
+
+  // A per-thread limit.
+  policy.max_thread_stack_len = 1024;
+  string thread_dump = temp_dir.path() +
+      "/minidump-writer-unittest-thread.dmp";
+  ASSERT_TRUE(WriteMinidump(thread_dump.c_str(), -1, options,
+                            child_pid, NULL, 0,
+                            MappingList(), AppMemoryList()));
+  ASSERT_NO_FATAL_FAILURE(
+      GetStackSizes(thread_dump, &total_stack_size, &max_stack_size));
+  EXPECT_EQ(1024, max_stack_size);
+
+  // A total limit, shared between the threads.
+  policy.max_thread_stack_len = -1;
+  policy.max_total_stack_len = normal_total_stack_size / 4;
+  string total_dump = temp_dir.path() +
+      "/minidump-writer-unittest-total.dmp";
+  ASSERT_TRUE(WriteMinidump(total_dump.c_str(), -1, options,
+                            child_pid, NULL, 0,
+                            MappingList(), AppMemoryList()));
+  ASSERT_NO_FATAL_FAILURE(
+      GetStackSizes(total_dump, &total_stack_size, &max_stack_size));
+  EXPECT_LE(total_stack_size, policy.max_total_stack_len);
+  EXPECT_GT(total_stack_size, policy.max_total_stack_len - 1024);
+
+  // An idle thread signature that matches nothing.
+  policy.max_total_stack_len = -1;
+  IdleThreadSignature signature;
+  signature.module_name = "no_such_module";
+  policy.idle_threads.push_back(signature);
+  string busy_dump = temp_dir.path() +
+      "/minidump-writer-unittest-busy.dmp";
+  ASSERT_TRUE(WriteMinidump(busy_dump.c_str(), -1, options,
+                            child_pid, NULL, 0,
+                            MappingList(), AppMemoryList()));
+  ASSERT_NO_FATAL_FAILURE(
+      GetStackSizes(busy_dump, &total_stack_size, &max_stack_size));
+  EXPECT_EQ(normal_total_stack_size, total_stack_size);
+
+  // One that matches the helper's threads, which all spin in the helper.
+  policy.idle_threads.back().thread_name = "linux_dumper";
+  policy.idle_threads.back().module_name = "linux_dumper_unittest_helper";
+  string idle_dump = temp_dir.path() +
+      "/minidump-writer-unittest-idle.dmp";
+  ASSERT_TRUE(WriteMinidump(idle_dump.c_str(), -1, options,
+                            child_pid, NULL, 0,
+                            MappingList(), AppMemoryList()));
+  ASSERT_NO_FATAL_FAILURE(
+      GetStackSizes(idle_dump, &total_stack_size, &max_stack_size));
+  EXPECT_EQ(0, total_stack_size);
+
+  // Kill the helper program.
+  kill(child_pid, SIGKILL);
+}
+
 }  // namespace
@@ -0,0 +1,260 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// proc_parsing_benchmark.cc: Measures how long LinuxPtraceDumper takes to
+// parse the /proc files of a large process.
+//
+// A child process is given a number of mappings, alternating between a
+// page of this program's file and an inaccessible anonymous page so that
+// neither the kernel nor the dumper merges them, and a number of idle
+// threads.  These phases are then timed:
+//   init:    LinuxPtraceDumper::Init, which reads /proc/<pid>/auxv, lists
+//            /proc/<pid>/task and parses /proc/<pid>/maps
+//   threads: LinuxPtraceDumper::GetThreadInfoByIndex for every thread,
+//            which parses /proc/<tid>/status and reads its registers
+//
+// Results are printed one line per case and phase, as fields separated by
+// '|', in the order named by the "#" header line.
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "client/linux/minidump_writer/linux_ptrace_dumper.h"
+#include "common/linux/eintr_wrapper.h"
+
+namespace {
+
+using google_breakpad::LinuxPtraceDumper;
+using google_breakpad::ThreadInfo;
+using std::vector;
+
+// Bumped whenever the output format changes.
+static const int kOutputVersion = 1;
+
+// Separator character for machine readable output.
+static const char kOutputSeparator = '|';
+
+// Stack size of the child's idle threads.
+static const size_t kThreadStackSize = 64 * 1024;
+
+struct ProcCase {
+  int mappings;
+  int threads;
+};
+
+static double Now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static void* IdleThread(void*) {
+  for (;;)
+    pause();
+  return NULL;
+}
+
+// Runs in the child: sets up |proc_case| and writes a byte to |ready_fd|
+// once it has, or exits if it cannot.
+static void RunChild(const ProcCase& proc_case, int ready_fd) {
+  const size_t page_size = getpagesize();
+  const int pairs = (proc_case.mappings + 1) / 2;
+  char* const region = reinterpret_cast<char*>(
+      mmap(NULL, pairs * 2 * page_size, PROT_NONE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (region == MAP_FAILED) {
+    perror("mmap");
+    _exit(1);
+  }
+  const int exe_fd = open("/proc/self/exe", O_RDONLY);
+  if (exe_fd < 0) {
+    perror("/proc/self/exe");
+    _exit(1);
+  }
+  for (int i = 0; i < pairs; ++i) {
+    if (mmap(region + 2 * i * page_size, page_size, PROT_READ,
+             MAP_PRIVATE | MAP_FIXED, exe_fd, 0) == MAP_FAILED) {
+      perror("mmap (is vm.max_map_count too low?)");
+      _exit(1);
+    }
+  }
+  close(exe_fd);
+
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  pthread_attr_setstacksize(&attributes, kThreadStackSize);
+  for (int i = 1; i < proc_case.threads; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, &attributes, IdleThread, NULL) != 0) {
+      fprintf(stderr, "pthread_create failed\n");
+      _exit(1);
+    }
+  }
+
+  char ready = 1;
+  if (HANDLE_EINTR(write(ready_fd, &ready, 1)) != 1)
+    _exit(1);
+  IdleThread(NULL);
+}
+
+static void PrintResult(const ProcCase& proc_case, const char* phase,
+                        int iterations, double usec, size_t items,
+                        const char* item_unit) {
+  const double usec_per_iteration = usec / iterations;
+  printf("m%d_t%d%c%s%c%d%c%.1f%c%zu%c%s%c%.0f\n",
+         proc_case.mappings, proc_case.threads, kOutputSeparator,
+         phase, kOutputSeparator,
+         iterations, kOutputSeparator,
+         usec_per_iteration, kOutputSeparator,
+         items, kOutputSeparator,
+         item_unit, kOutputSeparator,
+         usec_per_iteration > 0 ? items * 1e6 / usec_per_iteration : 0);
+}
+
+static bool BenchmarkCase(const ProcCase& proc_case, int iterations) {
+  int fds[2];
+  if (pipe(fds) != 0)
+    return false;
+  const pid_t child = fork();
+  if (child < 0)
+    return false;
+  if (child == 0) {
+    close(fds[0]);
+    RunChild(proc_case, fds[1]);
+  }
+  close(fds[1]);
+  char ready;
+  const bool started = HANDLE_EINTR(read(fds[0], &ready, 1)) == 1;
+  close(fds[0]);
+
+  bool ok = started;
+  double init_usec = 0, threads_usec = 0;
+  size_t mappings = 0, threads = 0;
+  for (int i = 0; ok && i < iterations; ++i) {
+    LinuxPtraceDumper dumper(child);
+    double start = Now();
+    ok = dumper.Init();
+    init_usec += Now() - start;
+    if (!ok || !dumper.ThreadsSuspend()) {
+      ok = false;
+      break;
+    }
+    mappings = dumper.mappings().size();
+    threads = dumper.threads().size();
+
+    start = Now();
+    for (size_t j = 0; ok && j < threads; ++j) {
+      ThreadInfo info;
+      ok = dumper.GetThreadInfoByIndex(j, &info);
+    }
+    threads_usec += Now() - start;
+    dumper.ThreadsResume();
+  }
+
+  kill(child, SIGKILL);
+  waitpid(child, NULL, 0);
+  if (!ok)
+    return false;
+
+  PrintResult(proc_case, "init", iterations, init_usec, mappings,
+              "mappings");
+  PrintResult(proc_case, "threads", iterations, threads_usec, threads,
+              "threads");
+  return true;
+}
+
+static void usage(const char *program_name) {
+  fprintf(stderr,
+          "usage: %s [-i iterations] [-m mappings -t threads]\n"
+          "    -i: times to repeat each phase (default 10)\n"
+          "    -m, -t: run only a process with this many mappings and\n"
+          "            threads, instead of the default cases\n",
+          program_name);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int iterations = 10;
+  ProcCase custom = { 0, 0 };
+  int argi = 1;
+  for (; argi + 1 < argc && argv[argi][0] == '-'; argi += 2) {
+    const char *value = argv[argi + 1];
+    if (strcmp(argv[argi], "-i") == 0 && (iterations = atoi(value)) > 0) {
+    } else if (strcmp(argv[argi], "-m") == 0 &&
+               (custom.mappings = atoi(value)) > 0) {
+    } else if (strcmp(argv[argi], "-t") == 0 &&
+               (custom.threads = atoi(value)) > 0) {
+    } else {
+      break;
+    }
+  }
+  bool have_custom = custom.mappings || custom.threads;
+  if (argi != argc ||
+      (have_custom && (!custom.mappings || !custom.threads))) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  printf("# proc_parsing_benchmark%c%d\n", kOutputSeparator, kOutputVersion);
+  printf("# case%cphase%citerations%cusec_per_iteration%c"
+         "items_per_iteration%citem_unit%citems_per_second\n",
+         kOutputSeparator, kOutputSeparator, kOutputSeparator,
+         kOutputSeparator, kOutputSeparator, kOutputSeparator);
+
+  vector<ProcCase> cases;
+  if (have_custom) {
+    cases.push_back(custom);
+  } else {
+    const ProcCase kCases[] = {
+      { 1000, 50 },
+      { 20000, 500 },
+    };
+    cases.assign(kCases, kCases + sizeof(kCases) / sizeof(kCases[0]));
+  }
+
+  int result = 0;
+  for (size_t i = 0; i < cases.size(); ++i) {
+    if (!BenchmarkCase(cases[i], iterations)) {
+      fprintf(stderr, "Case %d failed\n", static_cast<int>(i));
+      result = 1;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// thread_stack_policy.h: Limits on how much of the thread stacks the
+// minidump writer includes.  Kept apart from minidump_writer.h so that
+// MinidumpDescriptor can hold a policy without pulling in the dumper.
+
+#ifndef CLIENT_LINUX_MINIDUMP_WRITER_THREAD_STACK_POLICY_H_
+#define CLIENT_LINUX_MINIDUMP_WRITER_THREAD_STACK_POLICY_H_
+
+#include <sys/types.h>
+
+#include <list>
+#include <string>
+
+#include "common/using_std_string.h"
+
+namespace google_breakpad {
+
+// Describes threads that are idle and whose stacks are not worth writing,
+// such as the workers of a thread pool waiting for a task.  A thread
+// matches if its name starts with |thread_name| and its instruction pointer
+// is in a mapping whose file name starts with |module_name|.  Empty
+// strings match anything.
+struct IdleThreadSignature {
+  string thread_name;
+  string module_name;
+};
+typedef std::list<IdleThreadSignature> IdleThreadSignatureList;
+
+// Limits how much of the thread stacks goes into a minidump.  Stacks are
+// always kept from the stack pointer up, so a truncated stack still holds
+// its innermost frames.  The crashing thread is not subject to these
+// limits.
+struct ThreadStackPolicy {
+  ThreadStackPolicy()
+      : max_thread_stack_len(-1),
+        max_total_stack_len(-1) {}
+
+  // The most bytes of stack written for each thread, or -1 for no limit
+  // beyond the dumper's own.
+  int max_thread_stack_len;
+  // The most bytes of stack written for all threads together, or -1 for
+  // no limit.  The budget is shared out evenly, and what a small stack
+  // leaves unused goes to the threads after it.
+  off_t max_total_stack_len;
+  // Threads matching any of these get an empty stack.
+  IdleThreadSignatureList idle_threads;
+};
+
+}  // namespace google_breakpad
+
+#endif  // CLIENT_LINUX_MINIDUMP_WRITER_THREAD_STACK_POLICY_H_
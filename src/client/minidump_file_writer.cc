@@ -31,33 +31,63 @@
 //
 // See minidump_file_writer.h for documentation.
 
+#include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #include "client/minidump_file_writer-inl.h"
 #include "common/linux/linux_libc_support.h"
+#include "common/minidump_compression.h"
 #include "common/string_conversion.h"
 #if __linux__
 #include "third_party/lss/linux_syscall_support.h"
 #endif
 
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
 namespace google_breakpad {
 
+namespace {
+
+const size_t kCompressedBufferSize =
+    sizeof(CompressedMinidumpRecord) +
+    CompressedMinidumpBlockBound(kCompressedMinidumpMaxBlockSize);
+const size_t kHashTableSize =
+    kCompressedMinidumpHashTableSize * sizeof(u_int16_t);
+
+}  // namespace
+
 const MDRVA MinidumpFileWriter::kInvalidMDRVA = static_cast<MDRVA>(-1);
 
 MinidumpFileWriter::MinidumpFileWriter()
     : file_(-1),
       close_file_when_destroyed_(true),
       position_(0),
-      size_(0) {
+      size_(0),
+      buffer_(NULL),
+      buffer_start_(0),
+      compress_(false),
+      output_position_(0),
+      end_output_position_(0),
+      end_position_(0),
+      compressed_buffer_(NULL),
+      hash_table_(NULL) {
 }
 
 MinidumpFileWriter::~MinidumpFileWriter() {
   if (close_file_when_destroyed_)
     Close();
+  else if (file_ != -1)
+    Flush();
+  UnmapPages(buffer_, kBufferSize);
+  UnmapPages(compressed_buffer_, kCompressedBufferSize);
+  UnmapPages(hash_table_, kHashTableSize);
 }
 
 bool MinidumpFileWriter::Open(const char *path) {
@@ -81,7 +111,7 @@ bool MinidumpFileWriter::Close() {
   bool result = true;
 
   if (file_ != -1) {
-    if (-1 == ftruncate(file_, position_)) {
+    if (!Flush()) {
        return false;
     }
 #if __linux__
@@ -95,6 +125,174 @@ bool MinidumpFileWriter::Close() {
   return result;
 }
 
+bool MinidumpFileWriter::Reserve(size_t size) {
+  assert(file_ != -1);
+  // The size of a compressed container is not known in advance.
+  if (compress_ || size <= size_)
+    return true;
+  if (ftruncate(file_, size) != 0)
+    return false;
+  size_ = size;
+  return true;
+}
+
+bool MinidumpFileWriter::EnableCompression() {
+  assert(file_ != -1);
+  assert(position_ == 0);
+  if (compress_)
+    return true;
+  if (!compressed_buffer_) {
+    compressed_buffer_ =
+        reinterpret_cast<uint8_t *>(MapPages(kCompressedBufferSize));
+  }
+  if (!hash_table_)
+    hash_table_ = reinterpret_cast<u_int16_t *>(MapPages(kHashTableSize));
+  if (!compressed_buffer_ || !hash_table_)
+    return false;
+
+  CompressedMinidumpHeader header;
+  header.signature = kCompressedMinidumpSignature;
+  header.version = kCompressedMinidumpVersion;
+  if (!WriteAt(0, &header, sizeof(header)))
+    return false;
+  output_position_ = sizeof(header);
+  compress_ = true;
+  return true;
+}
+
+bool MinidumpFileWriter::Flush() {
+  assert(file_ != -1);
+  if (!FlushBuffer())
+    return false;
+  off_t end = position_;
+  if (compress_) {
+    if (!WriteCompressedEnd())
+      return false;
+    end = output_position_;
+  }
+  if (ftruncate(file_, end) != 0)
+    return false;
+  if (!compress_)
+    size_ = position_;
+  // pwrite() leaves the file offset alone; callers who passed in a file
+  // descriptor expect it at the end of the minidump.
+#if __linux__
+  return sys_lseek(file_, end, SEEK_SET) == end;
+#else
+  return lseek(file_, end, SEEK_SET) == end;
+#endif
+}
+
+bool MinidumpFileWriter::FlushBuffer() {
+  if (!buffer_ || buffer_start_ == position_)
+    return true;
+  bool result = WriteToFile(buffer_start_, buffer_, position_ - buffer_start_);
+  buffer_start_ = position_;
+  return result;
+}
+
+bool MinidumpFileWriter::WriteToFile(MDRVA position, const void *src,
+                                     size_t size) {
+  if (compress_)
+    return WriteCompressed(position, src, size);
+  return WriteAt(position, src, size);
+}
+
+bool MinidumpFileWriter::WriteCompressed(MDRVA position, const void *src,
+                                         size_t size) {
+  const uint8_t *data = static_cast<const uint8_t *>(src);
+  CompressedMinidumpRecord *record =
+      reinterpret_cast<CompressedMinidumpRecord *>(compressed_buffer_);
+  uint8_t *payload = compressed_buffer_ + sizeof(*record);
+  while (size) {
+    size_t block_size = size;
+    if (block_size > kCompressedMinidumpMaxBlockSize)
+      block_size = kCompressedMinidumpMaxBlockSize;
+
+    // Blocks that do not shrink are stored as they are.
+    size_t stored_size = CompressMinidumpBlock(
+        data, block_size, payload, block_size - 1, hash_table_);
+    if (stored_size) {
+      record->type = kCompressedMinidumpRecordCompressed;
+    } else {
+      record->type = kCompressedMinidumpRecordStored;
+      stored_size = block_size;
+      memcpy(payload, data, block_size);
+    }
+    record->offset = position;
+    record->size = static_cast<u_int32_t>(block_size);
+    record->stored_size = static_cast<u_int32_t>(stored_size);
+
+    const size_t record_size = sizeof(*record) + stored_size;
+    if (!WriteAt(output_position_, compressed_buffer_, record_size))
+      return false;
+    output_position_ += record_size;
+    data += block_size;
+    position += block_size;
+    size -= block_size;
+  }
+  return true;
+}
+
+bool MinidumpFileWriter::WriteCompressedEnd() {
+  if (output_position_ == end_output_position_ && position_ == end_position_)
+    return true;
+  CompressedMinidumpRecord record;
+  record.type = kCompressedMinidumpRecordEnd;
+  record.offset = position_;
+  record.size = 0;
+  record.stored_size = 0;
+  if (!WriteAt(output_position_, &record, sizeof(record)))
+    return false;
+  output_position_ += sizeof(record);
+  end_output_position_ = output_position_;
+  end_position_ = position_;
+  return true;
+}
+
+bool MinidumpFileWriter::WriteAt(off_t offset, const void *src,
+                                 size_t size) {
+  const uint8_t *data = static_cast<const uint8_t *>(src);
+  while (size) {
+#if __linux__
+    const ssize_t written = sys_pwrite64(file_, data, size, offset);
+#else
+    const ssize_t written = pwrite(file_, data, size, offset);
+#endif
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    data += written;
+    offset += written;
+    size -= written;
+  }
+  return true;
+}
+
+// static
+void *MinidumpFileWriter::MapPages(size_t size) {
+#if __linux__
+  void *pages = sys_mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#else
+  void *pages = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#endif
+  return pages == MAP_FAILED ? NULL : pages;
+}
+
+// static
+void MinidumpFileWriter::UnmapPages(void *pages, size_t size) {
+  if (!pages)
+    return;
+#if __linux__
+  sys_munmap(pages, size);
+#else
+  munmap(pages, size);
+#endif
+}
+
 bool MinidumpFileWriter::CopyStringToMDString(const wchar_t *str,
                                               unsigned int length,
                                               TypedMDRVA<MDString> *mdstring) {
@@ -222,22 +420,26 @@ MDRVA MinidumpFileWriter::Allocate(size_t size) {
   assert(file_ != -1);
   size_t aligned_size = (size + 7) & ~7;  // 64-bit alignment
 
-  if (position_ + aligned_size > size_) {
-    size_t growth = aligned_size;
-    size_t minimal_growth = getpagesize();
-
-    // Ensure that the file grows by at least the size of a memory page
-    if (growth < minimal_growth)
-      growth = minimal_growth;
+  if (!buffer_)
+    buffer_ = reinterpret_cast<uint8_t *>(MapPages(kBufferSize));
 
-    size_t new_size = size_ + growth;
-    if (ftruncate(file_, new_size) != 0)
+  MDRVA current_position = position_;
+  if (buffer_ &&
+      current_position + aligned_size <= buffer_start_ + kBufferSize) {
+    // The new area fits in what is left of the buffer.
+    memset(buffer_ + (current_position - buffer_start_), 0, aligned_size);
+  } else {
+    if (!FlushBuffer())
       return kInvalidMDRVA;
-
-    size_ = new_size;
+    if (buffer_ && aligned_size <= kBufferSize) {
+      buffer_start_ = current_position;
+      memset(buffer_, 0, aligned_size);
+    } else {
+      // Too big to buffer; writes to this area go straight to the file.
+      buffer_start_ = current_position + aligned_size;
+    }
   }
 
-  MDRVA current_position = position_;
   position_ += static_cast<MDRVA>(aligned_size);
 
   return current_position;
@@ -249,22 +451,26 @@ bool MinidumpFileWriter::Copy(MDRVA position, const void *src, ssize_t size) {
   assert(file_ != -1);
 
   // Ensure that the data will fit in the allocated space
-  if (static_cast<size_t>(size + position) > size_)
+  if (static_cast<size_t>(size + position) > position_)
     return false;
 
-  // Seek and write the data
-#if __linux__
-  if (sys_lseek(file_, position, SEEK_SET) == static_cast<off_t>(position)) {
-    if (sys_write(file_, src, size) == size) {
-#else
-  if (lseek(file_, position, SEEK_SET) == static_cast<off_t>(position)) {
-    if (write(file_, src, size) == size) {
-#endif
-      return true;
-    }
+  // Anything before the buffer goes straight to the file.
+  const uint8_t *data = static_cast<const uint8_t *>(src);
+  if (position < buffer_start_) {
+    size_t direct = buffer_start_ - position;
+    if (direct > static_cast<size_t>(size))
+      direct = size;
+    if (!WriteToFile(position, data, direct))
+      return false;
+    position += direct;
+    data += direct;
+    size -= direct;
   }
 
-  return false;
+  if (size)
+    memcpy(buffer_ + (position - buffer_start_), data, size);
+
+  return true;
 }
 
 bool UntypedMDRVA::Allocate(size_t size) {
@@ -47,6 +47,11 @@ template<typename MDType> class TypedMDRVA;
 // strings using the definitions in minidump_format.h.  Since this class is
 // expected to be used in a situation where the current process may be
 // damaged, it will not allocate heap memory.
+//
+// Writes to the most recently allocated part of the file are gathered in a
+// page-allocated buffer and written out in large chunks; only data written
+// back into earlier allocations (headers, directories) goes straight to the
+// file.  Everything is on disk once Flush() or Close() returns.
 // Sample usage:
 // MinidumpFileWriter writer;
 // writer.Open("/tmp/minidump.dmp");
@@ -91,6 +96,24 @@ public:
   // Return true on success, or false on failure.
   bool Close();
 
+  // Extends the file to |size| bytes in one step, so that it does not need
+  // to grow while the minidump is written.  The file is cut back to the
+  // bytes actually allocated by Flush() or Close().
+  // Return true on success, or false on failure.
+  bool Reserve(size_t size);
+
+  // Writes the minidump as a compressed container (see
+  // common/minidump_compression.h) instead of as plain bytes.  Must be
+  // called after Open() or SetFile() and before anything is allocated.
+  // Return true on success, or false on failure.
+  bool EnableCompression();
+
+  // Writes out any buffered data and sets the file size to position().  The
+  // destructor does this when SetFile() was used, but calling it directly
+  // lets the caller see failures.
+  // Return true on success, or false on failure.
+  bool Flush();
+
   // Copy the contents of |str| to a MDString and write it to the file.
   // |str| is expected to be either UTF-16 or UTF-32 depending on the size
   // of wchar_t.
@@ -119,11 +142,42 @@ public:
  private:
   friend class UntypedMDRVA;
 
+  // Size of the write buffer.  Allocations larger than this bypass it.
+  static const size_t kBufferSize = 64 * 1024;
+
   // Allocates an area of |size| bytes.
   // Returns the position of the allocation, or kInvalidMDRVA if it was
   // unable to allocate the bytes.
   MDRVA Allocate(size_t size);
 
+  // Writes the bytes held in |buffer_| to the file and empties it.
+  // Return true on success, or false on failure.
+  bool FlushBuffer();
+
+  // Writes |size| bytes from |src| to the minidump at |position|, either
+  // directly or as compressed records.
+  // Return true on success, or false on failure.
+  bool WriteToFile(MDRVA position, const void *src, size_t size);
+
+  // Appends records placing |size| bytes from |src| at |position| in the
+  // minidump to the compressed container.
+  // Return true on success, or false on failure.
+  bool WriteCompressed(MDRVA position, const void *src, size_t size);
+
+  // Appends the end record of the compressed container, unless nothing
+  // has changed since the last one.
+  // Return true on success, or false on failure.
+  bool WriteCompressedEnd();
+
+  // Writes |size| bytes from |src| to the file at |offset|.
+  // Return true on success, or false on failure.
+  bool WriteAt(off_t offset, const void *src, size_t size);
+
+  // Maps |size| bytes of zeroed pages for the writer's buffers, which must
+  // not come from the heap.  Returns NULL on failure.
+  static void *MapPages(size_t size);
+  static void UnmapPages(void *pages, size_t size);
+
   // The file descriptor for the output file.
   int file_;
 
@@ -133,9 +187,32 @@ public:
   // Current position in buffer
   MDRVA position_;
 
-  // Current allocated size
+  // Size the file has been extended to by Reserve()
   size_t size_;
 
+  // kBufferSize bytes holding the file contents from |buffer_start_| up to
+  // |position_|, or NULL before the first allocation
+  uint8_t *buffer_;
+
+  // File offset of the first byte of |buffer_|.  Writes before this offset
+  // go straight to the file.
+  MDRVA buffer_start_;
+
+  // Whether the file is a compressed container
+  bool compress_;
+
+  // Size of the compressed container written so far
+  off_t output_position_;
+
+  // |output_position_| and |position_| when the last end record was written
+  off_t end_output_position_;
+  MDRVA end_position_;
+
+  // Room for a record header and the largest compressed block, and the
+  // compressor's hash table, or NULL when not compressing
+  uint8_t *compressed_buffer_;
+  u_int16_t *hash_table_;
+
   // Copy |length| characters from |str| to |mdstring|.  These are distinct
   // because the underlying MDString is a UTF-16 based string.  The wchar_t
   // variant may need to create a MDString that has more characters than the
@@ -31,6 +31,7 @@
 
 /*
  g++ -I../ ../common/convert_UTF.c \
+ ../common/minidump_compression.cc \
  ../common/string_conversion.cc \
  minidump_file_writer.cc \
  minidump_file_writer_unittest.cc \
@@ -38,10 +39,14 @@
  */
 
 #include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "minidump_file_writer-inl.h"
+#include "common/minidump_compression.h"
 
+using google_breakpad::CompressedMinidumpHeader;
+using google_breakpad::CompressedMinidumpRecord;
 using google_breakpad::MinidumpFileWriter;
 
 #define ASSERT_TRUE(cond) \
@@ -166,11 +171,149 @@ static bool CompareFile(const char *path) {
   return true;
 }
 
+// Byte |i| of the data written by WriteLargeFile.
+static unsigned char LargeFileByte(size_t i) {
+  return static_cast<unsigned char>(i * 31 + 7);
+}
+
+// Writes enough data to overflow the writer's buffer several times, in
+// pieces small and large, and patches values into areas that have already
+// been written out.  The file is given as a descriptor and is completed by
+// the writer's destructor.  If |compress| is true, the file is written as a
+// compressed container.
+static bool WriteLargeFile(int fd, bool compress, size_t *total_size) {
+  MinidumpFileWriter writer;
+  writer.SetFile(fd);
+  if (compress)
+    ASSERT_TRUE(writer.EnableCompression());
+
+  google_breakpad::TypedMDRVA<unsigned long> count(&writer);
+  ASSERT_TRUE(count.Allocate());
+
+  const size_t sizes[] = { 24, 4096, 100000, 8, 65536, 40000, 40000, 300000 };
+  const size_t size_count = sizeof(sizes) / sizeof(sizes[0]);
+  unsigned char *data = new unsigned char[300000];
+  for (size_t i = 0; i < size_count; ++i) {
+    google_breakpad::UntypedMDRVA block(&writer);
+    ASSERT_TRUE(block.Allocate(sizes[i]));
+    for (size_t j = 0; j < sizes[i]; ++j)
+      data[j] = LargeFileByte(block.position() + j);
+    // Write the second half first.
+    const size_t half = sizes[i] / 2;
+    ASSERT_TRUE(block.Copy(block.position() + half, data + half,
+                           sizes[i] - half));
+    ASSERT_TRUE(block.Copy(data, half));
+  }
+  delete[] data;
+
+  *count.get() = size_count;
+  *total_size = writer.position();
+  return true;
+}
+
+static bool CompareLargeFile(int fd, size_t total_size) {
+  ASSERT_EQ(lseek(fd, 0, SEEK_END), static_cast<off_t>(total_size));
+  unsigned char *buffer = new unsigned char[total_size];
+  ASSERT_EQ(pread(fd, buffer, total_size, 0),
+            static_cast<ssize_t>(total_size));
+
+  unsigned long count;
+  memcpy(&count, buffer, sizeof(count));
+  ASSERT_EQ(count, 8UL);
+
+  // Every 8-byte aligned block follows the count.  Padding after a block
+  // reads as zero.
+  size_t offset = (sizeof(count) + 7) & ~7;
+  const size_t sizes[] = { 24, 4096, 100000, 8, 65536, 40000, 40000, 300000 };
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t j = 0; j < sizes[i]; ++j)
+      ASSERT_EQ(buffer[offset + j], LargeFileByte(offset + j));
+    for (size_t j = sizes[i]; j < ((sizes[i] + 7) & ~7); ++j)
+      ASSERT_EQ(buffer[offset + j], 0);
+    offset += (sizes[i] + 7) & ~7;
+  }
+  ASSERT_EQ(offset, total_size);
+  delete[] buffer;
+  return true;
+}
+
+// Writes the minidump held in the compressed container |fd| to |out_fd|.
+static bool ExpandCompressedFile(int fd, int out_fd) {
+  const off_t size = lseek(fd, 0, SEEK_END);
+  ASSERT_TRUE(size > static_cast<off_t>(sizeof(CompressedMinidumpHeader)));
+  unsigned char *buffer = new unsigned char[size];
+  ASSERT_EQ(pread(fd, buffer, size, 0), size);
+
+  CompressedMinidumpHeader header;
+  memcpy(&header, buffer, sizeof(header));
+  ASSERT_EQ(header.signature, google_breakpad::kCompressedMinidumpSignature);
+  ASSERT_EQ(header.version, google_breakpad::kCompressedMinidumpVersion);
+
+  unsigned char *block =
+      new unsigned char[google_breakpad::kCompressedMinidumpMaxBlockSize];
+  off_t position = sizeof(header);
+  bool saw_end = false;
+  while (position < size) {
+    CompressedMinidumpRecord record;
+    ASSERT_TRUE(size - position >= static_cast<off_t>(sizeof(record)));
+    memcpy(&record, buffer + position, sizeof(record));
+    position += sizeof(record);
+    ASSERT_TRUE(record.stored_size <= size - position);
+    const unsigned char *payload = buffer + position;
+    position += record.stored_size;
+
+    saw_end = record.type == google_breakpad::kCompressedMinidumpRecordEnd;
+    if (saw_end) {
+      ASSERT_EQ(ftruncate(out_fd, record.offset), 0);
+      continue;
+    }
+    ASSERT_TRUE(record.size <=
+                google_breakpad::kCompressedMinidumpMaxBlockSize);
+    if (record.type == google_breakpad::kCompressedMinidumpRecordStored) {
+      ASSERT_EQ(record.stored_size, record.size);
+      memcpy(block, payload, record.size);
+    } else {
+      ASSERT_EQ(record.type,
+                google_breakpad::kCompressedMinidumpRecordCompressed);
+      ASSERT_TRUE(google_breakpad::DecompressMinidumpBlock(
+          payload, record.stored_size, block, record.size));
+    }
+    ASSERT_EQ(pwrite(out_fd, block, record.size, record.offset),
+              static_cast<ssize_t>(record.size));
+  }
+  ASSERT_TRUE(saw_end);
+  delete[] block;
+  delete[] buffer;
+  return true;
+}
+
 static bool RunTests() {
   const char *path = "/tmp/minidump_file_writer_unittest.dmp";
   ASSERT_TRUE(WriteFile(path));
   ASSERT_TRUE(CompareFile(path));
   unlink(path);
+
+  int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+  ASSERT_NE(fd, -1);
+  size_t total_size = 0;
+  ASSERT_TRUE(WriteLargeFile(fd, false, &total_size));
+  ASSERT_TRUE(CompareLargeFile(fd, total_size));
+  close(fd);
+  unlink(path);
+
+  const char *expanded_path = "/tmp/minidump_file_writer_unittest_expanded.dmp";
+  fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+  ASSERT_NE(fd, -1);
+  int expanded_fd = open(expanded_path, O_RDWR | O_CREAT | O_EXCL, 0600);
+  ASSERT_NE(expanded_fd, -1);
+  ASSERT_TRUE(WriteLargeFile(fd, true, &total_size));
+  ASSERT_TRUE(lseek(fd, 0, SEEK_END) < static_cast<off_t>(total_size));
+  ASSERT_TRUE(ExpandCompressedFile(fd, expanded_fd));
+  ASSERT_TRUE(CompareLargeFile(expanded_fd, total_size));
+  close(expanded_fd);
+  close(fd);
+  unlink(expanded_path);
+  unlink(path);
   return true;
 }
 
@@ -55,8 +55,24 @@ CompilationUnit::CompilationUnit(const SectionMap& sections, uint64 offset,
                                  ByteReader* reader, Dwarf2Handler* handler)
     : offset_from_section_start_(offset), reader_(reader),
       sections_(sections), handler_(handler), abbrevs_(NULL),
+      abbrevs_owned_(false), abbrev_cache_(NULL),
       string_buffer_(NULL), string_buffer_length_(0) {}
 
+CompilationUnit::AbbrevCache::~AbbrevCache() {
+  for (TableMap::iterator it = tables_.begin(); it != tables_.end(); ++it)
+    delete it->second;
+}
+
+bool CompilationUnit::AbbrevCache::Key::operator<(const Key& other) const {
+  if (offset != other.offset)
+    return offset < other.offset;
+  if (address_size != other.address_size)
+    return address_size < other.address_size;
+  if (offset_size != other.offset_size)
+    return offset_size < other.offset_size;
+  return version < other.version;
+}
+
 // Read a DWARF2/3 abbreviation section.
 // Each abbrev consists of a abbreviation number, a tag, a byte
 // specifying whether the tag has children, and a list of
@@ -69,6 +85,20 @@ void CompilationUnit::ReadAbbrevs() {
   if (abbrevs_)
     return;
 
+  AbbrevCache::Key key;
+  key.offset = header_.abbrev_offset;
+  key.address_size = reader_->AddressSize();
+  key.offset_size = reader_->OffsetSize();
+  key.version = header_.version;
+  if (abbrev_cache_) {
+    AbbrevCache::TableMap::const_iterator cached =
+        abbrev_cache_->tables_.find(key);
+    if (cached != abbrev_cache_->tables_.end()) {
+      abbrevs_ = cached->second;
+      return;
+    }
+  }
+
   // First get the debug_abbrev section.  ".debug_abbrev" is the name
   // recommended in the DWARF spec, and used on Linux;
   // "__debug_abbrev" is the name used in Mac OS X Mach-O files.
@@ -77,8 +107,8 @@ void CompilationUnit::ReadAbbrevs() {
     iter = sections_.find("__debug_abbrev");
   assert(iter != sections_.end());
 
-  abbrevs_ = new std::vector<Abbrev>;
-  abbrevs_->resize(1);
+  std::vector<Abbrev>* abbrevs = new std::vector<Abbrev>;
+  abbrevs->resize(1);
 
   // The only way to check whether we are reading over the end of the
   // buffer would be to first compute the size of the leb128 data by
@@ -126,18 +156,89 @@ void CompilationUnit::ReadAbbrevs() {
       const enum DwarfForm form = static_cast<enum DwarfForm>(formtemp);
       abbrev.attributes.push_back(std::make_pair(name, form));
     }
-    assert(abbrev.number == abbrevs_->size());
-    abbrevs_->push_back(abbrev);
+
+    // Gather up runs of fixed-size attributes for SkipDIE.
+    SkipSpan span = { 0, static_cast<enum DwarfForm>(0) };
+    for (AttributeList::const_iterator i = abbrev.attributes.begin();
+         i != abbrev.attributes.end(); ++i) {
+      uint64 size;
+      if (FixedFormSize(i->second, &size)) {
+        span.fixed_size += size;
+      } else {
+        span.variable_form = i->second;
+        abbrev.skip_spans.push_back(span);
+        span.fixed_size = 0;
+        span.variable_form = static_cast<enum DwarfForm>(0);
+      }
+    }
+    if (span.fixed_size)
+      abbrev.skip_spans.push_back(span);
+
+    assert(abbrev.number == abbrevs->size());
+    abbrevs->push_back(abbrev);
   }
+
+  abbrevs_ = abbrevs;
+  if (abbrev_cache_ && !abbrev_cache_->frozen_)
+    abbrev_cache_->tables_[key] = abbrevs;
+  else
+    abbrevs_owned_ = true;
 }
 
-// Skips a single DIE's attributes.
+bool CompilationUnit::FixedFormSize(enum DwarfForm form, uint64* size) const {
+  switch (form) {
+    case DW_FORM_flag_present:
+      *size = 0;
+      return true;
+    case DW_FORM_data1:
+    case DW_FORM_flag:
+    case DW_FORM_ref1:
+      *size = 1;
+      return true;
+    case DW_FORM_ref2:
+    case DW_FORM_data2:
+      *size = 2;
+      return true;
+    case DW_FORM_ref4:
+    case DW_FORM_data4:
+      *size = 4;
+      return true;
+    case DW_FORM_ref8:
+    case DW_FORM_data8:
+    case DW_FORM_ref_sig8:
+      *size = 8;
+      return true;
+    case DW_FORM_addr:
+      *size = reader_->AddressSize();
+      return true;
+    case DW_FORM_ref_addr:
+      // Leave the versions SkipAttribute doesn't expect to it.
+      if (header_.version == 2) {
+        *size = reader_->AddressSize();
+        return true;
+      } else if (header_.version == 3) {
+        *size = reader_->OffsetSize();
+        return true;
+      }
+      return false;
+    case DW_FORM_strp:
+    case DW_FORM_sec_offset:
+      *size = reader_->OffsetSize();
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Skips a single DIE's attributes, a run of them at a time.
 const char* CompilationUnit::SkipDIE(const char* start,
                                               const Abbrev& abbrev) {
-  for (AttributeList::const_iterator i = abbrev.attributes.begin();
-       i != abbrev.attributes.end();
+  for (std::vector<SkipSpan>::const_iterator i = abbrev.skip_spans.begin();
+       i != abbrev.skip_spans.end();
        i++)  {
-    start = SkipAttribute(start, i->second);
+    start += i->fixed_size;
+    if (i->variable_form)
+      start = SkipAttribute(start, i->variable_form);
   }
   return start;
 }
@@ -248,7 +349,7 @@ void CompilationUnit::ReadHeader() {
         buffer_ + buffer_length_);
 }
 
-uint64 CompilationUnit::Start() {
+uint64 CompilationUnit::ReadUnitHeader() {
   // First get the debug_info section.  ".debug_info" is the name
   // recommended in the DWARF spec, and used on Linux; "__debug_info"
   // is the name used in Mac OS X Mach-O files.
@@ -272,6 +373,17 @@ uint64 CompilationUnit::Start() {
     ourlength += 12;
   else
     ourlength += 4;
+  return ourlength;
+}
+
+uint64 CompilationUnit::CacheAbbrevs() {
+  const uint64 ourlength = ReadUnitHeader();
+  ReadAbbrevs();
+  return ourlength;
+}
+
+uint64 CompilationUnit::Start() {
+  const uint64 ourlength = ReadUnitHeader();
 
   // See if the user wants this compilation unit, and if not, just return.
   if (!handler_->StartCompilationUnit(offset_from_section_start_,
@@ -287,7 +399,7 @@ uint64 CompilationUnit::Start() {
   // Set the string section if we have one.  ".debug_str" is the name
   // recommended in the DWARF spec, and used on Linux; "__debug_str"
   // is the name used in Mac OS X Mach-O files.
-  iter = sections_.find(".debug_str");
+  SectionMap::const_iterator iter = sections_.find(".debug_str");
   if (iter == sections_.end())
     iter = sections_.find("__debug_str");
   if (iter != sections_.end()) {
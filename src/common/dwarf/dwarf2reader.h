@@ -40,7 +40,6 @@
 #ifndef COMMON_DWARF_DWARF2READER_H__
 #define COMMON_DWARF_DWARF2READER_H__
 
-#include <list>
 #include <map>
 #include <string>
 #include <utility>
@@ -59,7 +58,7 @@ class LineInfoHandler;
 // This maps from a string naming a section to a pair containing a
 // the data for the section, and the size of the section.
 typedef std::map<string, std::pair<const char*, uint64> > SectionMap;
-typedef std::list<std::pair<enum DwarfAttribute, enum DwarfForm> >
+typedef std::vector<std::pair<enum DwarfAttribute, enum DwarfForm> >
     AttributeList;
 typedef AttributeList::iterator AttributeIterator;
 typedef AttributeList::const_iterator ConstAttributeIterator;
@@ -217,6 +216,10 @@ class LineInfoHandler {
 
 class CompilationUnit {
  public:
+  // A cache of abbreviation tables, which compilation units from the
+  // same file can share, so that each table is parsed only once, however
+  // many units use it.
+  class AbbrevCache;
 
   // Initialize a compilation unit.  This requires a map of sections,
   // the offset of this compilation unit in the .debug_info section, a
@@ -224,9 +227,20 @@ class CompilationUnit {
   CompilationUnit(const SectionMap& sections, uint64 offset,
                   ByteReader* reader, Dwarf2Handler* handler);
   virtual ~CompilationUnit() {
-    if (abbrevs_) delete abbrevs_;
+    if (abbrevs_owned_) delete abbrevs_;
   }
 
+  // Look up this compilation unit's abbreviation table in CACHE, which
+  // must outlive it, before parsing the table itself, and add the table
+  // to CACHE once parsed, unless CACHE is frozen.
+  void SetAbbrevCache(AbbrevCache* cache) { abbrev_cache_ = cache; }
+
+  // Read this compilation unit's header and add its abbreviation table
+  // to the cache given to SetAbbrevCache, without reading any DIEs or
+  // calling the handler. Return the full length of the unit, as Start
+  // does.
+  uint64 CacheAbbrevs();
+
   // Begin reading a Dwarf2 compilation unit, and calling the
   // callbacks in the Dwarf2Handler
 
@@ -238,6 +252,15 @@ class CompilationUnit {
 
  private:
 
+  // A run of attributes that SkipDIE can step over at once: some
+  // attributes whose data has the same size in every DIE, followed by
+  // one whose size must be read from the data, if VARIABLE_FORM is not
+  // zero.
+  struct SkipSpan {
+    uint64 fixed_size;
+    enum DwarfForm variable_form;
+  };
+
   // This struct represents a single DWARF2/3 abbreviation
   // The abbreviation tells how to read a DWARF2/3 DIE, and consist of a
   // tag and a list of attributes, as well as the data form of each attribute.
@@ -246,6 +269,8 @@ class CompilationUnit {
     enum DwarfTag tag;
     bool has_children;
     AttributeList attributes;
+    // The attributes again, as SkipDIE steps over them.
+    std::vector<SkipSpan> skip_spans;
   };
 
   // A DWARF2/3 compilation unit header.  This is not the same size as
@@ -261,9 +286,18 @@ class CompilationUnit {
   // Reads the DWARF2/3 header for this compilation unit.
   void ReadHeader();
 
+  // Finds the .debug_info section, reads the header, and returns the
+  // full length of the compilation unit.
+  uint64 ReadUnitHeader();
+
   // Reads the DWARF2/3 abbreviations for this compilation unit
   void ReadAbbrevs();
 
+  // Sets *SIZE to the size of FORM's data in this compilation unit and
+  // returns true if it is the same for every attribute; otherwise,
+  // returns false.
+  bool FixedFormSize(enum DwarfForm form, uint64* size) const;
+
   // Processes a single DIE for this compilation unit and return a new
   // pointer just past the end of it
   const char* ProcessDIE(uint64 dieoffset,
@@ -312,8 +346,12 @@ class CompilationUnit {
 
   // Set of DWARF2/3 abbreviations for this compilation unit.  Indexed
   // by abbreviation number, which means that abbrevs_[0] is not
-  // valid.
-  std::vector<Abbrev>* abbrevs_;
+  // valid.  Owned by abbrev_cache_ unless abbrevs_owned_ is set.
+  const std::vector<Abbrev>* abbrevs_;
+  bool abbrevs_owned_;
+
+  // The cache given to SetAbbrevCache, or NULL.
+  AbbrevCache* abbrev_cache_;
 
   // String section buffer and length, if we have a string section.
   // This is here to avoid doing a section lookup for strings in
@@ -322,6 +360,34 @@ class CompilationUnit {
   uint64 string_buffer_length_;
 };
 
+class CompilationUnit::AbbrevCache {
+ public:
+  AbbrevCache() : frozen_(false) { }
+  ~AbbrevCache();
+
+  // Stop adding tables to this cache. Compilation units whose tables
+  // are not in it yet parse their own instead. Since a frozen cache is
+  // never modified, units on different threads can share it.
+  void Freeze() { frozen_ = true; }
+
+ private:
+  friend class CompilationUnit;
+
+  // The abbreviation table at OFFSET in .debug_abbrev, for units with
+  // the given address size, offset size and DWARF version, on which
+  // the sizes SkipDIE uses depend.
+  struct Key {
+    uint64 offset;
+    uint8 address_size, offset_size;
+    uint16 version;
+    bool operator<(const Key& other) const;
+  };
+
+  typedef std::map<Key, const std::vector<Abbrev>*> TableMap;
+  TableMap tables_;
+  bool frozen_;
+};
+
 // This class is the main interface between the reader and the
 // client.  The virtual functions inside this get called for
 // interesting events that happen during DWARF2 reading.
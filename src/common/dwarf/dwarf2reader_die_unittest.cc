@@ -482,3 +482,223 @@ INSTANTIATE_TEST_CASE_P(
                       DwarfHeaderParams(kBigEndian,    8, 3, 8),
                       DwarfHeaderParams(kBigEndian,    8, 4, 4),
                       DwarfHeaderParams(kBigEndian,    8, 4, 8)));
+
+struct DwarfAbbrevs: public DwarfFormsFixture,
+                     public TestWithParam<DwarfHeaderParams> {
+  // Create a compilation unit, as directed by |params|, containing a
+  // single DIE, whose tag the abbreviation table gives as |tag|.
+  void MakeUnit(const DwarfHeaderParams &params, DwarfTag tag) {
+    Label abbrev_table = abbrevs.Here();
+    abbrevs.Abbrev(1, tag, dwarf2reader::DW_children_no)
+        .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+        .EndAbbrev()
+        .EndTable();
+
+    info.set_format_size(params.format_size);
+    info.set_endianness(params.endianness);
+    info.Header(params.version, abbrev_table, params.address_size)
+        .ULEB128(1)
+        .AppendCString("pelican");
+    info.Finish();
+  }
+
+  // Replace the .debug_abbrev section in |section_map| with one whose
+  // table gives the abbreviation code used by MakeUnit the tag |tag|.
+  void ReplaceAbbrevs(DwarfTag tag) {
+    TestAbbrevTable replacement;
+    replacement.start() = 0;
+    replacement.Abbrev(1, tag, dwarf2reader::DW_children_no)
+        .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+        .EndAbbrev()
+        .EndTable();
+    assert(replacement.GetContents(&replacement_contents));
+    section_map[".debug_abbrev"].first = replacement_contents.data();
+    section_map[".debug_abbrev"].second = replacement_contents.size();
+  }
+
+  // Expect the unit created by MakeUnit, with its DIE's tag |tag|.
+  void ExpectUnit(const DwarfHeaderParams &params, DwarfTag tag) {
+    ExpectBeginCompilationUnit(params, tag);
+    EXPECT_CALL(handler, ProcessAttributeString(_, dwarf2reader::DW_AT_name,
+                                                dwarf2reader::DW_FORM_string,
+                                                "pelican"))
+        .InSequence(s)
+        .WillOnce(Return());
+    ExpectEndCompilationUnit();
+  }
+
+  string replacement_contents;
+};
+
+// Units which share an abbreviation table through a cache use the first
+// one's parsed copy, rather than parsing the table again.
+TEST_P(DwarfAbbrevs, SharedTable) {
+  MakeUnit(GetParam(), dwarf2reader::DW_TAG_compile_unit);
+  ExpectUnit(GetParam(), dwarf2reader::DW_TAG_compile_unit);
+  ExpectUnit(GetParam(), dwarf2reader::DW_TAG_compile_unit);
+
+  ByteReader byte_reader(GetParam().endianness == kLittleEndian ?
+                         ENDIANNESS_LITTLE : ENDIANNESS_BIG);
+  CompilationUnit::AbbrevCache cache;
+  const SectionMap &sections = MakeSectionMap();
+  {
+    CompilationUnit parser(sections, 0, &byte_reader, &handler);
+    parser.SetAbbrevCache(&cache);
+    EXPECT_EQ(parser.Start(), info_contents.size());
+  }
+  // The second unit gets the table from the cache, not the section.
+  ReplaceAbbrevs(dwarf2reader::DW_TAG_partial_unit);
+  {
+    CompilationUnit parser(sections, 0, &byte_reader, &handler);
+    parser.SetAbbrevCache(&cache);
+    EXPECT_EQ(parser.Start(), info_contents.size());
+  }
+}
+
+// A frozen cache still supplies the tables put in it beforehand, but
+// units whose tables are not there parse and keep their own.
+TEST_P(DwarfAbbrevs, FrozenCache) {
+  MakeUnit(GetParam(), dwarf2reader::DW_TAG_compile_unit);
+  ExpectUnit(GetParam(), dwarf2reader::DW_TAG_compile_unit);
+  ExpectUnit(GetParam(), dwarf2reader::DW_TAG_partial_unit);
+
+  ByteReader byte_reader(GetParam().endianness == kLittleEndian ?
+                         ENDIANNESS_LITTLE : ENDIANNESS_BIG);
+  CompilationUnit::AbbrevCache cache;
+  cache.Freeze();
+  const SectionMap &sections = MakeSectionMap();
+  {
+    CompilationUnit parser(sections, 0, &byte_reader, &handler);
+    parser.SetAbbrevCache(&cache);
+    EXPECT_EQ(parser.Start(), info_contents.size());
+  }
+  ReplaceAbbrevs(dwarf2reader::DW_TAG_partial_unit);
+  {
+    CompilationUnit parser(sections, 0, &byte_reader, &handler);
+    parser.SetAbbrevCache(&cache);
+    EXPECT_EQ(parser.Start(), info_contents.size());
+  }
+}
+
+// CacheAbbrevs fills the cache without calling the handler, and returns
+// the unit's length.
+TEST_P(DwarfAbbrevs, CacheAbbrevs) {
+  MakeUnit(GetParam(), dwarf2reader::DW_TAG_compile_unit);
+  ExpectUnit(GetParam(), dwarf2reader::DW_TAG_compile_unit);
+
+  ByteReader byte_reader(GetParam().endianness == kLittleEndian ?
+                         ENDIANNESS_LITTLE : ENDIANNESS_BIG);
+  CompilationUnit::AbbrevCache cache;
+  const SectionMap &sections = MakeSectionMap();
+  {
+    CompilationUnit primer(sections, 0, &byte_reader, &handler);
+    primer.SetAbbrevCache(&cache);
+    EXPECT_EQ(primer.CacheAbbrevs(), info_contents.size());
+  }
+  cache.Freeze();
+  ReplaceAbbrevs(dwarf2reader::DW_TAG_partial_unit);
+  CompilationUnit parser(sections, 0, &byte_reader, &handler);
+  parser.SetAbbrevCache(&cache);
+  EXPECT_EQ(parser.Start(), info_contents.size());
+}
+
+// Skipping a DIE the handler declines steps over fixed-size and
+// variable-size attributes alike, landing on the next DIE.
+TEST_P(DwarfAbbrevs, SkipDIE) {
+  Label abbrev_table = abbrevs.Here();
+  abbrevs.Abbrev(1, dwarf2reader::DW_TAG_compile_unit,
+                 dwarf2reader::DW_children_yes)
+      .EndAbbrev()
+      .Abbrev(2, dwarf2reader::DW_TAG_subprogram,
+              dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_low_pc, dwarf2reader::DW_FORM_addr)
+      .Attribute(dwarf2reader::DW_AT_decl_line, dwarf2reader::DW_FORM_data2)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .Attribute(dwarf2reader::DW_AT_external,
+                 dwarf2reader::DW_FORM_flag_present)
+      .Attribute(dwarf2reader::DW_AT_decl_file, dwarf2reader::DW_FORM_udata)
+      .Attribute(dwarf2reader::DW_AT_frame_base,
+                 dwarf2reader::DW_FORM_block1)
+      .Attribute(dwarf2reader::DW_AT_sibling, dwarf2reader::DW_FORM_ref4)
+      .Attribute(dwarf2reader::DW_AT_stmt_list,
+                 dwarf2reader::DW_FORM_sec_offset)
+      .EndAbbrev()
+      .Abbrev(3, dwarf2reader::DW_TAG_variable, dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .EndAbbrev()
+      .EndTable();
+
+  info.set_format_size(GetParam().format_size);
+  info.set_endianness(GetParam().endianness);
+  info.Header(GetParam().version, abbrev_table, GetParam().address_size)
+      .ULEB128(1)                         // DW_TAG_compile_unit
+      .ULEB128(2)                         // DW_TAG_subprogram
+      .Append(GetParam().address_size, 0x5a)  // DW_AT_low_pc
+      .D16(0x4f2c)                        // DW_AT_decl_line
+      .AppendCString("skipped")           // DW_AT_name
+      .ULEB128(0x9b1d)                    // DW_AT_decl_file
+      .D8(3).Append(3, 0x9c)              // DW_AT_frame_base
+      .D32(0x17)                          // DW_AT_sibling
+      .Append(GetParam().format_size, 0xa5)  // DW_AT_stmt_list
+      .ULEB128(3)                         // DW_TAG_variable
+      .AppendCString("kept")              // DW_AT_name
+      .D8(0);                             // end of children
+  info.Finish();
+
+  EXPECT_CALL(handler,
+              StartCompilationUnit(0, GetParam().address_size,
+                                   GetParam().format_size, _,
+                                   GetParam().version))
+      .InSequence(s)
+      .WillOnce(Return(true));
+  EXPECT_CALL(handler, StartDIE(_, dwarf2reader::DW_TAG_compile_unit))
+      .InSequence(s)
+      .WillOnce(Return(true));
+  EXPECT_CALL(handler, StartDIE(_, dwarf2reader::DW_TAG_subprogram))
+      .InSequence(s)
+      .WillOnce(Return(false));
+  EXPECT_CALL(handler, EndDIE(_))
+      .InSequence(s)
+      .WillOnce(Return());
+  EXPECT_CALL(handler, StartDIE(_, dwarf2reader::DW_TAG_variable))
+      .InSequence(s)
+      .WillOnce(Return(true));
+  EXPECT_CALL(handler, ProcessAttributeString(_, dwarf2reader::DW_AT_name,
+                                              dwarf2reader::DW_FORM_string,
+                                              "kept"))
+      .InSequence(s)
+      .WillOnce(Return());
+  EXPECT_CALL(handler, EndDIE(_))
+      .Times(2)
+      .InSequence(s)
+      .WillRepeatedly(Return());
+
+  ParseCompilationUnit(GetParam());
+}
+
+INSTANTIATE_TEST_CASE_P(
+    HeaderVariants, DwarfAbbrevs,
+    ::testing::Values(DwarfHeaderParams(kLittleEndian, 4, 2, 4),
+                      DwarfHeaderParams(kLittleEndian, 4, 2, 8),
+                      DwarfHeaderParams(kLittleEndian, 4, 3, 4),
+                      DwarfHeaderParams(kLittleEndian, 4, 3, 8),
+                      DwarfHeaderParams(kLittleEndian, 4, 4, 4),
+                      DwarfHeaderParams(kLittleEndian, 4, 4, 8),
+                      DwarfHeaderParams(kLittleEndian, 8, 2, 4),
+                      DwarfHeaderParams(kLittleEndian, 8, 2, 8),
+                      DwarfHeaderParams(kLittleEndian, 8, 3, 4),
+                      DwarfHeaderParams(kLittleEndian, 8, 3, 8),
+                      DwarfHeaderParams(kLittleEndian, 8, 4, 4),
+                      DwarfHeaderParams(kLittleEndian, 8, 4, 8),
+                      DwarfHeaderParams(kBigEndian,    4, 2, 4),
+                      DwarfHeaderParams(kBigEndian,    4, 2, 8),
+                      DwarfHeaderParams(kBigEndian,    4, 3, 4),
+                      DwarfHeaderParams(kBigEndian,    4, 3, 8),
+                      DwarfHeaderParams(kBigEndian,    4, 4, 4),
+                      DwarfHeaderParams(kBigEndian,    4, 4, 8),
+                      DwarfHeaderParams(kBigEndian,    8, 2, 4),
+                      DwarfHeaderParams(kBigEndian,    8, 2, 8),
+                      DwarfHeaderParams(kBigEndian,    8, 3, 4),
+                      DwarfHeaderParams(kBigEndian,    8, 3, 8),
+                      DwarfHeaderParams(kBigEndian,    8, 4, 4),
+                      DwarfHeaderParams(kBigEndian,    8, 4, 8)));
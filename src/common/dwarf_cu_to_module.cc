@@ -41,6 +41,7 @@
 #include <assert.h>
 #include <cxxabi.h>
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdio.h>
 
 #include <algorithm>
@@ -87,10 +88,17 @@ struct DwarfCUToModule::Specification {
 
 // An abstract origin -- base definition of an inline function.
 struct AbstractOrigin {
-  AbstractOrigin() : name() {}
-  AbstractOrigin(const string& name) : name(name) {}
+  AbstractOrigin() : name(), has_origin(false), origin(0) {}
+  AbstractOrigin(const string& name)
+      : name(name), has_origin(false), origin(0) {}
 
   string name;
+
+  // If NAME is empty because this DIE's own DW_AT_abstract_origin
+  // pointed at a DIE not yet seen, HAS_ORIGIN is true and ORIGIN is
+  // that DIE's offset, where the name can be looked up later.
+  bool has_origin;
+  uint64 origin;
 };
 
 typedef map<uint64, AbstractOrigin> AbstractOriginByOffset;
@@ -127,7 +135,7 @@ struct DwarfCUToModule::FilePrivate {
 
 DwarfCUToModule::FileContext::FileContext(const string &filename_arg,
                                           Module *module_arg)
-    : filename(filename_arg), module(module_arg) {
+    : filename(filename_arg), module(module_arg), index(NULL) {
   file_private = new FilePrivate();
 }
 
@@ -135,6 +143,19 @@ DwarfCUToModule::FileContext::~FileContext() {
   delete file_private;
 }
 
+void DwarfCUToModule::FileContext::AddInterUnitData(
+    const FileContext &other) {
+  const FilePrivate *other_private = other.file_private;
+  for (SpecificationByOffset::const_iterator it =
+           other_private->specifications.begin();
+       it != other_private->specifications.end(); ++it)
+    file_private->specifications[it->first] = it->second;
+  for (AbstractOriginByOffset::const_iterator it =
+           other_private->origins.begin();
+       it != other_private->origins.end(); ++it)
+    file_private->origins[it->first] = it->second;
+}
+
 // Information global to the particular compilation unit we're
 // parsing. This is for data shared across the CU's entire DIE tree,
 // and parameters from the code invoking the CU parser.
@@ -142,7 +163,11 @@ struct DwarfCUToModule::CUContext {
   CUContext(FileContext *file_context_arg, WarningReporter *reporter_arg)
       : file_context(file_context_arg),
         reporter(reporter_arg),
-        language(Language::CPlusPlus) { }
+        language(Language::CPlusPlus),
+        start_offset(0),
+        end_offset(0),
+        has_inter_unit_references(false),
+        index_only(false) { }
   ~CUContext() {
     for (vector<Module::Function *>::iterator it = functions.begin();
          it != functions.end(); it++)
@@ -164,6 +189,60 @@ struct DwarfCUToModule::CUContext {
   //
   // Destroying this destroys all the functions this vector points to.
   vector<Module::Function *> functions;
+
+  // The offsets of the start of this compilation unit's header, and of
+  // the end of its data, in the .debug_info section.
+  uint64 start_offset, end_offset;
+
+  // True if a DIE in this compilation unit refers to one outside it,
+  // which the file context has no index to find in.
+  bool has_inter_unit_references;
+
+  // True if we are only recording specifications and abstract origins.
+  bool index_only;
+
+  // Note that a DIE in this compilation unit refers to the DIE at
+  // TARGET.
+  void NoteReference(uint64 target) {
+    if (file_context->index)
+      return;
+    if (target < start_offset || target >= end_offset)
+      has_inter_unit_references = true;
+  }
+
+  // The file private data holding the specifications and abstract
+  // origins: the index's, if the file context has one.
+  const FilePrivate *names() const {
+    if (file_context->index)
+      return file_context->index->file_private;
+    return file_context->file_private;
+  }
+
+  // Return the Specification for the DIE at OFFSET, or NULL if we have
+  // none.
+  const Specification *FindSpecification(uint64 offset) const {
+    const SpecificationByOffset &specifications = names()->specifications;
+    SpecificationByOffset::const_iterator spec = specifications.find(offset);
+    return spec == specifications.end() ? NULL : &spec->second;
+  }
+
+  // Return the AbstractOrigin for the DIE at OFFSET, or NULL if we have
+  // none. If that DIE's name was left to its own abstract origin, follow
+  // the chain to the first origin that has one; return NULL if the chain
+  // runs into a DIE we have no record of.
+  const AbstractOrigin *FindAbstractOrigin(uint64 offset) const {
+    const AbstractOriginByOffset &origins = names()->origins;
+    // A chain can't be longer than the table, unless it loops.
+    for (size_t hops = 0; hops <= origins.size(); hops++) {
+      AbstractOriginByOffset::const_iterator origin = origins.find(offset);
+      if (origin == origins.end())
+        return NULL;
+      if (!origin->second.name.empty() || !origin->second.has_origin)
+        return &origin->second;
+      offset = origin->second.origin;
+    }
+    return NULL;
+  }
 };
 
 // Information about the context of a particular DIE. This is for
@@ -245,7 +324,7 @@ class DwarfCUToModule::GenericDIEHandler: public dwarf2reader::DIEHandler {
   // If this DIE has a DW_AT_specification attribute, this is the
   // Specification structure for the DIE the attribute refers to.
   // Otherwise, this is NULL.
-  Specification *specification_;
+  const Specification *specification_;
 
   // The value of the DW_AT_name attribute, or the empty string if the
   // DIE has no such attribute.
@@ -273,23 +352,19 @@ void DwarfCUToModule::GenericDIEHandler::ProcessAttributeReference(
     uint64 data) {
   switch (attr) {
     case dwarf2reader::DW_AT_specification: {
+      cu_context_->NoteReference(data);
       // Find the Specification to which this attribute refers, and
       // set specification_ appropriately. We could do more processing
       // here, but it's better to leave the real work to our
       // EndAttribute member function, at which point we know we have
       // seen all the DIE's attributes.
-      FileContext *file_context = cu_context_->file_context;
-      SpecificationByOffset *specifications
-          = &file_context->file_private->specifications;
-      SpecificationByOffset::iterator spec = specifications->find(data);
-      if (spec != specifications->end()) {
-        specification_ = &spec->second;
-      } else {
+      specification_ = cu_context_->FindSpecification(data);
+      if (!specification_ && !cu_context_->index_only) {
         // Technically, there's no reason a DW_AT_specification
-        // couldn't be a forward reference, but supporting that would
-        // be a lot of work (changing to a two-pass structure), and I
-        // don't think any producers we care about ever emit such
-        // things.
+        // couldn't be a forward reference. Producers we care about
+        // rarely emit such things, so resolving them takes a separate
+        // pass over the file, to build an index (see
+        // FileContext::index).
         cu_context_->reporter->UnknownSpecification(offset_, data);
       }
       break;
@@ -357,8 +432,8 @@ string DwarfCUToModule::GenericDIEHandler::ComputeQualifiedName() {
   }
 
   // If this DIE was marked as a declaration, record its names in the
-  // specification table.
-  if (declaration_) {
+  // specification table, unless the index has them already.
+  if (declaration_ && !cu_context_->file_context->index) {
     FileContext *file_context = cu_context_->file_context;
     Specification spec;
     if (qualified_name)
@@ -385,13 +460,11 @@ class DwarfCUToModule::FuncHandler: public GenericDIEHandler {
   FuncHandler(CUContext *cu_context, DIEContext *parent_context,
               uint64 offset)
       : GenericDIEHandler(cu_context, parent_context, offset),
-        low_pc_(0), high_pc_(0), abstract_origin_(NULL), inline_(false) { }
+        low_pc_(0), high_pc_(0), abstract_origin_(NULL),
+        has_abstract_origin_(false), abstract_origin_offset_(0) { }
   void ProcessAttributeUnsigned(enum DwarfAttribute attr,
                                 enum DwarfForm form,
                                 uint64 data);
-  void ProcessAttributeSigned(enum DwarfAttribute attr,
-                              enum DwarfForm form,
-                              int64 data);
   void ProcessAttributeReference(enum DwarfAttribute attr,
                                  enum DwarfForm form,
                                  uint64 data);
@@ -405,7 +478,10 @@ class DwarfCUToModule::FuncHandler: public GenericDIEHandler {
   string name_;
   uint64 low_pc_, high_pc_; // DW_AT_low_pc, DW_AT_high_pc
   const AbstractOrigin* abstract_origin_;
-  bool inline_;
+  // True if this DIE has a DW_AT_abstract_origin attribute, whose value
+  // is abstract_origin_offset_, whether or not we found that DIE.
+  bool has_abstract_origin_;
+  uint64 abstract_origin_offset_;
 };
 
 void DwarfCUToModule::FuncHandler::ProcessAttributeUnsigned(
@@ -413,11 +489,6 @@ void DwarfCUToModule::FuncHandler::ProcessAttributeUnsigned(
     enum DwarfForm form,
     uint64 data) {
   switch (attr) {
-    // If this attribute is present at all --- even if its value is
-    // DW_INL_not_inlined --- then GCC may cite it as someone else's
-    // DW_AT_abstract_origin attribute.
-    case dwarf2reader::DW_AT_inline:      inline_  = true; break;
-
     case dwarf2reader::DW_AT_low_pc:      low_pc_  = data; break;
     case dwarf2reader::DW_AT_high_pc:     high_pc_ = data; break;
     default:
@@ -426,35 +497,18 @@ void DwarfCUToModule::FuncHandler::ProcessAttributeUnsigned(
   }
 }
 
-void DwarfCUToModule::FuncHandler::ProcessAttributeSigned(
-    enum DwarfAttribute attr,
-    enum DwarfForm form,
-    int64 data) {
-  switch (attr) {
-    // If this attribute is present at all --- even if its value is
-    // DW_INL_not_inlined --- then GCC may cite it as someone else's
-    // DW_AT_abstract_origin attribute.
-    case dwarf2reader::DW_AT_inline:      inline_  = true; break;
-
-    default:
-      break;
-  }
-}
-
 void DwarfCUToModule::FuncHandler::ProcessAttributeReference(
     enum DwarfAttribute attr,
     enum DwarfForm form,
     uint64 data) {
   switch(attr) {
     case dwarf2reader::DW_AT_abstract_origin: {
-      const AbstractOriginByOffset& origins =
-          cu_context_->file_context->file_private->origins;
-      AbstractOriginByOffset::const_iterator origin = origins.find(data);
-      if (origin != origins.end()) {
-        abstract_origin_ = &(origin->second);
-      } else {
+      cu_context_->NoteReference(data);
+      has_abstract_origin_ = true;
+      abstract_origin_offset_ = data;
+      abstract_origin_ = cu_context_->FindAbstractOrigin(data);
+      if (!abstract_origin_ && !cu_context_->index_only)
         cu_context_->reporter->UnknownAbstractOrigin(offset_, data);
-      }
       break;
     }
     default:
@@ -478,6 +532,8 @@ void DwarfCUToModule::FuncHandler::Finish() {
   // functions that were never used), but all the ones we're
   // interested in cover a non-empty range of bytes.
   if (low_pc_ < high_pc_) {
+    if (cu_context_->index_only)
+      return;
     // Create a Module::Function based on the data we've gathered, and
     // add it to the functions_ list.
     Module::Function *func = new Module::Function;
@@ -497,8 +553,17 @@ void DwarfCUToModule::FuncHandler::Finish() {
        // description is just empty debug data and should just be discarded.
        cu_context_->functions.push_back(func);
      }
-  } else if (inline_) {
+  } else if (!cu_context_->file_context->index) {
+    // Any subprogram without code may be cited as someone else's
+    // DW_AT_abstract_origin: GCC marks the ones it expects to inline with
+    // DW_AT_inline (even DW_INL_not_inlined), but with LTO it also emits
+    // abstract subprograms that carry only a DW_AT_abstract_origin of
+    // their own, pointing at the original abstract instance.
     AbstractOrigin origin(name_);
+    if (name_.empty() && has_abstract_origin_ && !abstract_origin_) {
+      origin.has_origin = true;
+      origin.origin = abstract_origin_offset_;
+    }
     cu_context_->file_context->file_private->origins[offset_] = origin;
   }
 }
@@ -538,51 +603,76 @@ dwarf2reader::DIEHandler *DwarfCUToModule::NamedScopeHandler::FindChildHandler(
   }
 }
 
+void DwarfCUToModule::WarningReporter::Output(const string &text) {
+  fputs(text.c_str(), stderr);
+}
+
+void DwarfCUToModule::WarningReporter::Printf(const char *format, ...) {
+  char buffer[1024];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length < 0)
+    return;
+  if (static_cast<size_t>(length) < sizeof(buffer)) {
+    Output(buffer);
+    return;
+  }
+
+  // Function and file names can be long; try again with enough room.
+  vector<char> long_buffer(length + 1);
+  va_start(args, format);
+  vsnprintf(&long_buffer[0], long_buffer.size(), format, args);
+  va_end(args);
+  Output(string(&long_buffer[0], length));
+}
+
 void DwarfCUToModule::WarningReporter::CUHeading() {
   if (printed_cu_header_)
     return;
-  fprintf(stderr, "%s: in compilation unit '%s' (offset 0x%llx):\n",
-          filename_.c_str(), cu_name_.c_str(), cu_offset_);
+  Printf("%s: in compilation unit '%s' (offset 0x%llx):\n",
+         filename_.c_str(), cu_name_.c_str(), cu_offset_);
   printed_cu_header_ = true;
 }
 
 void DwarfCUToModule::WarningReporter::UnknownSpecification(uint64 offset,
                                                             uint64 target) {
   CUHeading();
-  fprintf(stderr, "%s: the DIE at offset 0x%llx has a DW_AT_specification"
-          " attribute referring to the die at offset 0x%llx, which either"
-          " was not marked as a declaration, or comes later in the file\n",
-          filename_.c_str(), offset, target);
+  Printf("%s: the DIE at offset 0x%llx has a DW_AT_specification"
+         " attribute referring to the die at offset 0x%llx, which either"
+         " was not marked as a declaration, or comes later in the file\n",
+         filename_.c_str(), offset, target);
 }
 
 void DwarfCUToModule::WarningReporter::UnknownAbstractOrigin(uint64 offset,
                                                              uint64 target) {
   CUHeading();
-  fprintf(stderr, "%s: the DIE at offset 0x%llx has a DW_AT_abstract_origin"
-          " attribute referring to the die at offset 0x%llx, which either"
-          " was not marked as an inline, or comes later in the file\n",
-          filename_.c_str(), offset, target);
+  Printf("%s: the DIE at offset 0x%llx has a DW_AT_abstract_origin"
+         " attribute referring to the die at offset 0x%llx, which either"
+         " was not marked as an inline, or comes later in the file\n",
+         filename_.c_str(), offset, target);
 }
 
 void DwarfCUToModule::WarningReporter::MissingSection(const string &name) {
   CUHeading();
-  fprintf(stderr, "%s: warning: couldn't find DWARF '%s' section\n",
-          filename_.c_str(), name.c_str());
+  Printf("%s: warning: couldn't find DWARF '%s' section\n",
+         filename_.c_str(), name.c_str());
 }
 
 void DwarfCUToModule::WarningReporter::BadLineInfoOffset(uint64 offset) {
   CUHeading();
-  fprintf(stderr, "%s: warning: line number data offset beyond end"
-          " of '.debug_line' section\n",
-          filename_.c_str());
+  Printf("%s: warning: line number data offset beyond end"
+         " of '.debug_line' section\n",
+         filename_.c_str());
 }
 
 void DwarfCUToModule::WarningReporter::UncoveredHeading() {
   if (printed_unpaired_header_)
     return;
   CUHeading();
-  fprintf(stderr, "%s: warning: skipping unpaired lines/functions:\n",
-          filename_.c_str());
+  Printf("%s: warning: skipping unpaired lines/functions:\n",
+         filename_.c_str());
   printed_unpaired_header_ = true;
 }
 
@@ -591,24 +681,24 @@ void DwarfCUToModule::WarningReporter::UncoveredFunction(
   if (!uncovered_warnings_enabled_)
     return;
   UncoveredHeading();
-  fprintf(stderr, "    function%s: %s\n",
-          function.size == 0 ? " (zero-length)" : "",
-          function.name.c_str());
+  Printf("    function%s: %s\n",
+         function.size == 0 ? " (zero-length)" : "",
+         function.name.c_str());
 }
 
 void DwarfCUToModule::WarningReporter::UncoveredLine(const Module::Line &line) {
   if (!uncovered_warnings_enabled_)
     return;
   UncoveredHeading();
-  fprintf(stderr, "    line%s: %s:%d at 0x%" PRIx64 "\n",
-          (line.size == 0 ? " (zero-length)" : ""),
-          line.file->name.c_str(), line.number, line.address);
+  Printf("    line%s: %s:%d at 0x%" PRIx64 "\n",
+         (line.size == 0 ? " (zero-length)" : ""),
+         line.file->name.c_str(), line.number, line.address);
 }
 
 void DwarfCUToModule::WarningReporter::UnnamedFunction(uint64 offset) {
   CUHeading();
-  fprintf(stderr, "%s: warning: function at offset 0x%llx has no name\n",
-          filename_.c_str(), offset);
+  Printf("%s: warning: function at offset 0x%llx has no name\n",
+         filename_.c_str(), offset);
 }
 
 DwarfCUToModule::DwarfCUToModule(FileContext *file_context,
@@ -940,6 +1030,10 @@ void DwarfCUToModule::AssignLinesToFunctions() {
 }
 
 void DwarfCUToModule::Finish() {
+  // An index-only pass has no functions or lines to deal with.
+  if (cu_context_->index_only)
+    return;
+
   // Assembly language files have no function data, and that gives us
   // no place to store our line numbers (even though the GNU toolchain
   // will happily produce source line info for assembly language
@@ -972,6 +1066,8 @@ bool DwarfCUToModule::StartCompilationUnit(uint64 offset,
                                            uint8 offset_size,
                                            uint64 cu_length,
                                            uint8 dwarf_version) {
+  cu_context_->start_offset = offset;
+  cu_context_->end_offset = offset + cu_length + (offset_size == 8 ? 12 : 4);
   return dwarf_version >= 2;
 }
 
@@ -981,4 +1077,12 @@ bool DwarfCUToModule::StartRootDIE(uint64 offset, enum DwarfTag tag) {
   return tag == dwarf2reader::DW_TAG_compile_unit;
 }
 
+void DwarfCUToModule::set_index_only(bool index_only) {
+  cu_context_->index_only = index_only;
+}
+
+bool DwarfCUToModule::has_inter_unit_references() const {
+  return cu_context_->has_inter_unit_references;
+}
+
 } // namespace google_breakpad
@@ -78,6 +78,11 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
     FileContext(const string &filename_arg, Module *module_arg);
     ~FileContext();
 
+    // Add the inter-compilation unit data gathered while processing
+    // compilation units with OTHER to this context, as if they had
+    // been processed with this one.
+    void AddInterUnitData(const FileContext &other);
+
     // The name of this file, for use in error messages.
     string filename;
 
@@ -88,6 +93,15 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
     // The Module to which we're contributing definitions.
     Module *module;
 
+    // A context that handlers in index-only mode (see set_index_only)
+    // have already been run over, for every compilation unit in the
+    // file, or NULL. Handlers look up the targets of DW_AT_specification
+    // and DW_AT_abstract_origin attributes there, so references to DIEs
+    // later in the file, or in other compilation units, resolve no
+    // matter what order units are processed in. The index must outlive
+    // this context, and must not change while handlers are using it.
+    const FileContext *index;
+
     // Inter-compilation unit data used internally by the handlers.
     FilePrivate *file_private;
   };
@@ -110,9 +124,9 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
   };
 
   // The interface DwarfCUToModule uses to report warnings. The member
-  // function definitions for this class write messages to stderr, but
-  // you can override them if you'd like to detect or report these
-  // conditions yourself.
+  // function definitions for this class format messages and pass them
+  // to Output, which writes them to stderr; you can override either if
+  // you'd like to detect or report these conditions yourself.
   class WarningReporter {
    public:
     // Warn about problems in the DWARF file FILENAME, in the
@@ -165,6 +179,9 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
     virtual void UnnamedFunction(uint64 offset);
 
    protected:
+    // Write TEXT, a formatted piece of a warning message, to stderr.
+    virtual void Output(const string &text);
+
     string filename_;
     uint64 cu_offset_;
     string cu_name_;
@@ -173,6 +190,8 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
     bool uncovered_warnings_enabled_;
 
    private:
+    // Format a message as printf would, and pass it to Output.
+    void Printf(const char *format, ...);
     // Print a per-CU heading, once.
     void CUHeading();
     // Print an unpaired function/line heading, once.
@@ -211,6 +230,20 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
                             uint8 dwarf_version);
   bool StartRootDIE(uint64 offset, enum DwarfTag tag);
 
+  // If INDEX_ONLY is true, only record the names that other DIEs'
+  // DW_AT_specification and DW_AT_abstract_origin attributes may refer
+  // to in FILE_CONTEXT, without reading line data, adding functions to
+  // the module, or reporting references to DIEs not seen yet. Call this
+  // before the handler sees the compilation unit.
+  void set_index_only(bool index_only);
+
+  // Return true if a DW_AT_specification or DW_AT_abstract_origin
+  // attribute in this compilation unit referred to a DIE outside it,
+  // and FILE_CONTEXT has no index to find that DIE in. Only compilation
+  // units for which this is false produce the same results whatever
+  // other units FILE_CONTEXT has seen.
+  bool has_inter_unit_references() const;
+
  private:
 
   // Used internally by the handler. Full definitions are in
@@ -39,6 +39,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <link.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -69,6 +70,7 @@
 // This namespace contains helper functions.
 namespace {
 
+using google_breakpad::DumpOptions;
 using google_breakpad::DwarfCFIToModule;
 using google_breakpad::DwarfCUToModule;
 using google_breakpad::DwarfLineToModule;
@@ -200,10 +202,320 @@ class DumperLineToModule: public DwarfCUToModule::LineToModuleFunctor {
   dwarf2reader::ByteReader *byte_reader_;
 };
 
+// A warning reporter that holds on to the warnings about a compilation
+// unit, so that the warnings about units processed in parallel can
+// still be printed in the order the units appear in the file.
+class BufferedWarningReporter: public DwarfCUToModule::WarningReporter {
+ public:
+  BufferedWarningReporter(const string &filename, uint64 cu_offset)
+      : DwarfCUToModule::WarningReporter(filename, cu_offset) { }
+
+  // Write the warnings reported so far to stderr.
+  void Flush() {
+    fputs(buffer_.c_str(), stderr);
+    buffer_.clear();
+  }
+
+ protected:
+  void Output(const string &text) { buffer_ += text; }
+
+ private:
+  string buffer_;
+};
+
+// Moves a module's functions out to temporary files as DumpOptions
+// asks, once they have enough source lines between them.
+class FunctionSpiller {
+ public:
+  FunctionSpiller(const DumpOptions &options, Module *module)
+      : options_(options),
+        module_(module),
+        enabled_(!options.spill_directory.empty()) { }
+
+  // Call once the functions of a compilation unit have been added to
+  // the module, when their address ranges are final.
+  void UnitDone() {
+    if (enabled_ && module_->unspilled_line_count() >= options_.spill_lines &&
+        !module_->SpillFunctions(options_.spill_directory)) {
+      // The module still has its functions; carry on in memory.
+      fprintf(stderr, "keeping functions in memory\n");
+      enabled_ = false;
+    }
+  }
+
+ private:
+  const DumpOptions &options_;
+  Module *module_;
+  bool enabled_;
+};
+
+// What processing a compilation unit on its own, without the data
+// from the units before it, produced.
+struct DwarfCUResult {
+  DwarfCUResult(const string &dwarf_filename, uint64 offset)
+      : module("", "", "", ""),
+        file_context(dwarf_filename, &module),
+        reporter(dwarf_filename, offset),
+        has_inter_unit_references(false) { }
+
+  // The functions and files the unit defines.
+  Module module;
+
+  // The context the unit was processed in, holding the specifications
+  // and abstract origins it declares.
+  DwarfCUToModule::FileContext file_context;
+
+  // The warnings processing the unit produced.
+  BufferedWarningReporter reporter;
+
+  // True if the unit refers to DIEs outside itself, in which case the
+  // results above may be wrong, and it must be processed again.
+  bool has_inter_unit_references;
+};
+
+// The compilation units of a .debug_info section, shared between the
+// threads processing them.
+struct DwarfCUQueue {
+  // The file's sections, and their byte order.
+  const dwarf2reader::SectionMap *section_map;
+  dwarf2reader::Endianness endianness;
+
+  // The name of the file, for warnings.
+  string dwarf_filename;
+
+  // The units' abbreviation tables, all parsed before the threads
+  // start, and frozen.
+  dwarf2reader::CompilationUnit::AbbrevCache *abbrev_cache;
+
+  // The index of the file's specifications and abstract origins, or
+  // NULL if there is none.
+  const DwarfCUToModule::FileContext *index;
+
+  // The offsets of the units in the .debug_info section.
+  std::vector<uint64> offsets;
+
+  // The results of processing each unit, or NULL for units which have
+  // not been processed yet. Guarded by MUTEX.
+  std::vector<DwarfCUResult *> results;
+
+  // The index of the next unit to process. Guarded by MUTEX.
+  size_t next;
+
+  // The number of results the merging thread has taken. Guarded by
+  // MUTEX.
+  size_t merged;
+
+  // How far NEXT may run ahead of MERGED, so that results waiting to be
+  // merged do not pile up when the merge falls behind.
+  size_t max_in_flight;
+
+  pthread_mutex_t mutex;
+  // Signalled whenever a result is stored.
+  pthread_cond_t result_ready;
+  // Signalled whenever a result is taken.
+  pthread_cond_t result_taken;
+};
+
+// How many units each thread may have processed or be processing
+// before the merge catches up.
+const size_t kDwarfUnitsInFlightPerThread = 4;
+
+// Fill OFFSETS with the offsets of the compilation units in the
+// .debug_info section DEBUG_INFO, reading their headers with BYTE_READER.
+void FindCompilationUnits(const std::pair<const char *, uint64> &debug_info,
+                          dwarf2reader::ByteReader *byte_reader,
+                          std::vector<uint64> *offsets) {
+  const char *start = debug_info.first;
+  const uint64 length = debug_info.second;
+  uint64 offset = 0;
+  // Leave headers too short to read to CompilationUnit to complain
+  // about.
+  while (offset < length) {
+    offsets->push_back(offset);
+    if (length - offset < 12)
+      break;
+    size_t initial_length_size;
+    const uint64 unit_length =
+        byte_reader->ReadInitialLength(start + offset, &initial_length_size);
+    if (unit_length >= length - offset - initial_length_size)
+      break;
+    offset += initial_length_size + unit_length;
+  }
+}
+
+// Process the compilation units in the DwarfCUQueue ARG, one at a
+// time, until there are none left.
+void *ProcessDwarfCUs(void *arg) {
+  DwarfCUQueue *queue = reinterpret_cast<DwarfCUQueue *>(arg);
+  // CompilationUnit sets the reader's address and offset sizes, so
+  // each thread needs its own.
+  dwarf2reader::ByteReader byte_reader(queue->endianness);
+  DumperLineToModule line_to_module(&byte_reader);
+
+  while (true) {
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->next < queue->offsets.size() &&
+           queue->next - queue->merged >= queue->max_in_flight)
+      pthread_cond_wait(&queue->result_taken, &queue->mutex);
+    const size_t index = queue->next;
+    if (index < queue->offsets.size())
+      ++queue->next;
+    pthread_mutex_unlock(&queue->mutex);
+    if (index >= queue->offsets.size())
+      break;
+
+    const uint64 offset = queue->offsets[index];
+    DwarfCUResult *result = new DwarfCUResult(queue->dwarf_filename, offset);
+    result->file_context.section_map = *queue->section_map;
+    result->file_context.index = queue->index;
+    {
+      DwarfCUToModule root_handler(&result->file_context, &line_to_module,
+                                   &result->reporter);
+      dwarf2reader::DIEDispatcher die_dispatcher(&root_handler);
+      dwarf2reader::CompilationUnit reader(result->file_context.section_map,
+                                           offset,
+                                           &byte_reader,
+                                           &die_dispatcher);
+      reader.SetAbbrevCache(queue->abbrev_cache);
+      reader.Start();
+      result->has_inter_unit_references =
+          root_handler.has_inter_unit_references();
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    queue->results[index] = result;
+    pthread_cond_broadcast(&queue->result_ready);
+    pthread_mutex_unlock(&queue->mutex);
+  }
+  return NULL;
+}
+
+// Process the compilation units in .debug_info on DWARF_THREADS
+// threads, and add what they define to FILE_CONTEXT's module, letting
+// SPILLER know as each unit's functions are added. The units'
+// abbreviation tables are parsed into ABBREV_CACHE first. The
+// result is the same as processing them one after another: each unit
+// is processed on its own, then the results are added in the order
+// the units appear in the file, with the first definition of a
+// function winning. A unit that refers to DIEs outside itself is
+// processed again at that point, with the data from all the units
+// before it.
+void LoadDwarfInParallel(DwarfCUToModule::FileContext *file_context,
+                         dwarf2reader::Endianness endianness,
+                         int dwarf_threads,
+                         FunctionSpiller *spiller,
+                         dwarf2reader::CompilationUnit::AbbrevCache
+                             *abbrev_cache) {
+  dwarf2reader::ByteReader byte_reader(endianness);
+  DwarfCUQueue queue;
+  queue.section_map = &file_context->section_map;
+  queue.endianness = endianness;
+  queue.dwarf_filename = file_context->filename;
+  queue.abbrev_cache = abbrev_cache;
+  queue.index = file_context->index;
+  FindCompilationUnits(file_context->section_map[".debug_info"],
+                       &byte_reader, &queue.offsets);
+  // The threads only read the cache, so that they can share it.
+  dwarf2reader::Dwarf2Handler no_handler;
+  for (size_t i = 0; i < queue.offsets.size(); ++i) {
+    dwarf2reader::CompilationUnit unit(file_context->section_map,
+                                       queue.offsets[i],
+                                       &byte_reader,
+                                       &no_handler);
+    unit.SetAbbrevCache(abbrev_cache);
+    unit.CacheAbbrevs();
+  }
+  abbrev_cache->Freeze();
+  queue.results.resize(queue.offsets.size(), NULL);
+  queue.next = 0;
+  queue.merged = 0;
+  queue.max_in_flight =
+      kDwarfUnitsInFlightPerThread * static_cast<size_t>(dwarf_threads);
+  pthread_mutex_init(&queue.mutex, NULL);
+  pthread_cond_init(&queue.result_ready, NULL);
+  pthread_cond_init(&queue.result_taken, NULL);
+
+  std::vector<pthread_t> threads;
+  for (size_t i = 0;
+       i < static_cast<size_t>(dwarf_threads) && i < queue.offsets.size();
+       ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ProcessDwarfCUs, &queue) != 0)
+      break;
+    threads.push_back(thread);
+  }
+  if (threads.empty()) {
+    // Nothing merges until this returns, so it cannot wait for that.
+    queue.max_in_flight = queue.offsets.size();
+    ProcessDwarfCUs(&queue);
+  }
+
+  DumperLineToModule line_to_module(&byte_reader);
+  for (size_t i = 0; i < queue.offsets.size(); ++i) {
+    pthread_mutex_lock(&queue.mutex);
+    while (!queue.results[i])
+      pthread_cond_wait(&queue.result_ready, &queue.mutex);
+    DwarfCUResult *result = queue.results[i];
+    queue.results[i] = NULL;
+    queue.merged = i + 1;
+    pthread_cond_broadcast(&queue.result_taken);
+    pthread_mutex_unlock(&queue.mutex);
+
+    if (!result->has_inter_unit_references) {
+      file_context->AddInterUnitData(result->file_context);
+      file_context->module->TakeFunctionsAndFiles(&result->module);
+      result->reporter.Flush();
+      spiller->UnitDone();
+    } else {
+      DwarfCUToModule::WarningReporter reporter(file_context->filename,
+                                                queue.offsets[i]);
+      DwarfCUToModule root_handler(file_context, &line_to_module, &reporter);
+      dwarf2reader::DIEDispatcher die_dispatcher(&root_handler);
+      dwarf2reader::CompilationUnit reader(file_context->section_map,
+                                           queue.offsets[i],
+                                           &byte_reader,
+                                           &die_dispatcher);
+      reader.SetAbbrevCache(abbrev_cache);
+      reader.Start();
+      spiller->UnitDone();
+    }
+    delete result;
+  }
+
+  for (size_t i = 0; i < threads.size(); ++i)
+    pthread_join(threads[i], NULL);
+  pthread_cond_destroy(&queue.result_taken);
+  pthread_cond_destroy(&queue.result_ready);
+  pthread_mutex_destroy(&queue.mutex);
+}
+
+// Run index-only handlers over the compilation units in INDEX's
+// .debug_info section, one after another, so that INDEX can serve as
+// the index of other contexts for the same file.
+void IndexDwarf(DwarfCUToModule::FileContext *index,
+                dwarf2reader::ByteReader *byte_reader,
+                dwarf2reader::CompilationUnit::AbbrevCache *abbrev_cache) {
+  DumperLineToModule line_to_module(byte_reader);
+  const uint64 debug_info_length = index->section_map[".debug_info"].second;
+  for (uint64 offset = 0; offset < debug_info_length;) {
+    DwarfCUToModule::WarningReporter reporter(index->filename, offset);
+    DwarfCUToModule root_handler(index, &line_to_module, &reporter);
+    root_handler.set_index_only(true);
+    dwarf2reader::DIEDispatcher die_dispatcher(&root_handler);
+    dwarf2reader::CompilationUnit reader(index->section_map,
+                                         offset,
+                                         byte_reader,
+                                         &die_dispatcher);
+    reader.SetAbbrevCache(abbrev_cache);
+    offset += reader.Start();
+  }
+}
+
 template<typename ElfClass>
 bool LoadDwarf(const string& dwarf_filename,
                const typename ElfClass::Ehdr* elf_header,
                const bool big_endian,
+               const DumpOptions& options,
                Module* module) {
   typedef typename ElfClass::Shdr Shdr;
 
@@ -237,6 +549,20 @@ bool LoadDwarf(const string& dwarf_filename,
   // This should never have been called if the file doesn't have a
   // .debug_info section.
   assert(debug_info_section.first);
+  FunctionSpiller spiller(options, module);
+  // Compilation units often share abbreviation tables; parse each once.
+  dwarf2reader::CompilationUnit::AbbrevCache abbrev_cache;
+  DwarfCUToModule::FileContext index(dwarf_filename, module);
+  if (options.dwarf_index) {
+    index.section_map = file_context.section_map;
+    IndexDwarf(&index, &byte_reader, &abbrev_cache);
+    file_context.index = &index;
+  }
+  if (options.dwarf_threads > 1) {
+    LoadDwarfInParallel(&file_context, endianness, options.dwarf_threads,
+                        &spiller, &abbrev_cache);
+    return true;
+  }
   uint64 debug_info_length = debug_info_section.second;
   for (uint64 offset = 0; offset < debug_info_length;) {
     // Make a handler for the root DIE that populates MODULE with the
@@ -250,8 +576,10 @@ bool LoadDwarf(const string& dwarf_filename,
                                          offset,
                                          &byte_reader,
                                          &die_dispatcher);
+    reader.SetAbbrevCache(&abbrev_cache);
     // Process the entire compilation unit; get the offset of the next.
     offset += reader.Start();
+    spiller.UnitDone();
   }
   return true;
 }
@@ -490,6 +818,7 @@ bool LoadSymbols(const string& obj_file,
                  const bool big_endian,
                  const typename ElfClass::Ehdr* elf_header,
                  const bool read_gnu_debug_link,
+                 const DumpOptions& options,
                  LoadSymbolsInfo<ElfClass>* info,
                  Module* module) {
   typedef typename ElfClass::Addr Addr;
@@ -539,7 +868,8 @@ bool LoadSymbols(const string& obj_file,
     found_debug_info_section = true;
     found_usable_info = true;
     info->LoadedSection(".debug_info");
-    if (!LoadDwarf<ElfClass>(obj_file, elf_header, big_endian, module))
+    if (!LoadDwarf<ElfClass>(obj_file, elf_header, big_endian,
+                             options, module))
       fprintf(stderr, "%s: \".debug_info\" section found, but failed to load "
               "DWARF debugging information\n", obj_file.c_str());
   }
@@ -712,7 +1042,7 @@ template<typename ElfClass>
 bool WriteSymbolFileElfClass(const typename ElfClass::Ehdr* elf_header,
                              const string& obj_filename,
                              const string& debug_dir,
-                             bool cfi,
+                             const DumpOptions& options,
                              std::ostream& sym_stream) {
   typedef typename ElfClass::Ehdr Ehdr;
   typedef typename ElfClass::Shdr Shdr;
@@ -744,7 +1074,8 @@ bool WriteSymbolFileElfClass(const typename ElfClass::Ehdr* elf_header,
   LoadSymbolsInfo<ElfClass> info(debug_dir);
   Module module(name, os, architecture, id);
   if (!LoadSymbols<ElfClass>(obj_filename, big_endian, elf_header,
-                             !debug_dir.empty(), &info, &module)) {
+                             !debug_dir.empty(), options, &info,
+                             &module)) {
     const string debuglink_file = info.debuglink_file();
     if (debuglink_file.empty())
       return false;
@@ -782,11 +1113,12 @@ bool WriteSymbolFileElfClass(const typename ElfClass::Ehdr* elf_header,
     }
 
     if (!LoadSymbols<ElfClass>(debuglink_file, debug_big_endian,
-                               debug_elf_header, false, &info, &module)) {
+                               debug_elf_header, false, options, &info,
+                               &module)) {
       return false;
     }
   }
-  if (!module.Write(sym_stream, cfi))
+  if (!module.Write(sym_stream, options.cfi))
     return false;
 
   return true;
@@ -800,7 +1132,7 @@ namespace google_breakpad {
 bool WriteSymbolFileInternal(const uint8_t* obj_file,
                              const string& obj_filename,
                              const string& debug_dir,
-                             bool cfi,
+                             const DumpOptions& options,
                              std::ostream& sym_stream) {
 
   if (!IsValidElf(obj_file)) {
@@ -812,12 +1144,12 @@ bool WriteSymbolFileInternal(const uint8_t* obj_file,
   if (elfclass == ELFCLASS32) {
     return WriteSymbolFileElfClass<ElfClass32>(
         reinterpret_cast<const Elf32_Ehdr*>(obj_file), obj_filename, debug_dir,
-        cfi, sym_stream);
+        options, sym_stream);
   }
   if (elfclass == ELFCLASS64) {
     return WriteSymbolFileElfClass<ElfClass64>(
         reinterpret_cast<const Elf64_Ehdr*>(obj_file), obj_filename, debug_dir,
-        cfi, sym_stream);
+        options, sym_stream);
   }
 
   return false;
@@ -827,13 +1159,31 @@ bool WriteSymbolFile(const string &obj_file,
                      const string &debug_dir,
                      bool cfi,
                      std::ostream &sym_stream) {
+  return WriteSymbolFile(obj_file, debug_dir, cfi, 1, sym_stream);
+}
+
+bool WriteSymbolFile(const string &obj_file,
+                     const string &debug_dir,
+                     bool cfi,
+                     int dwarf_threads,
+                     std::ostream &sym_stream) {
+  DumpOptions options;
+  options.cfi = cfi;
+  options.dwarf_threads = dwarf_threads;
+  return WriteSymbolFile(obj_file, debug_dir, options, sym_stream);
+}
+
+bool WriteSymbolFile(const string &obj_file,
+                     const string &debug_dir,
+                     const DumpOptions &options,
+                     std::ostream &sym_stream) {
   MmapWrapper map_wrapper;
   void* elf_header = NULL;
   if (!LoadELF(obj_file, &map_wrapper, &elf_header))
     return false;
 
   return WriteSymbolFileInternal(reinterpret_cast<uint8_t*>(elf_header),
-                                 obj_file, debug_dir, cfi, sym_stream);
+                                 obj_file, debug_dir, options, sym_stream);
 }
 
 }  // namespace google_breakpad
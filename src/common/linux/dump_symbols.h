@@ -35,6 +35,8 @@
 #ifndef COMMON_LINUX_DUMP_SYMBOLS_H__
 #define COMMON_LINUX_DUMP_SYMBOLS_H__
 
+#include <stddef.h>
+
 #include <iostream>
 #include <string>
 
@@ -42,6 +44,35 @@
 
 namespace google_breakpad {
 
+// Options for WriteSymbolFile. Apart from CFI and DWARF_INDEX, they
+// don't change the symbol file written, only how it is produced.
+struct DumpOptions {
+  DumpOptions()
+      : cfi(true), dwarf_index(false), dwarf_threads(1),
+        spill_lines(1 << 22) { }
+
+  // If false, omit the CFI section.
+  bool cfi;
+
+  // If true, make a first pass over the DWARF compilation units to
+  // index the DIEs that DW_AT_specification and DW_AT_abstract_origin
+  // attributes refer to. This names functions whose references point
+  // forwards, or into units processed later, and lets units processed
+  // in parallel use each other's DIEs without being processed again.
+  bool dwarf_index;
+
+  // The number of threads on which to process DWARF compilation units.
+  int dwarf_threads;
+
+  // If not empty, bound the memory used for functions and their source
+  // lines: once the functions read from the compilation units so far
+  // have at least SPILL_LINES lines between them, move them to a
+  // temporary file in this directory, to be merged back in as the
+  // symbol file is written.
+  string spill_directory;
+  size_t spill_lines;
+};
+
 // Find all the debugging information in OBJ_FILE, an ELF executable
 // or shared library, and write it to SYM_STREAM in the Breakpad symbol
 // file format.
@@ -53,6 +84,22 @@ bool WriteSymbolFile(const string &obj_file,
                      bool cfi,
                      std::ostream &sym_stream);
 
+// As above, but process the DWARF compilation units in OBJ_FILE on
+// DWARF_THREADS threads. The symbol file written is the same whatever
+// the number of threads.
+bool WriteSymbolFile(const string &obj_file,
+                     const string &debug_dir,
+                     bool cfi,
+                     int dwarf_threads,
+                     std::ostream &sym_stream);
+
+// As above, with the CFI section, the number of threads and the use of
+// temporary files all given by OPTIONS.
+bool WriteSymbolFile(const string &obj_file,
+                     const string &debug_dir,
+                     const DumpOptions &options,
+                     std::ostream &sym_stream);
+
 }  // namespace google_breakpad
 
 #endif  // COMMON_LINUX_DUMP_SYMBOLS_H__
@@ -41,21 +41,27 @@
 #include <vector>
 
 #include "breakpad_googletest_includes.h"
+#include "common/dwarf/dwarf2reader_test_common.h"
+#include "common/linux/dump_symbols.h"
 #include "common/linux/synth_elf.h"
+#include "common/tests/auto_tempdir.h"
 #include "common/using_std_string.h"
 
 namespace google_breakpad {
 bool WriteSymbolFileInternal(const uint8_t* obj_file,
                              const string &obj_filename,
                              const string &debug_dir,
-                             bool cfi,
+                             const DumpOptions &options,
                              std::ostream &sym_stream);
 }
 
+using google_breakpad::AutoTempDir;
+using google_breakpad::DumpOptions;
 using google_breakpad::synth_elf::ELF;
 using google_breakpad::synth_elf::StringTable;
 using google_breakpad::synth_elf::SymbolTable;
 using google_breakpad::test_assembler::kLittleEndian;
+using google_breakpad::test_assembler::Label;
 using google_breakpad::test_assembler::Section;
 using google_breakpad::WriteSymbolFileInternal;
 using std::stringstream;
@@ -85,7 +91,7 @@ TEST_F(DumpSymbols, Invalid) {
   EXPECT_FALSE(WriteSymbolFileInternal(reinterpret_cast<uint8_t*>(&header),
                                        "foo",
                                        "",
-                                       true,
+                                       DumpOptions(),
                                        s));
 }
 
@@ -117,7 +123,7 @@ TEST_F(DumpSymbols, SimplePublic32) {
   ASSERT_TRUE(WriteSymbolFileInternal(elfdata,
                                       "foo",
                                       "",
-                                      true,
+                                      DumpOptions(),
                                       s));
   EXPECT_EQ("MODULE Linux x86 000000000000000000000000000000000 foo\n"
             "PUBLIC 1000 0 superfunc\n",
@@ -152,9 +158,225 @@ TEST_F(DumpSymbols, SimplePublic64) {
   ASSERT_TRUE(WriteSymbolFileInternal(elfdata,
                                       "foo",
                                       "",
-                                      true,
+                                      DumpOptions(),
                                       s));
   EXPECT_EQ("MODULE Linux x86_64 000000000000000000000000000000000 foo\n"
             "PUBLIC 1000 0 superfunc\n",
             s.str());
 }
+
+// Add a DW_TAG_subprogram DIE for a function named NAME, covering
+// [LOW_PC, HIGH_PC), to INFO, using abbreviation code 2 from the table
+// built in DumpSymbols.DwarfThreads.
+static void AddFunctionDIE(TestCompilationUnit *info, const string &name,
+                           uint64_t low_pc, uint64_t high_pc) {
+  info->ULEB128(2).AppendCString(name).D64(low_pc).D64(high_pc);
+}
+
+// Processing compilation units in parallel, or spilling their functions
+// to temporary files, must write the same symbol file as processing
+// them one at a time in memory: the first definition of a function
+// wins, and a unit whose DIEs refer to another unit's sees the data
+// from the units before it.
+TEST_F(DumpSymbols, DwarfThreads) {
+  TestAbbrevTable abbrevs;
+  abbrevs.set_endianness(kLittleEndian);
+  Label abbrev_table = abbrevs.Here();
+  abbrevs
+      .Abbrev(1, dwarf2reader::DW_TAG_compile_unit,
+              dwarf2reader::DW_children_yes)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .EndAbbrev()
+      .Abbrev(2, dwarf2reader::DW_TAG_subprogram, dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .Attribute(dwarf2reader::DW_AT_low_pc, dwarf2reader::DW_FORM_addr)
+      .Attribute(dwarf2reader::DW_AT_high_pc, dwarf2reader::DW_FORM_addr)
+      .EndAbbrev()
+      .Abbrev(3, dwarf2reader::DW_TAG_subprogram, dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .Attribute(dwarf2reader::DW_AT_declaration, dwarf2reader::DW_FORM_flag)
+      .EndAbbrev()
+      .Abbrev(4, dwarf2reader::DW_TAG_subprogram, dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_specification,
+                 dwarf2reader::DW_FORM_ref_addr)
+      .Attribute(dwarf2reader::DW_AT_low_pc, dwarf2reader::DW_FORM_addr)
+      .Attribute(dwarf2reader::DW_AT_high_pc, dwarf2reader::DW_FORM_addr)
+      .EndAbbrev()
+      .EndTable();
+
+  const int kUnits = 24;
+  TestCompilationUnit units[kUnits];
+  Label declaration;
+  Section debug_info(kLittleEndian);
+  for (int i = 0; i < kUnits; ++i) {
+    TestCompilationUnit &unit = units[i];
+    unit.set_format_size(4);
+    unit.set_endianness(kLittleEndian);
+    unit.start() = debug_info.start() + debug_info.Size();
+    unit.Header(3, abbrev_table, 8);
+    char name[32];
+    snprintf(name, sizeof(name), "unit%d.cc", i);
+    unit.ULEB128(1).AppendCString(name);
+    if (i == 0) {
+      // Declares a function defined in a later unit.
+      unit.Mark(&declaration);
+      unit.ULEB128(3).AppendCString("declared").D8(1);
+    } else if (i == 1) {
+      // Defines the same function as the last unit, but first.
+      AddFunctionDIE(&unit, "duplicate", 0x1000, 0x1010);
+    } else if (i == kUnits / 2) {
+      unit.ULEB128(4).D32(declaration).D64(0x1020).D64(0x1030);
+    } else if (i == kUnits - 1) {
+      AddFunctionDIE(&unit, "duplicate", 0x1000, 0x1008);
+    }
+    char function[32];
+    snprintf(function, sizeof(function), "function%d", i);
+    AddFunctionDIE(&unit, function, 0x2000 + i * 0x10, 0x2008 + i * 0x10);
+    unit.D8(0);
+    unit.Finish();
+    debug_info.Append(unit);
+  }
+  abbrevs.start() = 0;
+  debug_info.start() = 0;
+
+  ELF elf(EM_X86_64, ELFCLASS64, kLittleEndian);
+  Section text(kLittleEndian);
+  text.Append(4096, 0);
+  elf.AddSection(".text", text, SHT_PROGBITS);
+  elf.AddSection(".debug_abbrev", abbrevs, SHT_PROGBITS);
+  elf.AddSection(".debug_info", debug_info, SHT_PROGBITS);
+  elf.Finish();
+  GetElfContents(elf);
+
+  stringstream expected;
+  expected << "MODULE Linux x86_64 000000000000000000000000000000000 foo\n"
+           << "FUNC 1000 10 0 duplicate\n"
+           << "FUNC 1020 10 0 declared\n";
+  for (int i = 0; i < kUnits; ++i)
+    expected << "FUNC " << std::hex << 0x2000 + i * 0x10
+             << " 8 0 function" << std::dec << i << "\n";
+
+  const int kThreads[] = { 1, 2, 7, 64 };
+  for (size_t i = 0; i < sizeof(kThreads) / sizeof(kThreads[0]); ++i) {
+    DumpOptions options;
+    options.dwarf_threads = kThreads[i];
+    stringstream s;
+    ASSERT_TRUE(WriteSymbolFileInternal(elfdata,
+                                        "foo",
+                                        "",
+                                        options,
+                                        s));
+    EXPECT_EQ(expected.str(), s.str()) << kThreads[i] << " threads";
+
+    // Spilling the functions after every unit changes nothing either.
+    AutoTempDir temp_dir;
+    options.spill_directory = temp_dir.path();
+    options.spill_lines = 0;
+    stringstream spilled;
+    ASSERT_TRUE(WriteSymbolFileInternal(elfdata,
+                                        "foo",
+                                        "",
+                                        options,
+                                        spilled));
+    EXPECT_EQ(expected.str(), spilled.str())
+        << kThreads[i] << " threads, spilling";
+  }
+}
+
+// With DumpOptions::dwarf_index set, a DW_AT_specification that refers
+// to a declaration in a later compilation unit still names the
+// function, however many threads process the units.
+TEST_F(DumpSymbols, DwarfIndex) {
+  TestAbbrevTable abbrevs;
+  abbrevs.set_endianness(kLittleEndian);
+  Label abbrev_table = abbrevs.Here();
+  abbrevs
+      .Abbrev(1, dwarf2reader::DW_TAG_compile_unit,
+              dwarf2reader::DW_children_yes)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .EndAbbrev()
+      .Abbrev(2, dwarf2reader::DW_TAG_subprogram, dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .Attribute(dwarf2reader::DW_AT_low_pc, dwarf2reader::DW_FORM_addr)
+      .Attribute(dwarf2reader::DW_AT_high_pc, dwarf2reader::DW_FORM_addr)
+      .EndAbbrev()
+      .Abbrev(3, dwarf2reader::DW_TAG_subprogram, dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .Attribute(dwarf2reader::DW_AT_declaration, dwarf2reader::DW_FORM_flag)
+      .EndAbbrev()
+      .Abbrev(4, dwarf2reader::DW_TAG_subprogram, dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_specification,
+                 dwarf2reader::DW_FORM_ref_addr)
+      .Attribute(dwarf2reader::DW_AT_low_pc, dwarf2reader::DW_FORM_addr)
+      .Attribute(dwarf2reader::DW_AT_high_pc, dwarf2reader::DW_FORM_addr)
+      .EndAbbrev()
+      .EndTable();
+
+  const int kUnits = 6;
+  TestCompilationUnit units[kUnits];
+  Label declaration;
+  Section debug_info(kLittleEndian);
+  for (int i = 0; i < kUnits; ++i) {
+    TestCompilationUnit &unit = units[i];
+    unit.set_format_size(4);
+    unit.set_endianness(kLittleEndian);
+    unit.start() = debug_info.start() + debug_info.Size();
+    unit.Header(3, abbrev_table, 8);
+    char name[32];
+    snprintf(name, sizeof(name), "unit%d.cc", i);
+    unit.ULEB128(1).AppendCString(name);
+    if (i == 1) {
+      // Defines a function declared in a later unit.
+      unit.ULEB128(4).D32(declaration).D64(0x1020).D64(0x1030);
+    } else if (i == kUnits - 1) {
+      unit.Mark(&declaration);
+      unit.ULEB128(3).AppendCString("declared").D8(1);
+    }
+    char function[32];
+    snprintf(function, sizeof(function), "function%d", i);
+    AddFunctionDIE(&unit, function, 0x2000 + i * 0x10, 0x2008 + i * 0x10);
+    unit.D8(0);
+    unit.Finish();
+    debug_info.Append(unit);
+  }
+  abbrevs.start() = 0;
+  debug_info.start() = 0;
+
+  ELF elf(EM_X86_64, ELFCLASS64, kLittleEndian);
+  Section text(kLittleEndian);
+  text.Append(4096, 0);
+  elf.AddSection(".text", text, SHT_PROGBITS);
+  elf.AddSection(".debug_abbrev", abbrevs, SHT_PROGBITS);
+  elf.AddSection(".debug_info", debug_info, SHT_PROGBITS);
+  elf.Finish();
+  GetElfContents(elf);
+
+  stringstream expected;
+  expected << "MODULE Linux x86_64 000000000000000000000000000000000 foo\n"
+           << "FUNC 1020 10 0 declared\n";
+  for (int i = 0; i < kUnits; ++i)
+    expected << "FUNC " << std::hex << 0x2000 + i * 0x10
+             << " 8 0 function" << std::dec << i << "\n";
+
+  const int kThreads[] = { 1, 4 };
+  for (size_t i = 0; i < sizeof(kThreads) / sizeof(kThreads[0]); ++i) {
+    DumpOptions options;
+    options.dwarf_threads = kThreads[i];
+    stringstream unindexed;
+    ASSERT_TRUE(WriteSymbolFileInternal(elfdata,
+                                        "foo",
+                                        "",
+                                        options,
+                                        unindexed));
+    EXPECT_NE(expected.str(), unindexed.str()) << kThreads[i] << " threads";
+
+    options.dwarf_index = true;
+    stringstream indexed;
+    ASSERT_TRUE(WriteSymbolFileInternal(elfdata,
+                                        "foo",
+                                        "",
+                                        options,
+                                        indexed));
+    EXPECT_EQ(expected.str(), indexed.str()) << kThreads[i] << " threads";
+  }
+}
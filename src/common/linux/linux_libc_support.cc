@@ -145,19 +145,17 @@ const char* my_strrchr(const char* haystack, char needle) {
 const char* my_read_hex_ptr(uintptr_t* result, const char* s) {
   uintptr_t r = 0;
 
+  // Each range is tested with a single unsigned comparison; setting bit 5
+  // folds 'A'-'F' onto 'a'-'f' without letting any non-hex character in.
   for (;; ++s) {
-    if (*s >= '0' && *s <= '9') {
-      r <<= 4;
-      r += *s - '0';
-    } else if (*s >= 'a' && *s <= 'f') {
-      r <<= 4;
-      r += (*s - 'a') + 10;
-    } else if (*s >= 'A' && *s <= 'F') {
-      r <<= 4;
-      r += (*s - 'A') + 10;
-    } else {
-      break;
+    unsigned digit = static_cast<unsigned char>(*s) - '0';
+    if (digit > 9) {
+      digit = (static_cast<unsigned char>(*s) | 0x20) - 'a';
+      if (digit > 5)
+        break;
+      digit += 10;
     }
+    r = (r << 4) | digit;
   }
 
   *result = r;
@@ -168,12 +166,10 @@ const char* my_read_decimal_ptr(uintptr_t* result, const char* s) {
   uintptr_t r = 0;
 
   for (;; ++s) {
-    if (*s >= '0' && *s <= '9') {
-      r *= 10;
-      r += *s - '0';
-    } else {
+    const unsigned digit = static_cast<unsigned char>(*s) - '0';
+    if (digit > 9)
       break;
-    }
+    r = r * 10 + digit;
   }
   *result = r;
   return s;
@@ -177,6 +177,19 @@ TEST(LinuxLibcSupportTest, read_hex_ptr) {
   last = my_read_hex_ptr(&result, "0123a-");
   ASSERT_EQ(result, 0x123aU);
   ASSERT_EQ(*last, '-');
+
+  last = my_read_hex_ptr(&result, "09afAF");
+  ASSERT_EQ(result, 0x9afafU);
+  ASSERT_EQ(*last, 0);
+
+  // Characters next to the digit and letter ranges end the number.
+  static const char kNotHex[] = "/:@G`g\xc1";
+  for (const char* c = kNotHex; *c; ++c) {
+    const char s[] = { '1', *c, 0 };
+    last = my_read_hex_ptr(&result, s);
+    ASSERT_EQ(result, 1U);
+    ASSERT_EQ(last, s + 1);
+  }
 }
 
 TEST(LinuxLibcSupportTest, read_decimal_ptr) {
@@ -198,4 +211,12 @@ TEST(LinuxLibcSupportTest, read_decimal_ptr) {
   last = my_read_decimal_ptr(&result, "01234-");
   ASSERT_EQ(result, 1234U);
   ASSERT_EQ(*last, '-');
+
+  last = my_read_decimal_ptr(&result, "9/");
+  ASSERT_EQ(result, 9U);
+  ASSERT_EQ(*last, '/');
+
+  last = my_read_decimal_ptr(&result, "9:");
+  ASSERT_EQ(result, 9U);
+  ASSERT_EQ(*last, ':');
 }
@@ -32,6 +32,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/mman.h>
 
@@ -41,6 +42,7 @@
 #define sys_munmap munmap
 #define MAP_ANONYMOUS MAP_ANON
 #else
+#include "common/linux/linux_libc_support.h"
 #include "third_party/lss/linux_syscall_support.h"
 #endif
 
@@ -49,15 +51,25 @@ namespace google_breakpad {
 // This is very simple allocator which fetches pages from the kernel directly.
 // Thus, it can be used even when the heap may be corrupted.
 //
-// There is no free operation. The pages are only freed when the object is
-// destroyed.
+// Small allocations are carved out of shared pages. When handed back with
+// Free() or Realloc() they are kept on free lists, one per power of two size
+// class, and reused by later allocations; their pages are only freed when the
+// object is destroyed. Allocations too big to share a page get pages of their
+// own, which Free() gives straight back to the kernel. Callers must pass
+// Free() and Realloc() the size they allocated.
 class PageAllocator {
  public:
   PageAllocator()
       : page_size_(getpagesize()),
         last_(NULL),
         current_page_(NULL),
-        page_offset_(0) {
+        page_offset_(0),
+        pages_allocated_(0),
+        bytes_in_use_(0),
+        peak_bytes_in_use_(0),
+        free_bytes_(0) {
+    for (unsigned i = 0; i < kSizeClasses; ++i)
+      free_lists_[i] = NULL;
   }
 
   ~PageAllocator() {
@@ -65,9 +77,206 @@ class PageAllocator {
   }
 
   void *Alloc(unsigned bytes) {
-    if (!bytes)
+    if (!bytes || bytes > kMaxBytes)
       return NULL;
 
+    const unsigned size = RoundUp(bytes);
+    uint8_t *ret;
+    if (IsLarge(size)) {
+      ret = AllocLarge(size);
+    } else {
+      ret = TakeFreeBlock(size);
+      if (!ret)
+        ret = AllocFromPage(size);
+    }
+    if (ret)
+      CountAlloc(size);
+    return ret;
+  }
+
+  // Hands |bytes| at |p|, returned by Alloc(bytes), back for reuse.
+  void Free(void *p, unsigned bytes) {
+    if (!p || !bytes)
+      return;
+
+    const unsigned size = RoundUp(bytes);
+    bytes_in_use_ -= size;
+    if (IsLarge(size)) {
+      FreeLarge(p);
+    } else if (IsLastAllocation(p, size)) {
+      page_offset_ -= size;
+    } else {
+      AddFreeBlock(reinterpret_cast<uint8_t*>(p), size);
+    }
+  }
+
+  // Resizes the |old_bytes| at |p| to |new_bytes| without moving them, if
+  // there is room after them: in their own pages, or in the current page if
+  // they were the last allocation made there. Returns false, and changes
+  // nothing, if there is not.
+  bool ResizeInPlace(void *p, unsigned old_bytes, unsigned new_bytes) {
+    if (!p || !new_bytes || new_bytes > kMaxBytes)
+      return false;
+
+    const unsigned old_size = RoundUp(old_bytes);
+    const unsigned new_size = RoundUp(new_bytes);
+    if (IsLarge(old_size)) {
+      if (IsLarge(new_size) &&
+          sizeof(PageHeader) + new_size <= LargeHeader(p)->num_pages * page_size_) {
+        bytes_in_use_ -= old_size;
+        CountAlloc(new_size);
+        return true;
+      }
+    } else if (IsLastAllocation(p, old_size) &&
+               new_size - old_size <= page_size_ - page_offset_) {
+      page_offset_ = page_offset_ + new_size - old_size;
+      bytes_in_use_ -= old_size;
+      CountAlloc(new_size);
+      if (page_offset_ == page_size_) {
+        page_offset_ = 0;
+        current_page_ = NULL;
+      }
+      return true;
+    } else if (new_size <= old_size) {
+      Free(reinterpret_cast<uint8_t*>(p) + new_size, old_size - new_size);
+      return true;
+    }
+    return false;
+  }
+
+  // Resizes the |old_bytes| at |p| to |new_bytes|, like realloc(). The
+  // allocation is resized in place if ResizeInPlace() can; otherwise it is
+  // moved and the old one handed back.
+  void *Realloc(void *p, unsigned old_bytes, unsigned new_bytes) {
+    if (!p)
+      return Alloc(new_bytes);
+    if (!new_bytes) {
+      Free(p, old_bytes);
+      return NULL;
+    }
+    if (ResizeInPlace(p, old_bytes, new_bytes))
+      return p;
+
+    void *const ret = Alloc(new_bytes);
+    if (!ret)
+      return NULL;
+    CopyBytes(ret, p, old_bytes < new_bytes ? old_bytes : new_bytes);
+    Free(p, old_bytes);
+    return ret;
+  }
+
+  // Number of pages currently fetched from the kernel.
+  unsigned pages_allocated() const { return pages_allocated_; }
+
+  // Bytes currently allocated, and the most there have been at once.
+  size_t bytes_in_use() const { return bytes_in_use_; }
+  size_t peak_bytes_in_use() const { return peak_bytes_in_use_; }
+
+  // Bytes waiting on the free lists to be reused.
+  size_t free_bytes() const { return free_bytes_; }
+
+ private:
+  // linux_libc_support.cc, which provides my_memcpy, isn't built on Apple
+  // platforms.
+  static void CopyBytes(void *dest, const void *src, size_t len) {
+#ifdef __APPLE__
+    memcpy(dest, src, len);
+#else
+    my_memcpy(dest, src, len);
+#endif
+  }
+
+  struct PageHeader {
+    PageHeader *next;  // pointer to the start of the next set of pages.
+    unsigned num_pages;  // the number of pages in this set.
+  };
+
+  // Lives at the start of each block on a free list.
+  struct FreeBlock {
+    FreeBlock *next;
+    unsigned size;
+  };
+
+  // Allocations are rounded up to a multiple of this, which keeps every
+  // block aligned for a FreeBlock.
+  static const unsigned kAlignment = 8;
+
+  // Block sizes of size class n are in [2^n, 2^(n+1)).
+  static const unsigned kSizeClasses = 8 * sizeof(unsigned);
+
+  // Leaves room to round any allocation up to whole pages.
+  static const unsigned kMaxBytes = ~0U >> 1;
+
+  static unsigned RoundUp(unsigned bytes) {
+    return (bytes + kAlignment - 1) & ~(kAlignment - 1);
+  }
+
+  static unsigned SizeClass(unsigned size) {
+    unsigned size_class = 0;
+    while (size >>= 1)
+      ++size_class;
+    return size_class;
+  }
+
+  bool IsLarge(unsigned size) const {
+    return size > page_size_ - sizeof(PageHeader);
+  }
+
+  static PageHeader *LargeHeader(void *p) {
+    return reinterpret_cast<PageHeader*>(
+        reinterpret_cast<uint8_t*>(p) - sizeof(PageHeader));
+  }
+
+  void CountAlloc(unsigned size) {
+    bytes_in_use_ += size;
+    if (bytes_in_use_ > peak_bytes_in_use_)
+      peak_bytes_in_use_ = bytes_in_use_;
+  }
+
+  // Returns true if |size| bytes at |p| were the last allocation made from
+  // the current page.
+  bool IsLastAllocation(void *p, unsigned size) const {
+    return current_page_ && size <= page_offset_ &&
+           reinterpret_cast<uint8_t*>(p) + size == current_page_ + page_offset_;
+  }
+
+  void AddFreeBlock(uint8_t *p, unsigned size) {
+    // Anything smaller cannot hold its own FreeBlock, and is lost.
+    if (size < sizeof(FreeBlock))
+      return;
+
+    FreeBlock *const block = reinterpret_cast<FreeBlock*>(p);
+    const unsigned size_class = SizeClass(size);
+    block->next = free_lists_[size_class];
+    block->size = size;
+    free_lists_[size_class] = block;
+    free_bytes_ += size;
+  }
+
+  // Takes the first block of at least |size| bytes off the free lists, and
+  // puts back whatever it does not need.
+  uint8_t *TakeFreeBlock(unsigned size) {
+    if (!free_bytes_)
+      return NULL;
+    for (unsigned size_class = SizeClass(size); size_class < kSizeClasses;
+         ++size_class) {
+      for (FreeBlock **link = &free_lists_[size_class]; *link;
+           link = &(*link)->next) {
+        FreeBlock *const block = *link;
+        if (block->size < size)
+          continue;
+
+        *link = block->next;
+        free_bytes_ -= block->size;
+        uint8_t *const ret = reinterpret_cast<uint8_t*>(block);
+        AddFreeBlock(ret + size, block->size - size);
+        return ret;
+      }
+    }
+    return NULL;
+  }
+
+  uint8_t *AllocFromPage(unsigned bytes) {
     if (current_page_ && page_size_ - page_offset_ >= bytes) {
       uint8_t *const ret = current_page_ + page_offset_;
       page_offset_ += bytes;
@@ -79,19 +288,39 @@ class PageAllocator {
       return ret;
     }
 
-    const unsigned pages =
-        (bytes + sizeof(PageHeader) + page_size_ - 1) / page_size_;
-    uint8_t *const ret = GetNPages(pages);
+    uint8_t *const ret = GetNPages(1);
     if (!ret)
       return NULL;
 
-    page_offset_ = (page_size_ - (page_size_ * pages - (bytes + sizeof(PageHeader)))) % page_size_;
-    current_page_ = page_offset_ ? ret + page_size_ * (pages - 1) : NULL;
+    // Keep the rest of the current page for smaller allocations.
+    if (current_page_)
+      AddFreeBlock(current_page_ + page_offset_, page_size_ - page_offset_);
+
+    page_offset_ = (sizeof(PageHeader) + bytes) % page_size_;
+    current_page_ = page_offset_ ? ret : NULL;
 
     return ret + sizeof(PageHeader);
   }
 
- private:
+  uint8_t *AllocLarge(unsigned bytes) {
+    const unsigned pages =
+        (bytes + sizeof(PageHeader) + page_size_ - 1) / page_size_;
+    uint8_t *const ret = GetNPages(pages);
+    return ret ? ret + sizeof(PageHeader) : NULL;
+  }
+
+  void FreeLarge(void *p) {
+    PageHeader *const header = LargeHeader(p);
+    for (PageHeader **link = &last_; *link; link = &(*link)->next) {
+      if (*link == header) {
+        *link = header->next;
+        pages_allocated_ -= header->num_pages;
+        sys_munmap(header, header->num_pages * page_size_);
+        return;
+      }
+    }
+  }
+
   uint8_t *GetNPages(unsigned num_pages) {
 #ifdef __x86_64
     void *a = sys_mmap(NULL, page_size_ * num_pages, PROT_READ | PROT_WRITE,
@@ -107,6 +336,7 @@ class PageAllocator {
     header->next = last_;
     header->num_pages = num_pages;
     last_ = header;
+    pages_allocated_ += num_pages;
 
     return reinterpret_cast<uint8_t*>(a);
   }
@@ -120,21 +350,23 @@ class PageAllocator {
     }
   }
 
-  struct PageHeader {
-    PageHeader *next;  // pointer to the start of the next set of pages.
-    unsigned num_pages;  // the number of pages in this set.
-  };
-
   const unsigned page_size_;
   PageHeader *last_;
   uint8_t *current_page_;
   unsigned page_offset_;
+  FreeBlock *free_lists_[kSizeClasses];
+  unsigned pages_allocated_;
+  size_t bytes_in_use_;
+  size_t peak_bytes_in_use_;
+  size_t free_bytes_;
 };
 
 // A wasteful vector is like a normal std::vector, except that it's very much
 // simplier and it allocates memory from a PageAllocator. It's wasteful
-// because, when resizing, it always allocates a whole new array since the
-// PageAllocator doesn't support realloc.
+// because it never gives an array back. When it grows, the array is
+// extended in place if the allocator can; otherwise a new one is allocated
+// and the old one is left alone, so copies of the vector and pointers to
+// its elements taken before it grew still see the old contents.
 template<class T>
 class wasteful_vector {
  public:
@@ -195,10 +427,13 @@ class wasteful_vector {
 
  private:
   void Realloc(unsigned new_size) {
-    T *new_array =
-        reinterpret_cast<T*>(allocator_->Alloc(sizeof(T) * new_size));
-    memcpy(new_array, a_, used_ * sizeof(T));
-    a_ = new_array;
+    if (!allocator_->ResizeInPlace(a_, sizeof(T) * allocated_,
+                                   sizeof(T) * new_size)) {
+      T *new_array =
+          reinterpret_cast<T*>(allocator_->Alloc(sizeof(T) * new_size));
+      memcpy(new_array, a_, used_ * sizeof(T));
+      a_ = new_array;
+    }
     allocated_ = new_size;
   }
 
@@ -62,6 +62,83 @@ TEST(PageAllocatorTest, LargeObject) {
   }
 }
 
+TEST(PageAllocatorTest, FreeReusesMemory) {
+  PageAllocator allocator;
+
+  // Keep the freed block from being the last allocation.
+  void *p = allocator.Alloc(100);
+  ASSERT_FALSE(p == NULL);
+  ASSERT_FALSE(allocator.Alloc(8) == NULL);
+  allocator.Free(p, 100);
+  EXPECT_EQ(104U, allocator.free_bytes());
+  EXPECT_EQ(p, allocator.Alloc(64));
+  EXPECT_EQ(40U, allocator.free_bytes());
+  EXPECT_EQ(1U, allocator.pages_allocated());
+}
+
+TEST(PageAllocatorTest, FreeLastAllocation) {
+  PageAllocator allocator;
+
+  void *p = allocator.Alloc(100);
+  ASSERT_FALSE(p == NULL);
+  allocator.Free(p, 100);
+  EXPECT_EQ(0U, allocator.free_bytes());
+  EXPECT_EQ(0U, allocator.bytes_in_use());
+  EXPECT_EQ(p, allocator.Alloc(200));
+}
+
+TEST(PageAllocatorTest, ReallocInPlace) {
+  PageAllocator allocator;
+
+  uint8_t *p = reinterpret_cast<uint8_t*>(allocator.Alloc(16));
+  ASSERT_FALSE(p == NULL);
+  memset(p, 0x5a, 16);
+  EXPECT_EQ(p, allocator.Realloc(p, 16, 1024));
+  for (unsigned i = 0; i < 16; ++i)
+    ASSERT_EQ(0x5a, p[i]);
+  EXPECT_EQ(1024U, allocator.bytes_in_use());
+  EXPECT_EQ(p, allocator.Realloc(p, 1024, 32));
+  EXPECT_EQ(32U, allocator.bytes_in_use());
+  EXPECT_EQ(1024U, allocator.peak_bytes_in_use());
+  EXPECT_EQ(0U, allocator.free_bytes());
+}
+
+TEST(PageAllocatorTest, ReallocMoves) {
+  PageAllocator allocator;
+
+  uint8_t *p = reinterpret_cast<uint8_t*>(allocator.Alloc(16));
+  ASSERT_FALSE(p == NULL);
+  memset(p, 0x5a, 16);
+  ASSERT_FALSE(allocator.Alloc(8) == NULL);
+  uint8_t *q = reinterpret_cast<uint8_t*>(allocator.Realloc(p, 16, 64));
+  ASSERT_FALSE(q == NULL);
+  EXPECT_NE(p, q);
+  for (unsigned i = 0; i < 16; ++i)
+    ASSERT_EQ(0x5a, q[i]);
+  EXPECT_EQ(16U, allocator.free_bytes());
+  EXPECT_EQ(72U, allocator.bytes_in_use());
+}
+
+TEST(PageAllocatorTest, LargeReallocs) {
+  PageAllocator allocator;
+
+  // Growing a large block one page at a time unmaps what it moves out of.
+  const unsigned page_size = getpagesize();
+  void *p = NULL;
+  unsigned size = 0;
+  for (unsigned i = 1; i <= 64; ++i) {
+    p = allocator.Realloc(p, size, i * page_size);
+    ASSERT_FALSE(p == NULL);
+    memset(p, 0, i * page_size);
+    size = i * page_size;
+  }
+  EXPECT_EQ(size, allocator.bytes_in_use());
+  EXPECT_EQ(65U, allocator.pages_allocated());
+  allocator.Free(p, size);
+  EXPECT_EQ(0U, allocator.pages_allocated());
+  EXPECT_EQ(0U, allocator.bytes_in_use());
+}
+
 namespace {
 typedef testing::Test WastefulVectorTest;
 }
@@ -87,3 +164,62 @@ TEST(WastefulVectorTest, Simple) {
   for (unsigned i = 0; i < 256; ++i)
     ASSERT_EQ(v[i], i);
 }
+
+TEST(WastefulVectorTest, GrowsInPlace) {
+  PageAllocator allocator_;
+  wasteful_vector<unsigned> v(&allocator_, 4);
+
+  for (unsigned i = 0; i < 256; ++i)
+    v.push_back(i);
+  for (unsigned i = 0; i < 256; ++i)
+    ASSERT_EQ(v[i], i);
+  // Nothing else was allocated, so the array never had to move.
+  EXPECT_EQ(0U, allocator_.free_bytes());
+  EXPECT_EQ(256 * sizeof(unsigned), allocator_.bytes_in_use());
+}
+
+TEST(WastefulVectorTest, Interleaved) {
+  PageAllocator allocator_;
+  wasteful_vector<unsigned> v(&allocator_);
+  wasteful_vector<unsigned> w(&allocator_);
+
+  for (unsigned i = 0; i < 4096; ++i) {
+    v.push_back(i);
+    w.push_back(~i);
+  }
+  for (unsigned i = 0; i < 4096; ++i) {
+    ASSERT_EQ(v[i], i);
+    ASSERT_EQ(w[i], ~i);
+  }
+  // The arrays the vectors grew out of are kept.
+  EXPECT_GT(allocator_.bytes_in_use(), 2 * 4096 * sizeof(unsigned));
+}
+
+TEST(WastefulVectorTest, GrowAfterCopy) {
+  PageAllocator allocator_;
+  wasteful_vector<unsigned> v(&allocator_, 4);
+  wasteful_vector<unsigned> unrelated(&allocator_, 4);
+  for (unsigned i = 0; i < 4; ++i)
+    v.push_back(i);
+  const unsigned *first = &v[0];
+  const wasteful_vector<unsigned> copy = v;
+
+  // |unrelated| sits after |v|, so |v| has to move to grow.
+  unrelated.push_back(0);
+  for (unsigned i = 4; i < 4096; ++i)
+    v.push_back(i);
+  ASSERT_NE(first, &v[0]);
+  for (unsigned i = 0; i < 4096; ++i)
+    ASSERT_EQ(i, v[i]);
+
+  // The copy and the pointer still see the old array, and new allocations
+  // do not reuse it.
+  wasteful_vector<unsigned> w(&allocator_);
+  for (unsigned i = 0; i < 4096; ++i)
+    w.push_back(~i);
+  ASSERT_EQ(4U, copy.size());
+  for (unsigned i = 0; i < 4; ++i) {
+    ASSERT_EQ(i, copy[i]);
+    ASSERT_EQ(i, first[i]);
+  }
+}
@@ -0,0 +1,237 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_compression.cc: A small LZ77 block compressor for minidumps.
+//
+// See minidump_compression.h for documentation.
+//
+// A compressed block is a series of sequences.  Each is a token byte,
+// some literal bytes and, in every sequence but the last, a match.  The
+// token's high nibble is the number of literals and its low nibble the
+// match length less kMinMatch; a nibble of 15 is followed by bytes that are
+// added to it, up to and including the first that is not 255.  A match is
+// a two-byte little-endian distance back into the output.
+
+#include "common/minidump_compression.h"
+
+namespace google_breakpad {
+
+namespace {
+
+// The shortest match worth encoding.
+const size_t kMinMatch = 4;
+
+// Matches end at least this many bytes before the end of a block.
+const size_t kEndLiterals = 5;
+
+// No match starts in the last kMatchStartMargin bytes of a block, which
+// keeps the 4-byte reads of the match finder in bounds.
+const size_t kMatchStartMargin = 12;
+
+// The furthest back a match can refer.
+const size_t kMaxDistance = 65535;
+
+// log2(kCompressedMinidumpHashTableSize).
+const int kHashBits = 12;
+
+// An upper bound on any length field, far beyond any valid block, so that
+// malformed input cannot overflow a length.
+const size_t kMaxLength = 1 << 24;
+
+inline u_int32_t Read32(const u_int8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) |
+         (static_cast<u_int32_t>(p[3]) << 24);
+}
+
+inline u_int32_t Hash(u_int32_t sequence) {
+  return (sequence * 2654435761U) >> (32 - kHashBits);
+}
+
+// Writes the continuation bytes for a length field whose nibble was 15.
+// Returns false if they do not fit before |end|.
+bool PutLength(size_t length, u_int8_t **op, u_int8_t *end) {
+  while (length >= 255) {
+    if (*op == end)
+      return false;
+    *(*op)++ = 255;
+    length -= 255;
+  }
+  if (*op == end)
+    return false;
+  *(*op)++ = static_cast<u_int8_t>(length);
+  return true;
+}
+
+// Writes a sequence of |literal_count| bytes from |literals|, followed by
+// a match of |match_length| bytes at |distance| unless |match_length| is
+// 0.  Returns false if the sequence does not fit before |end|.
+bool PutSequence(const u_int8_t *literals, size_t literal_count,
+                 size_t distance, size_t match_length,
+                 u_int8_t **op, u_int8_t *end) {
+  if (*op == end)
+    return false;
+  u_int8_t *token = (*op)++;
+  *token = (literal_count >= 15 ? 15 : literal_count) << 4;
+  if (literal_count >= 15 && !PutLength(literal_count - 15, op, end))
+    return false;
+  if (static_cast<size_t>(end - *op) < literal_count)
+    return false;
+  for (size_t i = 0; i < literal_count; ++i)
+    (*op)[i] = literals[i];
+  *op += literal_count;
+
+  if (!match_length)
+    return true;
+  if (end - *op < 2)
+    return false;
+  *(*op)++ = static_cast<u_int8_t>(distance);
+  *(*op)++ = static_cast<u_int8_t>(distance >> 8);
+  const size_t code = match_length - kMinMatch;
+  *token |= code >= 15 ? 15 : code;
+  if (code >= 15 && !PutLength(code - 15, op, end))
+    return false;
+  return true;
+}
+
+// Reads the continuation bytes of a length field, adding them to |length|.
+// Returns false if the input ends first or the length is implausible.
+bool GetLength(const u_int8_t **ip, const u_int8_t *end, size_t *length) {
+  u_int8_t byte;
+  do {
+    if (*ip == end)
+      return false;
+    byte = *(*ip)++;
+    *length += byte;
+    if (*length > kMaxLength)
+      return false;
+  } while (byte == 255);
+  return true;
+}
+
+}  // namespace
+
+size_t CompressMinidumpBlock(const u_int8_t *src, size_t size,
+                             u_int8_t *dest, size_t capacity,
+                             u_int16_t *hash_table) {
+  if (size > kCompressedMinidumpMaxBlockSize)
+    return 0;
+  for (size_t i = 0; i < kCompressedMinidumpHashTableSize; ++i)
+    hash_table[i] = 0;
+
+  u_int8_t *op = dest;
+  u_int8_t *const end = dest + capacity;
+  size_t anchor = 0;
+  if (size > kMatchStartMargin) {
+    const size_t match_start_limit = size - kMatchStartMargin;
+    const size_t match_end_limit = size - kEndLiterals;
+    size_t position = 0;
+    size_t misses = 0;
+    while (position < match_start_limit) {
+      const u_int32_t sequence = Read32(src + position);
+      const u_int32_t hash = Hash(sequence);
+      // Positions fit in 16 bits because blocks are at most 64kB.  A stale
+      // or empty entry is caught by comparing the bytes.
+      const size_t candidate = hash_table[hash];
+      hash_table[hash] = static_cast<u_int16_t>(position);
+      if (candidate < position && position - candidate <= kMaxDistance &&
+          Read32(src + candidate) == sequence) {
+        size_t length = kMinMatch;
+        while (position + length < match_end_limit &&
+               src[candidate + length] == src[position + length]) {
+          ++length;
+        }
+        if (!PutSequence(src + anchor, position - anchor,
+                         position - candidate, length, &op, end)) {
+          return 0;
+        }
+        position += length;
+        anchor = position;
+        misses = 0;
+      } else {
+        // Step faster through data that does not compress.
+        position += 1 + (misses++ >> 6);
+      }
+    }
+  }
+  if (!PutSequence(src + anchor, size - anchor, 0, 0, &op, end))
+    return 0;
+  return op - dest;
+}
+
+bool DecompressMinidumpBlock(const u_int8_t *src, size_t src_size,
+                             u_int8_t *dest, size_t size) {
+  const u_int8_t *ip = src;
+  const u_int8_t *const src_end = src + src_size;
+  u_int8_t *op = dest;
+  u_int8_t *const dest_end = dest + size;
+
+  while (ip < src_end) {
+    const u_int8_t token = *ip++;
+
+    size_t literal_count = token >> 4;
+    if (literal_count == 15 && !GetLength(&ip, src_end, &literal_count))
+      return false;
+    if (literal_count > static_cast<size_t>(src_end - ip) ||
+        literal_count > static_cast<size_t>(dest_end - op)) {
+      return false;
+    }
+    for (size_t i = 0; i < literal_count; ++i)
+      op[i] = ip[i];
+    ip += literal_count;
+    op += literal_count;
+
+    // The last sequence has no match.
+    if (ip == src_end)
+      break;
+
+    if (src_end - ip < 2)
+      return false;
+    const size_t distance = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (distance == 0 || distance > static_cast<size_t>(op - dest))
+      return false;
+
+    size_t match_length = token & 15;
+    if (match_length == 15 && !GetLength(&ip, src_end, &match_length))
+      return false;
+    match_length += kMinMatch;
+    if (match_length > static_cast<size_t>(dest_end - op))
+      return false;
+
+    // The match may overlap the bytes it produces, so copy forwards.
+    const u_int8_t *match = op - distance;
+    for (size_t i = 0; i < match_length; ++i)
+      op[i] = match[i];
+    op += match_length;
+  }
+
+  return op == dest_end;
+}
+
+}  // namespace google_breakpad
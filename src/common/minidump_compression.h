@@ -0,0 +1,111 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_compression.h: The container format for compressed minidumps,
+// and the block compressor used to produce it.
+//
+// A compressed minidump starts with a CompressedMinidumpHeader and is
+// followed by a sequence of records, each a CompressedMinidumpRecord header
+// and |stored_size| bytes of payload.  A record places |size| bytes at
+// |offset| in the minidump; later records overwrite earlier ones, which is
+// how a writer patches headers and directories it has already written out.
+// Bytes no record covers are zero.  An end record gives the size of the
+// whole minidump.  All fields are in the byte order of the machine that
+// wrote the file, which the reader tells from the signature.
+//
+// The compressor and decompressor do not allocate memory or call into libc,
+// so the compressor can run inside a compromised process.
+
+#ifndef COMMON_MINIDUMP_COMPRESSION_H__
+#define COMMON_MINIDUMP_COMPRESSION_H__
+
+#include <stddef.h>
+
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+struct CompressedMinidumpHeader {
+  u_int32_t signature;  // kCompressedMinidumpSignature
+  u_int32_t version;    // kCompressedMinidumpVersion
+};
+
+struct CompressedMinidumpRecord {
+  u_int32_t type;         // One of the kCompressedMinidumpRecord* values
+  u_int32_t offset;       // Where the data goes in the minidump
+  u_int32_t size;         // Size of the data in the minidump
+  u_int32_t stored_size;  // Size of the payload following this header
+};
+
+// 'BMDZ' when read as a little-endian value.
+static const u_int32_t kCompressedMinidumpSignature = 0x5a444d42;
+static const u_int32_t kCompressedMinidumpVersion = 1;
+
+// The payload is |size| bytes compressed with CompressMinidumpBlock.
+static const u_int32_t kCompressedMinidumpRecordCompressed = 1;
+// The payload is |size| bytes, stored as they are.
+static const u_int32_t kCompressedMinidumpRecordStored = 2;
+// There is no payload; |offset| is the size of the minidump.
+static const u_int32_t kCompressedMinidumpRecordEnd = 3;
+
+// The largest |size| of a single record.
+static const size_t kCompressedMinidumpMaxBlockSize = 64 * 1024;
+
+// The largest ratio of minidump size to compressed minidump size a reader
+// accepts.  A block of zeroes, the best case for CompressMinidumpBlock,
+// shrinks about 230 times; anything claiming to expand much further is
+// malformed.
+static const size_t kCompressedMinidumpMaxRatio = 1024;
+
+// The number of entries in the hash table CompressMinidumpBlock needs.
+static const size_t kCompressedMinidumpHashTableSize = 4096;
+
+// The largest compressed size of |size| bytes.
+inline size_t CompressedMinidumpBlockBound(size_t size) {
+  return size + size / 255 + 16;
+}
+
+// Compresses the |size| bytes at |src| into |dest|, which has room for
+// |capacity| bytes.  |hash_table| is scratch space of
+// kCompressedMinidumpHashTableSize entries.  Returns the compressed size,
+// or 0 if |size| exceeds kCompressedMinidumpMaxBlockSize or the result
+// does not fit in |capacity|.
+size_t CompressMinidumpBlock(const u_int8_t *src, size_t size,
+                             u_int8_t *dest, size_t capacity,
+                             u_int16_t *hash_table);
+
+// Decompresses the |src_size| bytes at |src| into exactly |size| bytes at
+// |dest|.  Returns false if the input is malformed or does not produce
+// exactly |size| bytes.
+bool DecompressMinidumpBlock(const u_int8_t *src, size_t src_size,
+                             u_int8_t *dest, size_t size);
+
+}  // namespace google_breakpad
+
+#endif  // COMMON_MINIDUMP_COMPRESSION_H__
@@ -0,0 +1,168 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_compression_unittest.cc: Unit tests for the minidump block
+// compressor and decompressor.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/minidump_compression.h"
+
+namespace {
+
+using google_breakpad::CompressMinidumpBlock;
+using google_breakpad::CompressedMinidumpBlockBound;
+using google_breakpad::DecompressMinidumpBlock;
+using google_breakpad::kCompressedMinidumpHashTableSize;
+using google_breakpad::kCompressedMinidumpMaxBlockSize;
+using std::vector;
+
+class MinidumpCompressionTest : public ::testing::Test {
+ public:
+  MinidumpCompressionTest()
+      : hash_table_(kCompressedMinidumpHashTableSize) { }
+
+  // Compresses |input| and checks that it decompresses to the same bytes.
+  // Returns the compressed size.
+  size_t RoundTrip(const vector<u_int8_t> &input) {
+    vector<u_int8_t> compressed(
+        CompressedMinidumpBlockBound(input.size()) + 1);
+    size_t compressed_size =
+        CompressMinidumpBlock(Data(input), input.size(),
+                              &compressed[0], compressed.size(),
+                              &hash_table_[0]);
+    EXPECT_NE(0U, compressed_size);
+    EXPECT_LE(compressed_size, CompressedMinidumpBlockBound(input.size()));
+
+    vector<u_int8_t> output(input.size() + 1);
+    EXPECT_TRUE(DecompressMinidumpBlock(&compressed[0], compressed_size,
+                                        &output[0], input.size()));
+    output.resize(input.size());
+    EXPECT_TRUE(output == input);
+    return compressed_size;
+  }
+
+  static const u_int8_t *Data(const vector<u_int8_t> &bytes) {
+    return bytes.empty() ? NULL : &bytes[0];
+  }
+
+  vector<u_int16_t> hash_table_;
+};
+
+TEST_F(MinidumpCompressionTest, Empty) {
+  RoundTrip(vector<u_int8_t>());
+}
+
+TEST_F(MinidumpCompressionTest, Short) {
+  for (size_t size = 1; size < 40; ++size) {
+    vector<u_int8_t> input(size);
+    for (size_t i = 0; i < size; ++i)
+      input[i] = i % 3;
+    RoundTrip(input);
+  }
+}
+
+TEST_F(MinidumpCompressionTest, Zeroes) {
+  vector<u_int8_t> input(kCompressedMinidumpMaxBlockSize);
+  EXPECT_GT(input.size() / 100, RoundTrip(input));
+}
+
+TEST_F(MinidumpCompressionTest, Text) {
+  const char kLine[] = "libc.so.6 libpthread.so.0 linux-gate.so 0x08048000\n";
+  vector<u_int8_t> input;
+  for (int i = 0; i < 500; ++i) {
+    input.insert(input.end(), kLine, kLine + sizeof(kLine) - 1);
+    input.push_back(i);
+  }
+  EXPECT_GT(input.size() / 4, RoundTrip(input));
+}
+
+TEST_F(MinidumpCompressionTest, Random) {
+  srand(0);
+  vector<u_int8_t> input(kCompressedMinidumpMaxBlockSize);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = rand();
+  RoundTrip(input);
+
+  // Random bytes do not fit in less than their own size.
+  vector<u_int8_t> compressed(input.size());
+  EXPECT_EQ(0U, CompressMinidumpBlock(&input[0], input.size(),
+                                      &compressed[0], compressed.size(),
+                                      &hash_table_[0]));
+}
+
+TEST_F(MinidumpCompressionTest, TooBig) {
+  vector<u_int8_t> input(kCompressedMinidumpMaxBlockSize + 1);
+  vector<u_int8_t> compressed(CompressedMinidumpBlockBound(input.size()));
+  EXPECT_EQ(0U, CompressMinidumpBlock(&input[0], input.size(),
+                                      &compressed[0], compressed.size(),
+                                      &hash_table_[0]));
+}
+
+TEST_F(MinidumpCompressionTest, Malformed) {
+  vector<u_int8_t> input(1000);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = i % 7;
+  vector<u_int8_t> compressed(CompressedMinidumpBlockBound(input.size()));
+  size_t compressed_size =
+      CompressMinidumpBlock(&input[0], input.size(),
+                            &compressed[0], compressed.size(),
+                            &hash_table_[0]);
+  ASSERT_NE(0U, compressed_size);
+
+  vector<u_int8_t> output(input.size() + 1);
+  // Wrong output size.
+  EXPECT_FALSE(DecompressMinidumpBlock(&compressed[0], compressed_size,
+                                       &output[0], input.size() - 1));
+  EXPECT_FALSE(DecompressMinidumpBlock(&compressed[0], compressed_size,
+                                       &output[0], input.size() + 1));
+  // Every truncation fails cleanly.
+  for (size_t size = 0; size < compressed_size; ++size) {
+    EXPECT_FALSE(DecompressMinidumpBlock(&compressed[0], size,
+                                         &output[0], input.size()));
+  }
+  // A match reaching back before the start of the output.
+  const u_int8_t kBadDistance[] = { 0x10, 'a', 0x02, 0x00, 0x00 };
+  EXPECT_FALSE(DecompressMinidumpBlock(kBadDistance, sizeof(kBadDistance),
+                                       &output[0], 5));
+  // Garbage never writes past the end of the output.
+  srand(1);
+  for (int trial = 0; trial < 1000; ++trial) {
+    for (size_t i = 0; i < compressed_size; ++i)
+      compressed[i] = rand();
+    DecompressMinidumpBlock(&compressed[0], compressed_size,
+                            &output[0], input.size());
+  }
+}
+
+}  // namespace
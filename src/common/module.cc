@@ -36,16 +36,270 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <iostream>
 #include <utility>
 
 namespace google_breakpad {
 
-using std::dec;
-using std::endl;
-using std::hex;
+namespace {
+
+// Formats symbol file records into a large buffer, and writes the buffer
+// to a stream only when it fills up. Symbol files for big modules have
+// tens of millions of lines; writing them with iostream manipulators and
+// a flush per line takes a good share of dump_syms' time.
+class SymbolFileWriter {
+ public:
+  explicit SymbolFileWriter(std::ostream &stream)
+      : stream_(stream), buffer_(kBufferSize), used_(0) { }
+
+  void Char(char c) {
+    Reserve(1);
+    buffer_[used_++] = c;
+  }
+
+  void String(const char *text, size_t length) {
+    if (length > kBufferSize - used_) {
+      Flush();
+      if (length > kBufferSize) {
+        stream_.write(text, length);
+        return;
+      }
+    }
+    memcpy(&buffer_[used_], text, length);
+    used_ += length;
+  }
+
+  void String(const string &text) { String(text.data(), text.size()); }
+
+  // Write VALUE in lower-case hexadecimal, without a prefix.
+  void Hex(u_int64_t value) {
+    char digits[16];
+    int count = 0;
+    do {
+      digits[count++] = "0123456789abcdef"[value & 0xf];
+      value >>= 4;
+    } while (value);
+    Reserve(count);
+    while (count)
+      buffer_[used_++] = digits[--count];
+  }
+
+  // Write VALUE in decimal.
+  void Decimal(int value) {
+    char digits[10];
+    int count = 0;
+    // Negate as unsigned, so that INT_MIN works too.
+    unsigned int magnitude = value < 0 ? 0U - value : value;
+    do {
+      digits[count++] = '0' + magnitude % 10;
+      magnitude /= 10;
+    } while (magnitude);
+    Reserve(count + 1);
+    if (value < 0)
+      buffer_[used_++] = '-';
+    while (count)
+      buffer_[used_++] = digits[--count];
+  }
+
+  // Write out the buffered text. Return true if the stream has had no
+  // errors so far.
+  bool Flush() {
+    if (used_) {
+      stream_.write(&buffer_[0], used_);
+      used_ = 0;
+    }
+    return stream_.good();
+  }
+
+  bool good() const { return stream_.good(); }
+
+ private:
+  static const size_t kBufferSize = 1 << 20;
+
+  // Make room for LENGTH more bytes, which must be at most kBufferSize.
+  void Reserve(size_t length) {
+    if (length > kBufferSize - used_)
+      Flush();
+  }
+
+  std::ostream &stream_;
+  vector<char> buffer_;
+  size_t used_;
+};
+
+// Write RULE_MAP to WRITER, in the form appropriate for 'STACK CFI'
+// records, without a final newline.
+void WriteRuleMap(const Module::RuleMap &rule_map, SymbolFileWriter *writer) {
+  for (Module::RuleMap::const_iterator it = rule_map.begin();
+       it != rule_map.end(); ++it) {
+    if (it != rule_map.begin())
+      writer->Char(' ');
+    writer->String(it->first);
+    writer->String(": ", 2);
+    writer->String(it->second);
+  }
+}
+
+// SpillFunctions writes each function to its temporary file as a
+// SpilledFunction, followed by the function's name and then its lines,
+// as SpilledLines. Both are in the host's byte order.
+struct SpilledFunction {
+  u_int64_t address, size, parameter_size;
+  u_int32_t name_length, line_count;
+};
+
+struct SpilledLine {
+  u_int64_t address, size;
+  u_int32_t file;  // An index into Module::spilled_files_.
+  int32_t number;
+};
+
+// The most spilled runs a Module keeps before merging them into one.
+// Write reads all the runs at once, so this also bounds the number of
+// files it has open.
+const size_t kMaxSpilledRuns = 16;
+
+// Create an empty temporary file in DIRECTORY, already unlinked so that
+// it disappears once closed, and return a stream for it. On error,
+// return NULL.
+FILE *CreateSpillFile(const string &directory) {
+  string path_string = directory + "/breakpad_functions_XXXXXX";
+  vector<char> path(path_string.begin(), path_string.end());
+  path.push_back('\0');
+  int fd = mkstemp(&path[0]);
+  if (fd == -1)
+    return NULL;
+  unlink(&path[0]);
+  FILE *file = fdopen(fd, "w+");
+  if (!file)
+    close(fd);
+  return file;
+}
+
+// Reads the functions held in memory by a Module, and those it has
+// spilled, as a single sequence sorted by address and then name.
+// Where more than one source has the same function, the one from the
+// oldest source is read, and the others are dropped.
+class FunctionMerger {
+ public:
+  typedef set<Module::Function *, Module::FunctionCompare> FunctionSet;
+
+  // Merge the spilled RUNS, oldest first, whose lines refer to FILES,
+  // followed by the functions in [BEGIN, END). The runs are rewound.
+  FunctionMerger(const vector<FILE *> &runs,
+                 const vector<Module::File *> &files,
+                 FunctionSet::const_iterator begin,
+                 FunctionSet::const_iterator end)
+      : files_(files), sources_(runs.size() + 1), next_(begin), end_(end),
+        advance_(runs.size() + 1), error_(false) {
+    for (size_t i = 0; i < runs.size(); ++i) {
+      sources_[i].run = runs[i];
+      rewind(runs[i]);
+      Advance(i);
+    }
+    sources_.back().run = NULL;
+    Advance(runs.size());
+  }
+
+  // Set *FUNCTION to the next function, and return true. The function
+  // stays valid until the next call. At the end, or on error, return
+  // false.
+  bool Next(const Module::Function **function) {
+    if (advance_ < sources_.size())
+      Advance(advance_);
+    Module::FunctionCompare less;
+    size_t best = sources_.size();
+    for (size_t i = 0; i < sources_.size(); ++i) {
+      if (sources_[i].head &&
+          (best == sources_.size() ||
+           less(sources_[i].head, sources_[best].head)))
+        best = i;
+    }
+    if (error_ || best == sources_.size())
+      return false;
+    // Drop the same function from newer sources.
+    for (size_t i = best + 1; i < sources_.size(); ++i) {
+      while (sources_[i].head && !less(sources_[best].head, sources_[i].head))
+        Advance(i);
+    }
+    *function = sources_[best].head;
+    advance_ = best;
+    return !error_;
+  }
+
+  bool error() const { return error_; }
+
+ private:
+  struct Source {
+    Source() : run(NULL), head(NULL) { }
+    FILE *run;                         // NULL for the functions in memory.
+    Module::Function function;         // The last function read from RUN.
+    const Module::Function *head;      // This source's next function.
+  };
+
+  // Move source INDEX on to its next function.
+  void Advance(size_t index) {
+    Source &source = sources_[index];
+    source.head = NULL;
+    if (!source.run) {
+      if (next_ != end_)
+        source.head = *next_++;
+      return;
+    }
+
+    SpilledFunction spilled;
+    if (fread(&spilled, sizeof(spilled), 1, source.run) != 1) {
+      error_ = error_ || ferror(source.run);
+      return;
+    }
+    Module::Function &function = source.function;
+    function.address = spilled.address;
+    function.size = spilled.size;
+    function.parameter_size = spilled.parameter_size;
+    function.name.resize(spilled.name_length);
+    lines_.resize(spilled.line_count);
+    if ((spilled.name_length &&
+         fread(&function.name[0], spilled.name_length, 1, source.run) != 1) ||
+        (spilled.line_count &&
+         fread(&lines_[0], sizeof(SpilledLine) * spilled.line_count, 1,
+               source.run) != 1)) {
+      error_ = true;
+      return;
+    }
+    function.lines.resize(spilled.line_count);
+    for (size_t i = 0; i < lines_.size(); ++i) {
+      if (lines_[i].file >= files_.size()) {
+        error_ = true;
+        return;
+      }
+      Module::Line &line = function.lines[i];
+      line.address = lines_[i].address;
+      line.size = lines_[i].size;
+      line.file = files_[lines_[i].file];
+      line.number = lines_[i].number;
+    }
+    source.head = &function;
+  }
+
+  const vector<Module::File *> &files_;
+  vector<Source> sources_;
+  FunctionSet::const_iterator next_, end_;
+
+  // The index of the source whose head Next last returned, to advance
+  // on the next call; or sources_.size().
+  size_t advance_;
+
+  // Scratch space for reading lines.
+  vector<SpilledLine> lines_;
+
+  bool error_;
+};
+
+}  // namespace
 
 
 Module::Module(const string &name, const string &os,
@@ -54,7 +308,8 @@ Module::Module(const string &name, const string &os,
     os_(os),
     architecture_(architecture),
     id_(id),
-    load_address_(0) { }
+    load_address_(0),
+    unspilled_lines_(0) { }
 
 Module::~Module() {
   for (FileByNameMap::iterator it = files_.begin(); it != files_.end(); ++it)
@@ -69,6 +324,8 @@ Module::~Module() {
   }
   for (ExternSet::iterator it = externs_.begin(); it != externs_.end(); ++it)
     delete *it;
+  for (size_t i = 0; i < spilled_runs_.size(); ++i)
+    fclose(spilled_runs_[i]);
 }
 
 void Module::SetLoadAddress(Address address) {
@@ -84,6 +341,8 @@ void Module::AddFunction(Function *function) {
     // Free the duplicate that was not inserted because this Module
     // now owns it.
     delete function;
+  } else {
+    unspilled_lines_ += function->lines.size();
   }
 }
 
@@ -93,6 +352,122 @@ void Module::AddFunctions(vector<Function *>::iterator begin,
     AddFunction(*it);
 }
 
+bool Module::SpillFunctions(const string &directory) {
+  if (functions_.empty())
+    return true;
+
+  FILE *run = CreateSpillFile(directory);
+  if (!run) {
+    fprintf(stderr, "error creating temporary file in %s: %s\n",
+            directory.c_str(), strerror(errno));
+    return false;
+  }
+  const size_t spilled_file_count = spilled_files_.size();
+  bool written = true;
+  for (FunctionSet::const_iterator func_it = functions_.begin();
+       written && func_it != functions_.end(); ++func_it)
+    written = WriteSpilledFunction(**func_it, run);
+  if (!written || fflush(run) != 0) {
+    fprintf(stderr, "error spilling functions to %s: %s\n",
+            directory.c_str(), strerror(errno));
+    fclose(run);
+    // Forget the files that only the abandoned run referred to.
+    for (size_t i = spilled_file_count; i < spilled_files_.size(); ++i)
+      spilled_file_indices_.erase(spilled_files_[i]);
+    spilled_files_.resize(spilled_file_count);
+    return false;
+  }
+
+  for (FunctionSet::iterator func_it = functions_.begin();
+       func_it != functions_.end(); ++func_it)
+    delete *func_it;
+  functions_.clear();
+  unspilled_lines_ = 0;
+  spilled_runs_.push_back(run);
+
+  if (spilled_runs_.size() >= kMaxSpilledRuns)
+    return MergeSpilledRuns(directory);
+  return true;
+}
+
+bool Module::WriteSpilledFunction(const Function &function, FILE *run) {
+  SpilledFunction spilled;
+  spilled.address = function.address;
+  spilled.size = function.size;
+  spilled.parameter_size = function.parameter_size;
+  spilled.name_length = function.name.size();
+  spilled.line_count = function.lines.size();
+
+  vector<SpilledLine> lines(function.lines.size());
+  for (size_t i = 0; i < lines.size(); ++i) {
+    const Line &line = function.lines[i];
+    std::pair<map<File *, u_int32_t>::iterator, bool> inserted =
+        spilled_file_indices_.insert(
+            std::make_pair(line.file,
+                           static_cast<u_int32_t>(spilled_files_.size())));
+    if (inserted.second)
+      spilled_files_.push_back(line.file);
+    lines[i].address = line.address;
+    lines[i].size = line.size;
+    lines[i].file = inserted.first->second;
+    lines[i].number = line.number;
+  }
+
+  return fwrite(&spilled, sizeof(spilled), 1, run) == 1 &&
+      (function.name.empty() ||
+       fwrite(function.name.data(), function.name.size(), 1, run) == 1) &&
+      (lines.empty() ||
+       fwrite(&lines[0], sizeof(SpilledLine) * lines.size(), 1, run) == 1);
+}
+
+bool Module::MergeSpilledRuns(const string &directory) {
+  FILE *merged = CreateSpillFile(directory);
+  if (!merged) {
+    fprintf(stderr, "error creating temporary file in %s: %s\n",
+            directory.c_str(), strerror(errno));
+    return false;
+  }
+  // There are no functions in memory to merge.
+  FunctionMerger merger(spilled_runs_, spilled_files_,
+                        functions_.end(), functions_.end());
+  const Function *function;
+  bool written = true;
+  while (written && merger.Next(&function))
+    written = WriteSpilledFunction(*function, merged);
+  if (!written || merger.error() || fflush(merged) != 0) {
+    fprintf(stderr, "error merging spilled functions in %s: %s\n",
+            directory.c_str(), strerror(errno));
+    fclose(merged);
+    return false;
+  }
+
+  for (size_t i = 0; i < spilled_runs_.size(); ++i)
+    fclose(spilled_runs_[i]);
+  spilled_runs_.assign(1, merged);
+  return true;
+}
+
+void Module::TakeFunctionsAndFiles(Module *other) {
+  // Map OTHER's files to ours, creating any we don't have yet.
+  map<File *, File *> file_map;
+  for (FileByNameMap::iterator it = other->files_.begin();
+       it != other->files_.end(); ++it) {
+    file_map[it->second] = FindFile(it->second->name);
+    delete it->second;
+  }
+  other->files_.clear();
+
+  for (FunctionSet::iterator it = other->functions_.begin();
+       it != other->functions_.end(); ++it) {
+    Function *function = *it;
+    for (vector<Line>::iterator line_it = function->lines.begin();
+         line_it != function->lines.end(); ++line_it)
+      line_it->file = file_map[line_it->file];
+    AddFunction(function);
+  }
+  other->functions_.clear();
+}
+
 void Module::AddStackFrameEntry(StackFrameEntry *stack_frame_entry) {
   stack_frame_entries_.push_back(stack_frame_entry);
 }
@@ -167,11 +542,15 @@ void Module::AssignSourceIds() {
   }
 
   // Next, mark all files actually cited by our functions' line number
-  // info, by setting each one's source id to zero.
-  for (FunctionSet::const_iterator func_it = functions_.begin();
-       func_it != functions_.end(); ++func_it) {
-    Function *func = *func_it;
-    for (vector<Line>::iterator line_it = func->lines.begin();
+  // info, by setting each one's source id to zero.  Read the functions as
+  // Write does, so that files cited only by spilled duplicates it drops
+  // stay unmarked.  If reading the spilled functions fails here, Write
+  // will fail reading them too.
+  FunctionMerger merger(spilled_runs_, spilled_files_,
+                        functions_.begin(), functions_.end());
+  const Function *func;
+  while (merger.Next(&func)) {
+    for (vector<Line>::const_iterator line_it = func->lines.begin();
          line_it != func->lines.end(); ++line_it)
       line_it->file->source_id = 0;
   }
@@ -194,20 +573,18 @@ bool Module::ReportError() {
   return false;
 }
 
-bool Module::WriteRuleMap(const RuleMap &rule_map, std::ostream &stream) {
-  for (RuleMap::const_iterator it = rule_map.begin();
-       it != rule_map.end(); ++it) {
-    if (it != rule_map.begin())
-      stream << ' ';
-    stream << it->first << ": " << it->second;
-  }
-  return stream.good();
-}
-
 bool Module::Write(std::ostream &stream, bool cfi) {
-  stream << "MODULE " << os_ << " " << architecture_ << " "
-         << id_ << " " << name_ << endl;
-  if (!stream.good())
+  SymbolFileWriter writer(stream);
+  writer.String("MODULE ", 7);
+  writer.String(os_);
+  writer.Char(' ');
+  writer.String(architecture_);
+  writer.Char(' ');
+  writer.String(id_);
+  writer.Char(' ');
+  writer.String(name_);
+  writer.Char('\n');
+  if (!writer.good())
     return ReportError();
 
   AssignSourceIds();
@@ -217,47 +594,64 @@ bool Module::Write(std::ostream &stream, bool cfi) {
        file_it != files_.end(); ++file_it) {
     File *file = file_it->second;
     if (file->source_id >= 0) {
-      stream << "FILE " << file->source_id << " " <<  file->name << endl;
-      if (!stream.good())
-        return ReportError();
+      writer.String("FILE ", 5);
+      writer.Decimal(file->source_id);
+      writer.Char(' ');
+      writer.String(file->name);
+      writer.Char('\n');
     }
   }
+  if (!writer.good())
+    return ReportError();
 
-  // Write out functions and their lines.
-  for (FunctionSet::const_iterator func_it = functions_.begin();
-       func_it != functions_.end(); ++func_it) {
-    Function *func = *func_it;
-    stream << "FUNC " << hex
-           << (func->address - load_address_) << " "
-           << func->size << " "
-           << func->parameter_size << " "
-           << func->name << dec << endl;
-
-    if (!stream.good())
-      return ReportError();
-    for (vector<Line>::iterator line_it = func->lines.begin();
+  // Write out functions and their lines, merging any that have been
+  // spilled back in.
+  FunctionMerger merger(spilled_runs_, spilled_files_,
+                        functions_.begin(), functions_.end());
+  const Function *func;
+  while (merger.Next(&func)) {
+    writer.String("FUNC ", 5);
+    writer.Hex(func->address - load_address_);
+    writer.Char(' ');
+    writer.Hex(func->size);
+    writer.Char(' ');
+    writer.Hex(func->parameter_size);
+    writer.Char(' ');
+    writer.String(func->name);
+    writer.Char('\n');
+
+    for (vector<Line>::const_iterator line_it = func->lines.begin();
          line_it != func->lines.end(); ++line_it) {
-      stream << hex
-             << (line_it->address - load_address_) << " "
-             << line_it->size << " "
-             << dec
-             << line_it->number << " "
-             << line_it->file->source_id << endl;
-      if (!stream.good())
-        return ReportError();
+      writer.Hex(line_it->address - load_address_);
+      writer.Char(' ');
+      writer.Hex(line_it->size);
+      writer.Char(' ');
+      writer.Decimal(line_it->number);
+      writer.Char(' ');
+      writer.Decimal(line_it->file->source_id);
+      writer.Char('\n');
     }
+    if (!writer.good())
+      return ReportError();
+  }
+  if (merger.error()) {
+    fprintf(stderr, "error reading spilled functions: %s\n",
+            strerror(errno));
+    return false;
   }
 
   // Write out 'PUBLIC' records.
   for (ExternSet::const_iterator extern_it = externs_.begin();
        extern_it != externs_.end(); ++extern_it) {
     Extern *ext = *extern_it;
-    stream << "PUBLIC " << hex
-           << (ext->address - load_address_) << " 0 "
-           << ext->name << dec << endl;
-    if (!stream.good())
-      return ReportError();
+    writer.String("PUBLIC ", 7);
+    writer.Hex(ext->address - load_address_);
+    writer.String(" 0 ", 3);
+    writer.String(ext->name);
+    writer.Char('\n');
   }
+  if (!writer.good())
+    return ReportError();
 
   if (cfi) {
     // Write out 'STACK CFI INIT' and 'STACK CFI' records.
@@ -265,29 +659,30 @@ bool Module::Write(std::ostream &stream, bool cfi) {
     for (frame_it = stack_frame_entries_.begin();
          frame_it != stack_frame_entries_.end(); ++frame_it) {
       StackFrameEntry *entry = *frame_it;
-      stream << "STACK CFI INIT " << hex
-             << (entry->address - load_address_) << " "
-             << entry->size << " " << dec;
-      if (!stream.good()
-          || !WriteRuleMap(entry->initial_rules, stream))
-        return ReportError();
-
-      stream << endl;
+      writer.String("STACK CFI INIT ", 15);
+      writer.Hex(entry->address - load_address_);
+      writer.Char(' ');
+      writer.Hex(entry->size);
+      writer.Char(' ');
+      WriteRuleMap(entry->initial_rules, &writer);
+      writer.Char('\n');
 
       // Write out this entry's delta rules as 'STACK CFI' records.
       for (RuleChangeMap::const_iterator delta_it = entry->rule_changes.begin();
            delta_it != entry->rule_changes.end(); ++delta_it) {
-        stream << "STACK CFI " << hex
-               << (delta_it->first - load_address_) << " " << dec;
-        if (!stream.good()
-            || !WriteRuleMap(delta_it->second, stream))
-          return ReportError();
-
-        stream << endl;
+        writer.String("STACK CFI ", 10);
+        writer.Hex(delta_it->first - load_address_);
+        writer.Char(' ');
+        WriteRuleMap(delta_it->second, &writer);
+        writer.Char('\n');
       }
+      if (!writer.good())
+        return ReportError();
     }
   }
 
+  if (!writer.Flush() || !stream.flush().good())
+    return ReportError();
   return true;
 }
 
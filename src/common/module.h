@@ -38,6 +38,8 @@
 #ifndef COMMON_LINUX_MODULE_H__
 #define COMMON_LINUX_MODULE_H__
 
+#include <stdio.h>
+
 #include <iostream>
 #include <map>
 #include <set>
@@ -199,6 +201,27 @@ class Module {
   void AddFunctions(vector<Function *>::iterator begin,
                     vector<Function *>::iterator end);
 
+  // Write the functions added so far to a temporary file in DIRECTORY,
+  // and free them. Functions added afterwards are held in memory as
+  // usual, until the next call. Write merges the spilled functions back
+  // in, writing the same symbol file as if they had never been spilled;
+  // a function spilled earlier wins over an identical one added later,
+  // just as AddFunction's does. GetFunctions returns only the functions
+  // held in memory. Return true on success. On failure, report the
+  // error, leave the functions in memory and return false.
+  bool SpillFunctions(const string &directory);
+
+  // Return the number of source lines the functions held in memory had
+  // when they were added.
+  size_t unspilled_line_count() const { return unspilled_lines_; }
+
+  // Move all of OTHER's functions and files to this module, leaving
+  // OTHER with neither. OTHER's functions are added as if by
+  // AddFunction, so where both modules have a function at the same
+  // address with the same name, this module keeps its own. Lines are
+  // changed to refer to this module's file of the same name.
+  void TakeFunctionsAndFiles(Module *other);
+
   // Add STACK_FRAME_ENTRY to the module.
   // This module owns all StackFrameEntry objects added with this
   // function: destroying the module destroys them as well.
@@ -249,7 +272,8 @@ class Module {
   void GetStackFrameEntries(vector<StackFrameEntry *> *vec);
 
   // Find those files in this module that are actually referred to by
-  // functions' line number data, and assign them source id numbers.
+  // functions' line number data, spilled or not, and assign them source
+  // id numbers.
   // Set the source id numbers for all other files --- unused by the
   // source line data --- to -1.  We do this before writing out the
   // symbol file, at which point we omit any unused files.
@@ -260,11 +284,13 @@ class Module {
   // an error occurs. This method writes out:
   // - a header based on the values given to the constructor,
   // - the source files added via FindFile,
-  // - the functions added via AddFunctions, each with its lines,
+  // - the functions added via AddFunctions, spilled or not, each with
+  //   its lines,
   // - all public records,
   // - and if CFI is true, all CFI records.
   // Addresses in the output are all relative to the load address
-  // established by SetLoadAddress.
+  // established by SetLoadAddress. The records are written to STREAM
+  // in large chunks, and STREAM is flushed before this returns.
   bool Write(std::ostream &stream, bool cfi);
 
  private:
@@ -272,10 +298,13 @@ class Module {
   // errno to find the appropriate cause.  Return false.
   static bool ReportError();
 
-  // Write RULE_MAP to STREAM, in the form appropriate for 'STACK CFI'
-  // records, without a final newline. Return true if all goes well;
-  // if an error occurs, return false, and leave errno set.
-  static bool WriteRuleMap(const RuleMap &rule_map, std::ostream &stream);
+  // Write FUNCTION to the spill file RUN, numbering the files its lines
+  // refer to in spilled_files_. Return false on error.
+  bool WriteSpilledFunction(const Function &function, FILE *run);
+
+  // Merge all of spilled_runs_ into a single new run in DIRECTORY.
+  // Return false, keeping the old runs, on error.
+  bool MergeSpilledRuns(const string &directory);
 
   // Module header entries.
   string name_, os_, architecture_, id_;
@@ -314,6 +343,18 @@ class Module {
   // The module owns all the externs that have been added to it;
   // destroying the module frees the Externs these point to.
   ExternSet externs_;
+
+  // Temporary files holding the functions moved out of functions_ by
+  // SpillFunctions, each sorted like functions_, oldest first.
+  vector<FILE *> spilled_runs_;
+
+  // The files referred to by spilled functions' lines; the runs refer
+  // to them by their index here.
+  vector<File *> spilled_files_;
+  map<File *, u_int32_t> spilled_file_indices_;
+
+  // The number of lines in functions_, as counted by AddFunction.
+  size_t unspilled_lines_;
 };
 
 }  // namespace google_breakpad
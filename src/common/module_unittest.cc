@@ -42,8 +42,10 @@
 
 #include "breakpad_googletest_includes.h"
 #include "common/module.h"
+#include "common/tests/auto_tempdir.h"
 #include "common/using_std_string.h"
 
+using google_breakpad::AutoTempDir;
 using google_breakpad::Module;
 using std::stringstream;
 using std::vector;
@@ -255,6 +257,190 @@ TEST(Write, NoCFI) {
                contents.c_str());
 }
 
+// Extreme values must be written the way iostream would format them.
+TEST(Write, ExtremeValues) {
+  stringstream s;
+  Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+
+  Module::File *file = m.FindFile("file");
+  Module::Function *function = new(Module::Function);
+  function->name = "function";
+  function->address = 0;
+  function->size = 0xffffffffffffffffULL;
+  function->parameter_size = 0;
+  Module::Line line1 = { 0, 0xf, file, 0 };
+  Module::Line line2 = { 0x10, 0xffffffffffffffffULL, file, -1 };
+  Module::Line line3 = { 0x20, 0x10, file, -2147483647 - 1 };
+  Module::Line line4 = { 0x30, 0x10, file, 2147483647 };
+  function->lines.push_back(line1);
+  function->lines.push_back(line2);
+  function->lines.push_back(line3);
+  function->lines.push_back(line4);
+  m.AddFunction(function);
+
+  Module::Extern *ext = new(Module::Extern);
+  ext->address = 0xffffffffffffffffULL;
+  ext->name = "";
+  m.AddExtern(ext);
+
+  m.Write(s, true);
+  string contents = s.str();
+  EXPECT_STREQ("MODULE " MODULE_OS " " MODULE_ARCH " "
+               MODULE_ID " " MODULE_NAME "\n"
+               "FILE 0 file\n"
+               "FUNC 0 ffffffffffffffff 0 function\n"
+               "0 f 0 0\n"
+               "10 ffffffffffffffff -1 0\n"
+               "20 10 -2147483648 0\n"
+               "30 10 2147483647 0\n"
+               "PUBLIC ffffffffffffffff 0 \n",
+               contents.c_str());
+}
+
+// Records much larger than the writer's buffer, and enough of them to
+// fill it many times over, must come out intact.
+TEST(Write, LargeOutput) {
+  stringstream s;
+  Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+
+  Module::File *file = m.FindFile("file");
+  const string long_name(3 << 20, 'x');
+  Module::Function *function = new(Module::Function);
+  function->name = long_name;
+  function->address = 0x1000;
+  function->size = 0x100000;
+  function->parameter_size = 0;
+  for (int i = 0; i < 0x10000; ++i) {
+    Module::Line line = { 0x1000 + i * 0x10, 0x10, file, i };
+    function->lines.push_back(line);
+  }
+  m.AddFunction(function);
+
+  std::ostringstream expected;
+  expected << "MODULE " MODULE_OS " " MODULE_ARCH " "
+           << MODULE_ID " " MODULE_NAME "\n"
+           << "FILE 0 file\n"
+           << "FUNC 1000 100000 0 " << long_name << "\n";
+  for (int i = 0; i < 0x10000; ++i)
+    expected << std::hex << 0x1000 + i * 0x10 << " 10 " << std::dec << i
+             << " 0\n";
+
+  ASSERT_TRUE(m.Write(s, true));
+  EXPECT_TRUE(expected.str() == s.str());
+}
+
+// Add the functions of batch number BATCH to M. Batches overlap in
+// address, add functions with the same address but different names,
+// and add the same function (with a different size) again.
+static void AddFunctionBatch(Module *m, int batch) {
+  char name[64];
+  for (int i = 0; i < 8; ++i) {
+    Module::Function *function = new(Module::Function);
+    snprintf(name, sizeof(name), "function_%d_%d", batch % 3, i);
+    function->name = name;
+    function->address = 0x10000 + (i * 7 + batch % 5) * 0x100;
+    function->size = 0x40 + batch;
+    function->parameter_size = batch;
+    for (int j = 0; j < i % 3; ++j) {
+      snprintf(name, sizeof(name), "file_%d", (batch + j) % 4);
+      Module::Line line = { function->address + j * 0x10, 0x10,
+                            m->FindFile(name), batch * 100 + j };
+      function->lines.push_back(line);
+    }
+    m->AddFunction(function);
+  }
+}
+
+// Spilling functions must not change the symbol file written, however
+// many times the functions are spilled.
+TEST(Spill, SameOutput) {
+  AutoTempDir temp_dir;
+  const int kBatchCounts[] = { 2, 5, 40 };
+  for (size_t i = 0; i < sizeof(kBatchCounts) / sizeof(kBatchCounts[0]);
+       ++i) {
+    Module held(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+    Module spilled(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+    held.SetLoadAddress(0x1000);
+    spilled.SetLoadAddress(0x1000);
+    held.FindFile("unused file");
+    spilled.FindFile("unused file");
+    for (int batch = 0; batch < kBatchCounts[i]; ++batch) {
+      AddFunctionBatch(&held, batch);
+      AddFunctionBatch(&spilled, batch);
+      if (batch + 1 < kBatchCounts[i]) {
+        EXPECT_LT(0U, spilled.unspilled_line_count());
+        ASSERT_TRUE(spilled.SpillFunctions(temp_dir.path()));
+        EXPECT_EQ(0U, spilled.unspilled_line_count());
+      }
+    }
+
+    stringstream expected;
+    ASSERT_TRUE(held.Write(expected, true));
+    EXPECT_NE(string::npos, expected.str().find("FILE 0 file_0\n"));
+    stringstream s;
+    ASSERT_TRUE(spilled.Write(s, true));
+    EXPECT_EQ(expected.str(), s.str()) << kBatchCounts[i] << " batches";
+    // Writing again reads the spilled functions again.
+    stringstream again;
+    ASSERT_TRUE(spilled.Write(again, true));
+    EXPECT_EQ(expected.str(), again.str());
+  }
+}
+
+// A spilled function dropped as a duplicate must not leave a FILE record
+// behind for the files only it cites.
+TEST(Spill, DroppedDuplicateFiles) {
+  AutoTempDir temp_dir;
+  Module held(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  Module spilled(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  Module *modules[] = { &held, &spilled };
+  for (int i = 0; i < 2; ++i) {
+    Module *m = modules[i];
+    const char *files[] = { "kept", "dropped" };
+    for (int j = 0; j < 2; ++j) {
+      Module::Function *function = new(Module::Function);
+      function->name = "function";
+      function->address = 0x1000;
+      function->size = 0x10;
+      function->parameter_size = 0;
+      Module::Line line = { 0x1000, 0x10, m->FindFile(files[j]), 10 + j };
+      function->lines.push_back(line);
+      m->AddFunction(function);
+      if (m == &spilled)
+        ASSERT_TRUE(m->SpillFunctions(temp_dir.path()));
+    }
+  }
+
+  stringstream expected;
+  ASSERT_TRUE(held.Write(expected, true));
+  EXPECT_EQ("MODULE " MODULE_OS " " MODULE_ARCH " "
+            MODULE_ID " " MODULE_NAME "\n"
+            "FILE 0 kept\n"
+            "FUNC 1000 10 0 function\n"
+            "1000 10 10 0\n",
+            expected.str());
+  stringstream s;
+  ASSERT_TRUE(spilled.Write(s, true));
+  EXPECT_EQ(expected.str(), s.str());
+}
+
+TEST(Spill, BadDirectory) {
+  Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  AddFunctionBatch(&m, 0);
+  stringstream expected;
+  ASSERT_TRUE(m.Write(expected, true));
+
+  const size_t lines = m.unspilled_line_count();
+  EXPECT_FALSE(m.SpillFunctions("/nonexistent directory"));
+  EXPECT_EQ(lines, m.unspilled_line_count());
+  vector<Module::Function *> functions;
+  m.GetFunctions(&functions, functions.end());
+  EXPECT_EQ(8U, functions.size());
+  stringstream s;
+  ASSERT_TRUE(m.Write(s, true));
+  EXPECT_EQ(expected.str(), s.str());
+}
+
 TEST(Construct, AddFunctions) {
   stringstream s;
   Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
@@ -436,6 +622,70 @@ TEST(Construct, FunctionsWithSameAddress) {
                contents.c_str());
 }
 
+// Functions and files taken from another module should produce the
+// same output as adding them to this one directly; where both have a
+// function, the one already present wins.
+TEST(Construct, TakeFunctionsAndFiles) {
+  stringstream s;
+  Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  Module other("", "", "", "");
+
+  Module::File *file1 = m.FindFile("file1");
+  Module::Function *function1 = new(Module::Function);
+  function1->name = "function1";
+  function1->address = 0x1000;
+  function1->size = 0x100;
+  function1->parameter_size = 0;
+  Module::Line line1 = { 0x1000, 0x100, file1, 11 };
+  function1->lines.push_back(line1);
+  m.AddFunction(function1);
+
+  // A function at the same address with the same name, which should
+  // be dropped, and one which uses a file of the same name in OTHER.
+  Module::File *other_file1 = other.FindFile("file1");
+  Module::File *other_file2 = other.FindFile("file2");
+  Module::Function *duplicate = new(Module::Function);
+  duplicate->name = "function1";
+  duplicate->address = 0x1000;
+  duplicate->size = 0x80;
+  duplicate->parameter_size = 0;
+  Module::Line duplicate_line = { 0x1000, 0x80, other_file2, 22 };
+  duplicate->lines.push_back(duplicate_line);
+  other.AddFunction(duplicate);
+  Module::Function *function2 = new(Module::Function);
+  function2->name = "function2";
+  function2->address = 0x2000;
+  function2->size = 0x200;
+  function2->parameter_size = 0;
+  Module::Line line2 = { 0x2000, 0x100, other_file2, 33 };
+  Module::Line line3 = { 0x2100, 0x100, other_file1, 44 };
+  function2->lines.push_back(line2);
+  function2->lines.push_back(line3);
+  other.AddFunction(function2);
+
+  m.TakeFunctionsAndFiles(&other);
+
+  vector<Module::Function *> other_functions;
+  other.GetFunctions(&other_functions, other_functions.end());
+  EXPECT_EQ(0U, other_functions.size());
+  vector<Module::File *> other_files;
+  other.GetFiles(&other_files);
+  EXPECT_EQ(0U, other_files.size());
+
+  m.Write(s, true);
+  string contents = s.str();
+  EXPECT_STREQ("MODULE " MODULE_OS " " MODULE_ARCH " "
+               MODULE_ID " " MODULE_NAME "\n"
+               "FILE 0 file1\n"
+               "FILE 1 file2\n"
+               "FUNC 1000 100 0 function1\n"
+               "1000 100 11 0\n"
+               "FUNC 2000 200 0 function2\n"
+               "2000 100 33 1\n"
+               "2100 100 44 0\n",
+               contents.c_str());
+}
+
 // Externs should be written out as PUBLIC records, sorted by
 // address.
 TEST(Construct, Externs) {
@@ -0,0 +1,343 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// module_write_benchmark.cc: Measures how quickly Module::Write writes
+// the symbol file for a large module.
+//
+// A synthetic module resembling what dump_syms builds for a big binary is
+// written repeatedly by two writers:
+//   iostream: the way Module::Write used to work, formatting each record
+//             with iostream manipulators and flushing it with endl
+//   module:   Module::Write itself
+// to two sinks:
+//   memory:   a std::stringstream
+//   file:     a std::ofstream, on /dev/null unless -o names another file
+// The writers' output is checked to be identical.
+//
+// Results are printed one line per case, writer and sink, as fields
+// separated by '|', in the order named by the "#" header line.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/module.h"
+#include "common/using_std_string.h"
+
+namespace {
+
+using google_breakpad::Module;
+using std::vector;
+
+// Bumped whenever the output format changes.
+static const int kOutputVersion = 1;
+
+// Separator character for machine readable output.
+static const char kOutputSeparator = '|';
+
+struct WriteCase {
+  int functions;
+  int lines_per_function;
+};
+
+static double Now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+// Fill MODULE with WRITE_CASE's functions and lines, spread over a few
+// hundred files, plus a public symbol for every tenth function and a CFI
+// entry with two changes for every function.
+static void BuildModule(const WriteCase& write_case, Module* module) {
+  vector<Module::File*> files;
+  char name[256];
+  for (int i = 0; i < 300; ++i) {
+    snprintf(name, sizeof(name),
+             "/build/src/synthetic/directory_%d/file_%d.cc", i / 10, i);
+    files.push_back(module->FindFile(name));
+  }
+  const int lines = write_case.lines_per_function;
+  for (int i = 0; i < write_case.functions; ++i) {
+    const Module::Address address = 0x400000 + i * 0x10 * (lines + 1);
+    Module::Function* function = new Module::Function;
+    snprintf(name, sizeof(name),
+             "synthetic::Class%d::Method(int, char const*)", i);
+    function->name = name;
+    function->address = address;
+    function->size = 0x10 * lines;
+    function->parameter_size = 0;
+    for (int j = 0; j < lines; ++j) {
+      Module::Line line = { address + j * 0x10, 0x10,
+                            files[(i + j / 4) % files.size()],
+                            100 + i % 1000 + j };
+      function->lines.push_back(line);
+    }
+    module->AddFunction(function);
+
+    if (i % 10 == 0) {
+      Module::Extern* ext = new Module::Extern;
+      snprintf(name, sizeof(name), "synthetic_public_%d", i);
+      ext->address = address;
+      ext->name = name;
+      module->AddExtern(ext);
+    }
+
+    Module::StackFrameEntry* entry = new Module::StackFrameEntry;
+    entry->address = address;
+    entry->size = function->size;
+    entry->initial_rules[".cfa"] = "$rsp 8 +";
+    entry->initial_rules[".ra"] = ".cfa -8 + ^";
+    entry->rule_changes[address + 1][".cfa"] = "$rsp 16 +";
+    entry->rule_changes[address + 1]["$rbp"] = ".cfa -16 + ^";
+    entry->rule_changes[address + 4][".cfa"] = "$rbp 16 +";
+    module->AddStackFrameEntry(entry);
+  }
+}
+
+static void WriteRuleMapWithIostream(const Module::RuleMap& rule_map,
+                                     std::ostream& stream) {
+  for (Module::RuleMap::const_iterator it = rule_map.begin();
+       it != rule_map.end(); ++it) {
+    if (it != rule_map.begin())
+      stream << ' ';
+    stream << it->first << ": " << it->second;
+  }
+}
+
+// Write MODULE to STREAM the way Module::Write used to, for a module
+// whose load address is zero.
+static bool WriteWithIostream(const string& header, Module* module,
+                              std::ostream& stream) {
+  using std::dec;
+  using std::endl;
+  using std::hex;
+
+  stream << header << endl;
+  module->AssignSourceIds();
+
+  vector<Module::File*> files;
+  module->GetFiles(&files);
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (files[i]->source_id >= 0)
+      stream << "FILE " << files[i]->source_id << " " << files[i]->name
+             << endl;
+  }
+
+  vector<Module::Function*> functions;
+  module->GetFunctions(&functions, functions.end());
+  for (size_t i = 0; i < functions.size(); ++i) {
+    const Module::Function* func = functions[i];
+    stream << "FUNC " << hex << func->address << " " << func->size << " "
+           << func->parameter_size << " " << func->name << dec << endl;
+    for (vector<Module::Line>::const_iterator line_it = func->lines.begin();
+         line_it != func->lines.end(); ++line_it) {
+      stream << hex << line_it->address << " " << line_it->size << " "
+             << dec << line_it->number << " " << line_it->file->source_id
+             << endl;
+    }
+  }
+
+  vector<Module::Extern*> externs;
+  module->GetExterns(&externs, externs.end());
+  for (size_t i = 0; i < externs.size(); ++i) {
+    stream << "PUBLIC " << hex << externs[i]->address << " 0 "
+           << externs[i]->name << dec << endl;
+  }
+
+  vector<Module::StackFrameEntry*> entries;
+  module->GetStackFrameEntries(&entries);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const Module::StackFrameEntry* entry = entries[i];
+    stream << "STACK CFI INIT " << hex << entry->address << " "
+           << entry->size << " " << dec;
+    WriteRuleMapWithIostream(entry->initial_rules, stream);
+    stream << endl;
+    for (Module::RuleChangeMap::const_iterator delta_it =
+             entry->rule_changes.begin();
+         delta_it != entry->rule_changes.end(); ++delta_it) {
+      stream << "STACK CFI " << hex << delta_it->first << " " << dec;
+      WriteRuleMapWithIostream(delta_it->second, stream);
+      stream << endl;
+    }
+  }
+  return stream.good();
+}
+
+static bool Write(bool use_module_write, const string& header,
+                  Module* module, std::ostream& stream) {
+  if (use_module_write)
+    return module->Write(stream, true);
+  return WriteWithIostream(header, module, stream);
+}
+
+static size_t CountLines(const string& text) {
+  size_t lines = 0;
+  for (size_t i = 0; i < text.size(); ++i)
+    lines += text[i] == '\n';
+  return lines;
+}
+
+static void PrintResult(const WriteCase& write_case, const char* writer,
+                        const char* sink, int iterations, double usec,
+                        size_t lines, size_t bytes) {
+  const double usec_per_iteration = usec / iterations;
+  printf("f%d_l%d%c%s%c%s%c%d%c%.0f%c%zu%c%zu%c%.0f%c%.1f\n",
+         write_case.functions, write_case.lines_per_function,
+         kOutputSeparator, writer, kOutputSeparator, sink, kOutputSeparator,
+         iterations, kOutputSeparator, usec_per_iteration, kOutputSeparator,
+         lines, kOutputSeparator, bytes, kOutputSeparator,
+         usec_per_iteration > 0 ? lines * 1e6 / usec_per_iteration : 0,
+         kOutputSeparator,
+         usec_per_iteration > 0 ? bytes / usec_per_iteration : 0);
+}
+
+static bool BenchmarkCase(const WriteCase& write_case, int iterations,
+                          const char* file_path) {
+  const string header = "MODULE Linux x86_64 "
+                        "0123456789ABCDEF0123456789ABCDEF0 synthetic.so";
+  Module module("synthetic.so", "Linux", "x86_64",
+                "0123456789ABCDEF0123456789ABCDEF0");
+  BuildModule(write_case, &module);
+
+  // Both writers must produce the same symbol file.
+  std::stringstream iostream_output, module_output;
+  if (!Write(false, header, &module, iostream_output) ||
+      !Write(true, header, &module, module_output))
+    return false;
+  const string expected = iostream_output.str();
+  if (expected != module_output.str()) {
+    fprintf(stderr, "Module::Write output differs from iostream output\n");
+    return false;
+  }
+  const size_t lines = CountLines(expected);
+
+  static const char* const kWriters[] = { "iostream", "module" };
+  for (int writer = 0; writer < 2; ++writer) {
+    double usec = 0;
+    for (int i = 0; i < iterations; ++i) {
+      std::stringstream stream;
+      const double start = Now();
+      Write(writer == 1, header, &module, stream);
+      usec += Now() - start;
+    }
+    PrintResult(write_case, kWriters[writer], "memory", iterations, usec,
+                lines, expected.size());
+
+    usec = 0;
+    for (int i = 0; i < iterations; ++i) {
+      std::ofstream stream(file_path, std::ios::out | std::ios::trunc);
+      if (!stream.is_open()) {
+        perror(file_path);
+        return false;
+      }
+      const double start = Now();
+      const bool written = Write(writer == 1, header, &module, stream);
+      stream.close();
+      usec += Now() - start;
+      if (!written)
+        return false;
+    }
+    PrintResult(write_case, kWriters[writer], "file", iterations, usec,
+                lines, expected.size());
+  }
+  return true;
+}
+
+static void usage(const char *program_name) {
+  fprintf(stderr,
+          "usage: %s [-i iterations] [-o file] [-f functions -l lines]\n"
+          "    -i: times to write each module (default 3)\n"
+          "    -o: file to write to, instead of /dev/null\n"
+          "    -f, -l: write only a module with this many functions, each\n"
+          "            with this many lines, instead of the default cases\n",
+          program_name);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int iterations = 3;
+  const char* file_path = "/dev/null";
+  WriteCase custom = { 0, 0 };
+  int argi = 1;
+  for (; argi + 1 < argc && argv[argi][0] == '-'; argi += 2) {
+    const char *value = argv[argi + 1];
+    if (strcmp(argv[argi], "-i") == 0 && (iterations = atoi(value)) > 0) {
+    } else if (strcmp(argv[argi], "-o") == 0) {
+      file_path = value;
+    } else if (strcmp(argv[argi], "-f") == 0 &&
+               (custom.functions = atoi(value)) > 0) {
+    } else if (strcmp(argv[argi], "-l") == 0 &&
+               (custom.lines_per_function = atoi(value)) > 0) {
+    } else {
+      break;
+    }
+  }
+  bool have_custom = custom.functions || custom.lines_per_function;
+  if (argi != argc ||
+      (have_custom && (!custom.functions || !custom.lines_per_function))) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  printf("# module_write_benchmark%c%d\n", kOutputSeparator, kOutputVersion);
+  printf("# case%cwriter%csink%citerations%cusec_per_iteration%clines%c"
+         "bytes%clines_per_second%cbytes_per_usec\n",
+         kOutputSeparator, kOutputSeparator, kOutputSeparator,
+         kOutputSeparator, kOutputSeparator, kOutputSeparator,
+         kOutputSeparator, kOutputSeparator);
+
+  vector<WriteCase> cases;
+  if (have_custom) {
+    cases.push_back(custom);
+  } else {
+    const WriteCase kCases[] = {
+      { 10000, 10 },
+      { 100000, 30 },
+    };
+    cases.assign(kCases, kCases + sizeof(kCases) / sizeof(kCases[0]));
+  }
+
+  int result = 0;
+  for (size_t i = 0; i < cases.size(); ++i) {
+    if (!BenchmarkCase(cases[i], iterations, file_path)) {
+      fprintf(stderr, "Case %d failed\n", static_cast<int>(i));
+      result = 1;
+    }
+  }
+  return result;
+}
@@ -50,18 +50,34 @@ using std::map;
 
 class BasicSourceLineResolver : public SourceLineResolverBase {
  public:
-  BasicSourceLineResolver();
+  // If lazy is true, modules are loaded lazily: loading a symbol file only
+  // parses its FILE, PUBLIC and STACK WIN records, and indexes its FUNC and
+  // STACK CFI records by address without parsing them.  A function's name
+  // and line records are parsed the first time a lookup lands in the
+  // function, and a STACK CFI record's rules each time FindCFIFrameInfo
+  // needs them.  When only a few addresses of a large module are ever
+  // looked up, this makes loading much faster and the module much smaller.
+  //
+  // The resolver then keeps each module's symbol file in memory for as long
+  // as the module is loaded, and malformed line records are only detected,
+  // logged and skipped when their function is parsed, rather than failing
+  // the load.
+  explicit BasicSourceLineResolver(bool lazy = false);
   virtual ~BasicSourceLineResolver() { }
 
   using SourceLineResolverBase::LoadModule;
   using SourceLineResolverBase::LoadModuleUsingMapBuffer;
   using SourceLineResolverBase::LoadModuleUsingMemoryBuffer;
-  using SourceLineResolverBase::ShouldDeleteMemoryBufferAfterLoadModule;
   using SourceLineResolverBase::UnloadModule;
   using SourceLineResolverBase::HasModule;
   using SourceLineResolverBase::FillSourceLineInfo;
   using SourceLineResolverBase::FindWindowsFrameInfo;
   using SourceLineResolverBase::FindCFIFrameInfo;
+  using SourceLineResolverBase::HasThreadSafeLookups;
+
+  // Lazily loaded modules refer to their symbol files, which must then stay
+  // alive as long as the modules do.
+  virtual bool ShouldDeleteMemoryBufferAfterLoadModule();
 
  private:
   // friend declarations:
@@ -75,6 +91,8 @@ class BasicSourceLineResolver : public SourceLineResolverBase {
   // Module implements SourceLineResolverBase::Module interface.
   class Module;
 
+  bool lazy_;
+
   // Disallow unwanted copy ctor and assignment operator
   BasicSourceLineResolver(const BasicSourceLineResolver&);
   void operator=(const BasicSourceLineResolver&);
@@ -0,0 +1,107 @@
+// -*- mode: C++ -*-
+
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// caching_stack_frame_symbolizer.h: A StackFrameSymbolizer that loads
+// symbols into a SharedModuleCache instead of a source line resolver of
+// its own.
+//
+// Give each MinidumpProcessor its own CachingStackFrameSymbolizer, and all
+// of them the same SharedModuleCache.  A module's symbols are then fetched
+// from the SymbolSupplier and parsed once, by whichever processor needs
+// them first, and shared with every other processor from then on.
+//
+// Modules used by a minidump stay referenced, and so can't be evicted,
+// until the symbolizer is Reset, which MinidumpProcessor does at the start
+// of each minidump, or destroyed.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_CACHING_STACK_FRAME_SYMBOLIZER_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_CACHING_STACK_FRAME_SYMBOLIZER_H__
+
+#include <map>
+#include <string>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/shared_module_cache.h"
+#include "google_breakpad/processor/stack_frame_symbolizer.h"
+
+namespace google_breakpad {
+
+class CachingStackFrameSymbolizer : public StackFrameSymbolizer {
+ public:
+  // Neither supplier nor cache is owned, and both must outlive the
+  // symbolizer.
+  CachingStackFrameSymbolizer(SymbolSupplier* supplier,
+                              SharedModuleCache* cache);
+
+  virtual ~CachingStackFrameSymbolizer();
+
+  virtual SymbolizerResult FillSourceLineInfo(const CodeModules* modules,
+                                              const SystemInfo* system_info,
+                                              StackFrame* stack_frame);
+
+  virtual WindowsFrameInfo* FindWindowsFrameInfo(const StackFrame* frame);
+
+  virtual CFIFrameInfo* FindCFIFrameInfo(const StackFrame* frame);
+
+  // Releases every cached module referenced since the last Reset, as well
+  // as forgetting which modules are missing symbols.
+  virtual void Reset();
+
+  virtual bool HasImplementation() { return cache_ && supplier_; }
+
+  SharedModuleCache* cache() { return cache_; }
+
+ private:
+  // Maps code_file to the cache entry referenced for it.
+  typedef std::map<string, const SharedModuleCache::Entry*> EntryMap;
+
+  // Returns the entry referenced for frame's module, or NULL if none has
+  // been.
+  const SharedModuleCache::Entry* EntryForFrame(const StackFrame* frame);
+
+  // Releases and forgets every entry in entries_.  Requires resolver_lock_
+  // to be held exclusively.
+  void ReleaseEntries();
+
+  SharedModuleCache* cache_;
+
+  // Guarded by resolver_lock_, which is only held exclusively while a
+  // module is being added.  Lookups into the entries don't need the lock.
+  EntryMap entries_;
+
+  // Disallow copy constructor and assignment operator.
+  CachingStackFrameSymbolizer(const CachingStackFrameSymbolizer&);
+  void operator=(const CachingStackFrameSymbolizer&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_CACHING_STACK_FRAME_SYMBOLIZER_H__
@@ -47,6 +47,7 @@
 
 #include <map>
 #include <string>
+#include <utility>
 
 #include "google_breakpad/processor/source_line_resolver_base.h"
 
@@ -57,16 +58,30 @@ using std::map;
 class FastSourceLineResolver : public SourceLineResolverBase {
  public:
   FastSourceLineResolver();
-  virtual ~FastSourceLineResolver() { }
+  virtual ~FastSourceLineResolver();
 
   using SourceLineResolverBase::FillSourceLineInfo;
   using SourceLineResolverBase::FindCFIFrameInfo;
   using SourceLineResolverBase::FindWindowsFrameInfo;
   using SourceLineResolverBase::HasModule;
-  using SourceLineResolverBase::LoadModule;
+  using SourceLineResolverBase::HasThreadSafeLookups;
   using SourceLineResolverBase::LoadModuleUsingMapBuffer;
   using SourceLineResolverBase::LoadModuleUsingMemoryBuffer;
-  using SourceLineResolverBase::UnloadModule;
+
+  // Serialized symbol files (see processor/serialized_symbol_file.h) are
+  // mapped into memory and used in place, so loading one doesn't read it.
+  // Any other file, and any file on Windows, is read into memory as
+  // before.
+  virtual bool LoadModule(const CodeModule *module, const string &map_file);
+  virtual void UnloadModule(const CodeModule *module);
+
+  // True where files can be mapped, which is everywhere but Windows.
+  virtual bool MapsSymbolFiles();
+
+  // If verify is true, LoadModule verifies the checksums of serialized
+  // symbol files, which means reading each file in full.  By default, only
+  // their headers are checked.
+  void set_verify_checksums(bool verify) { verify_checksums_ = verify; }
 
  private:
   // Friend declarations.
@@ -89,6 +104,17 @@ class FastSourceLineResolver : public SourceLineResolverBase {
   // virtual method.
   virtual bool ShouldDeleteMemoryBufferAfterLoadModule();
 
+  // Returns true if the table of map sizes at the start of the size bytes
+  // of serialized data describes maps that fit within them.
+  static bool CheckMapSizes(const char *data, size_t size);
+
+  // The mapped serialized symbol files backing loaded modules, keyed by
+  // module name, with their sizes.
+  typedef map<string, std::pair<void*, size_t> > MappedFileMap;
+  MappedFileMap mapped_files_;
+
+  bool verify_checksums_;
+
   // Disallow unwanted copy ctor and assignment operator
   FastSourceLineResolver(const FastSourceLineResolver&);
   void operator=(const FastSourceLineResolver&);
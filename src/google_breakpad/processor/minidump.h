@@ -294,6 +294,10 @@ class MinidumpMemoryRegion : public MinidumpObject,
 
   // Cached memory.
   mutable vector<u_int8_t>* memory_;
+
+  // When the minidump is memory-mapped, the memory region is not copied.
+  // This points directly into the mapping instead, and memory_ is unused.
+  mutable const u_int8_t* mapped_memory_;
 };
 
 
@@ -492,9 +496,15 @@ class MinidumpModule : public MinidumpObject,
   // Cached CodeView record - this is MDCVInfoPDB20 or (likely)
   // MDCVInfoPDB70, or possibly something else entirely.  Stored as a u_int8_t
   // because the structure contains a variable-sized string and its exact
-  // size cannot be known until it is processed.
+  // size cannot be known until it is processed.  cv_record_ is NULL when
+  // the record is used in place from a memory-mapped minidump.
   vector<u_int8_t>* cv_record_;
 
+  // Points to the cached CodeView record, either within cv_record_ or
+  // directly into the minidump's mapping.  NULL if the record has not been
+  // read.
+  const u_int8_t* cv_record_bytes_;
+
   // If cv_record_ is present, cv_record_signature_ contains a copy of the
   // CodeView record's first four bytes, for ease of determinining the
   // type of structure that cv_record_ contains.
@@ -889,6 +899,12 @@ class Minidump {
   // weak pointer to input, and the caller must ensure that the stream
   // is valid as long as the Minidump object is.
   explicit Minidump(std::istream& input);
+  // path is the pathname of a file containing the minidump.  If
+  // memory_map is true, the entire file is mapped into memory when it is
+  // opened, and memory regions and CodeView records are returned as
+  // pointers into the mapping instead of being copied.  If the file cannot
+  // be mapped, this falls back to reading it as a stream.
+  Minidump(const string& path, bool memory_map);
 
   virtual ~Minidump();
 
@@ -948,7 +964,8 @@ class Minidump {
   }
   const MDRawDirectory* GetDirectoryEntryAtIndex(unsigned int index) const;
 
-  // The next 2 methods are lower-level I/O routines.  They use fd_.
+  // The next 4 methods are lower-level I/O routines.  They use stream_,
+  // or mapped_data_ if the minidump is memory-mapped.
 
   // Reads count bytes from the minidump at the current position into
   // the storage area pointed to by bytes.  bytes must be of sufficient
@@ -961,6 +978,17 @@ class Minidump {
   // Returns the current position of the minidump file.
   off_t Tell();
 
+  // If the minidump is memory-mapped, returns a pointer to count bytes at
+  // the current position within the mapping and advances the position by
+  // count, without copying anything.  Returns NULL if the minidump is not
+  // memory-mapped or if fewer than count bytes remain, in which case the
+  // position is unchanged.  The returned data is not byte-swapped.
+  const u_int8_t* ReadBytesInPlace(size_t count);
+
+  // True if the minidump file is being read through a memory mapping, or
+  // from memory after being decompressed.
+  bool is_memory_mapped() const { return mapped_data_ != NULL; }
+
   // The next 2 methods are medium-level I/O routines.
 
   // ReadString returns a string which is owned by the caller!  offset
@@ -1010,6 +1038,17 @@ class Minidump {
   // Opens the minidump file, or if already open, seeks to the beginning.
   bool Open();
 
+  // Maps the file at path_ into memory, setting mapped_data_ and
+  // mapped_size_.  Returns false if the file could not be mapped.
+  bool MapFile();
+
+  // If the input, positioned at its beginning, is a compressed minidump
+  // container (see common/minidump_compression.h), decompresses it into
+  // decompressed_data_ and reads from there from then on.  Otherwise
+  // leaves the input positioned at its beginning.  Returns false if the
+  // container is malformed.
+  bool Decompress();
+
   // The largest number of top-level streams that will be read from a minidump.
   // Note that streams are only read (and only consume memory) as needed,
   // when directed by the caller.  The default is 128.
@@ -1037,6 +1076,21 @@ class Minidump {
   // Set based on the path in Open, or directly in the constructor.
   std::istream*             stream_;
 
+  // True if the file at path_ should be memory-mapped instead of being read
+  // through stream_.
+  const bool                memory_map_;
+
+  // The memory-mapped minidump file, its size, and the current read
+  // position within it.  mapped_data_ is NULL unless the file was
+  // successfully mapped by Open.
+  const u_int8_t*           mapped_data_;
+  size_t                    mapped_size_;
+  off_t                     mapped_position_;
+
+  // The decompressed contents of a compressed minidump, owned by this
+  // object.  When set, mapped_data_ points here instead of at a mapping.
+  u_int8_t*                 decompressed_data_;
+
   // swap_ is true if the minidump file should be byte-swapped.  If the
   // minidump was produced by a CPU that is other-endian than the CPU
   // processing the minidump, this will be true.  If the two CPUs are
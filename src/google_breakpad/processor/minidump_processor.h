@@ -111,6 +111,18 @@ class MinidumpProcessor {
   // result.
   ProcessResult Process(Minidump* minidump,
                         ProcessState* process_state);
+
+  // Sets the number of threads used to walk a minidump's thread stacks.
+  // The default, 1, walks each stack in turn on the calling thread.  With
+  // more than one, stacks are walked concurrently on a pool of worker
+  // threads, which share the StackFrameSymbolizer (see
+  // stack_frame_symbolizer.h).  The ProcessState produced is identical in
+  // either case.
+  void set_stackwalk_threads(int stackwalk_threads) {
+    stackwalk_threads_ = stackwalk_threads;
+  }
+  int stackwalk_threads() const { return stackwalk_threads_; }
+
   // Populates the cpu_* fields of the |info| parameter with textual
   // representations of the CPU type that the minidump in |dump| was
   // produced on.  Returns false if this information is not available in
@@ -162,6 +174,9 @@ class MinidumpProcessor {
   // guess how likely it is that the crash represents an exploitable
   // memory corruption issue.
   bool enable_exploitability_;
+
+  // The number of threads to walk stacks on.  See set_stackwalk_threads.
+  int stackwalk_threads_;
 };
 
 }  // namespace google_breakpad
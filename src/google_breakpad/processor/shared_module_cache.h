@@ -0,0 +1,231 @@
+// -*- mode: C++ -*-
+
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// shared_module_cache.h: SharedModuleCache holds symbol modules that are
+// shared between any number of source line resolvers, stack frame
+// symbolizers and MinidumpProcessor instances, possibly running on
+// different threads.
+//
+// Each module is parsed once, from the text symbol format, and kept in
+// FastSourceLineResolver's serialized form.  Callers that miss on a module
+// together are served by a single load: the first one loads it, and the
+// rest wait for it to finish.  Lookups into a serialized
+// module only read its memory, so once a caller holds a reference to an
+// entry, it can look up source lines, WindowsFrameInfo and CFIFrameInfo
+// without taking any lock.  Only acquiring and releasing entries is
+// serialized.
+//
+// Entries are reference-counted.  When the total size of all cached
+// modules exceeds the cache's memory budget, entries that nobody holds a
+// reference to are evicted, least recently used first.  Entries that are
+// still referenced are never evicted, so the budget may be exceeded while
+// they're in use.
+//
+// See caching_stack_frame_symbolizer.h for the usual way to plug the cache
+// into MinidumpProcessor.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_SHARED_MODULE_CACHE_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_SHARED_MODULE_CACHE_H__
+
+#include <stddef.h>
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class CFIFrameInfo;
+class CodeModule;
+class ConditionVariable;
+class FastSourceLineResolver;
+class Mutex;
+struct StackFrame;
+struct WindowsFrameInfo;
+
+class SharedModuleCache {
+ public:
+  // A single cached module.  The lookup methods may be called concurrently
+  // from any number of threads, as long as the caller holds a reference
+  // to the entry.
+  class Entry {
+   public:
+    // Same as the SourceLineResolverInterface methods of the same names.
+    // frame->module must be the module the entry was acquired for, or
+    // one with the same code_file.
+    void FillSourceLineInfo(StackFrame* frame) const;
+    WindowsFrameInfo* FindWindowsFrameInfo(const StackFrame* frame) const;
+    CFIFrameInfo* FindCFIFrameInfo(const StackFrame* frame) const;
+
+    // The number of bytes this entry counts against the memory budget.
+    size_t size() const { return size_; }
+
+   private:
+    friend class SharedModuleCache;
+
+    Entry(const string& key, char* serialized_data, size_t size,
+          FastSourceLineResolver* resolver);
+    ~Entry();
+
+    string key_;
+
+    // The serialized module, which resolver_ reads in place.  Owned.
+    char* serialized_data_;
+    size_t size_;
+
+    // A resolver with only this module loaded.  Owned.
+    FastSourceLineResolver* resolver_;
+
+    // The number of outstanding Acquire and Insert calls not yet matched
+    // by Release.
+    int references_;
+
+    // This entry's position in the cache's idle list, valid only while
+    // references_ is zero.
+    std::list<Entry*>::iterator idle_position_;
+
+    // Disallow copy constructor and assignment operator.
+    Entry(const Entry&);
+    void operator=(const Entry&);
+  };
+
+  struct Stats {
+    // Acquire and AcquireOrBeginLoad calls that found the module in the
+    // cache, and those that didn't.
+    u_int64_t hits;
+    u_int64_t misses;
+    // Entries removed to bring the cache back within its budget.
+    u_int64_t evictions;
+    // Entries currently cached, and their total size in bytes.
+    size_t entries;
+    size_t bytes;
+  };
+
+  // Creates a cache that keeps unreferenced modules only while the total
+  // size of all cached modules is at most memory_budget bytes.
+  explicit SharedModuleCache(size_t memory_budget);
+
+  // All entries must have been released.
+  ~SharedModuleCache();
+
+  // Returns the entry for module, with a reference held for the caller,
+  // or NULL if the module isn't cached.  If another caller is loading the
+  // module, waits until it has finished.
+  const Entry* Acquire(const CodeModule* module);
+
+  // Like Acquire, except that when the module isn't cached, the caller
+  // becomes responsible for loading it: it must follow up with Insert, or
+  // with AbandonLoad if it has no symbols to insert.  Until it does, every
+  // other caller that asks for the module waits, so it must not ask for
+  // the module again itself.
+  const Entry* AcquireOrBeginLoad(const CodeModule* module);
+
+  // Ends a load begun by AcquireOrBeginLoad without inserting anything.
+  // The next caller waiting for the module, if any, takes over the load.
+  void AbandonLoad(const CodeModule* module);
+
+  // Parses symbol_data, the text symbol file for module, adds it to the
+  // cache and returns its entry with a reference held for the caller.
+  // The cache doesn't take ownership of symbol_data.  Returns NULL if
+  // symbol_data can't be parsed.  Either way, this ends any load of the
+  // module begun by AcquireOrBeginLoad.  Parsing happens without holding
+  // the cache's lock; if another caller inserts the same module in the
+  // meantime, their entry is returned and this copy is discarded.
+  const Entry* Insert(const CodeModule* module, char* symbol_data);
+
+  // Drops a reference obtained from Acquire or Insert.  The entry must
+  // not be used afterwards.
+  void Release(const Entry* entry);
+
+  // Evicts every entry that isn't referenced, regardless of the budget.
+  void Purge();
+
+  Stats GetStats() const;
+  size_t memory_budget() const { return memory_budget_; }
+
+ private:
+  typedef std::map<string, Entry*> EntryMap;
+
+  // Returns the key under which module's symbols are cached.  The key
+  // includes the debug file and identifier as well as the code file, so
+  // that different builds of a module with the same name don't collide.
+  static string KeyForModule(const CodeModule* module);
+
+  // Waits until nobody is loading the module cached under key, then
+  // returns its entry with a reference held for the caller, or NULL if
+  // it isn't cached.  Counts a hit or a miss.  Requires mutex_ to be held.
+  const Entry* WaitAndAcquire(const string& key);
+
+  // Forgets that the module cached under key is being loaded, and wakes
+  // the callers waiting for it.  Requires mutex_ to be held.
+  void EndLoad(const string& key);
+
+  // Takes a reference on entry.  Requires mutex_ to be held.
+  void Reference(Entry* entry);
+
+  // Evicts idle entries, least recently used first, until the cache is
+  // within budget (or until no idle entries remain).  Requires mutex_ to be
+  // held.
+  void EvictIdleEntries(size_t budget);
+
+  const size_t memory_budget_;
+
+  // Guards everything below, and the reference counts and idle positions
+  // of every entry.
+  Mutex* mutex_;
+
+  EntryMap entries_;
+
+  // Keys of the modules that callers of AcquireOrBeginLoad are loading,
+  // and the condition broadcast whenever one of those loads ends.
+  std::set<string> loading_;
+  ConditionVariable* load_ended_;
+
+  // Entries with no references, most recently released first.
+  std::list<Entry*> idle_;
+
+  size_t bytes_;
+  u_int64_t hits_;
+  u_int64_t misses_;
+  u_int64_t evictions_;
+
+  // Disallow copy constructor and assignment operator.
+  SharedModuleCache(const SharedModuleCache&);
+  void operator=(const SharedModuleCache&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_SHARED_MODULE_CACHE_H__
@@ -81,6 +81,9 @@ class SourceLineResolverBase : public SourceLineResolverInterface {
   virtual void FillSourceLineInfo(StackFrame *frame);
   virtual WindowsFrameInfo *FindWindowsFrameInfo(const StackFrame *frame);
   virtual CFIFrameInfo *FindCFIFrameInfo(const StackFrame *frame);
+  // Lookups only read modules_, and Module's lookup methods are
+  // thread-safe.
+  virtual bool HasThreadSafeLookups();
 
   // Nested structs and classes.
   struct Line;
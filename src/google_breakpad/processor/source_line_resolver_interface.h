@@ -98,9 +98,20 @@ class SourceLineResolverInterface {
   // If CFI stack walking information is available covering ADDRESS,
   // return a CFIFrameInfo structure describing it. If the information
   // is not available, return NULL. The caller takes ownership of any
-  // returned CFIFrameInfo object.
+  // returned CFIFrameInfo object, which must be deleted before its module
+  // is unloaded.
   virtual CFIFrameInfo *FindCFIFrameInfo(const StackFrame *frame) = 0;
 
+  // Returns true if HasModule, FillSourceLineInfo, FindWindowsFrameInfo
+  // and FindCFIFrameInfo may be called from several threads at once, so
+  // long as no module is being loaded or unloaded meanwhile.
+  virtual bool HasThreadSafeLookups() { return false; }
+
+  // Returns true if LoadModule maps serialized symbol files into memory
+  // instead of reading them, so that callers who know where a module's
+  // symbol file is should pass its path rather than its contents.
+  virtual bool MapsSymbolFiles() { return false; }
+
  protected:
   // SourceLineResolverInterface cannot be instantiated except by subclasses
   SourceLineResolverInterface() {}
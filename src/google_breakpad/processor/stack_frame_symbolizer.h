@@ -45,6 +45,8 @@
 namespace google_breakpad {
 class CFIFrameInfo;
 class CodeModules;
+class Mutex;
+class ReadWriteLock;
 class SymbolSupplier;
 class SourceLineResolverInterface;
 struct StackFrame;
@@ -68,7 +70,12 @@ class StackFrameSymbolizer {
   StackFrameSymbolizer(SymbolSupplier* supplier,
                        SourceLineResolverInterface* resolver);
 
-  virtual ~StackFrameSymbolizer() { }
+  virtual ~StackFrameSymbolizer();
+
+  // FillSourceLineInfo, FindWindowsFrameInfo and FindCFIFrameInfo may be
+  // called from several threads at once, as MinidumpProcessor does when it
+  // walks thread stacks concurrently.  Subclasses that override them are
+  // responsible for their own locking.
 
   // Encapsulate the step of resolving source line info for a stack frame.
   // "frame" must not be NULL.
@@ -84,7 +91,7 @@ class StackFrameSymbolizer {
   // A typical case is to call Reset() after processing an individual report
   // before start to process next one, in order to reset internal information
   // about missing symbols found so far.
-  virtual void Reset() { no_symbol_modules_.clear(); }
+  virtual void Reset();
 
   // Returns true if there is valid implementation for stack symbolization.
   virtual bool HasImplementation() { return resolver_ && supplier_; }
@@ -93,11 +100,27 @@ class StackFrameSymbolizer {
   SymbolSupplier* supplier() { return supplier_; }
 
  protected:
+  // Returns true if module is known to have missing symbols.
+  bool HasNoSymbols(const CodeModule* module);
+  // Records that module has missing symbols.
+  void NoteNoSymbols(const CodeModule* module);
+
   SymbolSupplier* supplier_;
   SourceLineResolverInterface* resolver_;
   // A list of modules known to have symbols missing. This helps avoid
   // repeated lookups for the missing symbols within one minidump.
   std::set<string> no_symbol_modules_;
+  // Guards no_symbol_modules_.
+  Mutex* mutex_;
+  // Guards supplier_ and resolver_.  Loading a module into the resolver
+  // holds it exclusively.  Lookups in loaded modules share it, unless the
+  // resolver doesn't have thread-safe lookups.
+  ReadWriteLock* resolver_lock_;
+
+ private:
+  // Disallow copy constructor and assignment operator.
+  StackFrameSymbolizer(const StackFrameSymbolizer&);
+  void operator=(const StackFrameSymbolizer&);
 };
 
 }  // namespace google_breakpad
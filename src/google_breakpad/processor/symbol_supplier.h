@@ -91,6 +91,11 @@ class SymbolSupplier {
 
   // Frees the data buffer allocated for the module in GetCStringSymbolData.
   virtual void FreeSymbolData(const CodeModule *module) = 0;
+
+  // Returns true if GetSymbolFile names a symbol file on disk that callers
+  // may read themselves, so that its NOT_FOUND is final.  Suppliers that
+  // only hand out symbol data return false.
+  virtual bool NamesSymbolFiles() { return false; }
 };
 
 }  // namespace google_breakpad
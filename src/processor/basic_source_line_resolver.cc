@@ -39,33 +39,58 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <map>
 #include <utility>
 #include <vector>
 
 #include "google_breakpad/processor/basic_source_line_resolver.h"
 #include "processor/basic_source_line_resolver_types.h"
+#include "processor/line_scanner.h"
 #include "processor/module_factory.h"
 
-#include "processor/tokenize.h"
-
 using std::map;
-using std::vector;
 using std::make_pair;
 
 namespace google_breakpad {
 
-static const char *kWhitespace = " \r\n";
+namespace {
+
+// Returns true if [begin, end) is a source line record, rather than one of
+// the keyword-introduced records.
+bool IsLineRecord(const char *begin, const char *end) {
+  size_t length = end - begin;
+  return !((length >= 5 && strncmp(begin, "FILE ", 5) == 0) ||
+           (length >= 6 && strncmp(begin, "STACK ", 6) == 0) ||
+           (length >= 5 && strncmp(begin, "FUNC ", 5) == 0) ||
+           (length >= 7 && strncmp(begin, "PUBLIC ", 7) == 0) ||
+           (length >= 7 && strncmp(begin, "MODULE ", 7) == 0) ||
+           (length >= 5 && strncmp(begin, "INFO ", 5) == 0));
+}
+
+// Orders lazily loaded STACK CFI delta rules by address alone.
+template<typename Rule>
+bool RuleAddressLess(const Rule &a, const Rule &b) {
+  return a.first < b.first;
+}
+
+}  // namespace
+
+BasicSourceLineResolver::BasicSourceLineResolver(bool lazy) :
+    SourceLineResolverBase(new BasicModuleFactory(lazy)), lazy_(lazy) { }
 
-BasicSourceLineResolver::BasicSourceLineResolver() :
-    SourceLineResolverBase(new BasicModuleFactory) { }
+bool BasicSourceLineResolver::ShouldDeleteMemoryBufferAfterLoadModule() {
+  return !lazy_;
+}
 
 bool BasicSourceLineResolver::Module::LoadMapFromMemory(char *memory_buffer) {
   linked_ptr<Function> cur_func;
   int line_number = 0;
-  char *save_ptr;
   size_t map_buffer_length = strlen(memory_buffer);
 
+  if (lazy_)
+    symbol_data_ = memory_buffer;
+
   // If the length is 0, we can still pretend we have a symbol file. This is
   // for scenarios that want to test symbol lookup, but don't necessarily care
   // if certain modules do not have any information, like system libraries.
@@ -73,30 +98,46 @@ bool BasicSourceLineResolver::Module::LoadMapFromMemory(char *memory_buffer) {
     return true;
   }
 
-  if (memory_buffer[map_buffer_length - 1] == '\n') {
-    memory_buffer[map_buffer_length - 1] = '\0';
-  }
-
-  char *buffer;
-  buffer = strtok_r(memory_buffer, "\r\n", &save_ptr);
-
-  while (buffer != NULL) {
+  // Each record is parsed in place, in a single pass over the buffer.
+  LineScanner lines(memory_buffer, memory_buffer + map_buffer_length);
+  const char *begin, *end;
+  while (lines.NextLine(&begin, &end)) {
     ++line_number;
+    size_t length = end - begin;
 
-    if (strncmp(buffer, "FILE ", 5) == 0) {
-      if (!ParseFile(buffer)) {
+    if (length >= 5 && strncmp(begin, "FILE ", 5) == 0) {
+      if (!ParseFile(begin, end)) {
         BPLOG(ERROR) << "ParseFile on buffer failed at " <<
             ":" << line_number;
         return false;
       }
-    } else if (strncmp(buffer, "STACK ", 6) == 0) {
-      if (!ParseStackInfo(buffer)) {
+    } else if (length >= 6 && strncmp(begin, "STACK ", 6) == 0) {
+      if (!ParseStackInfo(begin, end)) {
         BPLOG(ERROR) << "ParseStackInfo failed at " <<
             ":" << line_number;
         return false;
       }
-    } else if (strncmp(buffer, "FUNC ", 5) == 0) {
-      cur_func.reset(ParseFunction(buffer));
+    } else if (length >= 5 && strncmp(begin, "FUNC ", 5) == 0) {
+      if (lazy_) {
+        // Parse only the function's range and parameter size, which
+        // FindWindowsFrameInfo needs, and leave its name and lines for
+        // MaterializeFunction.
+        TokenScanner scanner(begin + 5, end);
+        const char *token_begins[4], *token_ends[4];
+        if (scanner.Tokenize(3, token_begins, token_ends)) {
+          cur_func.reset(new Function(
+              string(),
+              ParseHex(token_begins[0], token_ends[0]),
+              ParseHex(token_begins[1], token_ends[1]),
+              ParseHex(token_begins[2], token_ends[2])));
+          cur_func->unparsed_begin = begin;
+          cur_func->unparsed_end = end;
+        } else {
+          cur_func.reset();
+        }
+      } else {
+        cur_func.reset(ParseFunction(begin, end));
+      }
       if (!cur_func.get()) {
         BPLOG(ERROR) << "ParseFunction failed at " <<
             ":" << line_number;
@@ -106,23 +147,23 @@ bool BasicSourceLineResolver::Module::LoadMapFromMemory(char *memory_buffer) {
       // We'll silently ignore this, the function and any corresponding lines
       // will be destroyed when cur_func is released.
       functions_.StoreRange(cur_func->address, cur_func->size, cur_func);
-    } else if (strncmp(buffer, "PUBLIC ", 7) == 0) {
+    } else if (length >= 7 && strncmp(begin, "PUBLIC ", 7) == 0) {
       // Clear cur_func: public symbols don't contain line number information.
       cur_func.reset();
 
-      if (!ParsePublicSymbol(buffer)) {
+      if (!ParsePublicSymbol(begin, end)) {
         BPLOG(ERROR) << "ParsePublicSymbol failed at " <<
             ":" << line_number;
         return false;
       }
-    } else if (strncmp(buffer, "MODULE ", 7) == 0) {
+    } else if (length >= 7 && strncmp(begin, "MODULE ", 7) == 0) {
       // Ignore these.  They're not of any use to BasicSourceLineResolver,
       // which is fed modules by a SymbolSupplier.  These lines are present to
       // aid other tools in properly placing symbol files so that they can
       // be accessed by a SymbolSupplier.
       //
       // MODULE <guid> <age> <filename>
-    } else if (strncmp(buffer, "INFO ", 5) == 0) {
+    } else if (length >= 5 && strncmp(begin, "INFO ", 5) == 0) {
       // Ignore these as well, they're similarly just for housekeeping.
       //
       // INFO CODE_ID <code id> <filename>
@@ -132,21 +173,72 @@ bool BasicSourceLineResolver::Module::LoadMapFromMemory(char *memory_buffer) {
             ":" << line_number;
         return false;
       }
-      Line *line = ParseLine(buffer);
+      if (lazy_) {
+        cur_func->unparsed_end = end;
+        continue;
+      }
+      Line *line = ParseLine(begin, end);
       if (!line) {
         BPLOG(ERROR) << "ParseLine failed at " << line_number << " for " <<
-            buffer;
+            string(begin, end);
         return false;
       }
       cur_func->lines.StoreRange(line->address, line->size,
                                  linked_ptr<Line>(line));
     }
-    buffer = strtok_r(NULL, "\r\n", &save_ptr);
   }
+  if (lazy_)
+    SortLazyCFIDeltaRules();
   return true;
 }
 
+void BasicSourceLineResolver::Module::MaterializeFunction(Function *function) {
+  if (!function->unparsed_begin)
+    return;
+
+  LineScanner lines(function->unparsed_begin, function->unparsed_end);
+  const char *begin, *end;
+  function->unparsed_begin = function->unparsed_end = NULL;
+
+  // The FUNC record itself was checked when the module was loaded.
+  if (!lines.NextLine(&begin, &end))
+    return;
+  scoped_ptr<Function> parsed(ParseFunction(begin, end));
+  if (parsed.get())
+    function->name = parsed->name;
+
+  // Other records may be interleaved with the line records.
+  while (lines.NextLine(&begin, &end)) {
+    if (!IsLineRecord(begin, end))
+      continue;
+    Line *line = ParseLine(begin, end);
+    if (!line) {
+      BPLOG(ERROR) << "ParseLine failed for " << string(begin, end);
+      continue;
+    }
+    function->lines.StoreRange(line->address, line->size,
+                               linked_ptr<Line>(line));
+  }
+}
+
+void BasicSourceLineResolver::Module::SortLazyCFIDeltaRules() {
+  std::stable_sort(lazy_cfi_delta_rules_.begin(), lazy_cfi_delta_rules_.end(),
+                   RuleAddressLess<LazyDeltaRules::value_type>);
+  LazyDeltaRules::iterator kept = lazy_cfi_delta_rules_.begin();
+  for (LazyDeltaRules::iterator rule = lazy_cfi_delta_rules_.begin();
+       rule != lazy_cfi_delta_rules_.end(); ++rule) {
+    LazyDeltaRules::iterator next = rule + 1;
+    if (next != lazy_cfi_delta_rules_.end() && next->first == rule->first)
+      continue;
+    *kept++ = *rule;
+  }
+  lazy_cfi_delta_rules_.erase(kept, lazy_cfi_delta_rules_.end());
+  // Give back the slack left by push_back.
+  LazyDeltaRules(lazy_cfi_delta_rules_).swap(lazy_cfi_delta_rules_);
+}
+
 void BasicSourceLineResolver::Module::LookupAddress(StackFrame *frame) const {
+  AutoMutexLock lock(&lookup_mutex_);
   MemAddr address = frame->instruction - frame->module->base_address();
 
   // First, look for a FUNC record that covers address. Use
@@ -163,6 +255,7 @@ void BasicSourceLineResolver::Module::LookupAddress(StackFrame *frame) const {
   if (functions_.RetrieveNearestRange(address, &func,
                                       &function_base, &function_size) &&
       address >= function_base && address - function_base < function_size) {
+    MaterializeFunction(func.get());
     frame->function_name = func->name;
     frame->function_base = frame->module->base_address() + function_base;
 
@@ -186,6 +279,7 @@ void BasicSourceLineResolver::Module::LookupAddress(StackFrame *frame) const {
 
 WindowsFrameInfo *BasicSourceLineResolver::Module::FindWindowsFrameInfo(
     const StackFrame *frame) const {
+  AutoMutexLock lock(&lookup_mutex_);
   MemAddr address = frame->instruction - frame->module->base_address();
   scoped_ptr<WindowsFrameInfo> result(new WindowsFrameInfo());
 
@@ -235,91 +329,158 @@ WindowsFrameInfo *BasicSourceLineResolver::Module::FindWindowsFrameInfo(
 
 CFIFrameInfo *BasicSourceLineResolver::Module::FindCFIFrameInfo(
     const StackFrame *frame) const {
+  AutoMutexLock lock(&lookup_mutex_);
   MemAddr address = frame->instruction - frame->module->base_address();
-  MemAddr initial_base, initial_size;
-  string initial_rules;
-
-  // Find the initial rule whose range covers this address. That
-  // provides an initial set of register recovery rules. Then, walk
-  // forward from the initial rule's starting address to frame's
-  // instruction address, applying delta rules.
-  if (!cfi_initial_rules_.RetrieveRange(address, &initial_rules,
-                                        &initial_base, &initial_size)) {
+  MemAddr initial_base, rules_base;
+  if (!FindCFIRules(address, &initial_base, &rules_base))
     return NULL;
+
+  // Every address from rules_base up to the next delta rule gets the same
+  // set of rules, so put them together only once, and hand out instances
+  // that share them.
+  std::pair<MemAddr, MemAddr> key(initial_base, rules_base);
+  CFIFrameInfoCache::const_iterator cached = cfi_frame_info_cache_.find(key);
+  if (cached == cfi_frame_info_cache_.end()) {
+    if (cfi_frame_info_cache_.size() >= kMaxCachedCFIFrameInfos)
+      return BuildCFIFrameInfo(initial_base, rules_base);
+    cached = cfi_frame_info_cache_.insert(
+        std::make_pair(key, linked_ptr<CFIFrameInfo>(
+            BuildCFIFrameInfo(initial_base, rules_base)))).first;
   }
 
-  // Create a frame info structure, and populate it with the rules from
-  // the STACK CFI INIT record.
-  scoped_ptr<CFIFrameInfo> rules(new CFIFrameInfo());
-  if (!ParseCFIRuleSet(initial_rules, rules.get()))
-    return NULL;
+  const CFIFrameInfo *rules = cached->second.get();
+  return rules ? new CFIFrameInfo(rules) : NULL;
+}
 
-  // Find the first delta rule that falls within the initial rule's range.
-  map<MemAddr, string>::const_iterator delta =
-    cfi_delta_rules_.lower_bound(initial_base);
+bool BasicSourceLineResolver::Module::FindCFIRules(MemAddr address,
+                                                   MemAddr *initial_base,
+                                                   MemAddr *rules_base) const {
+  // Find the initial rule whose range covers this address, then the last
+  // delta rule at or before the address within that range, if any.
+  MemAddr initial_size;
+  if (lazy_) {
+    TextRange initial_rules;
+    if (!lazy_cfi_initial_rules_.RetrieveRange(address, &initial_rules,
+                                               initial_base, &initial_size))
+      return false;
+    LazyDeltaRules::const_iterator delta =
+      std::upper_bound(lazy_cfi_delta_rules_.begin(),
+                       lazy_cfi_delta_rules_.end(),
+                       std::make_pair(address, TextRange()),
+                       RuleAddressLess<LazyDeltaRules::value_type>);
+    *rules_base = *initial_base;
+    if (delta != lazy_cfi_delta_rules_.begin() &&
+        (--delta)->first >= *initial_base)
+      *rules_base = delta->first;
+  } else {
+    string initial_rules;
+    if (!cfi_initial_rules_.RetrieveRange(address, &initial_rules,
+                                          initial_base, &initial_size))
+      return false;
+    map<MemAddr, string>::const_iterator delta =
+      cfi_delta_rules_.upper_bound(address);
+    *rules_base = *initial_base;
+    if (delta != cfi_delta_rules_.begin() &&
+        (--delta)->first >= *initial_base)
+      *rules_base = delta->first;
+  }
+  return true;
+}
 
-  // Apply delta rules up to and including the frame's address.
-  while (delta != cfi_delta_rules_.end() && delta->first <= address) {
-    ParseCFIRuleSet(delta->second, rules.get());
-    delta++;
+CFIFrameInfo *BasicSourceLineResolver::Module::BuildCFIFrameInfo(
+    MemAddr initial_base, MemAddr rules_base) const {
+  // Create a frame info structure, and populate it with the rules from
+  // the STACK CFI INIT record. Then, walk forward from the initial rule's
+  // starting address, applying delta rules up to and including the one
+  // at rules_base.
+  scoped_ptr<CFIFrameInfo> rules(new CFIFrameInfo());
+  if (lazy_) {
+    TextRange initial_rules;
+    lazy_cfi_initial_rules_.RetrieveRange(initial_base, &initial_rules,
+                                          NULL, NULL);
+    if (!ParseCFIRuleSet(string(initial_rules.first, initial_rules.second),
+                         rules.get()))
+      return NULL;
+
+    LazyDeltaRules::const_iterator delta =
+      std::lower_bound(lazy_cfi_delta_rules_.begin(),
+                       lazy_cfi_delta_rules_.end(),
+                       std::make_pair(initial_base, TextRange()),
+                       RuleAddressLess<LazyDeltaRules::value_type>);
+    while (delta != lazy_cfi_delta_rules_.end() && delta->first <= rules_base) {
+      ParseCFIRuleSet(string(delta->second.first, delta->second.second),
+                      rules.get());
+      delta++;
+    }
+  } else {
+    string initial_rules;
+    cfi_initial_rules_.RetrieveRange(initial_base, &initial_rules, NULL, NULL);
+    if (!ParseCFIRuleSet(initial_rules, rules.get()))
+      return NULL;
+
+    map<MemAddr, string>::const_iterator delta =
+      cfi_delta_rules_.lower_bound(initial_base);
+    while (delta != cfi_delta_rules_.end() && delta->first <= rules_base) {
+      ParseCFIRuleSet(delta->second, rules.get());
+      delta++;
+    }
   }
 
   return rules.release();
 }
 
-bool BasicSourceLineResolver::Module::ParseFile(char *file_line) {
+bool BasicSourceLineResolver::Module::ParseFile(const char *begin,
+                                                const char *end) {
   // FILE <id> <filename>
-  file_line += 5;  // skip prefix
+  TokenScanner scanner(begin + 5, end);  // skip prefix
 
-  vector<char*> tokens;
-  if (!Tokenize(file_line, kWhitespace, 2, &tokens)) {
+  const char *token_begins[2], *token_ends[2];
+  if (!scanner.Tokenize(1, token_begins, token_ends)) {
     return false;
   }
 
-  int index = atoi(tokens[0]);
+  int index = ParseLong(token_begins[0], token_ends[0], 10);
   if (index < 0) {
     return false;
   }
 
-  char *filename = tokens[1];
-  if (!filename) {
-    return false;
-  }
-
-  files_.insert(make_pair(index, string(filename)));
+  files_.insert(make_pair(index, string(token_begins[1], token_ends[1])));
   return true;
 }
 
 BasicSourceLineResolver::Function*
-BasicSourceLineResolver::Module::ParseFunction(char *function_line) {
+BasicSourceLineResolver::Module::ParseFunction(const char *begin,
+                                               const char *end) {
   // FUNC <address> <size> <stack_param_size> <name>
-  function_line += 5;  // skip prefix
+  TokenScanner scanner(begin + 5, end);  // skip prefix
 
-  vector<char*> tokens;
-  if (!Tokenize(function_line, kWhitespace, 4, &tokens)) {
+  const char *token_begins[4], *token_ends[4];
+  if (!scanner.Tokenize(3, token_begins, token_ends)) {
     return NULL;
   }
 
-  u_int64_t address    = strtoull(tokens[0], NULL, 16);
-  u_int64_t size       = strtoull(tokens[1], NULL, 16);
-  int stack_param_size = strtoull(tokens[2], NULL, 16);
-  char *name           = tokens[3];
+  u_int64_t address    = ParseHex(token_begins[0], token_ends[0]);
+  u_int64_t size       = ParseHex(token_begins[1], token_ends[1]);
+  int stack_param_size = ParseHex(token_begins[2], token_ends[2]);
+  string name(token_begins[3], token_ends[3]);
 
   return new Function(name, address, size, stack_param_size);
 }
 
 BasicSourceLineResolver::Line* BasicSourceLineResolver::Module::ParseLine(
-    char *line_line) {
+    const char *begin, const char *end) {
   // <address> <line number> <source file id>
-  vector<char*> tokens;
-  if (!Tokenize(line_line, kWhitespace, 4, &tokens)) {
+  TokenScanner scanner(begin, end);
+
+  const char *token_begins[4], *token_ends[4];
+  if (!scanner.Tokenize(3, token_begins, token_ends)) {
     return NULL;
   }
 
-  u_int64_t address = strtoull(tokens[0], NULL, 16);
-  u_int64_t size    = strtoull(tokens[1], NULL, 16);
-  int line_number   = atoi(tokens[2]);
-  int source_file   = atoi(tokens[3]);
+  u_int64_t address = ParseHex(token_begins[0], token_ends[0]);
+  u_int64_t size    = ParseHex(token_begins[1], token_ends[1]);
+  int line_number   = ParseLong(token_begins[2], token_ends[2], 10);
+  int source_file   = ParseLong(token_begins[3], token_ends[3], 10);
   if (line_number <= 0) {
     return NULL;
   }
@@ -327,20 +488,20 @@ BasicSourceLineResolver::Line* BasicSourceLineResolver::Module::ParseLine(
   return new Line(address, size, source_file, line_number);
 }
 
-bool BasicSourceLineResolver::Module::ParsePublicSymbol(char *public_line) {
+bool BasicSourceLineResolver::Module::ParsePublicSymbol(const char *begin,
+                                                        const char *end) {
   // PUBLIC <address> <stack_param_size> <name>
 
   // Skip "PUBLIC " prefix.
-  public_line += 7;
+  TokenScanner scanner(begin + 7, end);
 
-  vector<char*> tokens;
-  if (!Tokenize(public_line, kWhitespace, 3, &tokens)) {
+  const char *token_begins[3], *token_ends[3];
+  if (!scanner.Tokenize(2, token_begins, token_ends)) {
     return false;
   }
 
-  u_int64_t address    = strtoull(tokens[0], NULL, 16);
-  int stack_param_size = strtoull(tokens[1], NULL, 16);
-  char *name           = tokens[2];
+  u_int64_t address    = ParseHex(token_begins[0], token_ends[0]);
+  int stack_param_size = ParseHex(token_begins[1], token_ends[1]);
 
   // A few public symbols show up with an address of 0.  This has been seen
   // in the dumped output of ntdll.pdb for symbols such as _CIlog, _CIpow,
@@ -352,99 +513,145 @@ bool BasicSourceLineResolver::Module::ParsePublicSymbol(char *public_line) {
     return true;
   }
 
-  linked_ptr<PublicSymbol> symbol(new PublicSymbol(name, address,
-                                                   stack_param_size));
+  linked_ptr<PublicSymbol> symbol(
+      new PublicSymbol(string(token_begins[2], token_ends[2]), address,
+                       stack_param_size));
   return public_symbols_.Store(address, symbol);
 }
 
-bool BasicSourceLineResolver::Module::ParseStackInfo(char *stack_info_line) {
+bool BasicSourceLineResolver::Module::ParseStackInfo(const char *begin,
+                                                     const char *end) {
   // Skip "STACK " prefix.
-  stack_info_line += 6;
+  TokenScanner scanner(begin + 6, end);
 
   // Find the token indicating what sort of stack frame walking
   // information this is.
-  while (*stack_info_line == ' ')
-    stack_info_line++;
-  const char *platform = stack_info_line;
-  while (!strchr(kWhitespace, *stack_info_line))
-    stack_info_line++;
-  *stack_info_line++ = '\0';
+  const char *platform_begin, *platform_end;
+  const char *rest_begin, *rest_end;
+  if (!scanner.NextToken(&platform_begin, &platform_end))
+    return false;
+  if (!scanner.Rest(&rest_begin, &rest_end))
+    rest_begin = rest_end = end;
+  size_t platform_length = platform_end - platform_begin;
 
   // MSVC stack frame info.
-  if (strcmp(platform, "WIN") == 0) {
-    int type = 0;
-    u_int64_t rva, code_size;
-    linked_ptr<WindowsFrameInfo>
-      stack_frame_info(WindowsFrameInfo::ParseFromString(stack_info_line,
-                                                         type,
-                                                         rva,
-                                                         code_size));
-    if (stack_frame_info == NULL)
-      return false;
-
-    // TODO(mmentovai): I wanted to use StoreRange's return value as this
-    // method's return value, but MSVC infrequently outputs stack info that
-    // violates the containment rules.  This happens with a section of code
-    // in strncpy_s in test_app.cc (testdata/minidump2).  There, problem looks
-    // like this:
-    //   STACK WIN 4 4242 1a a 0 ...  (STACK WIN 4 base size prolog 0 ...)
-    //   STACK WIN 4 4243 2e 9 0 ...
-    // ContainedRangeMap treats these two blocks as conflicting.  In reality,
-    // when the prolog lengths are taken into account, the actual code of
-    // these blocks doesn't conflict.  However, we can't take the prolog lengths
-    // into account directly here because we'd wind up with a different set
-    // of range conflicts when MSVC outputs stack info like this:
-    //   STACK WIN 4 1040 73 33 0 ...
-    //   STACK WIN 4 105a 59 19 0 ...
-    // because in both of these entries, the beginning of the code after the
-    // prolog is at 0x1073, and the last byte of contained code is at 0x10b2.
-    // Perhaps we could get away with storing ranges by rva + prolog_size
-    // if ContainedRangeMap were modified to allow replacement of
-    // already-stored values.
-
-    windows_frame_info_[type].StoreRange(rva, code_size, stack_frame_info);
-    return true;
-  } else if (strcmp(platform, "CFI") == 0) {
+  if (platform_length == 3 && strncmp(platform_begin, "WIN", 3) == 0) {
+    return ParseWindowsFrameInfo(rest_begin, rest_end);
+  } else if (platform_length == 3 && strncmp(platform_begin, "CFI", 3) == 0) {
     // DWARF CFI stack frame info
-    return ParseCFIFrameInfo(stack_info_line);
+    return ParseCFIFrameInfo(rest_begin, rest_end);
   } else {
     // Something unrecognized.
     return false;
   }
 }
 
-bool BasicSourceLineResolver::Module::ParseCFIFrameInfo(
-    char *stack_info_line) {
-  char *cursor;
+bool BasicSourceLineResolver::Module::ParseWindowsFrameInfo(const char *begin,
+                                                            const char *end) {
+  // This follows WindowsFrameInfo::ParseFromString, which the format of a
+  // STACK WIN record is documented alongside.
+  TokenScanner scanner(begin, end);
+  const char *token_begins[11], *token_ends[11];
+  if (!scanner.Tokenize(10, token_begins, token_ends))
+    return false;
 
-  // Is this an INIT record or a delta record?
-  char *init_or_address = strtok_r(stack_info_line, " \r\n", &cursor);
-  if (!init_or_address)
+  int type = ParseLong(token_begins[0], token_ends[0], 16);
+  if (type < 0 || type > WindowsFrameInfo::STACK_INFO_LAST - 1)
     return false;
 
-  if (strcmp(init_or_address, "INIT") == 0) {
-    // This record has the form "STACK INIT <address> <size> <rules...>".
-    char *address_field = strtok_r(NULL, " \r\n", &cursor);
-    if (!address_field) return false;
+  u_int64_t rva                 = ParseHex(token_begins[1], token_ends[1]);
+  u_int64_t code_size           = ParseHex(token_begins[2], token_ends[2]);
+  u_int32_t prolog_size         = ParseHex(token_begins[3], token_ends[3]);
+  u_int32_t epilog_size         = ParseHex(token_begins[4], token_ends[4]);
+  u_int32_t parameter_size      = ParseHex(token_begins[5], token_ends[5]);
+  u_int32_t saved_register_size = ParseHex(token_begins[6], token_ends[6]);
+  u_int32_t local_size          = ParseHex(token_begins[7], token_ends[7]);
+  u_int32_t max_stack_size      = ParseHex(token_begins[8], token_ends[8]);
+  int has_program_string        = ParseHex(token_begins[9], token_ends[9]);
+
+  string program_string;
+  int allocates_base_pointer = 0;
+  if (has_program_string) {
+    program_string.assign(token_begins[10], token_ends[10]);
+  } else {
+    allocates_base_pointer = ParseHex(token_begins[10], token_ends[10]);
+  }
+
+  linked_ptr<WindowsFrameInfo> stack_frame_info(
+      new WindowsFrameInfo(
+          static_cast<WindowsFrameInfo::StackInfoTypes>(type),
+          prolog_size,
+          epilog_size,
+          parameter_size,
+          saved_register_size,
+          local_size,
+          max_stack_size,
+          allocates_base_pointer,
+          program_string));
+
+  // TODO(mmentovai): I wanted to use StoreRange's return value as this
+  // method's return value, but MSVC infrequently outputs stack info that
+  // violates the containment rules.  This happens with a section of code
+  // in strncpy_s in test_app.cc (testdata/minidump2).  There, problem looks
+  // like this:
+  //   STACK WIN 4 4242 1a a 0 ...  (STACK WIN 4 base size prolog 0 ...)
+  //   STACK WIN 4 4243 2e 9 0 ...
+  // ContainedRangeMap treats these two blocks as conflicting.  In reality,
+  // when the prolog lengths are taken into account, the actual code of
+  // these blocks doesn't conflict.  However, we can't take the prolog lengths
+  // into account directly here because we'd wind up with a different set
+  // of range conflicts when MSVC outputs stack info like this:
+  //   STACK WIN 4 1040 73 33 0 ...
+  //   STACK WIN 4 105a 59 19 0 ...
+  // because in both of these entries, the beginning of the code after the
+  // prolog is at 0x1073, and the last byte of contained code is at 0x10b2.
+  // Perhaps we could get away with storing ranges by rva + prolog_size
+  // if ContainedRangeMap were modified to allow replacement of
+  // already-stored values.
+
+  windows_frame_info_[type].StoreRange(rva, code_size, stack_frame_info);
+  return true;
+}
 
-    char *size_field = strtok_r(NULL, " \r\n", &cursor);
-    if (!size_field) return false;
+bool BasicSourceLineResolver::Module::ParseCFIFrameInfo(const char *begin,
+                                                        const char *end) {
+  TokenScanner scanner(begin, end);
 
-    char *initial_rules = strtok_r(NULL, "\r\n", &cursor);
-    if (!initial_rules) return false;
+  // Is this an INIT record or a delta record?
+  const char *init_or_address_begin, *init_or_address_end;
+  if (!scanner.NextToken(&init_or_address_begin, &init_or_address_end))
+    return false;
 
-    MemAddr address = strtoul(address_field, NULL, 16);
-    MemAddr size    = strtoul(size_field,    NULL, 16);
-    cfi_initial_rules_.StoreRange(address, size, initial_rules);
+  if (init_or_address_end - init_or_address_begin == 4 &&
+      strncmp(init_or_address_begin, "INIT", 4) == 0) {
+    // This record has the form "STACK INIT <address> <size> <rules...>".
+    const char *token_begins[3], *token_ends[3];
+    if (!scanner.Tokenize(2, token_begins, token_ends))
+      return false;
+
+    MemAddr address = ParseHex(token_begins[0], token_ends[0]);
+    MemAddr size    = ParseHex(token_begins[1], token_ends[1]);
+    if (lazy_) {
+      lazy_cfi_initial_rules_.StoreRange(
+          address, size, TextRange(token_begins[2], token_ends[2]));
+    } else {
+      cfi_initial_rules_.StoreRange(address, size,
+                                    string(token_begins[2], token_ends[2]));
+    }
     return true;
   }
 
   // This record has the form "STACK <address> <rules...>".
-  char *address_field = init_or_address;
-  char *delta_rules = strtok_r(NULL, "\r\n", &cursor);
-  if (!delta_rules) return false;
-  MemAddr address = strtoul(address_field, NULL, 16);
-  cfi_delta_rules_[address] = delta_rules;
+  const char *delta_rules_begin, *delta_rules_end;
+  if (!scanner.Rest(&delta_rules_begin, &delta_rules_end))
+    return false;
+  MemAddr address = ParseHex(init_or_address_begin, init_or_address_end);
+  if (lazy_) {
+    lazy_cfi_delta_rules_.push_back(
+        std::make_pair(address, TextRange(delta_rules_begin, delta_rules_end)));
+  } else {
+    cfi_delta_rules_[address].assign(delta_rules_begin, delta_rules_end);
+  }
   return true;
 }
 
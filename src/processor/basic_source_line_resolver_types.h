@@ -39,6 +39,8 @@
 
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "google_breakpad/processor/basic_source_line_resolver.h"
 #include "processor/source_line_resolver_base_types.h"
@@ -48,6 +50,7 @@
 #include "processor/contained_range_map-inl.h"
 
 #include "processor/linked_ptr.h"
+#include "processor/mutex.h"
 #include "processor/scoped_ptr.h"
 #include "google_breakpad/processor/stack_frame.h"
 #include "processor/cfi_frame_info.h"
@@ -64,8 +67,18 @@ BasicSourceLineResolver::Function : public SourceLineResolverBase::Function {
                                           function_address,
                                           code_size,
                                           set_parameter_size),
-                                     lines() { }
+                                     lines(),
+                                     unparsed_begin(NULL),
+                                     unparsed_end(NULL) { }
   RangeMap< MemAddr, linked_ptr<Line> > lines;
+
+  // In a lazily loaded module, a function's FUNC record and the line
+  // records following it stay unparsed in the symbol file until a lookup
+  // first lands in the function: until then, [unparsed_begin, unparsed_end)
+  // spans those records, name is empty and lines is empty.  Both are NULL
+  // once the function has been parsed.
+  const char *unparsed_begin;
+  const char *unparsed_end;
  private:
   typedef SourceLineResolverBase::Function Base;
 };
@@ -73,11 +86,16 @@ BasicSourceLineResolver::Function : public SourceLineResolverBase::Function {
 
 class BasicSourceLineResolver::Module : public SourceLineResolverBase::Module {
  public:
-  explicit Module(const string &name) : name_(name) { }
+  // If lazy is true, LoadMapFromMemory only indexes the FUNC and STACK CFI
+  // records, leaving them to be parsed when a lookup needs them; see
+  // BasicSourceLineResolver's constructor.
+  explicit Module(const string &name, bool lazy = false)
+      : name_(name), lazy_(lazy), symbol_data_(NULL) { }
   virtual ~Module() { }
 
   // Loads a map from the given buffer in char* type.
-  // Does NOT have ownership of memory_buffer.
+  // Does NOT have ownership of memory_buffer, and does not modify it.  A
+  // lazily loaded module refers to memory_buffer for as long as it lives.
   virtual bool LoadMapFromMemory(char *memory_buffer);
 
   // Looks up the given relative address, and fills the StackFrame struct
@@ -94,7 +112,8 @@ class BasicSourceLineResolver::Module : public SourceLineResolverBase::Module {
   // If CFI stack walking information is available covering ADDRESS,
   // return a CFIFrameInfo structure describing it. If the information
   // is not available, return NULL. The caller takes ownership of any
-  // returned CFIFrameInfo object.
+  // returned CFIFrameInfo object, which shares rules cached in the module
+  // and so must not outlive it.
   virtual CFIFrameInfo *FindCFIFrameInfo(const StackFrame *frame) const;
 
  private:
@@ -105,25 +124,63 @@ class BasicSourceLineResolver::Module : public SourceLineResolverBase::Module {
 
   typedef std::map<int, string> FileMap;
 
+  // A span of the symbol file, used by lazily loaded modules to refer to
+  // the rules of a STACK CFI record without copying them.
+  typedef std::pair<const char*, const char*> TextRange;
+  typedef std::vector< std::pair<MemAddr, TextRange> > LazyDeltaRules;
+
+  // Each of the following parses the record held in [begin, end), a
+  // single line of the symbol file without its line terminator.  None of
+  // them modify the symbol file.
+
   // Parses a file declaration
-  bool ParseFile(char *file_line);
+  bool ParseFile(const char *begin, const char *end);
 
   // Parses a function declaration, returning a new Function object.
-  Function* ParseFunction(char *function_line);
+  static Function* ParseFunction(const char *begin, const char *end);
 
   // Parses a line declaration, returning a new Line object.
-  Line* ParseLine(char *line_line);
+  static Line* ParseLine(const char *begin, const char *end);
+
+  // Parses the unparsed records of a lazily loaded function, if any,
+  // filling in its name and lines.  Line records that fail to parse are
+  // logged and skipped.
+  static void MaterializeFunction(Function *function);
 
   // Parses a PUBLIC symbol declaration, storing it in public_symbols_.
   // Returns false if an error occurs.
-  bool ParsePublicSymbol(char *public_line);
+  bool ParsePublicSymbol(const char *begin, const char *end);
 
   // Parses a STACK WIN or STACK CFI frame info declaration, storing
   // it in the appropriate table.
-  bool ParseStackInfo(char *stack_info_line);
-
-  // Parses a STACK CFI record, storing it in cfi_frame_info_.
-  bool ParseCFIFrameInfo(char *stack_info_line);
+  bool ParseStackInfo(const char *begin, const char *end);
+
+  // Parses a STACK WIN record, less its "STACK WIN " prefix, storing it in
+  // windows_frame_info_.
+  bool ParseWindowsFrameInfo(const char *begin, const char *end);
+
+  // Parses a STACK CFI record, less its "STACK CFI " prefix, storing it in
+  // cfi_initial_rules_ or cfi_delta_rules_, or for a lazily loaded module,
+  // lazy_cfi_initial_rules_ or lazy_cfi_delta_rules_.
+  bool ParseCFIFrameInfo(const char *begin, const char *end);
+
+  // Finds the STACK CFI INIT record covering address, and the last delta
+  // record at or before address in its range, setting *initial_base and
+  // *rules_base to their addresses. If there is no such delta record,
+  // *rules_base is *initial_base. Returns false if no INIT record covers
+  // address.
+  bool FindCFIRules(MemAddr address, MemAddr *initial_base,
+                    MemAddr *rules_base) const;
+
+  // Returns a new CFIFrameInfo holding the rules of the STACK CFI INIT
+  // record at initial_base, with the delta records up to rules_base
+  // applied, or NULL if they don't parse.
+  CFIFrameInfo *BuildCFIFrameInfo(MemAddr initial_base,
+                                  MemAddr rules_base) const;
+
+  // Sorts lazy_cfi_delta_rules_ by address once loading is done, keeping
+  // only the last record for any address, as cfi_delta_rules_ would.
+  void SortLazyCFIDeltaRules();
 
   string name_;
   FileMap files_;
@@ -154,6 +211,35 @@ class BasicSourceLineResolver::Module : public SourceLineResolverBase::Module {
   // this map, or the end of the range as given by the cfi_initial_rules_
   // entry (which FindCFIFrameInfo looks up first).
   std::map<MemAddr, string> cfi_delta_rules_;
+
+  // Whether this module is loaded lazily, and if so, the symbol file it was
+  // loaded from, which the unparsed records point into.
+  bool lazy_;
+  const char *symbol_data_;
+
+  // A lazily loaded module's STACK CFI records, in place of
+  // cfi_initial_rules_ and cfi_delta_rules_.  The delta rules are kept in a
+  // vector sorted by address, which is far more compact than a map.
+  RangeMap<MemAddr, TextRange> lazy_cfi_initial_rules_;
+  LazyDeltaRules lazy_cfi_delta_rules_;
+
+  // The rule sets FindCFIFrameInfo has built, keyed by the FindCFIRules
+  // results they were built for; NULL where the rules didn't parse.  Stack
+  // walks keep coming back to the same functions, for example on every
+  // thread waiting in the same place.  The CFIFrameInfo objects
+  // FindCFIFrameInfo returns apply these rule sets without copying them,
+  // so entries are never removed.  Once there are kMaxCachedCFIFrameInfos
+  // of them, other rule sets are built afresh for every lookup.
+  typedef std::map<std::pair<MemAddr, MemAddr>, linked_ptr<CFIFrameInfo> >
+      CFIFrameInfoCache;
+  static const size_t kMaxCachedCFIFrameInfos = 4096;
+  mutable CFIFrameInfoCache cfi_frame_info_cache_;
+
+  // Held by LookupAddress, FindWindowsFrameInfo and FindCFIFrameInfo,
+  // which may be called from several threads at once.  They change
+  // cfi_frame_info_cache_ and lazily parsed functions, and even otherwise
+  // copy the linked_ptrs the maps above hold, which changes them.
+  mutable Mutex lookup_mutex_;
 };
 
 }  // namespace google_breakpad
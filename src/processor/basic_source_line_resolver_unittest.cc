@@ -28,6 +28,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdio.h>
+#include <string.h>
 
 #include <string>
 
@@ -403,6 +404,185 @@ TEST_F(TestBasicSourceLineResolver, TestUnload)
   ASSERT_TRUE(resolver.HasModule(&module1));
 }
 
+// Symbol data from other tools and platforms comes with CRLF line endings,
+// blank lines, "0x" prefixes and no trailing newline; make sure it loads
+// the same way it always has, and that the buffer isn't modified.
+TEST_F(TestBasicSourceLineResolver, TestLoadFromMemory)
+{
+  const char kSymbols[] =
+      "MODULE Linux x86 D3096ED481217FD4C16B29CD9BC208BA0 module\r\n"
+      "FILE 1  leading space.cc\r\n"
+      "\r\n"
+      "FUNC 0x1000 100 4 Function With Spaces(int, char)\r\n"
+      "1000 10 42 1\r\n"
+      "1010 f0 43 1\n\n"
+      "PUBLIC 2000 8 Public Symbol\n"
+      "STACK CFI INIT 3000 20 .cfa: $esp 4 + .ra: .cfa 4 - ^\n"
+      "STACK CFI 3010 .cfa: $esp 8 +";
+  string original(kSymbols);
+  char buffer[sizeof(kSymbols)];
+  memcpy(buffer, kSymbols, sizeof(kSymbols));
+
+  TestCodeModule module("module");
+  ASSERT_TRUE(resolver.LoadModuleUsingMemoryBuffer(&module, buffer));
+  ASSERT_EQ(original, buffer);
+
+  StackFrame frame;
+  frame.module = &module;
+  frame.instruction = 0x1014;
+  resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ(frame.function_name, "Function With Spaces(int, char)");
+  ASSERT_EQ(frame.function_base, 0x1000U);
+  ASSERT_EQ(frame.source_file_name, " leading space.cc");
+  ASSERT_EQ(frame.source_line, 43);
+  ASSERT_EQ(frame.source_line_base, 0x1010U);
+
+  ClearSourceLineInfo(&frame);
+  frame.module = &module;
+  frame.instruction = 0x2004;
+  resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ(frame.function_name, "Public Symbol");
+  ASSERT_EQ(frame.function_base, 0x2000U);
+
+  scoped_ptr<CFIFrameInfo> cfi_frame_info;
+  frame.instruction = 0x3008;
+  cfi_frame_info.reset(resolver.FindCFIFrameInfo(&frame));
+  ASSERT_TRUE(cfi_frame_info.get());
+  ASSERT_EQ(cfi_frame_info->Serialize(), ".cfa: $esp 4 + .ra: .cfa 4 - ^");
+  frame.instruction = 0x3018;
+  cfi_frame_info.reset(resolver.FindCFIFrameInfo(&frame));
+  ASSERT_TRUE(cfi_frame_info.get());
+  ASSERT_EQ(cfi_frame_info->Serialize(), ".cfa: $esp 8 + .ra: .cfa 4 - ^");
+}
+
+// A lazily loaded module should answer every lookup exactly as a fully
+// parsed one does.
+TEST_F(TestBasicSourceLineResolver, TestLazyLoad)
+{
+  BasicSourceLineResolver lazy_resolver(true);
+  ASSERT_FALSE(lazy_resolver.ShouldDeleteMemoryBufferAfterLoadModule());
+
+  TestCodeModule module1("module1");
+  TestCodeModule module2("module2");
+  ASSERT_TRUE(resolver.LoadModule(&module1, testdata_dir + "/module1.out"));
+  ASSERT_TRUE(resolver.LoadModule(&module2, testdata_dir + "/module2.out"));
+  ASSERT_TRUE(lazy_resolver.LoadModule(&module1,
+                                       testdata_dir + "/module1.out"));
+  ASSERT_TRUE(lazy_resolver.LoadModule(&module2,
+                                       testdata_dir + "/module2.out"));
+
+  const CodeModule *modules[] = { &module1, &module2 };
+  for (size_t i = 0; i < sizeof(modules) / sizeof(modules[0]); ++i) {
+    for (u_int64_t address = 0; address < 0x4000; ++address) {
+      StackFrame frame, lazy_frame;
+      frame.instruction = lazy_frame.instruction = address;
+      frame.module = lazy_frame.module = modules[i];
+      resolver.FillSourceLineInfo(&frame);
+      lazy_resolver.FillSourceLineInfo(&lazy_frame);
+      ASSERT_EQ(frame.function_name, lazy_frame.function_name) << address;
+      ASSERT_EQ(frame.function_base, lazy_frame.function_base) << address;
+      ASSERT_EQ(frame.source_file_name, lazy_frame.source_file_name);
+      ASSERT_EQ(frame.source_line, lazy_frame.source_line) << address;
+      ASSERT_EQ(frame.source_line_base, lazy_frame.source_line_base);
+
+      scoped_ptr<WindowsFrameInfo> windows_frame_info(
+          resolver.FindWindowsFrameInfo(&frame));
+      scoped_ptr<WindowsFrameInfo> lazy_windows_frame_info(
+          lazy_resolver.FindWindowsFrameInfo(&lazy_frame));
+      ASSERT_EQ(windows_frame_info.get() == NULL,
+                lazy_windows_frame_info.get() == NULL) << address;
+      if (windows_frame_info.get()) {
+        ASSERT_EQ(windows_frame_info->parameter_size,
+                  lazy_windows_frame_info->parameter_size);
+        ASSERT_EQ(windows_frame_info->program_string,
+                  lazy_windows_frame_info->program_string);
+      }
+
+      scoped_ptr<CFIFrameInfo> cfi_frame_info(
+          resolver.FindCFIFrameInfo(&frame));
+      scoped_ptr<CFIFrameInfo> lazy_cfi_frame_info(
+          lazy_resolver.FindCFIFrameInfo(&lazy_frame));
+      ASSERT_EQ(cfi_frame_info.get() == NULL,
+                lazy_cfi_frame_info.get() == NULL) << address;
+      if (cfi_frame_info.get()) {
+        ASSERT_EQ(cfi_frame_info->Serialize(),
+                  lazy_cfi_frame_info->Serialize()) << address;
+      }
+    }
+  }
+
+  // Malformed line records only come to light when their function is
+  // first looked up, and are skipped rather than failing the load.
+  const char kSymbols[] =
+      "FILE 1 file.cc\n"
+      "FUNC 1000 20 0 Function\n"
+      "1000 10 42 1\n"
+      "1010 10 -1 1\n"
+      "STACK CFI INIT 1000 20 .cfa: $esp 4 + .ra: .cfa 4 - ^\n"
+      "STACK CFI 1010 .cfa: $esp 12 +\n"
+      "STACK CFI 1010 .cfa: $esp 8 +\n";
+  char *buffer = new char[sizeof(kSymbols)];
+  memcpy(buffer, kSymbols, sizeof(kSymbols));
+  TestCodeModule module("module");
+  ASSERT_TRUE(lazy_resolver.LoadModuleUsingMemoryBuffer(&module, buffer));
+
+  StackFrame frame;
+  frame.module = &module;
+  frame.instruction = 0x1004;
+  lazy_resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ(frame.function_name, "Function");
+  ASSERT_EQ(frame.source_line, 42);
+  ClearSourceLineInfo(&frame);
+  frame.module = &module;
+  frame.instruction = 0x1014;
+  lazy_resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ(frame.function_name, "Function");
+  ASSERT_EQ(frame.source_line, 0);
+
+  // As when fully parsed, the last of several delta records for the same
+  // address wins.
+  scoped_ptr<CFIFrameInfo> cfi_frame_info(
+      lazy_resolver.FindCFIFrameInfo(&frame));
+  ASSERT_TRUE(cfi_frame_info.get());
+  ASSERT_EQ(cfi_frame_info->Serialize(), ".cfa: $esp 8 + .ra: .cfa 4 - ^");
+
+  // The resolver owns the buffer now.
+  lazy_resolver.UnloadModule(&module);
+  ASSERT_FALSE(lazy_resolver.HasModule(&module));
+}
+
+// Modules only cache so many CFI rule sets; rule sets beyond that should
+// still be found, and stay correct however often they are looked up.
+TEST_F(TestBasicSourceLineResolver, TestManyCFIRuleSets)
+{
+  const int kRuleSets = 5000;
+  string symbols;
+  for (int i = 0; i < kRuleSets; ++i) {
+    char record[100];
+    snprintf(record, sizeof(record),
+             "STACK CFI INIT %x 10 .cfa: $esp %d + .ra: .cfa 4 - ^\n",
+             i * 0x10, i);
+    symbols += record;
+  }
+
+  TestCodeModule module("module");
+  ASSERT_TRUE(resolver.LoadModuleUsingMapBuffer(&module, symbols));
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < kRuleSets; ++i) {
+      StackFrame frame;
+      frame.module = &module;
+      frame.instruction = i * 0x10 + pass;
+      scoped_ptr<CFIFrameInfo> cfi_frame_info(
+          resolver.FindCFIFrameInfo(&frame));
+      ASSERT_TRUE(cfi_frame_info.get()) << i;
+      char expected[100];
+      snprintf(expected, sizeof(expected), ".cfa: $esp %d + .ra: .cfa 4 - ^",
+               i);
+      ASSERT_EQ(expected, cfi_frame_info->Serialize()) << i;
+    }
+  }
+}
+
 }  // namespace
 
 int main(int argc, char *argv[]) {
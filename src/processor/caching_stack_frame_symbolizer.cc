@@ -0,0 +1,173 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// caching_stack_frame_symbolizer.cc: A StackFrameSymbolizer backed by a
+// SharedModuleCache.
+//
+// See caching_stack_frame_symbolizer.h for documentation.
+
+#include "google_breakpad/processor/caching_stack_frame_symbolizer.h"
+
+#include <assert.h>
+
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "google_breakpad/processor/symbol_supplier.h"
+#include "processor/logging.h"
+#include "processor/mutex.h"
+
+namespace google_breakpad {
+
+CachingStackFrameSymbolizer::CachingStackFrameSymbolizer(
+    SymbolSupplier* supplier,
+    SharedModuleCache* cache) : StackFrameSymbolizer(supplier, NULL),
+                                cache_(cache) { }
+
+CachingStackFrameSymbolizer::~CachingStackFrameSymbolizer() {
+  ReleaseEntries();
+}
+
+StackFrameSymbolizer::SymbolizerResult
+CachingStackFrameSymbolizer::FillSourceLineInfo(const CodeModules* modules,
+                                                const SystemInfo* system_info,
+                                                StackFrame* frame) {
+  assert(frame);
+
+  if (!modules) return ERROR;
+  const CodeModule* module = modules->GetModuleForAddress(frame->instruction);
+  if (!module) return ERROR;
+  frame->module = module;
+
+  if (!cache_) return ERROR;
+
+  // If module is known to have missing symbol file, return.
+  if (HasNoSymbols(module)) return ERROR;
+
+  const SharedModuleCache::Entry* entry = EntryForFrame(frame);
+  if (!entry) {
+    AutoReadWriteLock lock(resolver_lock_, true);
+    const string code_file = module->code_file();
+
+    // Another thread may have dealt with this module while we waited.
+    if (HasNoSymbols(module)) return ERROR;
+
+    EntryMap::const_iterator iterator = entries_.find(code_file);
+    if (iterator != entries_.end()) {
+      entry = iterator->second;
+    } else {
+      // Another symbolizer may have loaded this module already.  If not,
+      // this one loads it, and any others that need it wait.
+      entry = cache_->AcquireOrBeginLoad(module);
+      if (!entry) {
+        if (!supplier_) {
+          cache_->AbandonLoad(module);
+          return ERROR;
+        }
+
+        string symbol_file;
+        char* symbol_data = NULL;
+        SymbolSupplier::SymbolResult symbol_result =
+            supplier_->GetCStringSymbolData(module, system_info,
+                                            &symbol_file, &symbol_data);
+        switch (symbol_result) {
+          case SymbolSupplier::FOUND:
+            entry = cache_->Insert(module, symbol_data);
+            supplier_->FreeSymbolData(module);
+            if (!entry) {
+              BPLOG(ERROR) << "Failed to load symbol file in cache.";
+              NoteNoSymbols(module);
+              return ERROR;
+            }
+            break;
+
+          case SymbolSupplier::NOT_FOUND:
+            cache_->AbandonLoad(module);
+            NoteNoSymbols(module);
+            return ERROR;
+
+          case SymbolSupplier::INTERRUPT:
+            cache_->AbandonLoad(module);
+            return INTERRUPT;
+
+          default:
+            cache_->AbandonLoad(module);
+            BPLOG(ERROR) << "Unknown SymbolResult enum: " << symbol_result;
+            return ERROR;
+        }
+      }
+      entries_.insert(make_pair(code_file, entry));
+    }
+  }
+
+  // The entry stays referenced until Reset, so it's safe to use unlocked.
+  entry->FillSourceLineInfo(frame);
+  return NO_ERROR;
+}
+
+WindowsFrameInfo* CachingStackFrameSymbolizer::FindWindowsFrameInfo(
+    const StackFrame* frame) {
+  const SharedModuleCache::Entry* entry = EntryForFrame(frame);
+  return entry ? entry->FindWindowsFrameInfo(frame) : NULL;
+}
+
+CFIFrameInfo* CachingStackFrameSymbolizer::FindCFIFrameInfo(
+    const StackFrame* frame) {
+  const SharedModuleCache::Entry* entry = EntryForFrame(frame);
+  return entry ? entry->FindCFIFrameInfo(frame) : NULL;
+}
+
+void CachingStackFrameSymbolizer::Reset() {
+  {
+    AutoReadWriteLock lock(resolver_lock_, true);
+    ReleaseEntries();
+  }
+  StackFrameSymbolizer::Reset();
+}
+
+const SharedModuleCache::Entry* CachingStackFrameSymbolizer::EntryForFrame(
+    const StackFrame* frame) {
+  if (!frame->module)
+    return NULL;
+
+  AutoReadWriteLock lock(resolver_lock_, false);
+  EntryMap::const_iterator iterator =
+      entries_.find(frame->module->code_file());
+  return iterator != entries_.end() ? iterator->second : NULL;
+}
+
+void CachingStackFrameSymbolizer::ReleaseEntries() {
+  for (EntryMap::const_iterator iterator = entries_.begin();
+       iterator != entries_.end(); ++iterator) {
+    cache_->Release(iterator->second);
+  }
+  entries_.clear();
+}
+
+}  // namespace google_breakpad
@@ -36,10 +36,32 @@
 #ifndef PROCESSOR_CFI_FRAME_INFO_INL_H_
 #define PROCESSOR_CFI_FRAME_INFO_INL_H_
 
+#include <assert.h>
 #include <string.h>
 
 namespace google_breakpad {
 
+template <typename RegisterType, class RawContextType>
+SimpleCFIWalker<RegisterType, RawContextType>::SimpleCFIWalker(
+    const RegisterSet *register_map, size_t map_size)
+    : register_map_(register_map), map_size_(map_size),
+      register_name_array_(RegisterNameArray(register_map, map_size)),
+      register_names_(&register_name_array_[0], register_name_array_.size()) {
+  assert(map_size <= kMaxRegisters);
+}
+
+template <typename RegisterType, class RawContextType>
+vector<const char *>
+SimpleCFIWalker<RegisterType, RawContextType>::RegisterNameArray(
+    const RegisterSet *register_map, size_t map_size) {
+  vector<const char *> names(map_size * 2);
+  for (size_t i = 0; i < map_size; i++) {
+    names[i] = register_map[i].name;
+    names[map_size + i] = register_map[i].alternate_name;
+  }
+  return names;
+}
+
 template <typename RegisterType, class RawContextType>
 bool SimpleCFIWalker<RegisterType, RawContextType>::FindCallerRegisters(
     const MemoryRegion &memory,
@@ -48,22 +70,28 @@ bool SimpleCFIWalker<RegisterType, RawContextType>::FindCallerRegisters(
     int callee_validity,
     RawContextType *caller_context,
     int *caller_validity) const {
-  typedef CFIFrameInfo::RegisterValueMap<RegisterType> ValueMap;
-  ValueMap callee_registers;
-  ValueMap caller_registers;
-  // Just for brevity.
-  typename ValueMap::const_iterator caller_none = caller_registers.end();
+  // Register values, indexed like register_name_array_: the registers'
+  // values under their names come first, then under their alternate names.
+  RegisterType callee_registers[kMaxRegisters * 2];
+  RegisterType caller_registers[kMaxRegisters * 2];
+  u_int64_t callee_valid = 0;
+  u_int64_t caller_valid;
 
   // Populate callee_registers with register values from callee_context.
   for (size_t i = 0; i < map_size_; i++) {
     const RegisterSet &r = register_map_[i];
-    if (callee_validity & r.validity_flag)
-      callee_registers[r.name] = callee_context.*r.context_member;
+    if (callee_validity & r.validity_flag) {
+      callee_registers[i] = callee_context.*r.context_member;
+      callee_valid |= 1ULL << i;
+    }
   }
 
   // Apply the rules, and see what register values they yield.
-  if (!cfi_frame_info.FindCallerRegs<RegisterType>(callee_registers, memory,
-                                                   &caller_registers))
+  if (!cfi_frame_info.FindCallerRegs<RegisterType>(register_names_,
+                                                   callee_registers,
+                                                   callee_valid, memory,
+                                                   caller_registers,
+                                                   &caller_valid))
     return false;
 
   // Populate *caller_context with the values the rules placed in
@@ -72,25 +100,20 @@ bool SimpleCFIWalker<RegisterType, RawContextType>::FindCallerRegisters(
   *caller_validity = 0;
   for (size_t i = 0; i < map_size_; i++) {
     const RegisterSet &r = register_map_[i];
-    typename ValueMap::const_iterator caller_entry;
 
     // Did the rules provide a value for this register by its name?
-    caller_entry = caller_registers.find(r.name);
-    if (caller_entry != caller_none) {
-      caller_context->*r.context_member = caller_entry->second;
+    if ((caller_valid >> i) & 1) {
+      caller_context->*r.context_member = caller_registers[i];
       *caller_validity |= r.validity_flag;
       continue;
     }
 
     // Did the rules provide a value for this register under its
     // alternate name?
-    if (r.alternate_name) {
-      caller_entry = caller_registers.find(r.alternate_name);
-      if (caller_entry != caller_none) {
-        caller_context->*r.context_member = caller_entry->second;
-        *caller_validity |= r.validity_flag;
-        continue;
-      }
+    if ((caller_valid >> (map_size_ + i)) & 1) {
+      caller_context->*r.context_member = caller_registers[map_size_ + i];
+      *caller_validity |= r.validity_flag;
+      continue;
     }
 
     // Is this a callee-saves register? The walker assumes that these
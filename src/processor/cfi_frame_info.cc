@@ -34,8 +34,10 @@
 
 #include "processor/cfi_frame_info.h"
 
+#include <assert.h>
 #include <string.h>
 
+#include <algorithm>
 #include <sstream>
 
 #include "processor/postfix_evaluator-inl.h"
@@ -43,41 +45,117 @@
 
 namespace google_breakpad {
 
+namespace {
+
+// Orders register name indices by the names they index, then by index.
+class RegisterNameLess {
+ public:
+  explicit RegisterNameLess(const char * const *names) : names_(names) { }
+  bool operator()(int a, int b) const {
+    int order = strcmp(names_[a], names_[b]);
+    return order < 0 || (order == 0 && a < b);
+  }
+ private:
+  const char * const *names_;
+};
+
+// Orders register name indices by the names they index, for finding the
+// first index of a name.
+class RegisterNameIndexLess {
+ public:
+  explicit RegisterNameIndexLess(const char * const *names) : names_(names) { }
+  bool operator()(int index, const string &name) const {
+    return strcmp(names_[index], name.c_str()) < 0;
+  }
+ private:
+  const char * const *names_;
+};
+
+}  // namespace
+
+CFIFrameInfo::RegisterNames::RegisterNames(const char * const *names,
+                                           size_t count)
+    : names_(names), count_(count), ra_index_(-1), cfa_index_(-1) {
+  assert(count <= 64);
+  for (size_t i = 0; i < count; i++) {
+    if (names[i])
+      sorted_.push_back(static_cast<int>(i));
+  }
+  std::sort(sorted_.begin(), sorted_.end(), RegisterNameLess(names));
+  ra_index_ = Find(".ra");
+  cfa_index_ = Find(".cfa");
+}
+
+int CFIFrameInfo::RegisterNames::Find(const string &name) const {
+  vector<int>::const_iterator it =
+      std::lower_bound(sorted_.begin(), sorted_.end(), name,
+                       RegisterNameIndexLess(names_));
+  if (it == sorted_.end() || name != names_[*it])
+    return -1;
+  return *it;
+}
+
+void CFIFrameInfo::SetCFARule(const string &expression) {
+  assert(!shared_);
+  cfa_rule_.Compile(expression);
+}
+
+void CFIFrameInfo::SetRARule(const string &expression) {
+  assert(!shared_);
+  ra_rule_.Compile(expression);
+}
+
+void CFIFrameInfo::SetRegisterRule(const string &register_name,
+                                   const string &expression) {
+  assert(!shared_);
+  register_rules_[register_name].Compile(expression);
+}
+
 template<typename V>
 bool CFIFrameInfo::FindCallerRegs(const RegisterValueMap<V> &registers,
                                   const MemoryRegion &memory,
                                   RegisterValueMap<V> *caller_registers) const {
+  const CFIFrameInfo &rules = this->rules();
+
   // If there are not rules for both .ra and .cfa in effect at this address,
   // don't use this CFI data for stack walking.
-  if (cfa_rule_.empty() || ra_rule_.empty())
+  if (rules.cfa_rule_.empty() || rules.ra_rule_.empty())
     return false;
 
-  RegisterValueMap<V> working;
+  RegisterValueMap<V> working(registers);
   PostfixEvaluator<V> evaluator(&working, &memory);
 
   caller_registers->clear();
 
+  // Each rule is evaluated with the callee's registers, plus .cfa once it
+  // is known. Rules almost never assign to variables, so the working
+  // dictionary only needs to be rebuilt after one that does.
+
   // First, compute the CFA.
   V cfa;
-  working = registers;
-  if (!evaluator.EvaluateForValue(cfa_rule_, &cfa))
+  if (!evaluator.EvaluateForValue(rules.cfa_rule_, &cfa))
     return false;
 
   // Then, compute the return address.
   V ra;
-  working = registers;
+  if (rules.cfa_rule_.has_assignments())
+    working = registers;
   working[".cfa"] = cfa;
-  if (!evaluator.EvaluateForValue(ra_rule_, &ra))
+  if (!evaluator.EvaluateForValue(rules.ra_rule_, &ra))
     return false;
+  bool working_modified = rules.ra_rule_.has_assignments();
 
   // Now, compute values for all the registers register_rules_ mentions.
-  for (RuleMap::const_iterator it = register_rules_.begin();
-       it != register_rules_.end(); it++) {
+  for (RuleMap::const_iterator it = rules.register_rules_.begin();
+       it != rules.register_rules_.end(); it++) {
     V value;
-    working = registers;
-    working[".cfa"] = cfa;
+    if (working_modified) {
+      working = registers;
+      working[".cfa"] = cfa;
+    }
     if (!evaluator.EvaluateForValue(it->second, &value))
       return false;
+    working_modified = it->second.has_assignments();
     (*caller_registers)[it->first] = value;
   }
 
@@ -87,6 +165,133 @@ bool CFIFrameInfo::FindCallerRegs(const RegisterValueMap<V> &registers,
   return true;
 }
 
+namespace {
+
+// The most identifiers a rule may refer to for the indexed form of
+// FindCallerRegs to bind them itself. Real rules use a handful.
+const size_t kMaxBoundIdentifiers = 16;
+
+// Sets BINDINGS[i] to point to the value of the register named by
+// PROGRAM's i'th identifier, where VALID says it is known, or to *CFA for
+// ".cfa", if CFA is non-NULL. Other identifiers are left unbound.
+template<typename V>
+void BindRegisters(const PostfixProgram &program,
+                   const CFIFrameInfo::RegisterNames &names,
+                   const V *values, u_int64_t valid, const V *cfa,
+                   const V **bindings) {
+  const vector<string> &identifiers = program.identifiers();
+  for (size_t i = 0; i < identifiers.size(); i++) {
+    bindings[i] = NULL;
+    if (cfa && identifiers[i] == ".cfa") {
+      bindings[i] = cfa;
+    } else {
+      int index = names.Find(identifiers[i]);
+      if (index >= 0 && (valid >> index) & 1)
+        bindings[i] = &values[index];
+    }
+  }
+}
+
+// Returns true if PROGRAM assigns to variables, or refers to too many
+// identifiers to be bound by BindRegisters.
+bool NeedsDictionary(const PostfixProgram &program) {
+  return program.has_assignments() ||
+         program.identifiers().size() > kMaxBoundIdentifiers;
+}
+
+}  // namespace
+
+template<typename V>
+bool CFIFrameInfo::FindCallerRegs(const RegisterNames &register_names,
+                                  const V *callee_values,
+                                  u_int64_t callee_valid,
+                                  const MemoryRegion &memory,
+                                  V *caller_values,
+                                  u_int64_t *caller_valid) const {
+  const CFIFrameInfo &rules = this->rules();
+  const char * const *names = register_names.names();
+  const size_t count = register_names.count();
+
+  *caller_valid = 0;
+  if (rules.cfa_rule_.empty() || rules.ra_rule_.empty())
+    return false;
+
+  bool needs_dictionary = NeedsDictionary(rules.cfa_rule_) ||
+                          NeedsDictionary(rules.ra_rule_);
+  for (RuleMap::const_iterator it = rules.register_rules_.begin();
+       it != rules.register_rules_.end(); it++) {
+    needs_dictionary |= NeedsDictionary(it->second);
+  }
+
+  if (needs_dictionary) {
+    // Let the map version deal with rules that need a dictionary to work
+    // in.
+    RegisterValueMap<V> registers, caller_registers;
+    for (size_t i = 0; i < count; i++) {
+      if (names[i] && (callee_valid >> i) & 1)
+        registers[names[i]] = callee_values[i];
+    }
+    if (!FindCallerRegs(registers, memory, &caller_registers))
+      return false;
+    for (size_t i = 0; i < count; i++) {
+      if (!names[i])
+        continue;
+      typename RegisterValueMap<V>::const_iterator entry =
+          caller_registers.find(names[i]);
+      if (entry != caller_registers.end()) {
+        caller_values[i] = entry->second;
+        *caller_valid |= 1ULL << i;
+      }
+    }
+    return true;
+  }
+
+  PostfixEvaluator<V> evaluator(NULL, &memory);
+  const V *bindings[kMaxBoundIdentifiers];
+  u_int64_t recovered = 0;
+
+  // First, compute the CFA.
+  V cfa;
+  BindRegisters(rules.cfa_rule_, register_names, callee_values, callee_valid,
+                static_cast<V*>(NULL), bindings);
+  if (!evaluator.EvaluateForValue(rules.cfa_rule_, bindings, &cfa))
+    return false;
+
+  // Then, compute the return address.
+  V ra;
+  BindRegisters(rules.ra_rule_, register_names, callee_values, callee_valid,
+                &cfa, bindings);
+  if (!evaluator.EvaluateForValue(rules.ra_rule_, bindings, &ra))
+    return false;
+
+  // Now, compute values for all the registers register_rules_ mentions.
+  for (RuleMap::const_iterator it = rules.register_rules_.begin();
+       it != rules.register_rules_.end(); it++) {
+    V value;
+    BindRegisters(it->second, register_names, callee_values, callee_valid,
+                  &cfa, bindings);
+    if (!evaluator.EvaluateForValue(it->second, bindings, &value))
+      return false;
+    int index = register_names.Find(it->first);
+    if (index >= 0) {
+      caller_values[index] = value;
+      recovered |= 1ULL << index;
+    }
+  }
+
+  if (register_names.ra_index() >= 0) {
+    caller_values[register_names.ra_index()] = ra;
+    recovered |= 1ULL << register_names.ra_index();
+  }
+  if (register_names.cfa_index() >= 0) {
+    caller_values[register_names.cfa_index()] = cfa;
+    recovered |= 1ULL << register_names.cfa_index();
+  }
+
+  *caller_valid = recovered;
+  return true;
+}
+
 // Explicit instantiations for 32-bit and 64-bit architectures.
 template bool CFIFrameInfo::FindCallerRegs<u_int32_t>(
     const RegisterValueMap<u_int32_t> &registers,
@@ -96,24 +301,39 @@ template bool CFIFrameInfo::FindCallerRegs<u_int64_t>(
     const RegisterValueMap<u_int64_t> &registers,
     const MemoryRegion &memory,
     RegisterValueMap<u_int64_t> *caller_registers) const;
+template bool CFIFrameInfo::FindCallerRegs<u_int32_t>(
+    const RegisterNames &register_names,
+    const u_int32_t *callee_values,
+    u_int64_t callee_valid,
+    const MemoryRegion &memory,
+    u_int32_t *caller_values,
+    u_int64_t *caller_valid) const;
+template bool CFIFrameInfo::FindCallerRegs<u_int64_t>(
+    const RegisterNames &register_names,
+    const u_int64_t *callee_values,
+    u_int64_t callee_valid,
+    const MemoryRegion &memory,
+    u_int64_t *caller_values,
+    u_int64_t *caller_valid) const;
 
 string CFIFrameInfo::Serialize() const {
+  const CFIFrameInfo &rules = this->rules();
   std::ostringstream stream;
 
-  if (!cfa_rule_.empty()) {
-    stream << ".cfa: " << cfa_rule_;
+  if (!rules.cfa_rule_.empty()) {
+    stream << ".cfa: " << rules.cfa_rule_.expression();
   }
-  if (!ra_rule_.empty()) {
+  if (!rules.ra_rule_.empty()) {
     if (static_cast<std::streamoff>(stream.tellp()) != 0)
       stream << " ";
-    stream << ".ra: " << ra_rule_;
+    stream << ".ra: " << rules.ra_rule_.expression();
   }
-  for (RuleMap::const_iterator iter = register_rules_.begin();
-       iter != register_rules_.end();
+  for (RuleMap::const_iterator iter = rules.register_rules_.begin();
+       iter != rules.register_rules_.end();
        ++iter) {
     if (static_cast<std::streamoff>(stream.tellp()) != 0)
       stream << " ";
-    stream << iter->first << ": " << iter->second;
+    stream << iter->first << ": " << iter->second.expression();
   }
 
   return stream.str();
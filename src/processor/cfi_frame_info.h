@@ -40,13 +40,16 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "common/using_std_string.h"
 #include "google_breakpad/common/breakpad_types.h"
+#include "processor/postfix_evaluator.h"
 
 namespace google_breakpad {
 
 using std::map;
+using std::vector;
 
 class MemoryRegion;
 
@@ -69,14 +72,55 @@ class CFIFrameInfo {
   template<typename ValueType> class RegisterValueMap: 
     public map<string, ValueType> { };
 
+  // The names of the registers a stack walker passes to the indexed form
+  // of FindCallerRegs, indexed in turn so that rules can be bound to them
+  // without a linear search. Build one per walker, not per frame.
+  class RegisterNames {
+   public:
+    // NAMES is an array of COUNT register names, at most 64, which must
+    // outlive this object. NULL entries name no register.
+    RegisterNames(const char * const *names, size_t count);
+
+    const char * const *names() const { return names_; }
+    size_t count() const { return count_; }
+
+    // Return the index of the first register named NAME, or -1 if there
+    // is none.
+    int Find(const string &name) const;
+
+    // The indices of ".ra" and ".cfa", or -1 if they aren't named.
+    int ra_index() const { return ra_index_; }
+    int cfa_index() const { return cfa_index_; }
+
+   private:
+    const char * const *names_;
+    size_t count_;
+
+    // The indices of the non-NULL entries of names_, ordered by name and
+    // then by index.
+    vector<int> sorted_;
+
+    int ra_index_;
+    int cfa_index_;
+  };
+
+  CFIFrameInfo() : shared_(NULL) { }
+
+  // Construct an instance that applies the rules of SHARED without
+  // copying them. SHARED must outlive this instance and not change, and
+  // no rules may be set on this instance. This lets a source line
+  // resolver hand out the same rule set for many frames.
+  explicit CFIFrameInfo(const CFIFrameInfo *shared)
+      : shared_(shared->shared_ ? shared->shared_ : shared) { }
+
   // Set the expression for computing a call frame address, return
   // address, or register's value. At least the CFA rule and the RA
-  // rule must be set before calling FindCallerRegs.
-  void SetCFARule(const string &expression) { cfa_rule_ = expression; }
-  void SetRARule(const string &expression)  { ra_rule_ = expression; }
-  void SetRegisterRule(const string &register_name, const string &expression) {
-    register_rules_[register_name] = expression;
-  }
+  // rule must be set before calling FindCallerRegs. Each expression is
+  // compiled as it is set, so FindCallerRegs can be called any number of
+  // times without reparsing it.
+  void SetCFARule(const string &expression);
+  void SetRARule(const string &expression);
+  void SetRegisterRule(const string &register_name, const string &expression);
 
   // Compute the values of the calling frame's registers, according to
   // this rule set. Use ValueType in expression evaluation; this
@@ -100,6 +144,24 @@ class CFIFrameInfo {
                       const MemoryRegion &memory,
                       RegisterValueMap<ValueType> *caller_registers) const;
 
+  // The same, with the registers identified by their indices in
+  // REGISTER_NAMES instead of by name in a map; this saves building maps
+  // for every frame.
+  //
+  // The callee frame's registers are those named in REGISTER_NAMES whose
+  // bits are set in CALLEE_VALID, with values in CALLEE_VALUES. On success,
+  // the bits of *CALLER_VALID are set for the registers that the map
+  // version would have put in CALLER_REGISTERS, with their values in
+  // CALLER_VALUES; this includes ".ra" and ".cfa", if REGISTER_NAMES names
+  // them.
+  template<typename ValueType>
+  bool FindCallerRegs(const RegisterNames &register_names,
+                      const ValueType *callee_values,
+                      u_int64_t callee_valid,
+                      const MemoryRegion &memory,
+                      ValueType *caller_values,
+                      u_int64_t *caller_valid) const;
+
   // Serialize the rules in this object into a string in the format
   // of STACK CFI records.
   string Serialize() const;
@@ -107,17 +169,25 @@ class CFIFrameInfo {
  private:
 
   // A map from register names onto evaluation rules. 
-  typedef map<string, string> RuleMap;
+  typedef map<string, PostfixProgram> RuleMap;
+
+  // The instance whose rules this one applies, or NULL if it applies its
+  // own.
+  const CFIFrameInfo *shared_;
+
+  // The instance holding the rules this one applies.
+  const CFIFrameInfo &rules() const { return shared_ ? *shared_ : *this; }
 
   // In this type, a "postfix expression" is an expression of the sort
-  // interpreted by google_breakpad::PostfixEvaluator.
+  // interpreted by google_breakpad::PostfixEvaluator, held in the compiled
+  // form it evaluates.
 
   // A postfix expression for computing the current frame's CFA (call
   // frame address). The CFA is a reference address for the frame that
   // remains unchanged throughout the frame's lifetime. You should
   // evaluate this expression with a dictionary initially populated
   // with the values of the current frame's known registers.
-  string cfa_rule_;
+  PostfixProgram cfa_rule_;
 
   // The following expressions should be evaluated with a dictionary
   // initially populated with the values of the current frame's known
@@ -126,7 +196,7 @@ class CFIFrameInfo {
 
   // A postfix expression for computing the current frame's return
   // address. 
-  string ra_rule_;
+  PostfixProgram ra_rule_;
 
   // For a register named REG, rules[REG] is a postfix expression
   // which leaves the value of REG in the calling frame on the top of
@@ -239,9 +309,10 @@ class SimpleCFIWalker {
   // Create a simple CFI-based frame walker, given a description of the
   // architecture's register set. REGISTER_MAP is an array of
   // RegisterSet structures; MAP_SIZE is the number of elements in the
-  // array.
-  SimpleCFIWalker(const RegisterSet *register_map, size_t map_size)
-      : register_map_(register_map), map_size_(map_size) { }
+  // array, at most kMaxRegisters.
+  SimpleCFIWalker(const RegisterSet *register_map, size_t map_size);
+
+  static const size_t kMaxRegisters = 32;
 
   // Compute the calling frame's raw context given the callee's raw
   // context.
@@ -264,8 +335,25 @@ class SimpleCFIWalker {
                            int *caller_validity) const;
 
  private:
+  // Return the names of REGISTER_MAP's registers, followed by their
+  // alternate names.
+  static vector<const char *> RegisterNameArray(const RegisterSet *register_map,
+                                                size_t map_size);
+
   const RegisterSet *register_map_;
   size_t map_size_;
+
+  // The names of the registers in register_map_, followed by their
+  // alternate names.
+  vector<const char *> register_name_array_;
+
+  // register_name_array_, in the form CFIFrameInfo::FindCallerRegs takes.
+  // This points into register_name_array_, so a copy would dangle.
+  CFIFrameInfo::RegisterNames register_names_;
+
+  // Disallow copy constructor and assignment operator.
+  SimpleCFIWalker(const SimpleCFIWalker&);
+  void operator=(const SimpleCFIWalker&);
 };
 
 }  // namespace google_breakpad
@@ -289,6 +289,96 @@ TEST_F(Scope, SeparateTempsRA) {
                                              &caller_registers));
 }
 
+// The indexed form of FindCallerRegs should recover the same registers,
+// with the same values, as the map form.
+TEST_F(Scope, IndexedMatchesMap) {
+  ExpectNoMemoryReferences();
+
+  cfi.SetCFARule("reg1 8 +");
+  cfi.SetRARule(".cfa reg2 -");
+  cfi.SetRegisterRule("reg1", ".cfa 16 -");
+  cfi.SetRegisterRule("reg3", "reg2 reg1 *");
+  registers["reg1"] = 0x1000;
+  registers["reg2"] = 0x8;
+  ASSERT_TRUE(cfi.FindCallerRegs<u_int64_t>(registers, memory,
+                                            &caller_registers));
+
+  const char *names[] = { "reg1", "reg2", "reg3", "reg4", NULL, ".cfa",
+                          ".ra" };
+  const size_t count = sizeof(names) / sizeof(names[0]);
+  CFIFrameInfo::RegisterNames register_names(names, count);
+  u_int64_t callee_values[count] = { 0x1000, 0x8 };
+  u_int64_t caller_values[count];
+  u_int64_t caller_valid;
+  ASSERT_TRUE(cfi.FindCallerRegs<u_int64_t>(register_names, callee_values,
+                                            0x3, memory, caller_values,
+                                            &caller_valid));
+  ASSERT_EQ(0x65U, caller_valid);
+  ASSERT_EQ(4U, caller_registers.size());
+  for (size_t i = 0; i < count; i++) {
+    if (!names[i])
+      continue;
+    bool in_map = caller_registers.find(names[i]) != caller_registers.end();
+    ASSERT_EQ(in_map, ((caller_valid >> i) & 1) != 0);
+    if (in_map)
+      ASSERT_EQ(caller_registers[names[i]], caller_values[i]);
+  }
+}
+
+// The indexed form should fail just as the map form does.
+TEST_F(Scope, IndexedFailure) {
+  ExpectNoMemoryReferences();
+
+  cfi.SetCFARule("reg1");
+  cfi.SetRARule("0");
+  const char *names[] = { "reg1", ".cfa" };
+  CFIFrameInfo::RegisterNames register_names(names, 2);
+  u_int64_t callee_values[2] = { 0 };
+  u_int64_t caller_values[2];
+  u_int64_t caller_valid = 1;
+  ASSERT_FALSE(cfi.FindCallerRegs<u_int64_t>(register_names, callee_values, 0,
+                                             memory, caller_values,
+                                             &caller_valid));
+}
+
+// An instance sharing another's rules should apply and serialize them
+// just as the original does.
+TEST_F(Scope, SharedRules) {
+  ExpectNoMemoryReferences();
+
+  cfi.SetCFARule("reg1 8 +");
+  cfi.SetRARule(".cfa reg2 -");
+  cfi.SetRegisterRule("reg3", "reg2 reg1 *");
+  CFIFrameInfo shared(&cfi);
+  CFIFrameInfo shared_again(&shared);
+  EXPECT_EQ(cfi.Serialize(), shared.Serialize());
+  EXPECT_EQ(cfi.Serialize(), shared_again.Serialize());
+
+  registers["reg1"] = 0x1000;
+  registers["reg2"] = 0x8;
+  ASSERT_TRUE(shared_again.FindCallerRegs<u_int64_t>(registers, memory,
+                                                     &caller_registers));
+  ASSERT_EQ(3U, caller_registers.size());
+  ASSERT_EQ(0x1008U, caller_registers[".cfa"]);
+  ASSERT_EQ(0x1000U, caller_registers[".ra"]);
+  ASSERT_EQ(0x8000U, caller_registers["reg3"]);
+}
+
+TEST(RegisterNames, Find) {
+  const char *names[] = { "$b", NULL, "$a", ".ra", "$b", ".cfa" };
+  CFIFrameInfo::RegisterNames register_names(names, 6);
+  EXPECT_EQ(2, register_names.Find("$a"));
+  EXPECT_EQ(0, register_names.Find("$b"));
+  EXPECT_EQ(-1, register_names.Find("$c"));
+  EXPECT_EQ(-1, register_names.Find(""));
+  EXPECT_EQ(3, register_names.ra_index());
+  EXPECT_EQ(5, register_names.cfa_index());
+
+  CFIFrameInfo::RegisterNames no_names(names, 2);
+  EXPECT_EQ(-1, no_names.ra_index());
+  EXPECT_EQ(-1, no_names.cfa_index());
+}
+
 class MockCFIRuleParserHandler: public CFIRuleParser::Handler {
  public:
   MOCK_METHOD1(CFARule, void(const string &));
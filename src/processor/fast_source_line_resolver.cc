@@ -40,13 +40,23 @@
 #include "google_breakpad/processor/fast_source_line_resolver.h"
 #include "processor/fast_source_line_resolver_types.h"
 
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _WIN32
+
 #include <map>
 #include <string>
 #include <utility>
 
 #include "common/using_std_string.h"
+#include "processor/logging.h"
 #include "processor/module_factory.h"
 #include "processor/scoped_ptr.h"
+#include "processor/serialized_symbol_file.h"
 
 using std::map;
 using std::make_pair;
@@ -54,12 +64,133 @@ using std::make_pair;
 namespace google_breakpad {
 
 FastSourceLineResolver::FastSourceLineResolver()
-  : SourceLineResolverBase(new FastModuleFactory) { }
+  : SourceLineResolverBase(new FastModuleFactory),
+    verify_checksums_(false) { }
+
+FastSourceLineResolver::~FastSourceLineResolver() {
+#ifndef _WIN32
+  // The modules themselves are deleted by ~SourceLineResolverBase, but
+  // they don't touch their data when they are destroyed.
+  for (MappedFileMap::iterator iter = mapped_files_.begin();
+       iter != mapped_files_.end(); ++iter) {
+    munmap(iter->second.first, iter->second.second);
+  }
+#endif  // _WIN32
+}
 
 bool FastSourceLineResolver::ShouldDeleteMemoryBufferAfterLoadModule() {
   return false;
 }
 
+bool FastSourceLineResolver::MapsSymbolFiles() {
+#ifdef _WIN32
+  return false;
+#else
+  return true;
+#endif  // _WIN32
+}
+
+bool FastSourceLineResolver::LoadModule(const CodeModule *module,
+                                        const string &map_file) {
+#ifdef _WIN32
+  // The in-memory loaders accept serialized symbol files too.
+  return SourceLineResolverBase::LoadModule(module, map_file);
+#else
+  if (module == NULL)
+    return false;
+
+  // Make sure we don't already have a module with the given name.
+  if (modules_->find(module->code_file()) != modules_->end()) {
+    BPLOG(INFO) << "Symbols for module " << module->code_file()
+                << " already loaded";
+    return false;
+  }
+
+  // Anything that isn't a serialized symbol file is read the usual way,
+  // which also takes care of reporting files that can't be opened.
+  int fd = open(map_file.c_str(), O_RDONLY);
+  if (fd == -1)
+    return SourceLineResolverBase::LoadModule(module, map_file);
+  struct stat file_stat;
+  char magic[sizeof(kSerializedSymbolFileMagic)];
+  if (fstat(fd, &file_stat) == -1 ||
+      read(fd, magic, sizeof(magic)) != static_cast<ssize_t>(sizeof(magic)) ||
+      !IsSerializedSymbolFile(magic, sizeof(magic))) {
+    close(fd);
+    return SourceLineResolverBase::LoadModule(module, map_file);
+  }
+
+  BPLOG(INFO) << "Mapping serialized symbols for module " <<
+                 module->code_file() << " from " << map_file;
+
+  size_t file_size = file_stat.st_size;
+  void *mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not map " << map_file <<
+        ", error " << error_code << ": " << error_string;
+    return false;
+  }
+
+  const char *data;
+  size_t data_size;
+  if (!CheckSerializedSymbolFile(static_cast<const char*>(mapping), file_size,
+                                 verify_checksums_, &data, &data_size) ||
+      !CheckMapSizes(data, data_size)) {
+    BPLOG(ERROR) << "Invalid serialized symbol file " << map_file;
+    munmap(mapping, file_size);
+    return false;
+  }
+
+  // The mapping is read-only, but LoadMapFromMemory only reads the data
+  // despite taking a char*.
+  SourceLineResolverBase::Module *fast_module =
+      module_factory_->CreateModule(module->code_file());
+  if (!fast_module->LoadMapFromMemory(const_cast<char*>(data))) {
+    delete fast_module;
+    munmap(mapping, file_size);
+    return false;
+  }
+
+  modules_->insert(make_pair(module->code_file(), fast_module));
+  mapped_files_.insert(make_pair(module->code_file(),
+                                 make_pair(mapping, file_size)));
+  return true;
+#endif  // _WIN32
+}
+
+void FastSourceLineResolver::UnloadModule(const CodeModule *code_module) {
+  SourceLineResolverBase::UnloadModule(code_module);
+  if (!code_module)
+    return;
+
+#ifndef _WIN32
+  MappedFileMap::iterator iter = mapped_files_.find(code_module->code_file());
+  if (iter != mapped_files_.end()) {
+    munmap(iter->second.first, iter->second.second);
+    mapped_files_.erase(iter);
+  }
+#endif  // _WIN32
+}
+
+bool FastSourceLineResolver::CheckMapSizes(const char *data, size_t size) {
+  const size_t header_size = Module::kNumberMaps_ * sizeof(u_int32_t);
+  if (size < header_size)
+    return false;
+
+  u_int32_t map_sizes[Module::kNumberMaps_];
+  memcpy(map_sizes, data, header_size);
+  size_t total_size = header_size;
+  for (int i = 0; i < Module::kNumberMaps_; ++i) {
+    if (map_sizes[i] > size - total_size)
+      return false;
+    total_size += map_sizes[i];
+  }
+  return true;
+}
+
 void FastSourceLineResolver::Module::LookupAddress(StackFrame *frame) const {
   MemAddr address = frame->instruction - frame->module->base_address();
 
@@ -146,6 +277,22 @@ WindowsFrameInfo FastSourceLineResolver::CopyWFI(const char *raw) {
 bool FastSourceLineResolver::Module::LoadMapFromMemory(char *mem_buffer) {
   if (!mem_buffer) return false;
 
+  // Serialized symbol files, as opposed to bare serialized data, start
+  // with a header.  Their size can't be checked here, but their version
+  // can.
+  if (IsSerializedSymbolFile(mem_buffer,
+                             sizeof(SerializedSymbolFileHeader))) {
+    SerializedSymbolFileHeader header;
+    memcpy(&header, mem_buffer, sizeof(header));
+    if (header.version != kSerializedSymbolFileVersion ||
+        header.header_size != sizeof(header)) {
+      BPLOG(ERROR) << "Unsupported serialized symbol file version " <<
+                      header.version;
+      return false;
+    }
+    mem_buffer += sizeof(header);
+  }
+
   const u_int32_t *map_sizes = reinterpret_cast<const u_int32_t*>(mem_buffer);
 
   unsigned int header_size = kNumberMaps_ * sizeof(unsigned int);
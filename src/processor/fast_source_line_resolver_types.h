@@ -116,7 +116,8 @@ class FastSourceLineResolver::Module: public SourceLineResolverBase::Module {
   virtual ~Module() { }
 
   // Looks up the given relative address, and fills the StackFrame struct
-  // with the result.
+  // with the result.  Lookups only read the serialized data, so they need
+  // no lock.
   virtual void LookupAddress(StackFrame *frame) const;
 
   // Loads a map from the given buffer in char* type.
@@ -43,16 +43,21 @@
 #include <string>
 
 #include "breakpad_googletest_includes.h"
+#include "common/tests/auto_tempdir.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
 #include "google_breakpad/processor/stack_frame.h"
 #include "google_breakpad/processor/memory_region.h"
+#include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "google_breakpad/processor/symbol_supplier.h"
 #include "processor/logging.h"
 #include "processor/module_serializer.h"
 #include "processor/module_comparer.h"
 
 namespace {
 
+using google_breakpad::AutoTempDir;
 using google_breakpad::SourceLineResolverBase;
 using google_breakpad::BasicSourceLineResolver;
 using google_breakpad::FastSourceLineResolver;
@@ -60,10 +65,15 @@ using google_breakpad::ModuleSerializer;
 using google_breakpad::ModuleComparer;
 using google_breakpad::CFIFrameInfo;
 using google_breakpad::CodeModule;
+using google_breakpad::CodeModules;
 using google_breakpad::MemoryRegion;
 using google_breakpad::StackFrame;
+using google_breakpad::StackFrameSymbolizer;
+using google_breakpad::SymbolSupplier;
+using google_breakpad::SystemInfo;
 using google_breakpad::WindowsFrameInfo;
 using google_breakpad::linked_ptr;
+using google_breakpad::scoped_array;
 using google_breakpad::scoped_ptr;
 
 class TestCodeModule : public CodeModule {
@@ -86,6 +96,63 @@ class TestCodeModule : public CodeModule {
   string code_file_;
 };
 
+// A single module.
+class TestCodeModules : public CodeModules {
+ public:
+  explicit TestCodeModules(const CodeModule* module) : module_(module) {}
+
+  virtual unsigned int module_count() const { return 1; }
+  virtual const CodeModule* GetModuleForAddress(u_int64_t address) const {
+    return address - module_->base_address() < module_->size() ?
+        module_ : NULL;
+  }
+  virtual const CodeModule* GetMainModule() const { return module_; }
+  virtual const CodeModule* GetModuleAtSequence(unsigned int index) const {
+    return module_;
+  }
+  virtual const CodeModule* GetModuleAtIndex(unsigned int index) const {
+    return module_;
+  }
+  virtual const CodeModules* Copy() const {
+    return new TestCodeModules(module_);
+  }
+
+ private:
+  const CodeModule* module_;
+};
+
+// Names a symbol file, but won't hand out its contents.
+class FileOnlySymbolSupplier : public SymbolSupplier {
+ public:
+  explicit FileOnlySymbolSupplier(const string& path) : path_(path) {}
+
+  virtual SymbolResult GetSymbolFile(const CodeModule* module,
+                                     const SystemInfo* system_info,
+                                     string* symbol_file) {
+    *symbol_file = path_;
+    return FOUND;
+  }
+  virtual SymbolResult GetSymbolFile(const CodeModule* module,
+                                     const SystemInfo* system_info,
+                                     string* symbol_file,
+                                     string* symbol_data) {
+    ADD_FAILURE() << "symbol data requested";
+    return NOT_FOUND;
+  }
+  virtual SymbolResult GetCStringSymbolData(const CodeModule* module,
+                                            const SystemInfo* system_info,
+                                            string* symbol_file,
+                                            char** symbol_data) {
+    ADD_FAILURE() << "symbol data requested";
+    return NOT_FOUND;
+  }
+  virtual void FreeSymbolData(const CodeModule* module) {}
+  virtual bool NamesSymbolFiles() { return true; }
+
+ private:
+  string path_;
+};
+
 // A mock memory region object, for use by the STACK CFI tests.
 class MockMemoryRegion: public MemoryRegion {
   u_int64_t GetBase() const { return 0x10000; }
@@ -455,6 +522,102 @@ TEST_F(TestFastSourceLineResolver, TestUnload) {
   ASSERT_TRUE(fast_resolver.HasModule(&module1));
 }
 
+static bool WriteTestFile(const string &path, const char *data,
+                          size_t size) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  bool ok = fwrite(data, 1, size, file) == size;
+  return fclose(file) == 0 && ok;
+}
+
+TEST_F(TestFastSourceLineResolver, LoadSerializedSymbolFile) {
+  char *symbol_data;
+  ASSERT_TRUE(SourceLineResolverBase::ReadSymbolFile(&symbol_data,
+                                                     symbol_file(1)));
+  string symbol_data_string = symbol_data;
+  delete [] symbol_data;
+
+  unsigned int size;
+  scoped_array<char> file_data(
+      serializer.MakeSerializedSymbolFile(symbol_data_string, &size));
+  ASSERT_TRUE(file_data.get());
+
+  AutoTempDir temp_dir;
+  string path = temp_dir.path() + "/module1.sym";
+  ASSERT_TRUE(WriteTestFile(path, file_data.get(), size));
+
+  TestCodeModule module1("module1");
+  StackFrame frame;
+  frame.instruction = 0x1000;
+  frame.module = &module1;
+  fast_resolver.set_verify_checksums(true);
+  ASSERT_TRUE(fast_resolver.LoadModule(&module1, path));
+  ASSERT_TRUE(fast_resolver.HasModule(&module1));
+  fast_resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ(frame.function_name, "Function1_1");
+  ASSERT_EQ(frame.source_file_name, "file1_1.cc");
+  ASSERT_EQ(frame.source_line, 44);
+  ASSERT_FALSE(fast_resolver.LoadModule(&module1, path));
+  fast_resolver.UnloadModule(&module1);
+  ASSERT_FALSE(fast_resolver.HasModule(&module1));
+
+  // The header is also accepted by the in-memory loaders.
+  ClearSourceLineInfo(&frame);
+  frame.module = &module1;
+  ASSERT_TRUE(fast_resolver.LoadModuleUsingMapBuffer(
+      &module1, string(file_data.get(), size)));
+  fast_resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ(frame.function_name, "Function1_1");
+  fast_resolver.UnloadModule(&module1);
+
+  // Truncated files are always rejected.
+  fast_resolver.set_verify_checksums(false);
+  ASSERT_TRUE(WriteTestFile(path, file_data.get(), size - 1));
+  ASSERT_FALSE(fast_resolver.LoadModule(&module1, path));
+  ASSERT_FALSE(fast_resolver.HasModule(&module1));
+
+  // Damaged data is caught by verifying the checksum.
+  file_data[size / 2] ^= 1;
+  ASSERT_TRUE(WriteTestFile(path, file_data.get(), size));
+  fast_resolver.set_verify_checksums(true);
+  ASSERT_FALSE(fast_resolver.LoadModule(&module1, path));
+  ASSERT_FALSE(fast_resolver.HasModule(&module1));
+}
+
+// StackFrameSymbolizer hands the resolver the symbol file to map, rather
+// than reading it.
+TEST_F(TestFastSourceLineResolver, SymbolizerMapsSerializedSymbolFile) {
+  char *symbol_data;
+  ASSERT_TRUE(SourceLineResolverBase::ReadSymbolFile(&symbol_data,
+                                                     symbol_file(1)));
+  string symbol_data_string = symbol_data;
+  delete [] symbol_data;
+
+  unsigned int size;
+  scoped_array<char> file_data(
+      serializer.MakeSerializedSymbolFile(symbol_data_string, &size));
+  ASSERT_TRUE(file_data.get());
+
+  AutoTempDir temp_dir;
+  string path = temp_dir.path() + "/module1.sym";
+  ASSERT_TRUE(WriteTestFile(path, file_data.get(), size));
+
+  ASSERT_TRUE(fast_resolver.MapsSymbolFiles());
+  FileOnlySymbolSupplier supplier(path);
+  StackFrameSymbolizer symbolizer(&supplier, &fast_resolver);
+  TestCodeModule module1("module1");
+  TestCodeModules modules(&module1);
+  StackFrame frame;
+  frame.instruction = 0x1000;
+  ASSERT_EQ(StackFrameSymbolizer::NO_ERROR,
+            symbolizer.FillSourceLineInfo(&modules, NULL, &frame));
+  ASSERT_TRUE(fast_resolver.HasModule(&module1));
+  ASSERT_EQ(frame.function_name, "Function1_1");
+  ASSERT_EQ(frame.source_file_name, "file1_1.cc");
+  ASSERT_EQ(frame.source_line, 44);
+}
+
 TEST_F(TestFastSourceLineResolver, CompareModule) {
   char *symbol_data;
   string symbol_data_string;
@@ -0,0 +1,236 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// line_scanner.h: Splits a text buffer into lines and space-separated
+// tokens in place, without copying or modifying it, and converts tokens to
+// numbers.  BasicSourceLineResolver uses these to parse symbol files in a
+// single pass.
+//
+// The scanners reproduce the splitting rules of the strtok_r and Tokenize
+// based parser they replace, and the number parsers reproduce strtoull and
+// strtol, so that symbol files load exactly as they did before, including
+// malformed ones.
+
+#ifndef PROCESSOR_LINE_SCANNER_H__
+#define PROCESSOR_LINE_SCANNER_H__
+
+#include <limits.h>
+#include <string.h>
+
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+// Produces the lines of [begin, end).  Lines are separated by any run of
+// '\r' and '\n' characters, so empty lines are never produced.
+class LineScanner {
+ public:
+  LineScanner(const char *begin, const char *end)
+      : cursor_(begin), end_(end) { }
+
+  // Sets [*line_begin, *line_end) to the next line and returns true, or
+  // returns false if there are no more lines.
+  bool NextLine(const char **line_begin, const char **line_end) {
+    while (cursor_ < end_ && (*cursor_ == '\n' || *cursor_ == '\r'))
+      ++cursor_;
+    if (cursor_ == end_)
+      return false;
+    *line_begin = cursor_;
+    cursor_ = FindLineEnd(cursor_, end_);
+    *line_end = cursor_;
+    return true;
+  }
+
+  // Returns the first '\r' or '\n' in [begin, end), or end if there is
+  // none.  Symbol file lines are long enough that it pays to examine eight
+  // bytes at a time.
+  static const char *FindLineEnd(const char *begin, const char *end) {
+    const u_int64_t kOnes = 0x0101010101010101ULL;
+    const u_int64_t kHighBits = 0x8080808080808080ULL;
+    const u_int64_t kNewlines = kOnes * '\n';
+    const u_int64_t kReturns = kOnes * '\r';
+    const char *cursor = begin;
+    while (end - cursor >= 8) {
+      u_int64_t word;
+      memcpy(&word, cursor, sizeof(word));
+      // A byte of (x - kOnes) & ~x & kHighBits is nonzero exactly when the
+      // corresponding byte of x is zero.
+      u_int64_t newlines = word ^ kNewlines;
+      u_int64_t returns = word ^ kReturns;
+      if (((newlines - kOnes) & ~newlines & kHighBits) |
+          ((returns - kOnes) & ~returns & kHighBits))
+        break;
+      cursor += 8;
+    }
+    while (cursor < end && *cursor != '\n' && *cursor != '\r')
+      ++cursor;
+    return cursor;
+  }
+
+ private:
+  const char *cursor_;
+  const char *end_;
+};
+
+// Produces the space-separated tokens of a single line.
+class TokenScanner {
+ public:
+  TokenScanner(const char *begin, const char *end)
+      : cursor_(begin), end_(end) { }
+
+  // Skips spaces, then sets [*token_begin, *token_end) to the characters
+  // up to the next space or the end of the line.  Returns false if only
+  // spaces remain.
+  bool NextToken(const char **token_begin, const char **token_end) {
+    while (cursor_ < end_ && *cursor_ == ' ')
+      ++cursor_;
+    if (cursor_ == end_)
+      return false;
+    *token_begin = cursor_;
+    while (cursor_ < end_ && *cursor_ != ' ')
+      ++cursor_;
+    *token_end = cursor_;
+    return true;
+  }
+
+  // Sets [*rest_begin, *rest_end) to everything after the single space
+  // that ended the last token, leading spaces and all.  This is how
+  // Tokenize produces its final token, which holds names and rule strings
+  // that may themselves contain spaces.  Returns false if nothing follows.
+  bool Rest(const char **rest_begin, const char **rest_end) {
+    if (cursor_ < end_)
+      ++cursor_;
+    if (cursor_ == end_)
+      return false;
+    *rest_begin = cursor_;
+    *rest_end = end_;
+    cursor_ = end_;
+    return true;
+  }
+
+  // Reads up to count tokens into begins and ends, and then, as Tokenize
+  // does with max_tokens equal to count + 1, the rest of the line into
+  // begins[count] and ends[count].  Returns true only if all count + 1
+  // were found.
+  bool Tokenize(int count, const char **begins, const char **ends) {
+    for (int i = 0; i < count; ++i) {
+      if (!NextToken(&begins[i], &ends[i]))
+        return false;
+    }
+    return Rest(&begins[count], &ends[count]);
+  }
+
+ private:
+  const char *cursor_;
+  const char *end_;
+};
+
+// Returns true if c is a character that strtol and friends skip before a
+// number.
+inline bool IsNumberSpace(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Returns the value of digit c in the given base, which may be 10 or 16,
+// or -1 if c isn't a digit in that base.
+inline int DigitValue(char c, int base) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (base == 16) {
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+  }
+  return -1;
+}
+
+// Skips what strtol and friends skip before the digits of a number in
+// [*cursor, end): white space, a sign, and for base 16, a "0x" prefix.
+// Returns true if the number is negative.
+inline bool SkipNumberPrefix(const char **cursor, const char *end, int base) {
+  const char *position = *cursor;
+  while (position < end && IsNumberSpace(*position))
+    ++position;
+  bool negative = false;
+  if (position < end && (*position == '+' || *position == '-')) {
+    negative = *position == '-';
+    ++position;
+  }
+  if (base == 16 && end - position >= 3 && position[0] == '0' &&
+      (position[1] == 'x' || position[1] == 'X') &&
+      DigitValue(position[2], 16) >= 0)
+    position += 2;
+  *cursor = position;
+  return negative;
+}
+
+// Parses the hexadecimal number at the start of [begin, end) exactly as
+// strtoull(string, NULL, 16) would parse a string holding those
+// characters: parsing stops at the first character that isn't a digit,
+// and values that overflow produce ULLONG_MAX.
+inline u_int64_t ParseHex(const char *begin, const char *end) {
+  const char *cursor = begin;
+  bool negative = SkipNumberPrefix(&cursor, end, 16);
+  u_int64_t value = 0;
+  for (; cursor < end; ++cursor) {
+    int digit = DigitValue(*cursor, 16);
+    if (digit < 0)
+      break;
+    if (value >> 60)
+      return ULLONG_MAX;
+    value = (value << 4) | digit;
+  }
+  return negative ? -value : value;
+}
+
+// Parses the number at the start of [begin, end) exactly as
+// strtol(string, NULL, base) would, saturating at LONG_MIN and LONG_MAX.
+// base may be 10 or 16.  (atoi is strtol with base 10, cast to int.)
+inline long ParseLong(const char *begin, const char *end, int base) {
+  const char *cursor = begin;
+  bool negative = SkipNumberPrefix(&cursor, end, base);
+
+  // The magnitude of LONG_MIN is one more than LONG_MAX.
+  const unsigned long limit =
+      negative ? static_cast<unsigned long>(LONG_MAX) + 1 : LONG_MAX;
+  unsigned long value = 0;
+  for (; cursor < end; ++cursor) {
+    int digit = DigitValue(*cursor, base);
+    if (digit < 0)
+      break;
+    if (value > (limit - digit) / base)
+      return negative ? LONG_MIN : LONG_MAX;
+    value = value * base + digit;
+  }
+  return negative ? static_cast<long>(0 - value) : static_cast<long>(value);
+}
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_LINE_SCANNER_H__
@@ -0,0 +1,180 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// line_scanner_unittest.cc: Unit tests for LineScanner, TokenScanner and
+// the number parsers in line_scanner.h.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/using_std_string.h"
+#include "processor/line_scanner.h"
+
+namespace {
+
+using google_breakpad::LineScanner;
+using google_breakpad::ParseHex;
+using google_breakpad::ParseLong;
+using google_breakpad::TokenScanner;
+using std::vector;
+
+vector<string> Lines(const string &text) {
+  vector<string> lines;
+  LineScanner scanner(text.data(), text.data() + text.size());
+  const char *begin, *end;
+  while (scanner.NextLine(&begin, &end))
+    lines.push_back(string(begin, end));
+  return lines;
+}
+
+TEST(LineScannerTest, SplitsLines) {
+  vector<string> lines = Lines("one\ntwo\r\n\r\nthree four\rfive");
+  ASSERT_EQ(4U, lines.size());
+  EXPECT_EQ("one", lines[0]);
+  EXPECT_EQ("two", lines[1]);
+  EXPECT_EQ("three four", lines[2]);
+  EXPECT_EQ("five", lines[3]);
+
+  EXPECT_TRUE(Lines("").empty());
+  EXPECT_TRUE(Lines("\r\n\n\r").empty());
+}
+
+TEST(LineScannerTest, FindLineEndAtEveryOffset) {
+  // Exercise both the word-at-a-time loop and the byte loop that finishes
+  // it, with the newline at every position relative to a word.
+  for (size_t length = 0; length < 40; ++length) {
+    for (size_t position = 0; position <= length; ++position) {
+      string text(length, 'x');
+      if (position < length)
+        text[position] = position % 2 ? '\n' : '\r';
+      const char *begin = text.data();
+      const char *end = begin + length;
+      EXPECT_EQ(begin + position, LineScanner::FindLineEnd(begin, end))
+          << "length " << length << ", position " << position;
+    }
+  }
+
+  // Bytes that differ from '\n' only in their high bit must not match.
+  string text(16, '\x8a');
+  EXPECT_EQ(text.data() + text.size(),
+            LineScanner::FindLineEnd(text.data(), text.data() + text.size()));
+}
+
+TEST(TokenScannerTest, Tokenize) {
+  string line = "  1000  20 4 name with  spaces ";
+  TokenScanner scanner(line.data(), line.data() + line.size());
+  const char *begins[4], *ends[4];
+  ASSERT_TRUE(scanner.Tokenize(3, begins, ends));
+  EXPECT_EQ("1000", string(begins[0], ends[0]));
+  EXPECT_EQ("20", string(begins[1], ends[1]));
+  EXPECT_EQ("4", string(begins[2], ends[2]));
+  // Only the single separating space is dropped from the rest of the line.
+  EXPECT_EQ("name with  spaces ", string(begins[3], ends[3]));
+
+  line = "1000 20  spaced";
+  TokenScanner leading(line.data(), line.data() + line.size());
+  ASSERT_TRUE(leading.Tokenize(2, begins, ends));
+  EXPECT_EQ(" spaced", string(begins[2], ends[2]));
+}
+
+TEST(TokenScannerTest, TooFewTokens) {
+  const char *begins[4], *ends[4];
+
+  string line = "1000 20";
+  TokenScanner short_line(line.data(), line.data() + line.size());
+  EXPECT_FALSE(short_line.Tokenize(3, begins, ends));
+
+  line = "1000 20 4";
+  TokenScanner no_rest(line.data(), line.data() + line.size());
+  EXPECT_FALSE(no_rest.Tokenize(3, begins, ends));
+
+  line = "1000 20 4 ";
+  TokenScanner empty_rest(line.data(), line.data() + line.size());
+  EXPECT_FALSE(empty_rest.Tokenize(3, begins, ends));
+
+  line = "   ";
+  TokenScanner blank(line.data(), line.data() + line.size());
+  EXPECT_FALSE(blank.NextToken(&begins[0], &ends[0]));
+}
+
+// Strings that the number parsers must treat exactly as the C library
+// does.
+const char *const kNumbers[] = {
+  "0", "1", "42", "-1", "+7", "  12", "\t-3", "0x1f", "0X1F", "0x", "0xg",
+  "-0x10", "ff", "FF", "aBc", "12ab", "12 34", "1f:", "", "-", "+", " ",
+  "7fffffff", "80000000", "ffffffff", "100000000",
+  "7fffffffffffffff", "8000000000000000", "ffffffffffffffff",
+  "10000000000000000", "123456789abcdef0123",
+  "2147483647", "2147483648", "-2147483648", "-2147483649",
+  "9223372036854775807", "9223372036854775808",
+  "-9223372036854775808", "-9223372036854775809",
+  "99999999999999999999999",
+};
+
+TEST(NumberParserTest, MatchesStrtoull) {
+  for (size_t i = 0; i < sizeof(kNumbers) / sizeof(kNumbers[0]); ++i) {
+    const char *number = kNumbers[i];
+    EXPECT_EQ(strtoull(number, NULL, 16),
+              ParseHex(number, number + strlen(number)))
+        << "\"" << number << "\"";
+  }
+}
+
+TEST(NumberParserTest, MatchesStrtol) {
+  for (size_t i = 0; i < sizeof(kNumbers) / sizeof(kNumbers[0]); ++i) {
+    const char *number = kNumbers[i];
+    EXPECT_EQ(strtol(number, NULL, 10),
+              ParseLong(number, number + strlen(number), 10))
+        << "\"" << number << "\"";
+    EXPECT_EQ(strtol(number, NULL, 16),
+              ParseLong(number, number + strlen(number), 16))
+        << "\"" << number << "\"";
+  }
+}
+
+TEST(NumberParserTest, StopsAtEnd) {
+  // The parsers never look past the end they are given, even when the
+  // characters that follow are digits.
+  const char *number = "12345";
+  EXPECT_EQ(0x123U, ParseHex(number, number + 3));
+  EXPECT_EQ(12, ParseLong(number, number + 2, 10));
+  EXPECT_EQ(0U, ParseHex(number, number));
+  EXPECT_EQ(0, ParseLong(number, number, 10));
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -48,6 +48,8 @@ typedef SSIZE_T ssize_t;
 #define PRIx32 "lx"
 #define snprintf _snprintf
 #else  // _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #define O_BINARY 0
 #endif  // _WIN32
@@ -60,6 +62,8 @@ typedef SSIZE_T ssize_t;
 
 #include "processor/range_map-inl.h"
 
+#include "common/minidump_compression.h"
+
 #include "processor/basic_code_module.h"
 #include "processor/basic_code_modules.h"
 #include "processor/logging.h"
@@ -1152,7 +1156,8 @@ u_int32_t MinidumpMemoryRegion::max_bytes_ = 1024 * 1024;  // 1MB
 MinidumpMemoryRegion::MinidumpMemoryRegion(Minidump* minidump)
     : MinidumpObject(minidump),
       descriptor_(NULL),
-      memory_(NULL) {
+      memory_(NULL),
+      mapped_memory_(NULL) {
 }
 
 
@@ -1176,7 +1181,7 @@ const u_int8_t* MinidumpMemoryRegion::GetMemory() const {
     return NULL;
   }
 
-  if (!memory_) {
+  if (!memory_ && !mapped_memory_) {
     if (descriptor_->memory.data_size == 0) {
       BPLOG(ERROR) << "MinidumpMemoryRegion is empty";
       return NULL;
@@ -1194,6 +1199,18 @@ const u_int8_t* MinidumpMemoryRegion::GetMemory() const {
       return NULL;
     }
 
+    // Memory regions are never byte-swapped as a whole, so when the
+    // minidump is memory-mapped, the region can be used in place.
+    if (minidump_->is_memory_mapped()) {
+      mapped_memory_ =
+          minidump_->ReadBytesInPlace(descriptor_->memory.data_size);
+      if (!mapped_memory_) {
+        BPLOG(ERROR) << "MinidumpMemoryRegion could not map memory region";
+        return NULL;
+      }
+      return mapped_memory_;
+    }
+
     scoped_ptr< vector<u_int8_t> > memory(
         new vector<u_int8_t>(descriptor_->memory.data_size));
 
@@ -1205,6 +1222,9 @@ const u_int8_t* MinidumpMemoryRegion::GetMemory() const {
     memory_ = memory.release();
   }
 
+  if (mapped_memory_)
+    return mapped_memory_;
+
   return &(*memory_)[0];
 }
 
@@ -1232,6 +1252,7 @@ u_int32_t MinidumpMemoryRegion::GetSize() const {
 void MinidumpMemoryRegion::FreeMemory() {
   delete memory_;
   memory_ = NULL;
+  mapped_memory_ = NULL;
 }
 
 
@@ -1657,6 +1678,7 @@ MinidumpModule::MinidumpModule(Minidump* minidump)
       module_(),
       name_(NULL),
       cv_record_(NULL),
+      cv_record_bytes_(NULL),
       cv_record_signature_(MD_CVINFOUNKNOWN_SIGNATURE),
       misc_record_(NULL) {
 }
@@ -1675,6 +1697,7 @@ bool MinidumpModule::Read() {
   name_ = NULL;
   delete cv_record_;
   cv_record_ = NULL;
+  cv_record_bytes_ = NULL;
   cv_record_signature_ = MD_CVINFOUNKNOWN_SIGNATURE;
   delete misc_record_;
   misc_record_ = NULL;
@@ -1845,11 +1868,11 @@ string MinidumpModule::debug_file() const {
 
   string file;
   // Prefer the CodeView record if present.
-  if (cv_record_) {
+  if (cv_record_bytes_) {
     if (cv_record_signature_ == MD_CVINFOPDB70_SIGNATURE) {
       // It's actually an MDCVInfoPDB70 structure.
       const MDCVInfoPDB70* cv_record_70 =
-          reinterpret_cast<const MDCVInfoPDB70*>(&(*cv_record_)[0]);
+          reinterpret_cast<const MDCVInfoPDB70*>(cv_record_bytes_);
       assert(cv_record_70->cv_signature == MD_CVINFOPDB70_SIGNATURE);
 
       // GetCVRecord guarantees pdb_file_name is null-terminated.
@@ -1857,7 +1880,7 @@ string MinidumpModule::debug_file() const {
     } else if (cv_record_signature_ == MD_CVINFOPDB20_SIGNATURE) {
       // It's actually an MDCVInfoPDB20 structure.
       const MDCVInfoPDB20* cv_record_20 =
-          reinterpret_cast<const MDCVInfoPDB20*>(&(*cv_record_)[0]);
+          reinterpret_cast<const MDCVInfoPDB20*>(cv_record_bytes_);
       assert(cv_record_20->cv_header.signature == MD_CVINFOPDB20_SIGNATURE);
 
       // GetCVRecord guarantees pdb_file_name is null-terminated.
@@ -1926,11 +1949,11 @@ string MinidumpModule::debug_identifier() const {
   string identifier;
 
   // Use the CodeView record if present.
-  if (cv_record_) {
+  if (cv_record_bytes_) {
     if (cv_record_signature_ == MD_CVINFOPDB70_SIGNATURE) {
       // It's actually an MDCVInfoPDB70 structure.
       const MDCVInfoPDB70* cv_record_70 =
-          reinterpret_cast<const MDCVInfoPDB70*>(&(*cv_record_)[0]);
+          reinterpret_cast<const MDCVInfoPDB70*>(cv_record_bytes_);
       assert(cv_record_70->cv_signature == MD_CVINFOPDB70_SIGNATURE);
 
       // Use the same format that the MS symbol server uses in filesystem
@@ -1954,7 +1977,7 @@ string MinidumpModule::debug_identifier() const {
     } else if (cv_record_signature_ == MD_CVINFOPDB20_SIGNATURE) {
       // It's actually an MDCVInfoPDB20 structure.
       const MDCVInfoPDB20* cv_record_20 =
-          reinterpret_cast<const MDCVInfoPDB20*>(&(*cv_record_)[0]);
+          reinterpret_cast<const MDCVInfoPDB20*>(cv_record_bytes_);
       assert(cv_record_20->cv_header.signature == MD_CVINFOPDB20_SIGNATURE);
 
       // Use the same format that the MS symbol server uses in filesystem
@@ -2026,7 +2049,7 @@ const u_int8_t* MinidumpModule::GetCVRecord(u_int32_t* size) {
     return NULL;
   }
 
-  if (!cv_record_) {
+  if (!cv_record_bytes_) {
     // This just guards against 0-sized CodeView records; more specific checks
     // are used when the signature is checked against various structure types.
     if (module_.cv_record.data_size == 0) {
@@ -2052,18 +2075,32 @@ const u_int8_t* MinidumpModule::GetCVRecord(u_int32_t* size) {
     // variable-sized due to their pdb_file_name fields; these structures
     // are not MDCVInfoPDB70_minsize or MDCVInfoPDB20_minsize and treating
     // them as such would result in incomplete structures or overruns.
-    scoped_ptr< vector<u_int8_t> > cv_record(
-        new vector<u_int8_t>(module_.cv_record.data_size));
+    //
+    // A record that doesn't need byte-swapping is used in place when the
+    // minidump is memory-mapped.  Otherwise, it's copied out so that it can
+    // be swapped.
+    const u_int8_t* cv_record_bytes = NULL;
+    scoped_ptr< vector<u_int8_t> > cv_record;
+    if (!minidump_->swap()) {
+      cv_record_bytes =
+          minidump_->ReadBytesInPlace(module_.cv_record.data_size);
+    }
 
-    if (!minidump_->ReadBytes(&(*cv_record)[0], module_.cv_record.data_size)) {
-      BPLOG(ERROR) << "MinidumpModule could not read CodeView record";
-      return NULL;
+    if (!cv_record_bytes) {
+      cv_record.reset(new vector<u_int8_t>(module_.cv_record.data_size));
+
+      if (!minidump_->ReadBytes(&(*cv_record)[0],
+                                module_.cv_record.data_size)) {
+        BPLOG(ERROR) << "MinidumpModule could not read CodeView record";
+        return NULL;
+      }
+      cv_record_bytes = &(*cv_record)[0];
     }
 
     u_int32_t signature = MD_CVINFOUNKNOWN_SIGNATURE;
     if (module_.cv_record.data_size > sizeof(signature)) {
-      MDCVInfoPDB70* cv_record_signature =
-          reinterpret_cast<MDCVInfoPDB70*>(&(*cv_record)[0]);
+      const MDCVInfoPDB70* cv_record_signature =
+          reinterpret_cast<const MDCVInfoPDB70*>(cv_record_bytes);
       signature = cv_record_signature->cv_signature;
       if (minidump_->swap())
         Swap(&signature);
@@ -2090,7 +2127,7 @@ const u_int8_t* MinidumpModule::GetCVRecord(u_int32_t* size) {
 
       // The last field of either structure is null-terminated 8-bit character
       // data.  Ensure that it's null-terminated.
-      if ((*cv_record)[module_.cv_record.data_size - 1] != '\0') {
+      if (cv_record_bytes[module_.cv_record.data_size - 1] != '\0') {
         BPLOG(ERROR) << "MinidumpModule CodeView7 record string is not "
                         "0-terminated";
         return NULL;
@@ -2116,7 +2153,7 @@ const u_int8_t* MinidumpModule::GetCVRecord(u_int32_t* size) {
 
       // The last field of either structure is null-terminated 8-bit character
       // data.  Ensure that it's null-terminated.
-      if ((*cv_record)[module_.cv_record.data_size - 1] != '\0') {
+      if (cv_record_bytes[module_.cv_record.data_size - 1] != '\0') {
         BPLOG(ERROR) << "MindumpModule CodeView2 record string is not "
                         "0-terminated";
         return NULL;
@@ -2130,15 +2167,17 @@ const u_int8_t* MinidumpModule::GetCVRecord(u_int32_t* size) {
     // although byte-swapping can't be done.
 
     // Store the vector type because that's how storage was allocated, but
-    // return it casted to u_int8_t*.
+    // return it casted to u_int8_t*.  cv_record_ remains NULL if the record
+    // is being used in place.
     cv_record_ = cv_record.release();
+    cv_record_bytes_ = cv_record_bytes;
     cv_record_signature_ = signature;
   }
 
   if (size)
     *size = module_.cv_record.data_size;
 
-  return &(*cv_record_)[0];
+  return cv_record_bytes_;
 }
 
 
@@ -3785,6 +3824,11 @@ Minidump::Minidump(const string& path)
       stream_map_(new MinidumpStreamMap()),
       path_(path),
       stream_(NULL),
+      memory_map_(false),
+      mapped_data_(NULL),
+      mapped_size_(0),
+      mapped_position_(0),
+      decompressed_data_(NULL),
       swap_(false),
       valid_(false) {
 }
@@ -3795,24 +3839,51 @@ Minidump::Minidump(istream& stream)
       stream_map_(new MinidumpStreamMap()),
       path_(),
       stream_(&stream),
+      memory_map_(false),
+      mapped_data_(NULL),
+      mapped_size_(0),
+      mapped_position_(0),
+      decompressed_data_(NULL),
+      swap_(false),
+      valid_(false) {
+}
+
+Minidump::Minidump(const string& path, bool memory_map)
+    : header_(),
+      directory_(NULL),
+      stream_map_(new MinidumpStreamMap()),
+      path_(path),
+      stream_(NULL),
+      memory_map_(memory_map),
+      mapped_data_(NULL),
+      mapped_size_(0),
+      mapped_position_(0),
+      decompressed_data_(NULL),
       swap_(false),
       valid_(false) {
 }
 
 Minidump::~Minidump() {
-  if (stream_) {
+  if (stream_ || mapped_data_) {
     BPLOG(INFO) << "Minidump closing minidump";
   }
   if (!path_.empty()) {
     delete stream_;
   }
+  if (decompressed_data_) {
+    delete[] decompressed_data_;
+  } else if (mapped_data_) {
+#ifndef _WIN32
+    munmap(const_cast<u_int8_t*>(mapped_data_), mapped_size_);
+#endif  // _WIN32
+  }
   delete directory_;
   delete stream_map_;
 }
 
 
 bool Minidump::Open() {
-  if (stream_ != NULL) {
+  if (stream_ != NULL || mapped_data_ != NULL) {
     BPLOG(INFO) << "Minidump reopening minidump " << path_;
 
     // The file is already open.  Seek to the beginning, which is the position
@@ -3820,6 +3891,15 @@ bool Minidump::Open() {
     return SeekSet(0);
   }
 
+  if (memory_map_) {
+    if (MapFile()) {
+      BPLOG(INFO) << "Minidump mapped minidump " << path_;
+      return true;
+    }
+    BPLOG(INFO) << "Minidump could not map minidump " << path_ <<
+                   ", falling back to stream input";
+  }
+
   stream_ = new ifstream(path_.c_str(), std::ios::in | std::ios::binary);
   if (!stream_ || !stream_->good()) {
     string error_string;
@@ -3833,6 +3913,196 @@ bool Minidump::Open() {
   return true;
 }
 
+
+bool Minidump::MapFile() {
+#ifdef _WIN32
+  return false;
+#else  // _WIN32
+  int fd = open(path_.c_str(), O_RDONLY | O_BINARY);
+  if (fd == -1) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Minidump could not open minidump " << path_ <<
+                    ", error " << error_code << ": " << error_string;
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size <= 0 ||
+      static_cast<u_int64_t>(st.st_size) >
+          static_cast<u_int64_t>(numeric_limits<size_t>::max())) {
+    BPLOG(ERROR) << "Minidump could not determine a mappable size for " <<
+                    path_;
+    close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping remains valid after the descriptor is closed.
+  close(fd);
+  if (data == MAP_FAILED) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Minidump could not mmap minidump " << path_ <<
+                    ", error " << error_code << ": " << error_string;
+    return false;
+  }
+
+  mapped_data_ = static_cast<const u_int8_t*>(data);
+  mapped_size_ = size;
+  mapped_position_ = 0;
+  return true;
+#endif  // _WIN32
+}
+
+
+bool Minidump::Decompress() {
+  CompressedMinidumpHeader container;
+  if (!ReadBytes(&container, sizeof(container))) {
+    // Too short to be a compressed minidump, or anything else.
+    return false;
+  }
+
+  bool swap = false;
+  if (container.signature != kCompressedMinidumpSignature) {
+    Swap(&container.signature);
+    if (container.signature != kCompressedMinidumpSignature) {
+      // An ordinary minidump.
+      return SeekSet(0);
+    }
+    swap = true;
+    Swap(&container.version);
+  }
+  if (container.version != kCompressedMinidumpVersion) {
+    BPLOG(ERROR) << "Minidump unsupported compressed minidump version " <<
+                    container.version;
+    return false;
+  }
+
+  // Get the whole container into memory, unless it already is.
+  const u_int8_t* input = mapped_data_;
+  size_t input_size = mapped_size_;
+  vector<u_int8_t> input_buffer;
+  if (!input) {
+    stream_->seekg(0, std::ios_base::end);
+    std::streamoff end = stream_->tellg();
+    if (end < 0 || !SeekSet(0)) {
+      BPLOG(ERROR) << "Minidump cannot determine compressed minidump size";
+      return false;
+    }
+    input_buffer.resize(static_cast<size_t>(end));
+    if (!ReadBytes(&input_buffer[0], input_buffer.size())) {
+      BPLOG(ERROR) << "Minidump cannot read compressed minidump";
+      return false;
+    }
+    input = &input_buffer[0];
+    input_size = input_buffer.size();
+  }
+
+  // The first pass checks that the records are intact and finds the size of
+  // the minidump; the second fills it in.
+  size_t minidump_size = 0;
+  size_t end_size = 0;
+  for (int pass = 0; pass < 2; ++pass) {
+    size_t position = sizeof(container);
+    while (position < input_size) {
+      CompressedMinidumpRecord record;
+      if (input_size - position < sizeof(record)) {
+        BPLOG(ERROR) << "Minidump truncated compressed record at " <<
+                        position;
+        return false;
+      }
+      memcpy(&record, input + position, sizeof(record));
+      position += sizeof(record);
+      if (swap) {
+        Swap(&record.type);
+        Swap(&record.offset);
+        Swap(&record.size);
+        Swap(&record.stored_size);
+      }
+      if (record.stored_size > input_size - position) {
+        BPLOG(ERROR) << "Minidump truncated compressed record at " <<
+                        position;
+        return false;
+      }
+      const u_int8_t* payload = input + position;
+      position += record.stored_size;
+
+      if (record.type == kCompressedMinidumpRecordEnd) {
+        if (pass == 0 && record.offset > end_size)
+          end_size = record.offset;
+        continue;
+      }
+      if ((record.type != kCompressedMinidumpRecordCompressed &&
+           record.type != kCompressedMinidumpRecordStored) ||
+          record.size > kCompressedMinidumpMaxBlockSize ||
+          (record.type == kCompressedMinidumpRecordStored &&
+           record.stored_size != record.size) ||
+          static_cast<u_int64_t>(record.offset) + record.size >
+              numeric_limits<u_int32_t>::max()) {
+        BPLOG(ERROR) << "Minidump bad compressed record type " <<
+                        record.type << " at " << position;
+        return false;
+      }
+      if (pass == 0) {
+        if (record.offset + record.size > minidump_size)
+          minidump_size = record.offset + record.size;
+      } else if (record.type == kCompressedMinidumpRecordStored) {
+        memcpy(decompressed_data_ + record.offset, payload, record.size);
+      } else if (!DecompressMinidumpBlock(payload, record.stored_size,
+                                          decompressed_data_ + record.offset,
+                                          record.size)) {
+        BPLOG(ERROR) << "Minidump corrupt compressed block at " <<
+                        position - record.stored_size;
+        return false;
+      }
+    }
+    if (pass == 0) {
+      // Every record must lie within the size the end records give, and
+      // that size must be one the input could plausibly expand to, so that
+      // a bogus end record cannot make us allocate gigabytes.
+      if (end_size) {
+        if (minidump_size > end_size) {
+          BPLOG(ERROR) << "Minidump compressed record past end " <<
+                          end_size;
+          return false;
+        }
+        minidump_size = end_size;
+      }
+      if (minidump_size == 0) {
+        BPLOG(ERROR) << "Minidump compressed minidump is empty";
+        return false;
+      }
+      if (static_cast<u_int64_t>(minidump_size) >
+          static_cast<u_int64_t>(input_size) * kCompressedMinidumpMaxRatio) {
+        BPLOG(ERROR) << "Minidump compressed minidump of " << input_size <<
+                        " bytes claims to expand to " << minidump_size;
+        return false;
+      }
+      delete[] decompressed_data_;
+      decompressed_data_ = new u_int8_t[minidump_size]();
+    }
+  }
+
+  BPLOG(INFO) << "Minidump decompressed " << input_size << " bytes to " <<
+                 minidump_size;
+
+  // Read from the decompressed copy from now on.
+#ifndef _WIN32
+  if (mapped_data_)
+    munmap(const_cast<u_int8_t*>(mapped_data_), mapped_size_);
+#endif  // _WIN32
+  if (!path_.empty())
+    delete stream_;
+  stream_ = NULL;
+  mapped_data_ = decompressed_data_;
+  mapped_size_ = minidump_size;
+  mapped_position_ = 0;
+  return true;
+}
+
+
 bool Minidump::GetContextCPUFlagsFromSystemInfo(u_int32_t *context_cpu_flags) {
   // Initialize output parameters
   *context_cpu_flags = 0;
@@ -3913,6 +4183,11 @@ bool Minidump::Read() {
     return false;
   }
 
+  if (!Decompress()) {
+    BPLOG(ERROR) << "Minidump cannot decompress minidump";
+    return false;
+  }
+
   if (!ReadBytes(&header_, sizeof(MDRawHeader))) {
     BPLOG(ERROR) << "Minidump cannot read header";
     return false;
@@ -4155,6 +4430,17 @@ const MDRawDirectory* Minidump::GetDirectoryEntryAtIndex(unsigned int index)
 bool Minidump::ReadBytes(void* bytes, size_t count) {
   // Can't check valid_ because Read needs to call this method before
   // validity can be determined.
+  if (mapped_data_) {
+    const u_int8_t* source = ReadBytesInPlace(count);
+    if (!source) {
+      size_t remaining = mapped_position_ < static_cast<off_t>(mapped_size_) ?
+                         mapped_size_ - mapped_position_ : 0;
+      BPLOG(ERROR) << "ReadBytes: read " << remaining << "/" << count;
+      return false;
+    }
+    memcpy(bytes, source, count);
+    return true;
+  }
   if (!stream_) {
     return false;
   }
@@ -4177,6 +4463,16 @@ bool Minidump::ReadBytes(void* bytes, size_t count) {
 bool Minidump::SeekSet(off_t offset) {
   // Can't check valid_ because Read needs to call this method before
   // validity can be determined.
+  if (mapped_data_) {
+    // As with a stream, seeking beyond the end of the file is permitted,
+    // but subsequent reads will fail.
+    if (offset < 0) {
+      BPLOG(ERROR) << "SeekSet: negative offset " << offset;
+      return false;
+    }
+    mapped_position_ = offset;
+    return true;
+  }
   if (!stream_) {
     return false;
   }
@@ -4191,14 +4487,30 @@ bool Minidump::SeekSet(off_t offset) {
 }
 
 off_t Minidump::Tell() {
-  if (!valid_ || !stream_) {
+  if (!valid_ || (!stream_ && !mapped_data_)) {
     return (off_t)-1;
   }
 
+  if (mapped_data_)
+    return mapped_position_;
+
   return stream_->tellg();
 }
 
 
+const u_int8_t* Minidump::ReadBytesInPlace(size_t count) {
+  if (!mapped_data_ ||
+      mapped_position_ > static_cast<off_t>(mapped_size_) ||
+      count > mapped_size_ - mapped_position_) {
+    return NULL;
+  }
+
+  const u_int8_t* bytes = mapped_data_ + mapped_position_;
+  mapped_position_ += count;
+  return bytes;
+}
+
+
 string* Minidump::ReadString(off_t offset) {
   if (!valid_) {
     BPLOG(ERROR) << "Invalid Minidump for ReadString";
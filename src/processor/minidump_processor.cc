@@ -30,24 +30,180 @@
 #include "google_breakpad/processor/minidump_processor.h"
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 
+#include <vector>
+
 #include "google_breakpad/processor/call_stack.h"
 #include "google_breakpad/processor/minidump.h"
 #include "google_breakpad/processor/process_state.h"
 #include "google_breakpad/processor/exploitability.h"
 #include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "processor/linked_ptr.h"
 #include "processor/logging.h"
+#include "processor/mutex.h"
 #include "processor/scoped_ptr.h"
 #include "processor/stackwalker_x86.h"
 
 namespace google_breakpad {
 
+namespace {
+
+// The state needed to walk a single thread's stack, gathered from the
+// minidump on the calling thread.  Reading from a Minidump is not
+// thread-safe, so everything a Stackwalker needs from it is read before
+// any stack is walked concurrently.
+struct StackwalkJob {
+  StackwalkJob() : context(NULL), memory(NULL), interrupted(false) {}
+
+  MinidumpContext* context;
+  MinidumpMemoryRegion* memory;
+  string thread_string;
+
+  // Filled in by WalkThreadStack.  Ownership of stack is released to the
+  // ProcessState once every stack has been walked.
+  scoped_ptr<CallStack> stack;
+  bool interrupted;
+};
+
+// A CodeModules that serializes access to another CodeModules.
+// BasicCodeModules hands out linked_ptr copies internally, which is not
+// safe to do from several threads at once.  The CodeModule objects
+// returned are those of the wrapped CodeModules, so StackFrame::module
+// pointers remain valid after the wrapper is gone.
+class LockedCodeModules : public CodeModules {
+ public:
+  explicit LockedCodeModules(const CodeModules* modules) : modules_(modules) {}
+
+  virtual unsigned int module_count() const {
+    AutoMutexLock lock(&mutex_);
+    return modules_->module_count();
+  }
+  virtual const CodeModule* GetModuleForAddress(u_int64_t address) const {
+    AutoMutexLock lock(&mutex_);
+    return modules_->GetModuleForAddress(address);
+  }
+  virtual const CodeModule* GetMainModule() const {
+    AutoMutexLock lock(&mutex_);
+    return modules_->GetMainModule();
+  }
+  virtual const CodeModule* GetModuleAtSequence(unsigned int sequence) const {
+    AutoMutexLock lock(&mutex_);
+    return modules_->GetModuleAtSequence(sequence);
+  }
+  virtual const CodeModule* GetModuleAtIndex(unsigned int index) const {
+    AutoMutexLock lock(&mutex_);
+    return modules_->GetModuleAtIndex(index);
+  }
+  virtual const CodeModules* Copy() const {
+    AutoMutexLock lock(&mutex_);
+    return modules_->Copy();
+  }
+
+ private:
+  const CodeModules* modules_;
+  mutable Mutex mutex_;
+};
+
+// Walks the stack described by job, storing the result in job.
+void WalkThreadStack(const SystemInfo* system_info,
+                     const CodeModules* modules,
+                     StackFrameSymbolizer* frame_symbolizer,
+                     StackwalkJob* job) {
+  scoped_ptr<Stackwalker> stackwalker(
+      Stackwalker::StackwalkerForCPU(system_info,
+                                     job->context,
+                                     job->memory,
+                                     modules,
+                                     frame_symbolizer));
+
+  scoped_ptr<CallStack> stack(new CallStack());
+  if (stackwalker.get()) {
+    if (!stackwalker->Walk(stack.get())) {
+      BPLOG(INFO) << "Stackwalker interrupt (missing symbols?) at " <<
+        job->thread_string;
+      job->interrupted = true;
+    }
+  } else {
+    // Threads with missing CPU contexts will hit this, but
+    // don't abort processing the rest of the dump just for
+    // one bad thread.
+    BPLOG(ERROR) << "No stackwalker for " << job->thread_string;
+  }
+  job->stack.reset(stack.release());
+}
+
+// Hands out StackwalkJobs to a pool of worker threads.
+class StackwalkPool {
+ public:
+  StackwalkPool(const SystemInfo* system_info,
+                const CodeModules* modules,
+                StackFrameSymbolizer* frame_symbolizer,
+                std::vector<StackwalkJob*>* jobs)
+      : system_info_(system_info),
+        modules_(modules),
+        frame_symbolizer_(frame_symbolizer),
+        jobs_(jobs),
+        next_job_(0) {}
+
+  // Walks every job on up to thread_count threads, returning once all of
+  // them are done.  Jobs are walked on the calling thread if no worker
+  // threads can be started.
+  void Run(int thread_count) {
+    std::vector<pthread_t> threads;
+    for (int i = 0; i < thread_count; ++i) {
+      pthread_t thread;
+      if (pthread_create(&thread, NULL, WorkerThread, this) != 0) {
+        BPLOG(ERROR) << "Could not start stackwalk thread " << i;
+        break;
+      }
+      threads.push_back(thread);
+    }
+
+    if (threads.empty()) {
+      WorkerThread(this);
+      return;
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i)
+      pthread_join(threads[i], NULL);
+  }
+
+ private:
+  static void* WorkerThread(void* context) {
+    StackwalkPool* pool = static_cast<StackwalkPool*>(context);
+    StackwalkJob* job;
+    while ((job = pool->NextJob()) != NULL) {
+      WalkThreadStack(pool->system_info_, pool->modules_,
+                      pool->frame_symbolizer_, job);
+    }
+    return NULL;
+  }
+
+  StackwalkJob* NextJob() {
+    AutoMutexLock lock(&mutex_);
+    if (next_job_ == jobs_->size())
+      return NULL;
+    return (*jobs_)[next_job_++];
+  }
+
+  const SystemInfo* system_info_;
+  const CodeModules* modules_;
+  StackFrameSymbolizer* frame_symbolizer_;
+  std::vector<StackwalkJob*>* jobs_;
+  size_t next_job_;
+  Mutex mutex_;
+};
+
+}  // namespace
+
 MinidumpProcessor::MinidumpProcessor(SymbolSupplier *supplier,
                                      SourceLineResolverInterface *resolver)
     : frame_symbolizer_(new StackFrameSymbolizer(supplier, resolver)),
       own_frame_symbolizer_(true),
-      enable_exploitability_(false) {
+      enable_exploitability_(false),
+      stackwalk_threads_(1) {
 }
 
 MinidumpProcessor::MinidumpProcessor(SymbolSupplier *supplier,
@@ -55,14 +211,16 @@ MinidumpProcessor::MinidumpProcessor(SymbolSupplier *supplier,
                                      bool enable_exploitability)
     : frame_symbolizer_(new StackFrameSymbolizer(supplier, resolver)),
       own_frame_symbolizer_(true),
-      enable_exploitability_(enable_exploitability) {
+      enable_exploitability_(enable_exploitability),
+      stackwalk_threads_(1) {
 }
 
 MinidumpProcessor::MinidumpProcessor(StackFrameSymbolizer *frame_symbolizer,
                                      bool enable_exploitability)
     : frame_symbolizer_(frame_symbolizer),
       own_frame_symbolizer_(false),
-      enable_exploitability_(enable_exploitability) {
+      enable_exploitability_(enable_exploitability),
+      stackwalk_threads_(1) {
   assert(frame_symbolizer_);
 }
 
@@ -142,6 +300,11 @@ ProcessResult MinidumpProcessor::Process(
   // Reset frame_symbolizer_ at the beginning of stackwalk for each minidump.
   frame_symbolizer_->Reset();
 
+  // When walking concurrently, stacks are walked after every thread has
+  // been read from the minidump.  Otherwise, each is walked as it's read.
+  bool concurrent = stackwalk_threads_ > 1 && thread_count > 1;
+  std::vector<linked_ptr<StackwalkJob> > jobs;
+
   for (unsigned int thread_index = 0;
        thread_index < thread_count;
        ++thread_index) {
@@ -189,7 +352,7 @@ ProcessResult MinidumpProcessor::Process(
       // processed threads vector.  The thread vector's current size will
       // be the index of the current thread when it's pushed into the
       // vector.
-      process_state->requesting_thread_ = process_state->threads_.size();
+      process_state->requesting_thread_ = jobs.size();
 
       found_requesting_thread = true;
 
@@ -210,6 +373,12 @@ ProcessResult MinidumpProcessor::Process(
       BPLOG(ERROR) << "No memory region for " << thread_string;
     }
 
+    linked_ptr<StackwalkJob> job(new StackwalkJob());
+    job->context = context;
+    job->memory = thread_memory;
+    job->thread_string = thread_string;
+    jobs.push_back(job);
+
     // Use process_state->modules_ instead of module_list, because the
     // |modules| argument will be used to populate the |module| fields in
     // the returned StackFrame objects, which will be placed into the
@@ -218,28 +387,37 @@ ProcessResult MinidumpProcessor::Process(
     // returns.  process_state->modules_ is owned by the ProcessState object
     // (just like the StackFrame objects), and is much more suitable for this
     // task.
-    scoped_ptr<Stackwalker> stackwalker(
-        Stackwalker::StackwalkerForCPU(process_state->system_info(),
-                                       context,
-                                       thread_memory,
-                                       process_state->modules_,
-                                       frame_symbolizer_));
-
-    scoped_ptr<CallStack> stack(new CallStack());
-    if (stackwalker.get()) {
-      if (!stackwalker->Walk(stack.get())) {
-        BPLOG(INFO) << "Stackwalker interrupt (missing symbols?) at " <<
-          thread_string;
-        interrupted = true;
-      }
-    } else {
-      // Threads with missing CPU contexts will hit this, but
-      // don't abort processing the rest of the dump just for
-      // one bad thread.
-      BPLOG(ERROR) << "No stackwalker for " << thread_string;
+    //
+    // A memory region whose contents can't be loaded up front would go
+    // back to the minidump file on every access, so such a thread is
+    // walked right away even in concurrent mode.
+    if (!concurrent || (thread_memory && !thread_memory->GetMemory())) {
+      WalkThreadStack(process_state->system_info(), process_state->modules_,
+                      frame_symbolizer_, job.get());
     }
-    process_state->threads_.push_back(stack.release());
-    process_state->thread_memory_regions_.push_back(thread_memory);
+  }
+
+  if (concurrent) {
+    std::vector<StackwalkJob*> pending_jobs;
+    for (size_t job_index = 0; job_index < jobs.size(); ++job_index) {
+      if (!jobs[job_index]->stack.get())
+        pending_jobs.push_back(jobs[job_index].get());
+    }
+
+    scoped_ptr<LockedCodeModules> locked_modules;
+    if (process_state->modules_)
+      locked_modules.reset(new LockedCodeModules(process_state->modules_));
+    StackwalkPool pool(process_state->system_info(), locked_modules.get(),
+                       frame_symbolizer_, &pending_jobs);
+    pool.Run(stackwalk_threads_);
+  }
+
+  for (size_t job_index = 0; job_index < jobs.size(); ++job_index) {
+    StackwalkJob* job = jobs[job_index].get();
+    if (job->interrupted)
+      interrupted = true;
+    process_state->threads_.push_back(job->stack.release());
+    process_state->thread_memory_regions_.push_back(job->memory);
   }
 
   if (interrupted) {
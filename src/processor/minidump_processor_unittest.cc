@@ -37,6 +37,7 @@
 #include <fstream>
 #include <map>
 #include <utility>
+#include <vector>
 
 #include "breakpad_googletest_includes.h"
 #include "common/using_std_string.h"
@@ -54,6 +55,7 @@
 #include "processor/stackwalker_unittest_utils.h"
 
 using std::map;
+using std::vector;
 
 namespace google_breakpad {
 class MockMinidump : public Minidump {
@@ -136,6 +138,7 @@ using google_breakpad::MockMinidumpThread;
 using google_breakpad::MockMinidumpThreadList;
 using google_breakpad::ProcessState;
 using google_breakpad::scoped_ptr;
+using google_breakpad::StackFrame;
 using google_breakpad::SymbolSupplier;
 using google_breakpad::SystemInfo;
 using ::testing::_;
@@ -441,6 +444,63 @@ TEST_F(MinidumpProcessorTest, TestBasicProcessing) {
             google_breakpad::PROCESS_SYMBOL_SUPPLIER_INTERRUPTED);
 }
 
+// Walking stacks on several threads must give the same result as walking
+// them serially.
+TEST_F(MinidumpProcessorTest, TestConcurrentStackwalk) {
+  string minidump_file = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                         "/src/processor/testdata/minidump2.dmp";
+
+  TestSymbolSupplier serial_supplier;
+  BasicSourceLineResolver serial_resolver;
+  MinidumpProcessor serial_processor(&serial_supplier, &serial_resolver);
+  ProcessState serial_state;
+  ASSERT_EQ(serial_processor.Process(minidump_file, &serial_state),
+            google_breakpad::PROCESS_OK);
+
+  TestSymbolSupplier supplier;
+  BasicSourceLineResolver resolver;
+  MinidumpProcessor processor(&supplier, &resolver);
+  processor.set_stackwalk_threads(4);
+  ASSERT_EQ(4, processor.stackwalk_threads());
+  ProcessState state;
+  ASSERT_EQ(processor.Process(minidump_file, &state),
+            google_breakpad::PROCESS_OK);
+
+  ASSERT_EQ(serial_state.requesting_thread(), state.requesting_thread());
+  ASSERT_EQ(serial_state.threads()->size(), state.threads()->size());
+  ASSERT_EQ(serial_state.thread_memory_regions()->size(),
+            state.thread_memory_regions()->size());
+  for (size_t i = 0; i < state.threads()->size(); ++i) {
+    const vector<StackFrame*>* serial_frames =
+        serial_state.threads()->at(i)->frames();
+    const vector<StackFrame*>* frames = state.threads()->at(i)->frames();
+    ASSERT_EQ(serial_frames->size(), frames->size());
+    for (size_t j = 0; j < frames->size(); ++j) {
+      EXPECT_EQ(serial_frames->at(j)->instruction,
+                frames->at(j)->instruction);
+      EXPECT_EQ(serial_frames->at(j)->trust, frames->at(j)->trust);
+      EXPECT_EQ(serial_frames->at(j)->function_name,
+                frames->at(j)->function_name);
+      EXPECT_EQ(serial_frames->at(j)->source_file_name,
+                frames->at(j)->source_file_name);
+      EXPECT_EQ(serial_frames->at(j)->source_line,
+                frames->at(j)->source_line);
+      ASSERT_EQ(serial_frames->at(j)->module == NULL,
+                frames->at(j)->module == NULL);
+      if (frames->at(j)->module) {
+        EXPECT_EQ(serial_frames->at(j)->module->code_file(),
+                  frames->at(j)->module->code_file());
+      }
+    }
+  }
+
+  // Interruption by the symbol supplier must be reported the same way.
+  state.Clear();
+  supplier.set_interrupt(true);
+  ASSERT_EQ(processor.Process(minidump_file, &state),
+            google_breakpad::PROCESS_SYMBOL_SUPPLIER_INTERRUPTED);
+}
+
 TEST_F(MinidumpProcessorTest, TestThreadMissingMemory) {
   MockMinidump dump;
   EXPECT_CALL(dump, path()).WillRepeatedly(Return("mock minidump"));
@@ -0,0 +1,356 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_stackwalk_batch.cc: Process many minidumps with
+// MinidumpProcessor in one invocation, printing the results of each as
+// minidump_stackwalk would.
+//
+// Minidumps are named on the command line, directly, by a directory
+// containing them, or in a list file.  They're spread over a pool of
+// worker threads by a WorkStealingScheduler, and every worker loads its
+// symbols through one SharedModuleCache, so each module's symbols are
+// parsed once for the whole batch rather than once per minidump.
+//
+// Each minidump's results are printed as one record, in the order the
+// minidumps finish.  A record starts with a line
+//   Minidump|{path}|{result}|{read usec}|{process usec}
+// where {result} is OK or the name of the ProcessResult that
+// MinidumpProcessor returned, and the times are those spent reading the
+// minidump and then processing it.  If processing succeeded, the process
+// state follows, in minidump_stackwalk's output format.  A summary of the
+// batch is printed to stderr at the end.
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/caching_stack_frame_symbolizer.h"
+#include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/shared_module_cache.h"
+#include "processor/logging.h"
+#include "processor/mutex.h"
+#include "processor/scoped_ptr.h"
+#include "processor/simple_symbol_supplier.h"
+#include "processor/stackwalk_common.h"
+#include "processor/work_stealing_scheduler.h"
+
+namespace {
+
+using std::vector;
+using google_breakpad::AutoMutexLock;
+using google_breakpad::CachingStackFrameSymbolizer;
+using google_breakpad::Minidump;
+using google_breakpad::MinidumpProcessor;
+using google_breakpad::Mutex;
+using google_breakpad::PrintProcessState;
+using google_breakpad::PrintProcessStateMachineReadable;
+using google_breakpad::ProcessResult;
+using google_breakpad::ProcessState;
+using google_breakpad::scoped_ptr;
+using google_breakpad::SharedModuleCache;
+using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::WorkStealingScheduler;
+
+// Separator character for machine readable output.
+static const char kOutputSeparator = '|';
+
+// The default symbol cache budget, in megabytes.
+static const size_t kDefaultCacheMegabytes = 1024;
+
+static u_int64_t NowMicroseconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<u_int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+static const char *ProcessResultName(ProcessResult result) {
+  switch (result) {
+    case google_breakpad::PROCESS_OK:
+      return "OK";
+    case google_breakpad::PROCESS_ERROR_MINIDUMP_NOT_FOUND:
+      return "ERROR_MINIDUMP_NOT_FOUND";
+    case google_breakpad::PROCESS_ERROR_NO_MINIDUMP_HEADER:
+      return "ERROR_NO_MINIDUMP_HEADER";
+    case google_breakpad::PROCESS_ERROR_NO_THREAD_LIST:
+      return "ERROR_NO_THREAD_LIST";
+    case google_breakpad::PROCESS_ERROR_GETTING_THREAD:
+      return "ERROR_GETTING_THREAD";
+    case google_breakpad::PROCESS_ERROR_GETTING_THREAD_ID:
+      return "ERROR_GETTING_THREAD_ID";
+    case google_breakpad::PROCESS_ERROR_DUPLICATE_REQUESTING_THREADS:
+      return "ERROR_DUPLICATE_REQUESTING_THREADS";
+    case google_breakpad::PROCESS_SYMBOL_SUPPLIER_INTERRUPTED:
+      return "SYMBOL_SUPPLIER_INTERRUPTED";
+  }
+  return "UNKNOWN";
+}
+
+// Appends the path of every regular file in directory to paths, in name
+// order.  Returns false if directory can't be read.
+static bool AddDirectory(const string &directory, vector<string> *paths) {
+  DIR *dir = opendir(directory.c_str());
+  if (!dir)
+    return false;
+
+  vector<string> found;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    string path = directory + "/" + entry->d_name;
+    struct stat path_stat;
+    if (stat(path.c_str(), &path_stat) == 0 && S_ISREG(path_stat.st_mode))
+      found.push_back(path);
+  }
+  closedir(dir);
+
+  std::sort(found.begin(), found.end());
+  paths->insert(paths->end(), found.begin(), found.end());
+  return true;
+}
+
+// Appends each non-empty line of the list file at list_path, or of
+// standard input if list_path is "-", to paths.  Returns false if the list
+// can't be read.
+static bool AddList(const string &list_path, vector<string> *paths) {
+  std::ifstream list_file;
+  std::istream *list = &std::cin;
+  if (list_path != "-") {
+    list_file.open(list_path.c_str());
+    if (!list_file.is_open())
+      return false;
+    list = &list_file;
+  }
+
+  string line;
+  while (std::getline(*list, line)) {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    if (!line.empty())
+      paths->push_back(line);
+  }
+  return !list->bad();
+}
+
+// Processes one minidump per task.  Each worker has its own symbol
+// supplier, symbolizer and processor, and all of them share one module
+// cache.
+class BatchHandler : public WorkStealingScheduler::Handler {
+ public:
+  BatchHandler(const vector<string> &minidump_paths,
+               const vector<string> &symbol_paths,
+               SharedModuleCache *cache,
+               int worker_count,
+               bool machine_readable)
+      : minidump_paths_(minidump_paths),
+        machine_readable_(machine_readable),
+        failures_(0) {
+    for (int i = 0; i < worker_count; ++i) {
+      Worker *worker = new Worker();
+      if (!symbol_paths.empty())
+        worker->supplier.reset(new SimpleSymbolSupplier(symbol_paths));
+      worker->symbolizer.reset(
+          new CachingStackFrameSymbolizer(worker->supplier.get(), cache));
+      worker->processor.reset(
+          new MinidumpProcessor(worker->symbolizer.get(), false));
+      workers_.push_back(worker);
+    }
+  }
+
+  ~BatchHandler() {
+    for (size_t i = 0; i < workers_.size(); ++i)
+      delete workers_[i];
+  }
+
+  virtual void RunTask(size_t task, int worker_index) {
+    Worker *worker = workers_[worker_index];
+    const string &path = minidump_paths_[task];
+
+    u_int64_t start = NowMicroseconds();
+    Minidump dump(path, true);
+    ProcessResult result = google_breakpad::PROCESS_ERROR_MINIDUMP_NOT_FOUND;
+    bool read = dump.Read();
+    u_int64_t read_done = NowMicroseconds();
+
+    ProcessState process_state;
+    if (read) {
+      result = worker->processor->Process(&dump, &process_state);
+    } else {
+      BPLOG(ERROR) << "Minidump " << path << " could not be read";
+    }
+    u_int64_t process_done = NowMicroseconds();
+
+    // Print the whole record at once, so that records from different
+    // workers don't interleave.
+    AutoMutexLock lock(&output_mutex_);
+    if (result != google_breakpad::PROCESS_OK)
+      ++failures_;
+    printf("Minidump%c%s%c%s%c%llu%c%llu\n",
+           kOutputSeparator, path.c_str(),
+           kOutputSeparator, ProcessResultName(result),
+           kOutputSeparator,
+           static_cast<unsigned long long>(read_done - start),
+           kOutputSeparator,
+           static_cast<unsigned long long>(process_done - read_done));
+    if (result == google_breakpad::PROCESS_OK) {
+      if (machine_readable_)
+        PrintProcessStateMachineReadable(process_state);
+      else
+        PrintProcessState(process_state);
+    }
+    fflush(stdout);
+  }
+
+  // The number of minidumps that could not be processed.
+  size_t failures() const { return failures_; }
+
+ private:
+  struct Worker {
+    scoped_ptr<SimpleSymbolSupplier> supplier;
+    scoped_ptr<CachingStackFrameSymbolizer> symbolizer;
+    scoped_ptr<MinidumpProcessor> processor;
+  };
+
+  const vector<string> &minidump_paths_;
+  bool machine_readable_;
+  vector<Worker*> workers_;
+
+  // Guards stdout and failures_.
+  Mutex output_mutex_;
+  size_t failures_;
+};
+
+}  // namespace
+
+static void usage(const char *program_name) {
+  fprintf(stderr,
+          "usage: %s [-m] [-j threads] [-c cache-megabytes] [-l list-file]\n"
+          "       [-s symbol-path ...] [minidump-file-or-directory ...]\n"
+          "    -m : Output in machine-readable format\n"
+          "    -j : Minidumps to process at once (default: one per CPU)\n"
+          "    -c : Symbol cache size in megabytes (default: %d)\n"
+          "    -l : Also process the minidumps listed in list-file, one\n"
+          "         per line, or on standard input if list-file is -\n"
+          "    -s : Look for symbols in symbol-path; may be repeated\n",
+          program_name, static_cast<int>(kDefaultCacheMegabytes));
+}
+
+int main(int argc, char **argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  bool machine_readable = false;
+  long worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t cache_megabytes = kDefaultCacheMegabytes;
+  vector<string> minidump_paths;
+  vector<string> symbol_paths;
+
+  int ch;
+  while ((ch = getopt(argc, argv, "mj:c:l:s:h?")) != -1) {
+    switch (ch) {
+      case 'm':
+        machine_readable = true;
+        break;
+      case 'j':
+        worker_count = strtol(optarg, NULL, 10);
+        break;
+      case 'c':
+        cache_megabytes = strtoul(optarg, NULL, 10);
+        break;
+      case 'l':
+        if (!AddList(optarg, &minidump_paths)) {
+          fprintf(stderr, "Could not read minidump list %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 's':
+        symbol_paths.push_back(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  for (int argi = optind; argi < argc; ++argi) {
+    struct stat path_stat;
+    if (stat(argv[argi], &path_stat) == 0 && S_ISDIR(path_stat.st_mode)) {
+      if (!AddDirectory(argv[argi], &minidump_paths)) {
+        fprintf(stderr, "Could not read directory %s\n", argv[argi]);
+        return 1;
+      }
+    } else {
+      minidump_paths.push_back(argv[argi]);
+    }
+  }
+
+  if (minidump_paths.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (worker_count < 1)
+    worker_count = 1;
+  if (static_cast<size_t>(worker_count) > minidump_paths.size())
+    worker_count = minidump_paths.size();
+
+  SharedModuleCache cache(cache_megabytes << 20);
+  WorkStealingScheduler scheduler(worker_count);
+  BatchHandler handler(minidump_paths, symbol_paths, &cache,
+                       scheduler.worker_count(), machine_readable);
+
+  u_int64_t start = NowMicroseconds();
+  scheduler.Run(minidump_paths.size(), &handler);
+  u_int64_t elapsed = NowMicroseconds() - start;
+
+  SharedModuleCache::Stats stats = cache.GetStats();
+  fprintf(stderr,
+          "Processed %llu minidumps (%llu failed) in %.3f s on %d threads "
+          "(%llu stolen); symbol cache %llu hits, %llu misses, "
+          "%llu evictions\n",
+          static_cast<unsigned long long>(minidump_paths.size()),
+          static_cast<unsigned long long>(handler.failures()),
+          elapsed / 1e6, scheduler.worker_count(),
+          static_cast<unsigned long long>(scheduler.steal_count()),
+          static_cast<unsigned long long>(stats.hits),
+          static_cast<unsigned long long>(stats.misses),
+          static_cast<unsigned long long>(stats.evictions));
+
+  return handler.failures() == 0 ? 0 : 1;
+}
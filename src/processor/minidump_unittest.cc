@@ -30,14 +30,18 @@
 // Unit test for Minidump.  Uses a pre-generated minidump and
 // verifies that certain streams are correct.
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 #include <stdlib.h>
 #include <string>
 #include <vector>
 
 #include "breakpad_googletest_includes.h"
+#include "common/minidump_compression.h"
+#include "common/tests/auto_tempdir.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/common/minidump_format.h"
 #include "google_breakpad/processor/minidump.h"
@@ -46,6 +50,11 @@
 
 namespace {
 
+using google_breakpad::AutoTempDir;
+using google_breakpad::CompressedMinidumpBlockBound;
+using google_breakpad::CompressedMinidumpHeader;
+using google_breakpad::CompressedMinidumpRecord;
+using google_breakpad::CompressMinidumpBlock;
 using google_breakpad::Minidump;
 using google_breakpad::MinidumpContext;
 using google_breakpad::MinidumpException;
@@ -70,6 +79,7 @@ using google_breakpad::SynthMinidump::Thread;
 using google_breakpad::test_assembler::kBigEndian;
 using google_breakpad::test_assembler::kLittleEndian;
 using std::ifstream;
+using std::ofstream;
 using std::istringstream;
 using std::vector;
 using ::testing::Return;
@@ -80,6 +90,33 @@ public:
     minidump_file_ = string(getenv("srcdir") ? getenv("srcdir") : ".") +
       "/src/processor/testdata/minidump2.dmp";
   }
+
+  // Appends a record placing |size| bytes of |data| at |offset| to the
+  // compressed minidump |container|.
+  static void AppendRecord(u_int32_t type, u_int32_t offset,
+                           const char* data, size_t size,
+                           string* container) {
+    CompressedMinidumpRecord record = { type, offset,
+                                        static_cast<u_int32_t>(size), 0 };
+    string payload;
+    if (type == google_breakpad::kCompressedMinidumpRecordCompressed) {
+      vector<u_int8_t> compressed(CompressedMinidumpBlockBound(size));
+      vector<u_int16_t> hash_table(
+          google_breakpad::kCompressedMinidumpHashTableSize);
+      size_t compressed_size = CompressMinidumpBlock(
+          reinterpret_cast<const u_int8_t*>(data), size,
+          &compressed[0], compressed.size(), &hash_table[0]);
+      ASSERT_NE(0U, compressed_size);
+      payload.assign(reinterpret_cast<char*>(&compressed[0]),
+                     compressed_size);
+    } else if (type == google_breakpad::kCompressedMinidumpRecordStored) {
+      payload.assign(data, size);
+    }
+    record.stored_size = payload.size();
+    container->append(reinterpret_cast<char*>(&record), sizeof(record));
+    container->append(payload);
+  }
+
   string minidump_file_;
 };
 
@@ -119,6 +156,191 @@ TEST_F(MinidumpTest, TestMinidumpFromStream) {
   //TODO: add more checks here
 }
 
+TEST_F(MinidumpTest, TestMinidumpMemoryMapped) {
+  Minidump streamed(minidump_file_);
+  ASSERT_TRUE(streamed.Read());
+  ASSERT_FALSE(streamed.is_memory_mapped());
+
+  Minidump mapped(minidump_file_, true);
+  ASSERT_EQ(mapped.path(), minidump_file_);
+  ASSERT_TRUE(mapped.Read());
+  ASSERT_TRUE(mapped.is_memory_mapped());
+  ASSERT_EQ(0, memcmp(streamed.header(), mapped.header(),
+                      sizeof(MDRawHeader)));
+
+  // Thread stacks should be identical, and should point into the mapping.
+  MinidumpThreadList* streamed_threads = streamed.GetThreadList();
+  MinidumpThreadList* mapped_threads = mapped.GetThreadList();
+  ASSERT_TRUE(streamed_threads != NULL);
+  ASSERT_TRUE(mapped_threads != NULL);
+  ASSERT_EQ(streamed_threads->thread_count(), mapped_threads->thread_count());
+  for (unsigned int i = 0; i < mapped_threads->thread_count(); ++i) {
+    MinidumpMemoryRegion* streamed_memory =
+        streamed_threads->GetThreadAtIndex(i)->GetMemory();
+    MinidumpMemoryRegion* mapped_memory =
+        mapped_threads->GetThreadAtIndex(i)->GetMemory();
+    ASSERT_TRUE(streamed_memory != NULL);
+    ASSERT_TRUE(mapped_memory != NULL);
+    ASSERT_EQ(streamed_memory->GetBase(), mapped_memory->GetBase());
+    ASSERT_EQ(streamed_memory->GetSize(), mapped_memory->GetSize());
+    const u_int8_t* mapped_bytes = mapped_memory->GetMemory();
+    ASSERT_TRUE(mapped_bytes != NULL);
+    ASSERT_EQ(0, memcmp(streamed_memory->GetMemory(), mapped_bytes,
+                        mapped_memory->GetSize()));
+    const MDRawThread* raw_thread =
+        mapped_threads->GetThreadAtIndex(i)->thread();
+    // Freeing and re-reading returns the same in-place pointer.
+    mapped_memory->FreeMemory();
+    ASSERT_EQ(mapped_bytes, mapped_memory->GetMemory());
+    u_int32_t value;
+    ASSERT_TRUE(mapped_memory->GetMemoryAtAddress(
+        raw_thread->stack.start_of_memory_range, &value));
+  }
+
+  // Module CodeView records should produce the same identifiers.
+  MinidumpModuleList* streamed_modules = streamed.GetModuleList();
+  MinidumpModuleList* mapped_modules = mapped.GetModuleList();
+  ASSERT_TRUE(streamed_modules != NULL);
+  ASSERT_TRUE(mapped_modules != NULL);
+  ASSERT_EQ(streamed_modules->module_count(), mapped_modules->module_count());
+  for (unsigned int i = 0; i < mapped_modules->module_count(); ++i) {
+    const google_breakpad::CodeModule* streamed_module =
+        streamed_modules->GetModuleAtIndex(i);
+    const google_breakpad::CodeModule* mapped_module =
+        mapped_modules->GetModuleAtIndex(i);
+    EXPECT_EQ(streamed_module->code_file(), mapped_module->code_file());
+    EXPECT_EQ(streamed_module->debug_file(), mapped_module->debug_file());
+    EXPECT_EQ(streamed_module->debug_identifier(),
+              mapped_module->debug_identifier());
+  }
+}
+
+TEST_F(MinidumpTest, TestCompressedMinidump) {
+  ifstream file_stream(minidump_file_.c_str(), std::ios::in);
+  ASSERT_TRUE(file_stream.good());
+  string bytes((std::istreambuf_iterator<char>(file_stream)),
+               std::istreambuf_iterator<char>());
+  ASSERT_GT(bytes.size(), sizeof(MDRawHeader));
+
+  // Write the minidump the way the client does: the header first as zeroes
+  // and then patched, the rest in blocks, then an end record.
+  CompressedMinidumpHeader header = {
+    google_breakpad::kCompressedMinidumpSignature,
+    google_breakpad::kCompressedMinidumpVersion
+  };
+  string container(reinterpret_cast<char*>(&header), sizeof(header));
+  const string zeroes(sizeof(MDRawHeader), '\0');
+  AppendRecord(google_breakpad::kCompressedMinidumpRecordCompressed, 0,
+               zeroes.data(), zeroes.size(), &container);
+  const size_t kBlockSize = google_breakpad::kCompressedMinidumpMaxBlockSize;
+  for (size_t offset = sizeof(MDRawHeader); offset < bytes.size();
+       offset += kBlockSize) {
+    AppendRecord(google_breakpad::kCompressedMinidumpRecordCompressed,
+                 offset, bytes.data() + offset,
+                 std::min(kBlockSize, bytes.size() - offset), &container);
+  }
+  AppendRecord(google_breakpad::kCompressedMinidumpRecordStored, 0,
+               bytes.data(), sizeof(MDRawHeader), &container);
+  AppendRecord(google_breakpad::kCompressedMinidumpRecordEnd, bytes.size(),
+               NULL, 0, &container);
+  ASSERT_LT(container.size(), bytes.size());
+
+  AutoTempDir temp_dir;
+  string compressed_file = temp_dir.path() + "/compressed.dmp";
+  {
+    ofstream out(compressed_file.c_str(), std::ios::out | std::ios::binary);
+    out.write(container.data(), container.size());
+    ASSERT_TRUE(out.good());
+  }
+
+  Minidump plain(minidump_file_);
+  ASSERT_TRUE(plain.Read());
+  ASSERT_TRUE(plain.GetThreadList() != NULL);
+
+  istringstream stream(container);
+  Minidump streamed(stream);
+  Minidump from_file(compressed_file);
+  Minidump mapped(compressed_file, true);
+  Minidump* compressed[] = { &streamed, &from_file, &mapped };
+  for (size_t i = 0; i < sizeof(compressed) / sizeof(compressed[0]); ++i) {
+    Minidump* minidump = compressed[i];
+    ASSERT_TRUE(minidump->Read());
+    ASSERT_EQ(0, memcmp(plain.header(), minidump->header(),
+                        sizeof(MDRawHeader)));
+    MinidumpThreadList* threads = minidump->GetThreadList();
+    ASSERT_TRUE(threads != NULL);
+    ASSERT_EQ(plain.GetThreadList()->thread_count(), threads->thread_count());
+    for (unsigned int j = 0; j < threads->thread_count(); ++j) {
+      MinidumpMemoryRegion* plain_memory =
+          plain.GetThreadList()->GetThreadAtIndex(j)->GetMemory();
+      MinidumpMemoryRegion* memory = threads->GetThreadAtIndex(j)->GetMemory();
+      ASSERT_TRUE(memory != NULL);
+      ASSERT_EQ(plain_memory->GetSize(), memory->GetSize());
+      ASSERT_EQ(0, memcmp(plain_memory->GetMemory(), memory->GetMemory(),
+                          memory->GetSize()));
+    }
+    ASSERT_TRUE(minidump->GetModuleList() != NULL);
+    // Reading again starts over from the decompressed copy.
+    ASSERT_TRUE(minidump->Read());
+  }
+
+  // A truncated container is rejected.
+  istringstream truncated(container.substr(0, container.size() - 20));
+  Minidump truncated_minidump(truncated);
+  ASSERT_FALSE(truncated_minidump.Read());
+}
+
+TEST_F(MinidumpTest, TestCompressedMinidumpBadSize) {
+  ifstream file_stream(minidump_file_.c_str(), std::ios::in);
+  ASSERT_TRUE(file_stream.good());
+  string bytes((std::istreambuf_iterator<char>(file_stream)),
+               std::istreambuf_iterator<char>());
+
+  CompressedMinidumpHeader header = {
+    google_breakpad::kCompressedMinidumpSignature,
+    google_breakpad::kCompressedMinidumpVersion
+  };
+  string lone_end(reinterpret_cast<char*>(&header), sizeof(header));
+  string records = lone_end;
+  const size_t kBlockSize = google_breakpad::kCompressedMinidumpMaxBlockSize;
+  for (size_t offset = 0; offset < bytes.size(); offset += kBlockSize) {
+    AppendRecord(google_breakpad::kCompressedMinidumpRecordStored,
+                 offset, bytes.data() + offset,
+                 std::min(kBlockSize, bytes.size() - offset), &records);
+  }
+
+  // A lone end record claiming a huge minidump is rejected before anything
+  // is allocated for it.
+  AppendRecord(google_breakpad::kCompressedMinidumpRecordEnd, 0xFFFFFFF0,
+               NULL, 0, &lone_end);
+  istringstream lone_end_stream(lone_end);
+  Minidump lone_end_minidump(lone_end_stream);
+  ASSERT_FALSE(lone_end_minidump.Read());
+
+  // The same goes for an intact minidump with such an end record.
+  string huge_end = records;
+  AppendRecord(google_breakpad::kCompressedMinidumpRecordEnd, 0xFFFFFFF0,
+               NULL, 0, &huge_end);
+  istringstream huge_end_stream(huge_end);
+  Minidump huge_end_minidump(huge_end_stream);
+  ASSERT_FALSE(huge_end_minidump.Read());
+
+  // An end record that cuts off data some record places is rejected.
+  string short_end = records;
+  AppendRecord(google_breakpad::kCompressedMinidumpRecordEnd,
+               bytes.size() - 1, NULL, 0, &short_end);
+  istringstream short_end_stream(short_end);
+  Minidump short_end_minidump(short_end_stream);
+  ASSERT_FALSE(short_end_minidump.Read());
+
+  // A correct end record is accepted.
+  AppendRecord(google_breakpad::kCompressedMinidumpRecordEnd, bytes.size(),
+               NULL, 0, &records);
+  istringstream records_stream(records);
+  Minidump minidump(records_stream);
+  ASSERT_TRUE(minidump.Read());
+}
+
 TEST(Dump, ReadBackEmpty) {
   Dump dump(0);
   dump.Finish();
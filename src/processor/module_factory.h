@@ -51,11 +51,15 @@ class ModuleFactory {
 
 class BasicModuleFactory : public ModuleFactory {
  public:
+  explicit BasicModuleFactory(bool lazy = false) : lazy_(lazy) { }
   virtual ~BasicModuleFactory() { }
   virtual BasicSourceLineResolver::Module* CreateModule(
       const string &name) const {
-    return new BasicSourceLineResolver::Module(name);
+    return new BasicSourceLineResolver::Module(name, lazy_);
   }
+
+ private:
+  bool lazy_;
 };
 
 class FastModuleFactory : public ModuleFactory {
@@ -35,11 +35,14 @@
 
 #include "processor/module_serializer.h"
 
+#include <string.h>
+
 #include <map>
 #include <string>
 
 #include "processor/basic_code_module.h"
 #include "processor/logging.h"
+#include "processor/serialized_symbol_file.h"
 
 namespace google_breakpad {
 
@@ -96,6 +99,18 @@ char *ModuleSerializer::Write(const BasicSourceLineResolver::Module &module,
 
 char* ModuleSerializer::Serialize(
     const BasicSourceLineResolver::Module &module, unsigned int *size) {
+  // Most of a lazily loaded module's records are still unparsed, so
+  // serialize a fully parsed copy of it instead.
+  if (module.lazy_) {
+    BasicSourceLineResolver::Module parsed_module(module.name_);
+    if (!parsed_module.LoadMapFromMemory(
+            const_cast<char*>(module.symbol_data_))) {
+      if (size) *size = 0;
+      return NULL;
+    }
+    return Serialize(parsed_module, size);
+  }
+
   // Compute size of memory to allocate.
   unsigned int size_to_alloc = SizeOf(module);
 
@@ -188,13 +203,43 @@ char* ModuleSerializer::SerializeSymbolFileData(
     const string &symbol_data, unsigned int *size) {
   scoped_ptr<BasicSourceLineResolver::Module> module(
       new BasicSourceLineResolver::Module("no name"));
-  scoped_array<char> buffer(new char[symbol_data.size() + 1]);
-  strcpy(buffer.get(), symbol_data.c_str());
-  if (!module->LoadMapFromMemory(buffer.get())) {
+  // LoadMapFromMemory doesn't modify the buffer, so there is no need to
+  // copy symbol_data first.
+  if (!module->LoadMapFromMemory(const_cast<char*>(symbol_data.c_str()))) {
     return NULL;
   }
-  buffer.reset(NULL);
   return Serialize(*(module.get()), size);
 }
 
+char* ModuleSerializer::MakeSerializedSymbolFile(
+    const string &symbol_data, unsigned int *size) {
+  scoped_ptr<BasicSourceLineResolver::Module> module(
+      new BasicSourceLineResolver::Module("no name"));
+  if (!module->LoadMapFromMemory(const_cast<char*>(symbol_data.c_str()))) {
+    return NULL;
+  }
+
+  unsigned int data_size = SizeOf(*module);
+  unsigned int file_size = sizeof(SerializedSymbolFileHeader) + data_size;
+  char *file_data = new char[file_size];
+  char *module_data = file_data + sizeof(SerializedSymbolFileHeader);
+
+  // Write the serialized module first, since the header's checksum covers
+  // it.
+  char *end_address = Write(*module, module_data);
+  if (end_address != file_data + file_size) {
+    BPLOG(ERROR) << "data_size differs from size written: " << data_size <<
+                    " vs " << end_address - module_data;
+    delete [] file_data;
+    return NULL;
+  }
+
+  SerializedSymbolFileHeader header;
+  MakeSerializedSymbolFileHeader(module_data, data_size, &header);
+  memcpy(file_data, &header, sizeof(header));
+
+  if (size) *size = file_size;
+  return file_data;
+}
+
 }  // namespace google_breakpad
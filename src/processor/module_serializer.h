@@ -81,6 +81,16 @@ class ModuleSerializer {
   char* SerializeSymbolFileData(const string &symbol_data,
                                 unsigned int *size = NULL);
 
+  // Given the string format symbol_data, produces the contents of a
+  // serialized symbol file: the serialized data preceded by a
+  // SerializedSymbolFileHeader (see serialized_symbol_file.h).  Written to
+  // disk, this can be mapped and used in place by
+  // FastSourceLineResolver::LoadModule.  Caller takes ownership of the
+  // data (on heap), and owner should call delete [] to free the memory
+  // after use.
+  char* MakeSerializedSymbolFile(const string &symbol_data,
+                                 unsigned int *size = NULL);
+
   // Serializes one loaded module with given moduleid in the basic source line
   // resolver, and loads the serialized data into the fast source line resolver.
   // Return false if the basic source line doesn't have a module with the given
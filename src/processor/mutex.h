@@ -0,0 +1,147 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// mutex.h: Minimal pthread-based locking primitives used by the processor
+// to share symbolization state between threads that walk stacks
+// concurrently.
+
+#ifndef PROCESSOR_MUTEX_H__
+#define PROCESSOR_MUTEX_H__
+
+#include <pthread.h>
+
+namespace google_breakpad {
+
+// A non-recursive mutual exclusion lock.
+class Mutex {
+ public:
+  Mutex() { pthread_mutex_init(&mutex_, NULL); }
+  ~Mutex() { pthread_mutex_destroy(&mutex_); }
+
+  void Lock() { pthread_mutex_lock(&mutex_); }
+  void Unlock() { pthread_mutex_unlock(&mutex_); }
+
+ private:
+  friend class ConditionVariable;
+
+  pthread_mutex_t mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  Mutex(const Mutex&);
+  void operator=(const Mutex&);
+};
+
+// Holds a Mutex for the lifetime of the AutoMutexLock.  If the mutex is
+// NULL, this does nothing, which lets callers make locking optional.
+class AutoMutexLock {
+ public:
+  explicit AutoMutexLock(Mutex* mutex) : mutex_(mutex) {
+    if (mutex_)
+      mutex_->Lock();
+  }
+  ~AutoMutexLock() {
+    if (mutex_)
+      mutex_->Unlock();
+  }
+
+ private:
+  Mutex* mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  AutoMutexLock(const AutoMutexLock&);
+  void operator=(const AutoMutexLock&);
+};
+
+// Lets threads holding a Mutex wait until another thread signals them.
+class ConditionVariable {
+ public:
+  ConditionVariable() { pthread_cond_init(&condition_, NULL); }
+  ~ConditionVariable() { pthread_cond_destroy(&condition_); }
+
+  // Releases mutex, which the caller must hold, until the condition is
+  // broadcast, and takes it again before returning.  As wakeups may be
+  // spurious, callers should wait in a loop that rechecks their condition.
+  void Wait(Mutex* mutex) { pthread_cond_wait(&condition_, &mutex->mutex_); }
+  void Broadcast() { pthread_cond_broadcast(&condition_); }
+
+ private:
+  pthread_cond_t condition_;
+
+  // Disallow copy constructor and assignment operator.
+  ConditionVariable(const ConditionVariable&);
+  void operator=(const ConditionVariable&);
+};
+
+// A lock that any number of readers may hold at once, or one writer.
+class ReadWriteLock {
+ public:
+  ReadWriteLock() { pthread_rwlock_init(&lock_, NULL); }
+  ~ReadWriteLock() { pthread_rwlock_destroy(&lock_); }
+
+  void ReadLock() { pthread_rwlock_rdlock(&lock_); }
+  void WriteLock() { pthread_rwlock_wrlock(&lock_); }
+  void Unlock() { pthread_rwlock_unlock(&lock_); }
+
+ private:
+  pthread_rwlock_t lock_;
+
+  // Disallow copy constructor and assignment operator.
+  ReadWriteLock(const ReadWriteLock&);
+  void operator=(const ReadWriteLock&);
+};
+
+// Holds a ReadWriteLock for the lifetime of the AutoReadWriteLock, as a
+// writer if exclusive is true and as a reader otherwise.  If the lock is
+// NULL, this does nothing.
+class AutoReadWriteLock {
+ public:
+  AutoReadWriteLock(ReadWriteLock* lock, bool exclusive) : lock_(lock) {
+    if (!lock_)
+      return;
+    if (exclusive)
+      lock_->WriteLock();
+    else
+      lock_->ReadLock();
+  }
+  ~AutoReadWriteLock() {
+    if (lock_)
+      lock_->Unlock();
+  }
+
+ private:
+  ReadWriteLock* lock_;
+
+  // Disallow copy constructor and assignment operator.
+  AutoReadWriteLock(const AutoReadWriteLock&);
+  void operator=(const AutoReadWriteLock&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_MUTEX_H__
@@ -43,188 +43,283 @@
 
 #include <stdio.h>
 
-#include <sstream>
+#include <limits>
 
 #include "google_breakpad/processor/memory_region.h"
 #include "processor/logging.h"
 
 namespace google_breakpad {
 
-using std::istringstream;
-using std::ostringstream;
-
 
 // A small class used in Evaluate to make sure to clean up the stack
 // before returning failure.
+template<typename Stack>
 class AutoStackClearer {
  public:
-  explicit AutoStackClearer(vector<string> *stack) : stack_(stack) {}
+  explicit AutoStackClearer(Stack *stack) : stack_(stack) {}
   ~AutoStackClearer() { stack_->clear(); }
 
  private:
-  vector<string> *stack_;
+  Stack *stack_;
 };
 
 
+inline int PostfixProgram::Intern(const string &name) {
+  // Expressions only ever name a handful of identifiers.
+  for (size_t i = 0; i < identifiers_.size(); ++i) {
+    if (identifiers_[i] == name)
+      return static_cast<int>(i);
+  }
+  identifiers_.push_back(name);
+  return static_cast<int>(identifiers_.size() - 1);
+}
+
+inline void PostfixProgram::Compile(const string &expression) {
+  expression_ = expression;
+  instructions_.clear();
+  identifiers_.clear();
+  has_assignments_ = false;
+
+  // Tokenize, splitting on whitespace.
+  const char *whitespace = " \t\n\v\f\r";
+  size_t token_begin = expression.find_first_not_of(whitespace);
+  while (token_begin != string::npos) {
+    size_t token_end = expression.find_first_of(whitespace, token_begin);
+    if (token_end == string::npos)
+      token_end = expression.size();
+    string token(expression, token_begin, token_end - token_begin);
+    token_begin = expression.find_first_not_of(whitespace, token_end);
+
+    Instruction instruction = { OP_PUSH_LITERAL, -1, 0, false };
+
+    // Normally, tokens are whitespace-separated, but occasionally, the
+    // assignment operator is smashed up against the next token, i.e.
+    // $T0 $ebp 128 + =$eip $T0 4 + ^ =$ebp $T0 ^ =
+    // This has been observed in program strings produced by MSVS 2010 in LTO
+    // mode.
+    if (token.size() > 1 && token[0] == '=') {
+      instruction.opcode = OP_ASSIGN;
+      instructions_.push_back(instruction);
+      has_assignments_ = true;
+      token.erase(0, 1);
+    }
+
+    if (token == "+") {
+      instruction.opcode = OP_ADD;
+    } else if (token == "-") {
+      instruction.opcode = OP_SUBTRACT;
+    } else if (token == "*") {
+      instruction.opcode = OP_MULTIPLY;
+    } else if (token == "/") {
+      instruction.opcode = OP_DIVIDE_QUOTIENT;
+    } else if (token == "%") {
+      instruction.opcode = OP_DIVIDE_MODULUS;
+    } else if (token == "@") {
+      instruction.opcode = OP_ALIGN;
+    } else if (token == "^") {
+      instruction.opcode = OP_DEREFERENCE;
+    } else if (token == "=") {
+      instruction.opcode = OP_ASSIGN;
+      has_assignments_ = true;
+    } else {
+      // The token is not an operator, it's a literal value or an
+      // identifier.  Literals are decimal, may have a leading '-' sign,
+      // and may then have a sign of their own, as stream extraction
+      // permits; anything else, including a literal too large for even
+      // u_int64_t, is an identifier.
+      instruction.identifier = Intern(token);
+      size_t i = 0;
+      if (i < token.size() && token[i] == '-') {
+        instruction.negative = true;
+        ++i;
+      }
+      if (i < token.size() && (token[i] == '+' || token[i] == '-')) {
+        if (token[i] == '-')
+          instruction.negative = !instruction.negative;
+        ++i;
+      }
+      bool is_literal = i < token.size();
+      for (; is_literal && i < token.size(); ++i) {
+        u_int64_t digit = token[i] - '0';
+        if (token[i] < '0' || token[i] > '9' ||
+            instruction.magnitude >
+                (std::numeric_limits<u_int64_t>::max() - digit) / 10) {
+          is_literal = false;
+        } else {
+          instruction.magnitude = instruction.magnitude * 10 + digit;
+        }
+      }
+      if (!is_literal)
+        instruction.opcode = OP_PUSH_IDENTIFIER;
+    }
+    instructions_.push_back(instruction);
+  }
+}
+
+
 template<typename ValueType>
-bool PostfixEvaluator<ValueType>::EvaluateToken(
-    const string &token,
-    const string &expression,
+bool PostfixEvaluator<ValueType>::EvaluateInstruction(
+    const PostfixProgram::Instruction &instruction,
     DictionaryValidityType *assigned) {
-  // There are enough binary operations that do exactly the same thing
-  // (other than the specific operation, of course) that it makes sense
-  // to share as much code as possible.
-  enum BinaryOperation {
-    BINARY_OP_NONE = 0,
-    BINARY_OP_ADD,
-    BINARY_OP_SUBTRACT,
-    BINARY_OP_MULTIPLY,
-    BINARY_OP_DIVIDE_QUOTIENT,
-    BINARY_OP_DIVIDE_MODULUS,
-    BINARY_OP_ALIGN
-  };
-
-  BinaryOperation operation = BINARY_OP_NONE;
-  if (token == "+")
-    operation = BINARY_OP_ADD;
-  else if (token == "-")
-    operation = BINARY_OP_SUBTRACT;
-  else if (token == "*")
-    operation = BINARY_OP_MULTIPLY;
-  else if (token == "/")
-    operation = BINARY_OP_DIVIDE_QUOTIENT;
-  else if (token == "%")
-    operation = BINARY_OP_DIVIDE_MODULUS;
-  else if (token == "@")
-    operation = BINARY_OP_ALIGN;
-
-  if (operation != BINARY_OP_NONE) {
-    // Get the operands.
-    ValueType operand1 = ValueType();
-    ValueType operand2 = ValueType();
-    if (!PopValues(&operand1, &operand2)) {
-      BPLOG(ERROR) << "Could not PopValues to get two values for binary "
-                      "operation " << token << ": " << expression;
-      return false;
+  const string &expression = program_->expression_;
+  switch (instruction.opcode) {
+    case PostfixProgram::OP_PUSH_LITERAL:
+      // A literal that doesn't fit ValueType is an identifier after all.
+      if (instruction.magnitude <= static_cast<u_int64_t>(
+              std::numeric_limits<ValueType>::max())) {
+        ValueType value = static_cast<ValueType>(instruction.magnitude);
+        PushValue(instruction.negative ? -value : value);
+        break;
+      }
+      // Fall through.
+    case PostfixProgram::OP_PUSH_IDENTIFIER: {
+      StackEntry entry = { ValueType(), instruction.identifier };
+      stack_.push_back(entry);
+      break;
     }
 
-    // Perform the operation.
-    ValueType result;
-    switch (operation) {
-      case BINARY_OP_ADD:
-        result = operand1 + operand2;
-        break;
-      case BINARY_OP_SUBTRACT:
-        result = operand1 - operand2;
-        break;
-      case BINARY_OP_MULTIPLY:
-        result = operand1 * operand2;
-        break;
-      case BINARY_OP_DIVIDE_QUOTIENT:
-        result = operand1 / operand2;
-        break;
-      case BINARY_OP_DIVIDE_MODULUS:
-        result = operand1 % operand2;
-        break;
-      case BINARY_OP_ALIGN:
-	result =
-	  operand1 & (static_cast<ValueType>(-1) ^ (operand2 - 1));
-        break;
-      case BINARY_OP_NONE:
-        // This will not happen, but compilers will want a default or
-        // BINARY_OP_NONE case.
-        BPLOG(ERROR) << "Not reached!";
+    case PostfixProgram::OP_ADD:
+    case PostfixProgram::OP_SUBTRACT:
+    case PostfixProgram::OP_MULTIPLY:
+    case PostfixProgram::OP_DIVIDE_QUOTIENT:
+    case PostfixProgram::OP_DIVIDE_MODULUS:
+    case PostfixProgram::OP_ALIGN: {
+      // Get the operands.
+      ValueType operand1 = ValueType();
+      ValueType operand2 = ValueType();
+      if (!PopValues(&operand1, &operand2)) {
+        static const char kOperators[] = "+-*/%@";
+        BPLOG(ERROR) << "Could not PopValues to get two values for binary "
+                        "operation " <<
+                        kOperators[instruction.opcode -
+                                   PostfixProgram::OP_ADD] <<
+                        ": " << expression;
         return false;
-        break;
-    }
+      }
 
-    // Save the result.
-    PushValue(result);
-  } else if (token == "^") {
-    // ^ for unary dereference.  Can't dereference without memory.
-    if (!memory_) {
-      BPLOG(ERROR) << "Attempt to dereference without memory: " <<
-                      expression;
-      return false;
-    }
+      // Perform the operation.
+      ValueType result = ValueType();
+      switch (instruction.opcode) {
+        case PostfixProgram::OP_ADD:
+          result = operand1 + operand2;
+          break;
+        case PostfixProgram::OP_SUBTRACT:
+          result = operand1 - operand2;
+          break;
+        case PostfixProgram::OP_MULTIPLY:
+          result = operand1 * operand2;
+          break;
+        case PostfixProgram::OP_DIVIDE_QUOTIENT:
+          result = operand1 / operand2;
+          break;
+        case PostfixProgram::OP_DIVIDE_MODULUS:
+          result = operand1 % operand2;
+          break;
+        case PostfixProgram::OP_ALIGN:
+          result =
+            operand1 & (static_cast<ValueType>(-1) ^ (operand2 - 1));
+          break;
+        default:
+          // This will not happen, but compilers will want a default.
+          BPLOG(ERROR) << "Not reached!";
+          return false;
+      }
 
-    ValueType address;
-    if (!PopValue(&address)) {
-      BPLOG(ERROR) << "Could not PopValue to get value to derefence: " <<
-                      expression;
-      return false;
+      // Save the result.
+      PushValue(result);
+      break;
     }
 
-    ValueType value;
-    if (!memory_->GetMemoryAtAddress(address, &value)) {
-      BPLOG(ERROR) << "Could not dereference memory at address " <<
-                      HexString(address) << ": " << expression;
-      return false;
-    }
+    case PostfixProgram::OP_DEREFERENCE: {
+      // ^ for unary dereference.  Can't dereference without memory.
+      if (!memory_) {
+        BPLOG(ERROR) << "Attempt to dereference without memory: " <<
+                        expression;
+        return false;
+      }
 
-    PushValue(value);
-  } else if (token == "=") {
-    // = for assignment.
-    ValueType value;
-    if (!PopValue(&value)) {
-      BPLOG(INFO) << "Could not PopValue to get value to assign: " <<
-                     expression;
-      return false;
-    }
+      ValueType address;
+      if (!PopValue(&address)) {
+        BPLOG(ERROR) << "Could not PopValue to get value to derefence: " <<
+                        expression;
+        return false;
+      }
 
-    // Assignment is only meaningful when assigning into an identifier.
-    // The identifier must name a variable, not a constant.  Variables
-    // begin with '$'.
-    string identifier;
-    if (PopValueOrIdentifier(NULL, &identifier) != POP_RESULT_IDENTIFIER) {
-      BPLOG(ERROR) << "PopValueOrIdentifier returned a value, but an "
-                      "identifier is needed to assign " <<
-                      HexString(value) << ": " << expression;
-      return false;
-    }
-    if (identifier.empty() || identifier[0] != '$') {
-      BPLOG(ERROR) << "Can't assign " << HexString(value) << " to " <<
-                      identifier << ": " << expression;
-      return false;
+      ValueType value;
+      if (!memory_->GetMemoryAtAddress(address, &value)) {
+        BPLOG(ERROR) << "Could not dereference memory at address " <<
+                        HexString(address) << ": " << expression;
+        return false;
+      }
+
+      PushValue(value);
+      break;
     }
 
-    (*dictionary_)[identifier] = value;
-    if (assigned)
-      (*assigned)[identifier] = true;
-  } else {
-    // The token is not an operator, it's a literal value or an identifier.
-    // Push it onto the stack as-is.  Use push_back instead of PushValue
-    // because PushValue pushes ValueType as a string, but token is already
-    // a string.
-    stack_.push_back(token);
+    case PostfixProgram::OP_ASSIGN: {
+      // = for assignment.
+      ValueType value;
+      if (!PopValue(&value)) {
+        BPLOG(INFO) << "Could not PopValue to get value to assign: " <<
+                       expression;
+        return false;
+      }
+
+      // Assignment is only meaningful when assigning into an identifier.
+      // The identifier must name a variable, not a constant.  Variables
+      // begin with '$'.
+      int identifier;
+      if (PopValueOrIdentifier(NULL, &identifier) != POP_RESULT_IDENTIFIER) {
+        BPLOG(ERROR) << "PopValueOrIdentifier returned a value, but an "
+                        "identifier is needed to assign " <<
+                        HexString(value) << ": " << expression;
+        return false;
+      }
+      const string &name = program_->identifiers_[identifier];
+      if (name.empty() || name[0] != '$') {
+        BPLOG(ERROR) << "Can't assign " << HexString(value) << " to " <<
+                        name << ": " << expression;
+        return false;
+      }
+
+      (*dictionary_)[name] = value;
+      identifier_values_[identifier].state = IDENTIFIER_DEFINED;
+      identifier_values_[identifier].value = value;
+      if (assigned)
+        (*assigned)[name] = true;
+      break;
+    }
   }
   return true;
 }
 
 template<typename ValueType>
 bool PostfixEvaluator<ValueType>::EvaluateInternal(
-    const string &expression,
+    const PostfixProgram &program,
+    const ValueType * const *bindings,
     DictionaryValidityType *assigned) {
-  // Tokenize, splitting on whitespace.
-  istringstream stream(expression);
-  string token;
-  while (stream >> token) {
-    // Normally, tokens are whitespace-separated, but occasionally, the
-    // assignment operator is smashed up against the next token, i.e.
-    // $T0 $ebp 128 + =$eip $T0 4 + ^ =$ebp $T0 ^ =
-    // This has been observed in program strings produced by MSVS 2010 in LTO
-    // mode.
-    if (token.size() > 1 && token[0] == '=') {
-      if (!EvaluateToken("=", expression, assigned)) {
-        return false;
+  program_ = &program;
+  IdentifierValue unknown = { IDENTIFIER_UNKNOWN, ValueType() };
+  identifier_values_.assign(program.identifiers_.size(), unknown);
+  if (bindings) {
+    if (program.has_assignments_) {
+      BPLOG(ERROR) << "Bindings don't suit expression: " <<
+                      program.expression_;
+      return false;
+    }
+    for (size_t i = 0; i < program.identifiers_.size(); ++i) {
+      if (bindings[i]) {
+        identifier_values_[i].state = IDENTIFIER_DEFINED;
+        identifier_values_[i].value = *bindings[i];
+      } else {
+        identifier_values_[i].state = IDENTIFIER_UNDEFINED;
       }
+    }
+  }
 
-      if (!EvaluateToken(token.substr(1), expression, assigned)) {
-        return false;
-      }
-    } else if (!EvaluateToken(token, expression, assigned)) {
+  for (size_t i = 0; i < program.instructions_.size(); ++i) {
+    if (!EvaluateInstruction(program.instructions_[i], assigned))
       return false;
-    }
   }
 
   return true;
@@ -233,10 +328,22 @@ bool PostfixEvaluator<ValueType>::EvaluateInternal(
 template<typename ValueType>
 bool PostfixEvaluator<ValueType>::Evaluate(const string &expression,
                                            DictionaryValidityType *assigned) {
+  return Evaluate(PostfixProgram(expression), assigned);
+}
+
+template<typename ValueType>
+bool PostfixEvaluator<ValueType>::EvaluateForValue(const string &expression,
+                                                   ValueType *result) {
+  return EvaluateForValue(PostfixProgram(expression), result);
+}
+
+template<typename ValueType>
+bool PostfixEvaluator<ValueType>::Evaluate(const PostfixProgram &program,
+                                           DictionaryValidityType *assigned) {
   // Ensure that the stack is cleared before returning.
-  AutoStackClearer clearer(&stack_);
+  AutoStackClearer< vector<StackEntry> > clearer(&stack_);
 
-  if (!EvaluateInternal(expression, assigned))
+  if (!EvaluateInternal(program, NULL, assigned))
     return false;
 
   // If there's anything left on the stack, it indicates incomplete execution.
@@ -245,23 +352,39 @@ bool PostfixEvaluator<ValueType>::Evaluate(const string &expression,
   if (stack_.empty())
     return true;
 
-  BPLOG(ERROR) << "Incomplete execution: " << expression;
+  BPLOG(ERROR) << "Incomplete execution: " << program.expression();
   return false;
 }
 
 template<typename ValueType>
-bool PostfixEvaluator<ValueType>::EvaluateForValue(const string &expression,
-                                                   ValueType *result) {
+bool PostfixEvaluator<ValueType>::EvaluateForValue(
+    const PostfixProgram &program, ValueType *result) {
+  return EvaluateForValueInternal(program, NULL, result);
+}
+
+template<typename ValueType>
+bool PostfixEvaluator<ValueType>::EvaluateForValue(
+    const PostfixProgram &program,
+    const ValueType * const *bindings,
+    ValueType *result) {
+  return EvaluateForValueInternal(program, bindings, result);
+}
+
+template<typename ValueType>
+bool PostfixEvaluator<ValueType>::EvaluateForValueInternal(
+    const PostfixProgram &program,
+    const ValueType * const *bindings,
+    ValueType *result) {
   // Ensure that the stack is cleared before returning.
-  AutoStackClearer clearer(&stack_);
+  AutoStackClearer< vector<StackEntry> > clearer(&stack_);
 
-  if (!EvaluateInternal(expression, NULL))
+  if (!EvaluateInternal(program, bindings, NULL))
     return false;
 
   // A successful execution should leave exactly one value on the stack.
   if (stack_.size() != 1) {
     BPLOG(ERROR) << "Expression yielded bad number of results: "
-                 << "'" << expression << "'";
+                 << "'" << program.expression() << "'";
     return false;
   }
 
@@ -271,43 +394,21 @@ bool PostfixEvaluator<ValueType>::EvaluateForValue(const string &expression,
 template<typename ValueType>
 typename PostfixEvaluator<ValueType>::PopResult
 PostfixEvaluator<ValueType>::PopValueOrIdentifier(
-    ValueType *value, string *identifier) {
+    ValueType *value, int *identifier) {
   // There needs to be at least one element on the stack to pop.
   if (!stack_.size())
     return POP_RESULT_FAIL;
 
-  string token = stack_.back();
+  StackEntry entry = stack_.back();
   stack_.pop_back();
 
-  // First, try to treat the value as a literal. Literals may have leading
-  // '-' sign, and the entire remaining string must be parseable as
-  // ValueType. If this isn't possible, it can't be a literal, so treat it
-  // as an identifier instead.
-  //
-  // Some versions of the libstdc++, the GNU standard C++ library, have
-  // stream extractors for unsigned integer values that permit a leading
-  // '-' sign (6.0.13); others do not (6.0.9). Since we require it, we
-  // handle it explicitly here.
-  istringstream token_stream(token);
-  ValueType literal = ValueType();
-  bool negative;
-  if (token_stream.peek() == '-') {
-    negative = true;
-    token_stream.get();
-  } else {
-    negative = false;
-  }
-  if (token_stream >> literal && token_stream.peek() == EOF) {
-    if (value) {
-      *value = literal;
-    }
-    if (negative)
-      *value = -*value;
+  if (entry.identifier < 0) {
+    if (value)
+      *value = entry.value;
     return POP_RESULT_VALUE;
   } else {
-    if (identifier) {
-      *identifier = token;
-    }
+    if (identifier)
+      *identifier = entry.identifier;
     return POP_RESULT_IDENTIFIER;
   }
 }
@@ -316,26 +417,37 @@ PostfixEvaluator<ValueType>::PopValueOrIdentifier(
 template<typename ValueType>
 bool PostfixEvaluator<ValueType>::PopValue(ValueType *value) {
   ValueType literal = ValueType();
-  string token;
+  int identifier;
   PopResult result;
-  if ((result = PopValueOrIdentifier(&literal, &token)) == POP_RESULT_FAIL) {
+  if ((result = PopValueOrIdentifier(&literal, &identifier)) ==
+      POP_RESULT_FAIL) {
     return false;
   } else if (result == POP_RESULT_VALUE) {
     // This is the easy case.
     *value = literal;
   } else {  // result == POP_RESULT_IDENTIFIER
     // There was an identifier at the top of the stack.  Resolve it to a
-    // value by looking it up in the dictionary.
-    typename DictionaryType::const_iterator iterator =
-        dictionary_->find(token);
-    if (iterator == dictionary_->end()) {
+    // value, looking it up in the dictionary if it hasn't been already.
+    IdentifierValue &identifier_value = identifier_values_[identifier];
+    if (identifier_value.state == IDENTIFIER_UNKNOWN) {
+      typename DictionaryType::const_iterator iterator =
+          dictionary_->find(program_->identifiers_[identifier]);
+      if (iterator == dictionary_->end()) {
+        identifier_value.state = IDENTIFIER_UNDEFINED;
+      } else {
+        identifier_value.state = IDENTIFIER_DEFINED;
+        identifier_value.value = iterator->second;
+      }
+    }
+    if (identifier_value.state == IDENTIFIER_UNDEFINED) {
       // The identifier wasn't found in the dictionary.  Don't imply any
       // default value, just fail.
-      BPLOG(INFO) << "Identifier " << token << " not in dictionary";
+      BPLOG(INFO) << "Identifier " << program_->identifiers_[identifier] <<
+                     " not in dictionary";
       return false;
     }
 
-    *value = iterator->second;
+    *value = identifier_value.value;
   }
 
   return true;
@@ -351,9 +463,8 @@ bool PostfixEvaluator<ValueType>::PopValues(ValueType *value1,
 
 template<typename ValueType>
 void PostfixEvaluator<ValueType>::PushValue(const ValueType &value) {
-  ostringstream token_stream;
-  token_stream << value;
-  stack_.push_back(token_stream.str());
+  StackEntry entry = { value, -1 };
+  stack_.push_back(entry);
 }
 
 
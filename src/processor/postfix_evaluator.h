@@ -64,6 +64,12 @@
 // obtained from MSVC frame data debugging information in pdb files as
 // returned by the DIA APIs.
 //
+// Expressions are compiled into a PostfixProgram before they are evaluated:
+// its tokens are classified once, literals are converted to numbers, and
+// identifiers are interned, so that evaluation itself works on a stack of
+// numbers and never rescans the expression.  Callers that evaluate the same
+// expression repeatedly should compile it once and keep the PostfixProgram.
+//
 // Author: Mark Mentovai
 
 #ifndef PROCESSOR_POSTFIX_EVALUATOR_H__
@@ -75,6 +81,7 @@
 #include <vector>
 
 #include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
 
 namespace google_breakpad {
 
@@ -83,6 +90,69 @@ using std::vector;
 
 class MemoryRegion;
 
+// A postfix expression compiled for evaluation by PostfixEvaluator.
+class PostfixProgram {
+ public:
+  PostfixProgram() : has_assignments_(false) {}
+  explicit PostfixProgram(const string &expression)
+      : has_assignments_(false) {
+    Compile(expression);
+  }
+
+  // Replace this program with the compiled form of expression.  This
+  // can't fail: any token that isn't an operator or a literal is taken to
+  // be an identifier, and other errors are reported by evaluation.
+  void Compile(const string &expression);
+
+  // The expression this program was compiled from.
+  const string &expression() const { return expression_; }
+  bool empty() const { return expression_.empty(); }
+
+  // True if the program assigns to any variable.
+  bool has_assignments() const { return has_assignments_; }
+
+  // The constants and variables the program refers to, each named once.
+  const vector<string> &identifiers() const { return identifiers_; }
+
+ private:
+  template<typename> friend class PostfixEvaluator;
+
+  enum Opcode {
+    OP_PUSH_LITERAL = 0,
+    OP_PUSH_IDENTIFIER,
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE_QUOTIENT,
+    OP_DIVIDE_MODULUS,
+    OP_ALIGN,
+    OP_DEREFERENCE,
+    OP_ASSIGN
+  };
+
+  struct Instruction {
+    Opcode opcode;
+
+    // For OP_PUSH_IDENTIFIER, the index in identifiers_ of the identifier
+    // to push.  For OP_PUSH_LITERAL, the index of the literal's own text,
+    // which stands for an identifier of that name instead if the literal
+    // is too large for the evaluator's ValueType.
+    int identifier;
+
+    // For OP_PUSH_LITERAL, the literal's magnitude and sign.
+    u_int64_t magnitude;
+    bool negative;
+  };
+
+  // Returns the index of name in identifiers_, adding it if necessary.
+  int Intern(const string &name);
+
+  string expression_;
+  vector<Instruction> instructions_;
+  vector<string> identifiers_;
+  bool has_assignments_;
+};
+
 template<typename ValueType>
 class PostfixEvaluator {
  public:
@@ -96,7 +166,8 @@ class PostfixEvaluator {
   // will fail in that case unless set_dictionary is used before calling
   // Evaluate.
   PostfixEvaluator(DictionaryType *dictionary, const MemoryRegion *memory)
-      : dictionary_(dictionary), memory_(memory), stack_() {}
+      : dictionary_(dictionary), memory_(memory), program_(NULL), stack_(),
+        identifier_values_() {}
 
   // Evaluate the expression, starting with an empty stack. The results of
   // execution will be stored in one (or more) variables in the dictionary.
@@ -113,6 +184,19 @@ class PostfixEvaluator {
   // Otherwise, return false.
   bool EvaluateForValue(const string &expression, ValueType *result);
 
+  // The same, for an expression that has already been compiled.
+  bool Evaluate(const PostfixProgram &program,
+                DictionaryValidityType *assigned);
+  bool EvaluateForValue(const PostfixProgram &program, ValueType *result);
+
+  // Like EvaluateForValue, but without consulting the dictionary: bindings
+  // is an array of program.identifiers().size() pointers, and the value of
+  // program.identifiers()[i] is *bindings[i], or undefined if bindings[i]
+  // is NULL.  Fails for programs that make assignments.
+  bool EvaluateForValue(const PostfixProgram &program,
+                        const ValueType * const *bindings,
+                        ValueType *result);
+
   DictionaryType* dictionary() const { return dictionary_; }
 
   // Reset the dictionary.  PostfixEvaluator does not take ownership.
@@ -126,13 +210,35 @@ class PostfixEvaluator {
     POP_RESULT_IDENTIFIER
   };
 
+  // An entry on the stack: either a value, or an identifier whose value
+  // is looked up when the entry is popped.
+  struct StackEntry {
+    ValueType value;
+
+    // The index of the identifier in program_'s identifiers_, or -1 if
+    // this entry is a value.
+    int identifier;
+  };
+
+  // What is known about an identifier's value during an evaluation.
+  enum IdentifierState {
+    IDENTIFIER_UNKNOWN = 0,  // not looked up in the dictionary yet
+    IDENTIFIER_DEFINED,
+    IDENTIFIER_UNDEFINED
+  };
+
+  struct IdentifierValue {
+    IdentifierState state;
+    ValueType value;
+  };
+
   // Retrieves the topmost literal value, constant, or variable from the
   // stack.  Returns POP_RESULT_VALUE if the topmost entry is a literal
   // value, and sets |value| accordingly.  Returns POP_RESULT_IDENTIFIER
   // if the topmost entry is a constant or variable identifier, and sets
-  // |identifier| accordingly.  Returns POP_RESULT_FAIL on failure, such
-  // as when the stack is empty.
-  PopResult PopValueOrIdentifier(ValueType *value, string *identifier);
+  // |identifier| to its index in program_'s identifiers.  Returns
+  // POP_RESULT_FAIL on failure, such as when the stack is empty.
+  PopResult PopValueOrIdentifier(ValueType *value, int *identifier);
 
   // Retrieves the topmost value on the stack.  If the topmost entry is
   // an identifier, the dictionary is queried for the identifier's value.
@@ -148,15 +254,21 @@ class PostfixEvaluator {
   // Pushes a new value onto the stack.
   void PushValue(const ValueType &value);
 
-  // Evaluate expression, updating *assigned if it is non-zero. Return
-  // true if evaluation completes successfully. Do not clear the stack
-  // upon successful evaluation.
-  bool EvaluateInternal(const string &expression,
+  // Evaluate program, updating *assigned if it is non-zero. Identifiers
+  // are resolved using bindings if it is non-NULL, and the dictionary
+  // otherwise. Return true if evaluation completes successfully. Do not
+  // clear the stack upon successful evaluation.
+  bool EvaluateInternal(const PostfixProgram &program,
+                        const ValueType * const *bindings,
                         DictionaryValidityType *assigned);
 
-  bool EvaluateToken(const string &token,
-                     const string &expression,
-                     DictionaryValidityType *assigned);
+  // EvaluateForValue, with bindings as for EvaluateInternal.
+  bool EvaluateForValueInternal(const PostfixProgram &program,
+                                const ValueType * const *bindings,
+                                ValueType *result);
+
+  bool EvaluateInstruction(const PostfixProgram::Instruction &instruction,
+                           DictionaryValidityType *assigned);
 
   // The dictionary mapping constant and variable identifiers (strings) to
   // values.  Keys beginning with '$' are treated as variable names, and
@@ -167,10 +279,17 @@ class PostfixEvaluator {
   // If NULL, dereferencing is unsupported and will fail.  Weak pointer.
   const MemoryRegion *memory_;
 
+  // The program being evaluated.  Weak pointer.
+  const PostfixProgram *program_;
+
   // The stack contains state information as execution progresses.  Values
-  // are pushed on to it as the expression string is read and as operations
-  // yield values; values are popped when used as operands to operators.
-  vector<string> stack_;
+  // are pushed on to it as the program is run and as operations yield
+  // values; values are popped when used as operands to operators.
+  vector<StackEntry> stack_;
+
+  // The values of program_'s identifiers, indexed like its identifiers_, so
+  // that each is looked up in the dictionary at most once per evaluation.
+  vector<IdentifierValue> identifier_values_;
 };
 
 }  // namespace google_breakpad
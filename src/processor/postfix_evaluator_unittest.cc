@@ -50,6 +50,7 @@ namespace {
 using std::map;
 using google_breakpad::MemoryRegion;
 using google_breakpad::PostfixEvaluator;
+using google_breakpad::PostfixProgram;
 
 
 // FakeMemoryRegion is used to test PostfixEvaluator's dereference (^)
@@ -385,6 +386,68 @@ static bool RunTests() {
     return false;
   }
 
+  // A compiled program can be evaluated any number of times, against any
+  // dictionary, and sees the dictionary's current values each time.
+  PostfixProgram program("$result $input 8 @ ^ 2 * =");
+  if (!program.has_assignments() ||
+      PostfixProgram("$input 8 @ ^").has_assignments()) {
+    fprintf(stderr, "FAIL: program assignments\n");
+    return false;
+  }
+  PostfixEvaluator<unsigned int>::DictionaryType dictionary_3;
+  postfix_evaluator.set_dictionary(&dictionary_3);
+  for (unsigned int input = 0; input < 100; input++) {
+    dictionary_3["$input"] = input;
+    if (!postfix_evaluator.Evaluate(program, NULL) ||
+        dictionary_3["$result"] != ((input & ~7U) + 1) * 2) {
+      fprintf(stderr, "FAIL: compiled program, input %u\n", input);
+      return false;
+    }
+  }
+  if (program.expression() != "$result $input 8 @ ^ 2 * =") {
+    fprintf(stderr, "FAIL: compiled program expression\n");
+    return false;
+  }
+
+  // Literals too large for the evaluator's type are identifiers, as are
+  // tokens that are only partly numeric.
+  dictionary_3["4294967296"] = 7;
+  dictionary_3["12abc"] = 9;
+  const EvaluateForValueTest evaluate_for_value_tests_3[] = {
+    { "4294967295",             true,  4294967295U },   // largest literal
+    { "4294967296",             true,  7 },             // identifier
+    { "12abc 1 +",              true,  10 },            // identifier
+    { "-+5",                    true,  0xfffffffb },    // explicit sign
+    { "--5",                    true,  5 },             // double negative
+    { "$input 2 = $input",      true,  2 },             // sees assignment
+    { "99999999999999999999",   false, 0 },             // unknown identifier
+    { "=",                      false, 0 }              // nothing to assign
+  };
+  const int evaluate_for_value_tests_3_size
+      = (sizeof (evaluate_for_value_tests_3)
+         / sizeof (evaluate_for_value_tests_3[0]));
+  for (int i = 0; i < evaluate_for_value_tests_3_size; i++) {
+    const EvaluateForValueTest *test = &evaluate_for_value_tests_3[i];
+    unsigned int result;
+    if (postfix_evaluator.EvaluateForValue(PostfixProgram(test->expression),
+                                           &result) != test->evaluable ||
+        (test->evaluable && result != test->value)) {
+      fprintf(stderr, "FAIL: compiled evaluate for value test %d\n", i);
+      return false;
+    }
+  }
+
+  // A 64-bit evaluator takes 4294967296 as a literal.
+  PostfixEvaluator<u_int64_t>::DictionaryType dictionary_4;
+  PostfixEvaluator<u_int64_t> postfix_evaluator_64(&dictionary_4,
+                                                   &fake_memory);
+  u_int64_t result_64;
+  if (!postfix_evaluator_64.EvaluateForValue("4294967296 1 -", &result_64) ||
+      result_64 != 0xffffffffULL) {
+    fprintf(stderr, "FAIL: 64-bit literal\n");
+    return false;
+  }
+
   return true;
 }
 
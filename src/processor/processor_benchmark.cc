@@ -0,0 +1,705 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// processor_benchmark.cc: Measures the throughput of the minidump
+// processor, phase by phase.
+//
+// Synthetic Windows x86 minidumps are built with SynthMinidump at a range
+// of thread, module and stack sizes, each thread's stack holding a chain
+// of %ebp frames that return into the modules, and each module having a
+// synthetic symbol file.  For each, these phases are timed:
+//   read:      Minidump::Read, and reading the thread, module and memory
+//              lists, from an in-memory copy of the minidump
+//   walk:      MinidumpProcessor::Process without symbols
+//   load:      loading every module's symbols into a
+//              BasicSourceLineResolver
+//   symbolize: MinidumpProcessor::Process with every module's symbols
+//              already loaded
+// Then every minidump in the corpus directory (src/processor/testdata by
+// default) is timed for read, and for process_cold and process_warm:
+// processing with its symbols from the corpus's symbols directory, loaded
+// afresh each time or once beforehand.
+//
+// Results are printed one line per case and phase, as fields separated by
+// '|', in the order named by the "#" header line.  Allocations count calls
+// to operator new and the bytes they request; peak RSS is that reached
+// during the phase on Linux 4.0 and later, and the process's peak so far
+// elsewhere.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/symbol_supplier.h"
+#include "processor/basic_code_module.h"
+#include "processor/logging.h"
+#include "processor/scoped_ptr.h"
+#include "processor/simple_symbol_supplier.h"
+#include "processor/synth_minidump.h"
+
+namespace {
+
+using google_breakpad::BasicCodeModule;
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::CodeModule;
+using google_breakpad::Minidump;
+using google_breakpad::MinidumpProcessor;
+using google_breakpad::ProcessState;
+using google_breakpad::scoped_ptr;
+using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::SymbolSupplier;
+using google_breakpad::SystemInfo;
+using google_breakpad::test_assembler::kLittleEndian;
+using std::istringstream;
+using std::map;
+using std::vector;
+
+namespace SynthMinidump = google_breakpad::SynthMinidump;
+
+// Bumped whenever the output format changes.
+static const int kOutputVersion = 1;
+
+// Separator character for machine readable output.
+static const char kOutputSeparator = '|';
+
+// The layout of synthetic modules: where the first one is loaded, how far
+// apart they are, and how many functions their symbol files describe.
+static const u_int32_t kModuleBase = 0x10000000;
+static const u_int32_t kModuleSpacing = 0x01000000;
+static const u_int32_t kModuleSize = 0x00100000;
+static const u_int32_t kFunctionBase = 0x1000;
+static const u_int32_t kFunctionSize = 0x100;
+static const int kFunctionCount = 1000;
+
+// Where synthetic thread stacks are placed, how far apart, and the size of
+// each frame.
+static const u_int32_t kStackBase = 0x01000000;
+static const u_int32_t kStackSpacing = 0x00100000;
+static const u_int32_t kFrameSize = 16;
+
+// Totals of the operator new calls made so far.  The benchmark is single
+// threaded, so these need no lock.
+u_int64_t allocation_count = 0;
+u_int64_t allocated_bytes = 0;
+
+}  // namespace
+
+void *operator new(size_t size) {
+  ++allocation_count;
+  allocated_bytes += size;
+  void *memory = malloc(size ? size : 1);
+  if (!memory)
+    throw std::bad_alloc();
+  return memory;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *memory) throw() {
+  free(memory);
+}
+
+void operator delete[](void *memory) throw() {
+  free(memory);
+}
+
+// Compilers with sized deallocation call these instead of the above.
+void operator delete(void *memory, size_t) throw() {
+  operator delete(memory);
+}
+
+void operator delete[](void *memory, size_t) throw() {
+  operator delete[](memory);
+}
+
+namespace {
+
+u_int64_t NowMicroseconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<u_int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// Resets the high-water mark that PeakRSSKB reports, where the kernel
+// supports it.
+void ResetPeakRSS() {
+  FILE *clear_refs = fopen("/proc/self/clear_refs", "w");
+  if (clear_refs) {
+    fputs("5", clear_refs);
+    fclose(clear_refs);
+  }
+}
+
+// Returns the peak resident set size since ResetPeakRSS, or failing that,
+// of the process so far, in kilobytes.
+long PeakRSSKB() {
+  FILE *status = fopen("/proc/self/status", "r");
+  if (status) {
+    char line[256];
+    long peak = -1;
+    while (fgets(line, sizeof(line), status)) {
+      if (strncmp(line, "VmHWM:", 6) == 0) {
+        peak = strtol(line + 6, NULL, 10);
+        break;
+      }
+    }
+    fclose(status);
+    if (peak >= 0)
+      return peak;
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+// Measures one phase of one case, from construction until Report.
+class PhaseTimer {
+ public:
+  PhaseTimer() {
+    ResetPeakRSS();
+    start_allocations_ = allocation_count;
+    start_bytes_ = allocated_bytes;
+    start_ = NowMicroseconds();
+  }
+
+  // Prints the measurements, given that the phase repeated its work
+  // iterations times, processing items_per_iteration of item_unit each
+  // time.
+  void Report(const string &case_name, const char *phase, int iterations,
+              u_int64_t items_per_iteration, const char *item_unit) {
+    u_int64_t elapsed = NowMicroseconds() - start_;
+    if (elapsed == 0)
+      elapsed = 1;
+    printf("%s%c%s%c%d%c%.1f%c%llu%c%s%c%.0f%c%llu%c%llu%c%ld\n",
+           case_name.c_str(), kOutputSeparator,
+           phase, kOutputSeparator,
+           iterations, kOutputSeparator,
+           static_cast<double>(elapsed) / iterations, kOutputSeparator,
+           static_cast<unsigned long long>(items_per_iteration),
+           kOutputSeparator,
+           item_unit, kOutputSeparator,
+           items_per_iteration * iterations * 1e6 / elapsed,
+           kOutputSeparator,
+           static_cast<unsigned long long>(
+               (allocation_count - start_allocations_) / iterations),
+           kOutputSeparator,
+           static_cast<unsigned long long>(
+               (allocated_bytes - start_bytes_) / iterations),
+           kOutputSeparator,
+           PeakRSSKB());
+    fflush(stdout);
+  }
+
+ private:
+  u_int64_t start_;
+  u_int64_t start_allocations_;
+  u_int64_t start_bytes_;
+};
+
+// A SymbolSupplier serving symbol files held in memory, keyed by the
+// modules' code_file.
+class MemorySymbolSupplier : public SymbolSupplier {
+ public:
+  explicit MemorySymbolSupplier(const map<string, string> *symbol_files)
+      : symbol_files_(symbol_files) {}
+  virtual ~MemorySymbolSupplier() {
+    for (map<string, char *>::iterator it = memory_buffers_.begin();
+         it != memory_buffers_.end(); ++it) {
+      delete [] it->second;
+    }
+  }
+
+  virtual SymbolResult GetSymbolFile(const CodeModule *module,
+                                     const SystemInfo *system_info,
+                                     string *symbol_file) {
+    return symbol_files_->count(module->code_file()) ? FOUND : NOT_FOUND;
+  }
+
+  virtual SymbolResult GetSymbolFile(const CodeModule *module,
+                                     const SystemInfo *system_info,
+                                     string *symbol_file,
+                                     string *symbol_data) {
+    map<string, string>::const_iterator it =
+        symbol_files_->find(module->code_file());
+    if (it == symbol_files_->end())
+      return NOT_FOUND;
+    *symbol_data = it->second;
+    return FOUND;
+  }
+
+  virtual SymbolResult GetCStringSymbolData(const CodeModule *module,
+                                            const SystemInfo *system_info,
+                                            string *symbol_file,
+                                            char **symbol_data) {
+    map<string, string>::const_iterator it =
+        symbol_files_->find(module->code_file());
+    if (it == symbol_files_->end())
+      return NOT_FOUND;
+    FreeSymbolData(module);
+    char *buffer = new char[it->second.size() + 1];
+    memcpy(buffer, it->second.c_str(), it->second.size() + 1);
+    memory_buffers_[module->code_file()] = buffer;
+    *symbol_data = buffer;
+    return FOUND;
+  }
+
+  virtual void FreeSymbolData(const CodeModule *module) {
+    map<string, char *>::iterator it =
+        memory_buffers_.find(module->code_file());
+    if (it != memory_buffers_.end()) {
+      delete [] it->second;
+      memory_buffers_.erase(it);
+    }
+  }
+
+ private:
+  const map<string, string> *symbol_files_;
+  map<string, char *> memory_buffers_;
+};
+
+// The shape of a synthetic minidump.
+struct SyntheticCase {
+  int threads;
+  int modules;
+  int frames;  // per thread
+};
+
+string SyntheticModuleName(int module) {
+  char name[64];
+  snprintf(name, sizeof(name), "c:\\synthetic\\module%d.dll", module);
+  return name;
+}
+
+// Returns the address that frame number frame of a thread returns to.
+u_int32_t SyntheticReturnAddress(const SyntheticCase &shape, int thread,
+                                 int frame) {
+  int module = (thread + frame) % shape.modules;
+  u_int32_t offset = ((thread * 7 + frame) * 0x130) %
+                     (kFunctionCount * kFunctionSize);
+  return kModuleBase + module * kModuleSpacing + kFunctionBase + offset;
+}
+
+// Returns a symbol file for a synthetic module, with kFunctionCount
+// functions of four lines each, and a public symbol for every tenth.
+string SyntheticSymbolFile(int module) {
+  string data = "MODULE windows x86 0123456789ABCDEF0123456789ABCDEF1 " +
+                SyntheticModuleName(module) + "\n";
+  char record[256];
+  for (int i = 0; i < 20; ++i) {
+    snprintf(record, sizeof(record),
+             "FILE %d c:\\synthetic\\src\\module%d\\file_%d.cc\n",
+             i, module, i);
+    data += record;
+  }
+  for (int i = 0; i < kFunctionCount; ++i) {
+    u_int32_t address = kFunctionBase + i * kFunctionSize;
+    snprintf(record, sizeof(record),
+             "FUNC %x %x 8 synthetic::Module%d::Function%d(int, char*)\n",
+             address, kFunctionSize, module, i);
+    data += record;
+    for (int line = 0; line < 4; ++line) {
+      snprintf(record, sizeof(record), "%x 40 %d %d\n",
+               address + line * 0x40, 100 + line, i % 20);
+      data += record;
+    }
+  }
+  for (int i = 0; i < kFunctionCount; i += 10) {
+    snprintf(record, sizeof(record), "PUBLIC %x 8 synthetic_public_%d\n",
+             kFunctionBase + i * kFunctionSize, i);
+    data += record;
+  }
+  return data;
+}
+
+// Returns the contents of a synthetic minidump of the given shape.  Each
+// thread's stack is a chain of frames linked by saved %ebp values, each
+// returning into one of the modules.
+string SyntheticMinidump(const SyntheticCase &shape) {
+  SynthMinidump::Dump dump(0, kLittleEndian);
+
+  SynthMinidump::String csd_version(
+      dump, SynthMinidump::SystemInfo::windows_x86_csd_version);
+  SynthMinidump::SystemInfo system_info(
+      dump, SynthMinidump::SystemInfo::windows_x86, csd_version);
+  dump.Add(&system_info);
+  dump.Add(&csd_version);
+
+  // Sections are appended by reference to their labels, so they must
+  // outlive GetContents.
+  vector<SynthMinidump::Section *> sections;
+
+  for (int i = 0; i < shape.modules; ++i) {
+    SynthMinidump::String *name =
+        new SynthMinidump::String(dump, SyntheticModuleName(i));
+    SynthMinidump::Module *module =
+        new SynthMinidump::Module(dump, kModuleBase + i * kModuleSpacing,
+                                  kModuleSize, *name);
+    dump.Add(name);
+    dump.Add(module);
+    sections.push_back(name);
+    sections.push_back(module);
+  }
+
+  for (int i = 0; i < shape.threads; ++i) {
+    u_int32_t stack_base = kStackBase + i * kStackSpacing;
+    SynthMinidump::Memory *stack = new SynthMinidump::Memory(dump,
+                                                             stack_base);
+    for (int frame = 0; frame < shape.frames; ++frame) {
+      bool last = frame == shape.frames - 1;
+      u_int32_t frame_base = stack_base + frame * kFrameSize;
+      stack->D32(last ? 0 : frame_base + kFrameSize)
+            .D32(last ? 0 : SyntheticReturnAddress(shape, i, frame + 1))
+            .D32(0)
+            .D32(0);
+    }
+
+    MDRawContextX86 raw_context;
+    memset(&raw_context, 0, sizeof(raw_context));
+    raw_context.context_flags = MD_CONTEXT_X86_INTEGER |
+                                MD_CONTEXT_X86_CONTROL;
+    raw_context.eip = SyntheticReturnAddress(shape, i, 0);
+    raw_context.esp = stack_base;
+    raw_context.ebp = stack_base;
+    SynthMinidump::Context *context =
+        new SynthMinidump::Context(dump, raw_context);
+    SynthMinidump::Thread *thread =
+        new SynthMinidump::Thread(dump, 0x1000 + i, *stack, *context);
+    dump.Add(stack);
+    dump.Add(context);
+    dump.Add(thread);
+    sections.push_back(stack);
+    sections.push_back(context);
+    sections.push_back(thread);
+  }
+
+  dump.Finish();
+  string contents;
+  dump.GetContents(&contents);
+  for (size_t i = 0; i < sections.size(); ++i)
+    delete sections[i];
+  return contents;
+}
+
+// Reads the minidump in contents, along with its thread, module and
+// memory lists, any of which may be missing or unreadable.  Returns false
+// if the minidump itself can't be read.
+bool ReadMinidump(const string &contents) {
+  istringstream stream(contents);
+  Minidump dump(stream);
+  if (!dump.Read())
+    return false;
+  dump.GetThreadList();
+  dump.GetModuleList();
+  dump.GetMemoryList();
+  return true;
+}
+
+u_int64_t CountFrames(const ProcessState &process_state) {
+  u_int64_t frames = 0;
+  for (size_t i = 0; i < process_state.threads()->size(); ++i)
+    frames += process_state.threads()->at(i)->frames()->size();
+  return frames;
+}
+
+// Processes contents with processor iterations times, setting *frames to
+// the number of frames found.  Returns false on failure.
+bool ProcessRepeatedly(const string &contents, MinidumpProcessor *processor,
+                       int iterations, u_int64_t *frames) {
+  istringstream stream(contents);
+  Minidump dump(stream);
+  if (!dump.Read())
+    return false;
+  for (int i = 0; i < iterations; ++i) {
+    ProcessState process_state;
+    if (processor->Process(&dump, &process_state) !=
+        google_breakpad::PROCESS_OK)
+      return false;
+    *frames = CountFrames(process_state);
+  }
+  return true;
+}
+
+bool BenchmarkSynthetic(const SyntheticCase &shape, int iterations) {
+  char name[64];
+  snprintf(name, sizeof(name), "synthetic_t%d_m%d_f%d",
+           shape.threads, shape.modules, shape.frames);
+  string contents = SyntheticMinidump(shape);
+  map<string, string> symbol_files;
+  u_int64_t symbol_bytes = 0;
+  for (int i = 0; i < shape.modules; ++i) {
+    string &data = symbol_files[SyntheticModuleName(i)];
+    data = SyntheticSymbolFile(i);
+    symbol_bytes += data.size();
+  }
+
+  {
+    PhaseTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+      if (!ReadMinidump(contents))
+        return false;
+    }
+    timer.Report(name, "read", iterations, contents.size(), "bytes");
+  }
+
+  {
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(NULL, &resolver);
+    u_int64_t frames = 0;
+    PhaseTimer timer;
+    if (!ProcessRepeatedly(contents, &processor, iterations, &frames))
+      return false;
+    timer.Report(name, "walk", iterations, frames, "frames");
+  }
+
+  {
+    PhaseTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+      BasicSourceLineResolver resolver;
+      for (int j = 0; j < shape.modules; ++j) {
+        BasicCodeModule module(kModuleBase + j * kModuleSpacing, kModuleSize,
+                               SyntheticModuleName(j), "", "", "", "");
+        if (!resolver.LoadModuleUsingMapBuffer(
+                &module, symbol_files[module.code_file()]))
+          return false;
+      }
+    }
+    timer.Report(name, "load", iterations, symbol_bytes, "bytes");
+  }
+
+  {
+    MemorySymbolSupplier supplier(&symbol_files);
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(&supplier, &resolver);
+    u_int64_t frames = 0;
+    // Load every module before timing.
+    if (!ProcessRepeatedly(contents, &processor, 1, &frames))
+      return false;
+    PhaseTimer timer;
+    if (!ProcessRepeatedly(contents, &processor, iterations, &frames))
+      return false;
+    timer.Report(name, "symbolize", iterations, frames, "frames");
+  }
+
+  return true;
+}
+
+bool ReadFile(const string &path, string *contents) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+  char buffer[65536];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    contents->append(buffer, count);
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+bool BenchmarkCorpusMinidump(const string &path, const string &name,
+                             const vector<string> &symbol_paths,
+                             int iterations) {
+  string contents;
+  if (!ReadFile(path, &contents))
+    return false;
+
+  {
+    PhaseTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+      if (!ReadMinidump(contents))
+        return false;
+    }
+    timer.Report(name, "read", iterations, contents.size(), "bytes");
+  }
+
+  u_int64_t frames = 0;
+  {
+    PhaseTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+      SimpleSymbolSupplier supplier(symbol_paths);
+      BasicSourceLineResolver resolver;
+      MinidumpProcessor processor(&supplier, &resolver);
+      if (!ProcessRepeatedly(contents, &processor, 1, &frames))
+        return false;
+    }
+    timer.Report(name, "process_cold", iterations, frames, "frames");
+  }
+
+  {
+    SimpleSymbolSupplier supplier(symbol_paths);
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(&supplier, &resolver);
+    if (!ProcessRepeatedly(contents, &processor, 1, &frames))
+      return false;
+    PhaseTimer timer;
+    if (!ProcessRepeatedly(contents, &processor, iterations, &frames))
+      return false;
+    timer.Report(name, "process_warm", iterations, frames, "frames");
+  }
+
+  return true;
+}
+
+// Benchmarks every .dmp file in corpus, in name order.  Returns false if
+// any of them fails.
+bool BenchmarkCorpus(const string &corpus, int iterations) {
+  DIR *dir = opendir(corpus.c_str());
+  if (!dir) {
+    fprintf(stderr, "Could not read corpus directory %s\n", corpus.c_str());
+    return false;
+  }
+  vector<string> names;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    string file_name = entry->d_name;
+    if (file_name.size() > 4 &&
+        file_name.compare(file_name.size() - 4, 4, ".dmp") == 0)
+      names.push_back(file_name);
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+
+  vector<string> symbol_paths(1, corpus + "/symbols");
+  bool ok = true;
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (!BenchmarkCorpusMinidump(corpus + "/" + names[i], names[i],
+                                 symbol_paths, iterations)) {
+      fprintf(stderr, "Could not process %s\n", names[i].c_str());
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+}  // namespace
+
+static void usage(const char *program_name) {
+  fprintf(stderr,
+          "usage: %s [-i iterations] [-c corpus-directory] "
+          "[-t threads -m modules -f frames]\n"
+          "    -i : Number of times to repeat each phase (default 10)\n"
+          "    -c : Directory of minidumps, with symbols in its symbols\n"
+          "         subdirectory (default src/processor/testdata); an empty\n"
+          "         name skips the corpus\n"
+          "    -t, -m, -f : Benchmark only a synthetic minidump with this\n"
+          "         many threads, modules, and frames per thread\n",
+          program_name);
+}
+
+int main(int argc, char **argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  int iterations = 10;
+  string corpus = "src/processor/testdata";
+  SyntheticCase custom = { 0, 0, 0 };
+  int argi = 1;
+  for (; argi + 1 < argc && argv[argi][0] == '-'; argi += 2) {
+    const char *value = argv[argi + 1];
+    if (strcmp(argv[argi], "-i") == 0 && (iterations = atoi(value)) > 0) {
+    } else if (strcmp(argv[argi], "-c") == 0) {
+      corpus = value;
+    } else if (strcmp(argv[argi], "-t") == 0 &&
+               (custom.threads = atoi(value)) > 0) {
+    } else if (strcmp(argv[argi], "-m") == 0 &&
+               (custom.modules = atoi(value)) > 0) {
+    } else if (strcmp(argv[argi], "-f") == 0 &&
+               (custom.frames = atoi(value)) > 0) {
+    } else {
+      break;
+    }
+  }
+  bool have_custom = custom.threads || custom.modules || custom.frames;
+  if (argi != argc ||
+      (have_custom &&
+       (!custom.threads || !custom.modules || !custom.frames))) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // Processing logs a great deal; keep it out of the measurements.
+  std::clog.setstate(std::ios::failbit);
+
+  printf("# processor_benchmark%c%d\n", kOutputSeparator, kOutputVersion);
+  printf("# case%cphase%citerations%cusec_per_iteration%c"
+         "items_per_iteration%citem_unit%citems_per_second%c"
+         "allocations_per_iteration%callocated_bytes_per_iteration%c"
+         "peak_rss_kb\n",
+         kOutputSeparator, kOutputSeparator, kOutputSeparator,
+         kOutputSeparator, kOutputSeparator, kOutputSeparator,
+         kOutputSeparator, kOutputSeparator, kOutputSeparator);
+
+  vector<SyntheticCase> cases;
+  if (have_custom) {
+    cases.push_back(custom);
+  } else {
+    const SyntheticCase kCases[] = {
+      { 1, 4, 16 },
+      { 16, 16, 64 },
+      { 64, 64, 256 },
+    };
+    cases.assign(kCases, kCases + sizeof(kCases) / sizeof(kCases[0]));
+  }
+
+  int result = 0;
+  for (size_t i = 0; i < cases.size(); ++i) {
+    if (!BenchmarkSynthetic(cases[i], iterations)) {
+      fprintf(stderr, "Synthetic case %d failed\n", static_cast<int>(i));
+      result = 1;
+    }
+  }
+
+  if (!have_custom && !corpus.empty() && !BenchmarkCorpus(corpus, iterations))
+    result = 1;
+
+  return result;
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// serialize_symbol_file.cc: Convert a text symbol file, as written by
+// dump_syms, into a serialized symbol file that FastSourceLineResolver can
+// map into memory and use without parsing.
+//
+// See processor/serialized_symbol_file.h for the format.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/fast_source_line_resolver.h"
+#include "google_breakpad/processor/source_line_resolver_base.h"
+#include "processor/basic_code_module.h"
+#include "processor/logging.h"
+#include "processor/module_serializer.h"
+#include "processor/scoped_ptr.h"
+#include "processor/serialized_symbol_file.h"
+
+namespace {
+
+using google_breakpad::BasicCodeModule;
+using google_breakpad::FastSourceLineResolver;
+using google_breakpad::IsSerializedSymbolFile;
+using google_breakpad::ModuleSerializer;
+using google_breakpad::SourceLineResolverBase;
+using google_breakpad::kSerializedSymbolFileMagic;
+using google_breakpad::scoped_array;
+
+bool Convert(const char *symbol_file, const char *serialized_file) {
+  char *symbol_data;
+  if (!SourceLineResolverBase::ReadSymbolFile(&symbol_data, symbol_file))
+    return false;
+  string symbol_data_string(symbol_data);
+  delete [] symbol_data;
+
+  ModuleSerializer serializer;
+  unsigned int size;
+  scoped_array<char> serialized_data(
+      serializer.MakeSerializedSymbolFile(symbol_data_string, &size));
+  if (!serialized_data.get()) {
+    fprintf(stderr, "Could not parse %s\n", symbol_file);
+    return false;
+  }
+
+  FILE *file = fopen(serialized_file, "wb");
+  if (!file) {
+    fprintf(stderr, "Could not open %s for writing\n", serialized_file);
+    return false;
+  }
+  bool ok = fwrite(serialized_data.get(), 1, size, file) == size;
+  if (fclose(file) != 0)
+    ok = false;
+  if (!ok) {
+    fprintf(stderr, "Could not write %s\n", serialized_file);
+    remove(serialized_file);
+  }
+  return ok;
+}
+
+// Loads serialized_file the way the processor would, but verifying its
+// checksum as well.
+bool Check(const char *serialized_file) {
+  // FastSourceLineResolver would take anything else for bare serialized
+  // data, which has no header to check.
+  char magic[sizeof(kSerializedSymbolFileMagic)];
+  FILE *file = fopen(serialized_file, "rb");
+  if (!file) {
+    fprintf(stderr, "Could not open %s\n", serialized_file);
+    return false;
+  }
+  size_t magic_size = fread(magic, 1, sizeof(magic), file);
+  fclose(file);
+  if (!IsSerializedSymbolFile(magic, magic_size)) {
+    fprintf(stderr, "%s is not a serialized symbol file\n", serialized_file);
+    return false;
+  }
+
+  FastSourceLineResolver resolver;
+  resolver.set_verify_checksums(true);
+  BasicCodeModule module(0, 0, serialized_file, "", "", "", "");
+  if (!resolver.LoadModule(&module, serialized_file)) {
+    fprintf(stderr, "%s is not a valid serialized symbol file\n",
+            serialized_file);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+static void usage(const char *program_name) {
+  fprintf(stderr,
+          "usage: %s <symbol-file> <serialized-symbol-file>\n"
+          "       %s -c <serialized-symbol-file>\n"
+          "    -c : Check a serialized symbol file, including its checksum\n",
+          program_name, program_name);
+}
+
+int main(int argc, char **argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  if (argc != 3) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (strcmp(argv[1], "-c") == 0)
+    return Check(argv[2]) ? 0 : 1;
+
+  return Convert(argv[1], argv[2]) ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// serialized_symbol_file.cc: Implementation of the serialized symbol file
+// format helpers.
+//
+// See serialized_symbol_file.h for documentation.
+
+#include "processor/serialized_symbol_file.h"
+
+#include <string.h>
+
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+const char kSerializedSymbolFileMagic[8] = {
+  'B', 'P', 'S', 'Y', 'M', 'B', 'I', 'N'
+};
+
+u_int32_t SerializedSymbolFileChecksum(const char *data, size_t size) {
+  const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data);
+  // The largest number of bytes that can be summed before a and b must be
+  // reduced to keep b from overflowing 32 bits.
+  const size_t kMaxRun = 5552;
+  const u_int32_t kModulus = 65521;
+  u_int32_t a = 1, b = 0;
+  while (size > 0) {
+    size_t run = size < kMaxRun ? size : kMaxRun;
+    size -= run;
+    while (run--) {
+      a += *bytes++;
+      b += a;
+    }
+    a %= kModulus;
+    b %= kModulus;
+  }
+  return (b << 16) | a;
+}
+
+void MakeSerializedSymbolFileHeader(const char *data, size_t size,
+                                    SerializedSymbolFileHeader *header) {
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, kSerializedSymbolFileMagic, sizeof(header->magic));
+  header->version = kSerializedSymbolFileVersion;
+  header->header_size = sizeof(*header);
+  header->data_size = size;
+  header->checksum = SerializedSymbolFileChecksum(data, size);
+}
+
+bool IsSerializedSymbolFile(const char *buffer, size_t size) {
+  return size >= sizeof(kSerializedSymbolFileMagic) &&
+         memcmp(buffer, kSerializedSymbolFileMagic,
+                sizeof(kSerializedSymbolFileMagic)) == 0;
+}
+
+bool CheckSerializedSymbolFile(const char *buffer, size_t size,
+                               bool verify_checksum, const char **data,
+                               size_t *data_size) {
+  if (size < sizeof(SerializedSymbolFileHeader) ||
+      !IsSerializedSymbolFile(buffer, size)) {
+    BPLOG(ERROR) << "Not a serialized symbol file";
+    return false;
+  }
+
+  SerializedSymbolFileHeader header;
+  memcpy(&header, buffer, sizeof(header));
+  if (header.version != kSerializedSymbolFileVersion ||
+      header.header_size != sizeof(header)) {
+    BPLOG(ERROR) << "Unsupported serialized symbol file version " <<
+                    header.version;
+    return false;
+  }
+
+  if (header.data_size != size - sizeof(header)) {
+    BPLOG(ERROR) << "Serialized symbol file size mismatch: header says " <<
+                    header.data_size << " bytes, file has " <<
+                    size - sizeof(header);
+    return false;
+  }
+
+  const char *module_data = buffer + sizeof(header);
+  if (verify_checksum &&
+      SerializedSymbolFileChecksum(module_data, header.data_size) !=
+          header.checksum) {
+    BPLOG(ERROR) << "Serialized symbol file checksum mismatch";
+    return false;
+  }
+
+  *data = module_data;
+  *data_size = header.data_size;
+  return true;
+}
+
+}  // namespace google_breakpad
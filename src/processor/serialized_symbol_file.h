@@ -0,0 +1,85 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// serialized_symbol_file.h: The on-disk format of serialized symbol files.
+//
+// A serialized symbol file holds a module serialized by ModuleSerializer,
+// preceded by a SerializedSymbolFileHeader.  FastSourceLineResolver maps
+// such files into memory and uses them in place, so loading one costs
+// about as much as opening it, however large the module is.
+//
+// The serialized module is stored in the byte order and layout of the
+// machine that wrote it.  A reader of the other byte order sees a
+// version it doesn't recognize, and rejects the file.
+
+#ifndef PROCESSOR_SERIALIZED_SYMBOL_FILE_H__
+#define PROCESSOR_SERIALIZED_SYMBOL_FILE_H__
+
+#include <stddef.h>
+
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+struct SerializedSymbolFileHeader {
+  char magic[8];          // kSerializedSymbolFileMagic
+  u_int32_t version;      // kSerializedSymbolFileVersion
+  u_int32_t header_size;  // sizeof(SerializedSymbolFileHeader)
+  u_int64_t data_size;    // The size of the serialized module that follows
+  u_int32_t checksum;     // SerializedSymbolFileChecksum of the module
+  u_int32_t reserved;     // Zero
+};
+
+extern const char kSerializedSymbolFileMagic[8];
+
+// Bump this whenever the layout written by ModuleSerializer changes.
+const u_int32_t kSerializedSymbolFileVersion = 1;
+
+// Returns the Adler-32 checksum of the size bytes at data.
+u_int32_t SerializedSymbolFileChecksum(const char *data, size_t size);
+
+// Fills in header to describe the size bytes of serialized module at data.
+void MakeSerializedSymbolFileHeader(const char *data, size_t size,
+                                    SerializedSymbolFileHeader *header);
+
+// Returns true if the size bytes at buffer start with the magic number of
+// a serialized symbol file.  The rest of the file isn't examined.
+bool IsSerializedSymbolFile(const char *buffer, size_t size);
+
+// Checks that the size bytes at buffer are a complete serialized symbol
+// file of the current version.  If verify_checksum is true, also verifies
+// the checksum, which requires reading the whole file.  On success, sets
+// *data and *data_size to the serialized module and returns true.
+bool CheckSerializedSymbolFile(const char *buffer, size_t size,
+                               bool verify_checksum, const char **data,
+                               size_t *data_size);
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_SERIALIZED_SYMBOL_FILE_H__
@@ -0,0 +1,264 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// shared_module_cache.cc: A reference-counted, size-bounded cache of
+// serialized symbol modules that may be shared between threads.
+//
+// See shared_module_cache.h for documentation.
+
+#include "google_breakpad/processor/shared_module_cache.h"
+
+#include <assert.h>
+
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/fast_source_line_resolver.h"
+#include "processor/logging.h"
+#include "processor/module_serializer.h"
+#include "processor/mutex.h"
+#include "processor/scoped_ptr.h"
+
+namespace google_breakpad {
+
+SharedModuleCache::Entry::Entry(const string& key,
+                                char* serialized_data,
+                                size_t size,
+                                FastSourceLineResolver* resolver)
+    : key_(key),
+      serialized_data_(serialized_data),
+      size_(size),
+      resolver_(resolver),
+      references_(0),
+      idle_position_() {
+}
+
+SharedModuleCache::Entry::~Entry() {
+  // The resolver's module points into serialized_data_, so it goes first.
+  delete resolver_;
+  delete [] serialized_data_;
+}
+
+void SharedModuleCache::Entry::FillSourceLineInfo(StackFrame* frame) const {
+  resolver_->FillSourceLineInfo(frame);
+}
+
+WindowsFrameInfo* SharedModuleCache::Entry::FindWindowsFrameInfo(
+    const StackFrame* frame) const {
+  return resolver_->FindWindowsFrameInfo(frame);
+}
+
+CFIFrameInfo* SharedModuleCache::Entry::FindCFIFrameInfo(
+    const StackFrame* frame) const {
+  return resolver_->FindCFIFrameInfo(frame);
+}
+
+SharedModuleCache::SharedModuleCache(size_t memory_budget)
+    : memory_budget_(memory_budget),
+      mutex_(new Mutex()),
+      entries_(),
+      loading_(),
+      load_ended_(new ConditionVariable()),
+      idle_(),
+      bytes_(0),
+      hits_(0),
+      misses_(0),
+      evictions_(0) {
+}
+
+SharedModuleCache::~SharedModuleCache() {
+  for (EntryMap::iterator iterator = entries_.begin();
+       iterator != entries_.end(); ++iterator) {
+    if (iterator->second->references_ != 0) {
+      BPLOG(ERROR) << "SharedModuleCache destroyed with " <<
+                      iterator->second->references_ <<
+                      " references outstanding to " << iterator->first;
+    }
+    delete iterator->second;
+  }
+  delete load_ended_;
+  delete mutex_;
+}
+
+// static
+string SharedModuleCache::KeyForModule(const CodeModule* module) {
+  return module->code_file() + '\n' + module->debug_file() + '\n' +
+         module->debug_identifier();
+}
+
+const SharedModuleCache::Entry* SharedModuleCache::Acquire(
+    const CodeModule* module) {
+  if (!module)
+    return NULL;
+
+  AutoMutexLock lock(mutex_);
+  return WaitAndAcquire(KeyForModule(module));
+}
+
+const SharedModuleCache::Entry* SharedModuleCache::AcquireOrBeginLoad(
+    const CodeModule* module) {
+  if (!module)
+    return NULL;
+
+  string key = KeyForModule(module);
+  AutoMutexLock lock(mutex_);
+  const Entry* entry = WaitAndAcquire(key);
+  if (!entry)
+    loading_.insert(key);
+  return entry;
+}
+
+void SharedModuleCache::AbandonLoad(const CodeModule* module) {
+  if (!module)
+    return;
+
+  AutoMutexLock lock(mutex_);
+  EndLoad(KeyForModule(module));
+}
+
+const SharedModuleCache::Entry* SharedModuleCache::Insert(
+    const CodeModule* module, char* symbol_data) {
+  if (!module || !symbol_data)
+    return NULL;
+
+  string key = KeyForModule(module);
+
+  // Parse and serialize without holding the lock, since this is by far the
+  // most expensive part of loading a module.
+  ModuleSerializer serializer;
+  unsigned int size = 0;
+  scoped_array<char> serialized_data(
+      serializer.SerializeSymbolFileData(symbol_data, &size));
+  if (!serialized_data.get()) {
+    BPLOG(ERROR) << "Could not parse symbols for " << module->code_file();
+    AutoMutexLock lock(mutex_);
+    EndLoad(key);
+    return NULL;
+  }
+
+  scoped_ptr<FastSourceLineResolver> resolver(new FastSourceLineResolver());
+  if (!resolver->LoadModuleUsingMemoryBuffer(module, serialized_data.get())) {
+    BPLOG(ERROR) << "Could not load serialized symbols for " <<
+                    module->code_file();
+    AutoMutexLock lock(mutex_);
+    EndLoad(key);
+    return NULL;
+  }
+
+  AutoMutexLock lock(mutex_);
+  EndLoad(key);
+  EntryMap::iterator iterator = entries_.find(key);
+  if (iterator != entries_.end()) {
+    // Someone else got here first.  Use theirs, and let resolver and
+    // serialized_data go.
+    Reference(iterator->second);
+    return iterator->second;
+  }
+
+  Entry* entry = new Entry(key, serialized_data.release(), size,
+                           resolver.release());
+  entries_.insert(make_pair(key, entry));
+  bytes_ += entry->size_;
+  entry->references_ = 1;
+
+  // The new entry is referenced, so this can only evict others.
+  EvictIdleEntries(memory_budget_);
+  return entry;
+}
+
+void SharedModuleCache::Release(const Entry* entry) {
+  if (!entry)
+    return;
+
+  AutoMutexLock lock(mutex_);
+  // Reference counts and idle positions are guarded by mutex_, not by the
+  // entry, so it's safe to modify them through the caller's const pointer.
+  Entry* mutable_entry = const_cast<Entry*>(entry);
+  assert(mutable_entry->references_ > 0);
+  if (--mutable_entry->references_ == 0) {
+    idle_.push_front(mutable_entry);
+    mutable_entry->idle_position_ = idle_.begin();
+    EvictIdleEntries(memory_budget_);
+  }
+}
+
+void SharedModuleCache::Purge() {
+  AutoMutexLock lock(mutex_);
+  EvictIdleEntries(0);
+}
+
+SharedModuleCache::Stats SharedModuleCache::GetStats() const {
+  AutoMutexLock lock(mutex_);
+  Stats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.evictions = evictions_;
+  stats.entries = entries_.size();
+  stats.bytes = bytes_;
+  return stats;
+}
+
+const SharedModuleCache::Entry* SharedModuleCache::WaitAndAcquire(
+    const string& key) {
+  while (loading_.find(key) != loading_.end())
+    load_ended_->Wait(mutex_);
+
+  EntryMap::iterator iterator = entries_.find(key);
+  if (iterator == entries_.end()) {
+    ++misses_;
+    return NULL;
+  }
+
+  ++hits_;
+  Reference(iterator->second);
+  return iterator->second;
+}
+
+void SharedModuleCache::EndLoad(const string& key) {
+  if (loading_.erase(key))
+    load_ended_->Broadcast();
+}
+
+void SharedModuleCache::Reference(Entry* entry) {
+  if (entry->references_++ == 0)
+    idle_.erase(entry->idle_position_);
+}
+
+void SharedModuleCache::EvictIdleEntries(size_t budget) {
+  while (bytes_ > budget && !idle_.empty()) {
+    Entry* entry = idle_.back();
+    idle_.pop_back();
+    BPLOG(INFO) << "Evicting cached symbols for " << entry->key_.substr(
+                       0, entry->key_.find('\n'));
+    entries_.erase(entry->key_);
+    bytes_ -= entry->size_;
+    ++evictions_;
+    delete entry;
+  }
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,532 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// shared_module_cache_unittest.cc: Unit tests for SharedModuleCache and
+// CachingStackFrameSymbolizer.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/caching_stack_frame_symbolizer.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/shared_module_cache.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "google_breakpad/processor/symbol_supplier.h"
+#include "processor/mutex.h"
+#include "processor/scoped_ptr.h"
+#include "processor/windows_frame_info.h"
+
+namespace {
+
+using google_breakpad::CachingStackFrameSymbolizer;
+using google_breakpad::CodeModule;
+using google_breakpad::AutoMutexLock;
+using google_breakpad::CodeModules;
+using google_breakpad::Mutex;
+using google_breakpad::SharedModuleCache;
+using google_breakpad::StackFrame;
+using google_breakpad::StackFrameSymbolizer;
+using google_breakpad::SymbolSupplier;
+using google_breakpad::SystemInfo;
+using google_breakpad::WindowsFrameInfo;
+using google_breakpad::scoped_ptr;
+using std::vector;
+
+class TestCodeModule : public CodeModule {
+ public:
+  TestCodeModule(string code_file, string debug_identifier)
+      : code_file_(code_file), debug_identifier_(debug_identifier) {}
+  virtual ~TestCodeModule() {}
+
+  virtual u_int64_t base_address() const { return 0; }
+  virtual u_int64_t size() const { return 0xb000; }
+  virtual string code_file() const { return code_file_; }
+  virtual string code_identifier() const { return ""; }
+  virtual string debug_file() const { return ""; }
+  virtual string debug_identifier() const { return debug_identifier_; }
+  virtual string version() const { return ""; }
+  virtual const CodeModule* Copy() const {
+    return new TestCodeModule(code_file_, debug_identifier_);
+  }
+
+ private:
+  string code_file_;
+  string debug_identifier_;
+};
+
+// A CodeModules holding a single module that covers every address.
+class TestCodeModules : public CodeModules {
+ public:
+  explicit TestCodeModules(const CodeModule* module) : module_(module) {}
+  virtual ~TestCodeModules() {}
+
+  virtual unsigned int module_count() const { return 1; }
+  virtual const CodeModule* GetModuleForAddress(u_int64_t address) const {
+    return module_;
+  }
+  virtual const CodeModule* GetMainModule() const { return module_; }
+  virtual const CodeModule* GetModuleAtSequence(unsigned int sequence) const {
+    return sequence == 0 ? module_ : NULL;
+  }
+  virtual const CodeModule* GetModuleAtIndex(unsigned int index) const {
+    return index == 0 ? module_ : NULL;
+  }
+  virtual const CodeModules* Copy() const {
+    return new TestCodeModules(module_);
+  }
+
+ private:
+  const CodeModule* module_;
+};
+
+// Supplies the contents of a single symbol file for every module, and
+// counts how often it's asked to.
+class TestSymbolSupplier : public SymbolSupplier {
+ public:
+  explicit TestSymbolSupplier(const string& symbol_data)
+      : symbol_data_(symbol_data), requests_(0), buffer_(NULL) {}
+  virtual ~TestSymbolSupplier() { delete [] buffer_; }
+
+  virtual SymbolResult GetSymbolFile(const CodeModule* module,
+                                     const SystemInfo* system_info,
+                                     string* symbol_file) {
+    return NOT_FOUND;
+  }
+  virtual SymbolResult GetSymbolFile(const CodeModule* module,
+                                     const SystemInfo* system_info,
+                                     string* symbol_file,
+                                     string* symbol_data) {
+    return NOT_FOUND;
+  }
+  virtual SymbolResult GetCStringSymbolData(const CodeModule* module,
+                                            const SystemInfo* system_info,
+                                            string* symbol_file,
+                                            char** symbol_data) {
+    ++requests_;
+    delete [] buffer_;
+    buffer_ = new char[symbol_data_.size() + 1];
+    memcpy(buffer_, symbol_data_.c_str(), symbol_data_.size() + 1);
+    *symbol_data = buffer_;
+    return FOUND;
+  }
+  virtual void FreeSymbolData(const CodeModule* module) {
+    delete [] buffer_;
+    buffer_ = NULL;
+  }
+
+  int requests() const { return requests_; }
+
+ private:
+  string symbol_data_;
+  int requests_;
+  char* buffer_;
+};
+
+// Like TestSymbolSupplier, but may be used by many threads at once.  It
+// takes a while to supply each symbol file, so that threads asking for the
+// same module overlap.
+class ThreadSafeSymbolSupplier : public SymbolSupplier {
+ public:
+  explicit ThreadSafeSymbolSupplier(const string& symbol_data)
+      : symbol_data_(symbol_data), requests_(0) {}
+  virtual ~ThreadSafeSymbolSupplier() {}
+
+  virtual SymbolResult GetSymbolFile(const CodeModule* module,
+                                     const SystemInfo* system_info,
+                                     string* symbol_file) {
+    return NOT_FOUND;
+  }
+  virtual SymbolResult GetSymbolFile(const CodeModule* module,
+                                     const SystemInfo* system_info,
+                                     string* symbol_file,
+                                     string* symbol_data) {
+    return NOT_FOUND;
+  }
+  virtual SymbolResult GetCStringSymbolData(const CodeModule* module,
+                                            const SystemInfo* system_info,
+                                            string* symbol_file,
+                                            char** symbol_data) {
+    usleep(20000);
+    char* buffer = new char[symbol_data_.size() + 1];
+    memcpy(buffer, symbol_data_.c_str(), symbol_data_.size() + 1);
+    AutoMutexLock lock(&mutex_);
+    ++requests_;
+    delete [] buffers_[module];
+    buffers_[module] = buffer;
+    *symbol_data = buffer;
+    return FOUND;
+  }
+  virtual void FreeSymbolData(const CodeModule* module) {
+    AutoMutexLock lock(&mutex_);
+    delete [] buffers_[module];
+    buffers_.erase(module);
+  }
+
+  int requests() {
+    AutoMutexLock lock(&mutex_);
+    return requests_;
+  }
+
+ private:
+  string symbol_data_;
+  Mutex mutex_;
+  int requests_;
+  std::map<const CodeModule*, char*> buffers_;
+};
+
+struct LookupThreadArgs {
+  const SharedModuleCache::Entry* entry;
+  const CodeModule* module;
+  int failures;
+};
+
+void* LookupThread(void* argument) {
+  LookupThreadArgs* args = static_cast<LookupThreadArgs*>(argument);
+  for (int i = 0; i < 1000; ++i) {
+    StackFrame frame;
+    frame.instruction = 0x1000;
+    frame.module = args->module;
+    args->entry->FillSourceLineInfo(&frame);
+    if (frame.function_name != "Function1_1" || frame.source_line != 44)
+      ++args->failures;
+  }
+  return NULL;
+}
+
+struct SymbolizeThreadArgs {
+  SharedModuleCache* cache;
+  SymbolSupplier* supplier;
+  const CodeModule* module;
+  bool symbolized;
+};
+
+// Symbolizes a frame in args->module with a symbolizer of its own.
+void* SymbolizeThread(void* argument) {
+  SymbolizeThreadArgs* args = static_cast<SymbolizeThreadArgs*>(argument);
+  TestCodeModules modules(args->module);
+  CachingStackFrameSymbolizer symbolizer(args->supplier, args->cache);
+  StackFrame frame;
+  frame.instruction = 0x1000;
+  args->symbolized =
+      symbolizer.FillSourceLineInfo(&modules, NULL, &frame) ==
+          StackFrameSymbolizer::NO_ERROR &&
+      frame.function_name == "Function1_1";
+  return NULL;
+}
+
+class SharedModuleCacheTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    string testdata_dir = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                          "/src/processor/testdata";
+    ASSERT_TRUE(ReadFile(testdata_dir + "/module1.out", &module1_symbols));
+    ASSERT_TRUE(ReadFile(testdata_dir + "/module2.out", &module2_symbols));
+  }
+
+  static bool ReadFile(const string& path, string* contents) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+      return false;
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      contents->append(buffer, length);
+    fclose(file);
+    return true;
+  }
+
+  // Inserts symbols into cache for module.  Insert doesn't take ownership
+  // of its buffer, but does need it to be writable.
+  static const SharedModuleCache::Entry* Insert(SharedModuleCache* cache,
+                                                const CodeModule* module,
+                                                const string& symbols) {
+    vector<char> buffer(symbols.begin(), symbols.end());
+    buffer.push_back('\0');
+    return cache->Insert(module, &buffer[0]);
+  }
+
+  string module1_symbols;
+  string module2_symbols;
+};
+
+TEST_F(SharedModuleCacheTest, InsertAndAcquire) {
+  SharedModuleCache cache(1 << 20);
+  TestCodeModule module1("module1", "ID1");
+
+  ASSERT_FALSE(cache.Acquire(&module1));
+  const SharedModuleCache::Entry* entry =
+      Insert(&cache, &module1, module1_symbols);
+  ASSERT_TRUE(entry);
+  EXPECT_GT(entry->size(), 0U);
+
+  // A different module object describing the same module finds the entry.
+  TestCodeModule module1_copy("module1", "ID1");
+  EXPECT_EQ(entry, cache.Acquire(&module1_copy));
+  // A different build of the module doesn't.
+  TestCodeModule module1_other("module1", "ID2");
+  EXPECT_FALSE(cache.Acquire(&module1_other));
+
+  StackFrame frame;
+  frame.instruction = 0x1000;
+  frame.module = &module1;
+  entry->FillSourceLineInfo(&frame);
+  EXPECT_EQ("Function1_1", frame.function_name);
+  EXPECT_EQ("file1_1.cc", frame.source_file_name);
+  EXPECT_EQ(44, frame.source_line);
+  scoped_ptr<WindowsFrameInfo> windows_frame_info(
+      entry->FindWindowsFrameInfo(&frame));
+  ASSERT_TRUE(windows_frame_info.get());
+  EXPECT_EQ("$eip 4 + ^ = $esp $ebp 8 + = $ebp $ebp ^ =",
+            windows_frame_info->program_string);
+
+  cache.Release(entry);
+  cache.Release(entry);
+
+  SharedModuleCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(1U, stats.hits);
+  EXPECT_EQ(2U, stats.misses);
+  EXPECT_EQ(0U, stats.evictions);
+  EXPECT_EQ(1U, stats.entries);
+  EXPECT_EQ(entry->size(), stats.bytes);
+}
+
+TEST_F(SharedModuleCacheTest, InsertDuplicate) {
+  SharedModuleCache cache(1 << 20);
+  TestCodeModule module1("module1", "ID1");
+
+  const SharedModuleCache::Entry* first =
+      Insert(&cache, &module1, module1_symbols);
+  const SharedModuleCache::Entry* second =
+      Insert(&cache, &module1, module1_symbols);
+  ASSERT_TRUE(first);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(1U, cache.GetStats().entries);
+  cache.Release(first);
+  cache.Release(second);
+}
+
+TEST_F(SharedModuleCacheTest, BadSymbols) {
+  SharedModuleCache cache(1 << 20);
+  TestCodeModule module1("module1", "ID1");
+  EXPECT_FALSE(Insert(&cache, &module1, "FUNC not hex\n"));
+  EXPECT_EQ(0U, cache.GetStats().entries);
+}
+
+TEST_F(SharedModuleCacheTest, EvictsLeastRecentlyUsedIdleEntries) {
+  TestCodeModule module1("module1", "ID1");
+  TestCodeModule module2("module2", "ID2");
+  TestCodeModule module3("module3", "ID3");
+
+  // Find out how large each module is, to set a budget that fits two.
+  size_t size;
+  {
+    SharedModuleCache sizing_cache(1 << 20);
+    const SharedModuleCache::Entry* entry =
+        Insert(&sizing_cache, &module1, module1_symbols);
+    ASSERT_TRUE(entry);
+    size = entry->size();
+    sizing_cache.Release(entry);
+  }
+
+  // Load the same symbols for every module, so they're all the same size.
+  SharedModuleCache cache(size * 2);
+  const SharedModuleCache::Entry* entry1 =
+      Insert(&cache, &module1, module1_symbols);
+  const SharedModuleCache::Entry* entry2 =
+      Insert(&cache, &module2, module1_symbols);
+  const SharedModuleCache::Entry* entry3 =
+      Insert(&cache, &module3, module1_symbols);
+  ASSERT_TRUE(entry1 && entry2 && entry3);
+
+  // Everything is referenced, so nothing may be evicted yet.
+  EXPECT_EQ(3U, cache.GetStats().entries);
+  EXPECT_EQ(size * 3, cache.GetStats().bytes);
+
+  // Releasing module1 leaves the cache over budget with an idle entry, so
+  // it's evicted at once.  That brings the cache back within budget.
+  cache.Release(entry1);
+  EXPECT_EQ(1U, cache.GetStats().evictions);
+  EXPECT_FALSE(cache.Acquire(&module1));
+  cache.Release(entry3);
+  cache.Release(entry2);
+  EXPECT_EQ(1U, cache.GetStats().evictions);
+  EXPECT_EQ(2U, cache.GetStats().entries);
+
+  // module3 was released before module2, so it's the one to go when
+  // module1 comes back.
+  entry1 = Insert(&cache, &module1, module1_symbols);
+  ASSERT_TRUE(entry1);
+  EXPECT_EQ(2U, cache.GetStats().evictions);
+  EXPECT_FALSE(cache.Acquire(&module3));
+  entry2 = cache.Acquire(&module2);
+  ASSERT_TRUE(entry2);
+  cache.Release(entry2);
+  cache.Release(entry1);
+  EXPECT_EQ(2U, cache.GetStats().entries);
+
+  cache.Purge();
+  SharedModuleCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(0U, stats.entries);
+  EXPECT_EQ(0U, stats.bytes);
+  EXPECT_EQ(4U, stats.evictions);
+}
+
+TEST_F(SharedModuleCacheTest, ConcurrentLookups) {
+  SharedModuleCache cache(1 << 20);
+  TestCodeModule module1("module1", "ID1");
+  const SharedModuleCache::Entry* entry =
+      Insert(&cache, &module1, module1_symbols);
+  ASSERT_TRUE(entry);
+
+  const int kThreads = 4;
+  pthread_t threads[kThreads];
+  LookupThreadArgs args[kThreads];
+  for (int i = 0; i < kThreads; ++i) {
+    args[i].entry = entry;
+    args[i].module = &module1;
+    args[i].failures = 0;
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, LookupThread, &args[i]));
+  }
+  for (int i = 0; i < kThreads; ++i) {
+    pthread_join(threads[i], NULL);
+    EXPECT_EQ(0, args[i].failures);
+  }
+  cache.Release(entry);
+}
+
+TEST_F(SharedModuleCacheTest, SymbolizersShareModules) {
+  SharedModuleCache cache(1 << 20);
+  TestCodeModule module1("module1", "ID1");
+  TestCodeModules modules(&module1);
+  TestSymbolSupplier supplier(module1_symbols);
+
+  CachingStackFrameSymbolizer symbolizer1(&supplier, &cache);
+  CachingStackFrameSymbolizer symbolizer2(&supplier, &cache);
+  ASSERT_TRUE(symbolizer1.HasImplementation());
+
+  StackFrame frame1;
+  frame1.instruction = 0x1000;
+  EXPECT_EQ(StackFrameSymbolizer::NO_ERROR,
+            symbolizer1.FillSourceLineInfo(&modules, NULL, &frame1));
+  EXPECT_EQ("Function1_1", frame1.function_name);
+
+  StackFrame frame2;
+  frame2.instruction = 0x1000;
+  EXPECT_EQ(StackFrameSymbolizer::NO_ERROR,
+            symbolizer2.FillSourceLineInfo(&modules, NULL, &frame2));
+  EXPECT_EQ("Function1_1", frame2.function_name);
+  EXPECT_EQ(44, frame2.source_line);
+  scoped_ptr<WindowsFrameInfo> windows_frame_info(
+      symbolizer2.FindWindowsFrameInfo(&frame2));
+  EXPECT_TRUE(windows_frame_info.get());
+
+  // Only the first symbolizer had to ask for the symbols.
+  EXPECT_EQ(1, supplier.requests());
+  EXPECT_EQ(1U, cache.GetStats().entries);
+
+  // Both symbolizers hold the module until they're reset, after which it
+  // can be evicted.
+  symbolizer1.Reset();
+  cache.Purge();
+  EXPECT_EQ(1U, cache.GetStats().entries);
+  symbolizer2.Reset();
+  cache.Purge();
+  EXPECT_EQ(0U, cache.GetStats().entries);
+}
+
+TEST_F(SharedModuleCacheTest, ConcurrentMissesLoadOnce) {
+  SharedModuleCache cache(1 << 20);
+  ThreadSafeSymbolSupplier supplier(module1_symbols);
+
+  // Every thread has its own copy of one of two modules.
+  const int kThreads = 8;
+  vector<TestCodeModule*> modules;
+  pthread_t threads[kThreads];
+  SymbolizeThreadArgs args[kThreads];
+  for (int i = 0; i < kThreads; ++i) {
+    modules.push_back(new TestCodeModule(i % 2 ? "module2" : "module1",
+                                         i % 2 ? "ID2" : "ID1"));
+    args[i].cache = &cache;
+    args[i].supplier = &supplier;
+    args[i].module = modules[i];
+    args[i].symbolized = false;
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, SymbolizeThread, &args[i]));
+  }
+  for (int i = 0; i < kThreads; ++i) {
+    pthread_join(threads[i], NULL);
+    EXPECT_TRUE(args[i].symbolized);
+    delete modules[i];
+  }
+
+  // Each module was supplied and parsed once; everyone else waited for it.
+  EXPECT_EQ(2, supplier.requests());
+  SharedModuleCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(2U, stats.misses);
+  EXPECT_EQ(static_cast<u_int64_t>(kThreads - 2), stats.hits);
+  EXPECT_EQ(2U, stats.entries);
+}
+
+TEST_F(SharedModuleCacheTest, AbandonedLoadPassesToNextCaller) {
+  SharedModuleCache cache(1 << 20);
+  TestCodeModule module1("module1", "ID1");
+
+  EXPECT_FALSE(cache.AcquireOrBeginLoad(&module1));
+  cache.AbandonLoad(&module1);
+  // Nobody is loading the module any more, so this doesn't wait, and the
+  // caller gets to load it.
+  EXPECT_FALSE(cache.AcquireOrBeginLoad(&module1));
+  const SharedModuleCache::Entry* entry =
+      Insert(&cache, &module1, module1_symbols);
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(entry, cache.AcquireOrBeginLoad(&module1));
+  cache.Release(entry);
+  cache.Release(entry);
+
+  // A failed insert ends the load too.
+  TestCodeModule module2("module2", "ID2");
+  EXPECT_FALSE(cache.AcquireOrBeginLoad(&module2));
+  EXPECT_FALSE(Insert(&cache, &module2, "FUNC not hex\n"));
+  EXPECT_FALSE(cache.Acquire(&module2));
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -123,6 +123,8 @@ class SimpleSymbolSupplier : public SymbolSupplier {
   // Free the data buffer allocated in the above GetCStringSymbolData();
   virtual void FreeSymbolData(const CodeModule *module);
 
+  virtual bool NamesSymbolFiles() { return true; }
+
  protected:
   SymbolResult GetSymbolFileAtPathFromRoot(const CodeModule *module,
                                            const SystemInfo *system_info,
@@ -296,6 +296,10 @@ CFIFrameInfo *SourceLineResolverBase::FindCFIFrameInfo(
   return NULL;
 }
 
+bool SourceLineResolverBase::HasThreadSafeLookups() {
+  return true;
+}
+
 bool SourceLineResolverBase::CompareString::operator()(
     const string &s1, const string &s2) const {
   return strcmp(s1.c_str(), s2.c_str()) < 0;
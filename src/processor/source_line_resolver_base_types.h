@@ -124,6 +124,10 @@ class SourceLineResolverBase::Module {
 
   // Looks up the given relative address, and fills the StackFrame struct
   // with the result.
+  //
+  // LookupAddress, FindWindowsFrameInfo and FindCFIFrameInfo must be safe
+  // to call from several threads at once, as SourceLineResolverBase
+  // promises in HasThreadSafeLookups.
   virtual void LookupAddress(StackFrame *frame) const = 0;
 
   // If Windows stack walking information is available covering ADDRESS,
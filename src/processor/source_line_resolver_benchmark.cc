@@ -0,0 +1,218 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// source_line_resolver_benchmark.cc: Measures how quickly
+// BasicSourceLineResolver loads symbol files.
+//
+// Each symbol file named on the command line is loaded, looked up once and
+// unloaded repeatedly, and the rate is reported in lines and megabytes per
+// second, along with the peak resident set size.  With no symbol files, a
+// synthetic one resembling the output of dump_syms for a large module is
+// used.  -l loads modules lazily.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <iostream>
+#include <string>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "processor/basic_code_module.h"
+#include "processor/cfi_frame_info.h"
+#include "processor/logging.h"
+#include "processor/scoped_ptr.h"
+
+namespace {
+
+using google_breakpad::BasicCodeModule;
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::CFIFrameInfo;
+using google_breakpad::scoped_ptr;
+using google_breakpad::StackFrame;
+
+// Returns a symbol file with the given number of functions, each with
+// ten lines and a CFI entry, plus a public symbol for every tenth one.
+string SyntheticSymbolFile(int function_count) {
+  string data = "MODULE Linux x86_64 0123456789ABCDEF0123456789ABCDEF0 "
+                "synthetic.so\n";
+  char record[256];
+  for (int i = 0; i < 100; ++i) {
+    snprintf(record, sizeof(record),
+             "FILE %d /build/src/synthetic/directory/file_%d.cc\n", i, i);
+    data += record;
+  }
+  for (int i = 0; i < function_count; ++i) {
+    unsigned int address = 0x1000 + i * 0x100;
+    snprintf(record, sizeof(record),
+             "FUNC %x 100 0 synthetic::Class%d::Method(int, char const*)\n",
+             address, i);
+    data += record;
+    for (int line = 0; line < 10; ++line) {
+      snprintf(record, sizeof(record), "%x 1a %d %d\n",
+               address + line * 0x1a, 100 + line, i % 100);
+      data += record;
+    }
+  }
+  for (int i = 0; i < function_count; i += 10) {
+    snprintf(record, sizeof(record), "PUBLIC %x 0 synthetic_public_%d\n",
+             0x1000 + i * 0x100, i);
+    data += record;
+  }
+  for (int i = 0; i < function_count; ++i) {
+    unsigned int address = 0x1000 + i * 0x100;
+    snprintf(record, sizeof(record),
+             "STACK CFI INIT %x 100 .cfa: $rsp 8 + .ra: .cfa -8 + ^\n"
+             "STACK CFI %x .cfa: $rsp 16 + $rbp: .cfa -16 + ^\n",
+             address, address + 1);
+    data += record;
+  }
+  return data;
+}
+
+bool ReadFile(const char *path, string *contents) {
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return false;
+  char buffer[65536];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    contents->append(buffer, count);
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+double Now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Returns the address of the first FUNC record in data, or zero.
+u_int64_t FirstFunctionAddress(const string &data) {
+  size_t position = data.compare(0, 5, "FUNC ") == 0 ?
+      0 : data.find("\nFUNC ");
+  if (position == string::npos)
+    return 0;
+  return strtoull(data.c_str() + position + (position ? 6 : 5), NULL, 16);
+}
+
+// Loads data iterations times, looking up the first function after each
+// load, and prints the rate.  Returns false if the data doesn't load.
+bool Benchmark(const string &name, const string &data, int iterations,
+               bool lazy) {
+  size_t line_count = 0;
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (data[i] == '\n')
+      ++line_count;
+  }
+
+  BasicSourceLineResolver resolver(lazy);
+  BasicCodeModule module(0, 0, name, "", "", "", "");
+  StackFrame frame;
+  frame.module = &module;
+  frame.instruction = FirstFunctionAddress(data);
+  double start = Now();
+  for (int i = 0; i < iterations; ++i) {
+    if (!resolver.LoadModuleUsingMapBuffer(&module, data))
+      return false;
+    resolver.FillSourceLineInfo(&frame);
+    scoped_ptr<CFIFrameInfo> cfi_frame_info(resolver.FindCFIFrameInfo(&frame));
+    resolver.UnloadModule(&module);
+  }
+  double seconds = Now() - start;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  printf("%s: %lu lines, %lu bytes, %d %sloads in %.3f s: "
+         "%.0f lines/sec, %.1f MB/sec, peak RSS %ld KB\n",
+         name.c_str(),
+         static_cast<unsigned long>(line_count),
+         static_cast<unsigned long>(data.size()),
+         iterations, lazy ? "lazy " : "", seconds,
+         line_count * iterations / seconds,
+         data.size() * iterations / seconds / (1024 * 1024),
+         usage.ru_maxrss);
+  return true;
+}
+
+}  // namespace
+
+static void usage(const char *program_name) {
+  fprintf(stderr, "usage: %s [-l] [-i iterations] [symbol-file ...]\n"
+          "    -l : Load modules lazily\n"
+          "    -i : Number of times to load each file (default 10)\n",
+          program_name);
+}
+
+int main(int argc, char **argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  int iterations = 10;
+  bool lazy = false;
+  int argi = 1;
+  for (; argi < argc && argv[argi][0] == '-'; ++argi) {
+    if (strcmp(argv[argi], "-l") == 0) {
+      lazy = true;
+    } else if (strcmp(argv[argi], "-i") == 0 && argi + 1 < argc &&
+               (iterations = atoi(argv[argi + 1])) > 0) {
+      ++argi;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  // Every load logs a few lines; keep them out of the measurements.
+  std::clog.setstate(std::ios::failbit);
+
+  if (argi == argc) {
+    return Benchmark("synthetic", SyntheticSymbolFile(100000), iterations,
+                     lazy) ? 0 : 1;
+  }
+
+  int result = 0;
+  for (; argi < argc; ++argi) {
+    string data;
+    if (!ReadFile(argv[argi], &data)) {
+      fprintf(stderr, "%s: could not read %s\n", argv[0], argv[argi]);
+      result = 1;
+    } else if (!Benchmark(argv[argi], data, iterations, lazy)) {
+      fprintf(stderr, "%s: could not load %s\n", argv[0], argv[argi]);
+      result = 1;
+    }
+  }
+  return result;
+}
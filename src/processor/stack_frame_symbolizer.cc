@@ -44,14 +44,23 @@
 #include "google_breakpad/processor/system_info.h"
 #include "processor/linked_ptr.h"
 #include "processor/logging.h"
+#include "processor/mutex.h"
 #include "processor/scoped_ptr.h"
 
 namespace google_breakpad {
 
 StackFrameSymbolizer::StackFrameSymbolizer(
     SymbolSupplier* supplier,
-    SourceLineResolverInterface* resolver) : supplier_(supplier),
-                                             resolver_(resolver) { }
+    SourceLineResolverInterface* resolver)
+    : supplier_(supplier),
+      resolver_(resolver),
+      mutex_(new Mutex()),
+      resolver_lock_(new ReadWriteLock()) { }
+
+StackFrameSymbolizer::~StackFrameSymbolizer() {
+  delete resolver_lock_;
+  delete mutex_;
+}
 
 StackFrameSymbolizer::SymbolizerResult StackFrameSymbolizer::FillSourceLineInfo(
     const CodeModules* modules,
@@ -66,24 +75,63 @@ StackFrameSymbolizer::SymbolizerResult StackFrameSymbolizer::FillSourceLineInfo(
 
   if (!resolver_) return ERROR;  // no resolver.
   // If module is known to have missing symbol file, return.
-  if (no_symbol_modules_.find(module->code_file()) !=
-      no_symbol_modules_.end()) {
+  if (HasNoSymbols(module)) return ERROR;
+
+  // If module is already loaded, go ahead to fill source line info and return.
+  {
+    AutoReadWriteLock lock(resolver_lock_,
+                           !resolver_->HasThreadSafeLookups());
+    if (resolver_->HasModule(frame->module)) {
+      resolver_->FillSourceLineInfo(frame);
+      return NO_ERROR;
+    }
+  }
+
+  // Module needs to fetch symbol file. First check to see if supplier exists.
+  if (!supplier_) {
     return ERROR;
   }
 
-  // If module is already loaded, go ahead to fill source line info and return.
+  // Loading changes the resolver, so nothing else may use it meanwhile.
+  // Another thread may have dealt with this module while we waited.
+  AutoReadWriteLock lock(resolver_lock_, true);
   if (resolver_->HasModule(frame->module)) {
     resolver_->FillSourceLineInfo(frame);
     return NO_ERROR;
   }
+  if (HasNoSymbols(module)) return ERROR;
 
-  // Module needs to fetch symbol file. First check to see if supplier exists.
-  if (!supplier_) {
-    return ERROR;
+  // A resolver which maps symbol files is given the file itself, so that
+  // its contents need not be read.  Suppliers that can't name a file are
+  // asked for the data instead.
+  string symbol_file;
+  if (resolver_->MapsSymbolFiles() && supplier_->NamesSymbolFiles()) {
+    SymbolSupplier::SymbolResult symbol_result =
+        supplier_->GetSymbolFile(module, system_info, &symbol_file);
+    switch (symbol_result) {
+      case SymbolSupplier::FOUND:
+        if (resolver_->LoadModule(frame->module, symbol_file)) {
+          resolver_->FillSourceLineInfo(frame);
+          return NO_ERROR;
+        }
+        BPLOG(ERROR) << "Failed to load symbol file in resolver.";
+        NoteNoSymbols(module);
+        return ERROR;
+
+      case SymbolSupplier::NOT_FOUND:
+        NoteNoSymbols(module);
+        return ERROR;
+
+      case SymbolSupplier::INTERRUPT:
+        return INTERRUPT;
+
+      default:
+        BPLOG(ERROR) << "Unknown SymbolResult enum: " << symbol_result;
+        return ERROR;
+    }
   }
 
   // Start fetching symbol from supplier.
-  string symbol_file;
   char* symbol_data = NULL;
   SymbolSupplier::SymbolResult symbol_result = supplier_->GetCStringSymbolData(
       module, system_info, &symbol_file, &symbol_data);
@@ -101,13 +149,13 @@ StackFrameSymbolizer::SymbolizerResult StackFrameSymbolizer::FillSourceLineInfo(
         return NO_ERROR;
       } else {
         BPLOG(ERROR) << "Failed to load symbol file in resolver.";
-        no_symbol_modules_.insert(module->code_file());
+        NoteNoSymbols(module);
         return ERROR;
       }
     }
 
     case SymbolSupplier::NOT_FOUND:
-      no_symbol_modules_.insert(module->code_file());
+      NoteNoSymbols(module);
       return ERROR;
 
     case SymbolSupplier::INTERRUPT:
@@ -121,12 +169,32 @@ StackFrameSymbolizer::SymbolizerResult StackFrameSymbolizer::FillSourceLineInfo(
 
 WindowsFrameInfo* StackFrameSymbolizer::FindWindowsFrameInfo(
     const StackFrame* frame) {
-  return resolver_ ? resolver_->FindWindowsFrameInfo(frame) : NULL;
+  if (!resolver_) return NULL;
+  AutoReadWriteLock lock(resolver_lock_, !resolver_->HasThreadSafeLookups());
+  return resolver_->FindWindowsFrameInfo(frame);
 }
 
 CFIFrameInfo* StackFrameSymbolizer::FindCFIFrameInfo(
     const StackFrame* frame) {
-  return resolver_ ? resolver_->FindCFIFrameInfo(frame) : NULL;
+  if (!resolver_) return NULL;
+  AutoReadWriteLock lock(resolver_lock_, !resolver_->HasThreadSafeLookups());
+  return resolver_->FindCFIFrameInfo(frame);
+}
+
+void StackFrameSymbolizer::Reset() {
+  AutoMutexLock lock(mutex_);
+  no_symbol_modules_.clear();
+}
+
+bool StackFrameSymbolizer::HasNoSymbols(const CodeModule* module) {
+  AutoMutexLock lock(mutex_);
+  return no_symbol_modules_.find(module->code_file()) !=
+      no_symbol_modules_.end();
+}
+
+void StackFrameSymbolizer::NoteNoSymbols(const CodeModule* module) {
+  AutoMutexLock lock(mutex_);
+  no_symbol_modules_.insert(module->code_file());
 }
 
 }  // namespace google_breakpad
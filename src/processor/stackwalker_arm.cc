@@ -46,6 +46,19 @@
 
 namespace google_breakpad {
 
+namespace {
+
+// The registers STACK CFI rules recover, indexed like
+// MDRawContextARM::iregs, followed by the CFA and return address.
+const char* const kCFIRegisterNames[] = {
+  "r0",  "r1",  "r2",  "r3",  "r4",  "r5",  "r6",  "r7",
+  "r8",  "r9",  "r10", "r11", "r12", "sp",  "lr",  "pc",
+  "f0",  "f1",  "f2",  "f3",  "f4",  "f5",  "f6",  "f7",
+  "fps", "cpsr",
+  ".cfa", ".ra"
+};
+
+}  // namespace
 
 StackwalkerARM::StackwalkerARM(const SystemInfo* system_info,
                                const MDRawContextARM* context,
@@ -55,7 +68,10 @@ StackwalkerARM::StackwalkerARM(const SystemInfo* system_info,
                                StackFrameSymbolizer* resolver_helper)
     : Stackwalker(system_info, memory, modules, resolver_helper),
       context_(context), fp_register_(fp_register),
-      context_frame_validity_(StackFrameARM::CONTEXT_VALID_ALL) { }
+      context_frame_validity_(StackFrameARM::CONTEXT_VALID_ALL),
+      cfi_register_names_(kCFIRegisterNames,
+                          sizeof(kCFIRegisterNames) /
+                          sizeof(kCFIRegisterNames[0])) { }
 
 
 StackFrame* StackwalkerARM::GetContextFrame() {
@@ -81,36 +97,36 @@ StackFrameARM* StackwalkerARM::GetCallerByCFIFrameInfo(
     CFIFrameInfo* cfi_frame_info) {
   StackFrameARM* last_frame = static_cast<StackFrameARM*>(frames.back());
 
-  static const char* register_names[] = {
-    "r0",  "r1",  "r2",  "r3",  "r4",  "r5",  "r6",  "r7",
-    "r8",  "r9",  "r10", "r11", "r12", "sp",  "lr",  "pc",
-    "f0",  "f1",  "f2",  "f3",  "f4",  "f5",  "f6",  "f7",
-    "fps", "cpsr",
-    NULL
-  };
-
-  // Populate a dictionary with the valid register values in last_frame.
-  CFIFrameInfo::RegisterValueMap<u_int32_t> callee_registers;
-  for (int i = 0; register_names[i]; i++)
-    if (last_frame->context_validity & StackFrameARM::RegisterValidFlag(i))
-      callee_registers[register_names[i]] = last_frame->context.iregs[i];
+  // The registers in cfi_register_names_, less the CFA and return address.
+  static const int kRegisterCount = 26;
+  static const int kCFA = kRegisterCount, kRA = kRegisterCount + 1;
+
+  // Gather the valid register values in last_frame.
+  u_int32_t callee_registers[kRegisterCount];
+  u_int64_t callee_valid = 0;
+  for (int i = 0; i < kRegisterCount; i++) {
+    if (last_frame->context_validity & StackFrameARM::RegisterValidFlag(i)) {
+      callee_registers[i] = last_frame->context.iregs[i];
+      callee_valid |= 1ULL << i;
+    }
+  }
 
   // Use the STACK CFI data to recover the caller's register values.
-  CFIFrameInfo::RegisterValueMap<u_int32_t> caller_registers;
-  if (!cfi_frame_info->FindCallerRegs(callee_registers, *memory_,
-                                      &caller_registers))
+  u_int32_t caller_registers[kRegisterCount + 2];
+  u_int64_t caller_valid;
+  if (!cfi_frame_info->FindCallerRegs<u_int32_t>(
+          cfi_register_names_, callee_registers, callee_valid,
+          *memory_, caller_registers, &caller_valid))
     return NULL;
 
   // Construct a new stack frame given the values the CFI recovered.
   scoped_ptr<StackFrameARM> frame(new StackFrameARM());
-  for (int i = 0; register_names[i]; i++) {
-    CFIFrameInfo::RegisterValueMap<u_int32_t>::iterator entry =
-      caller_registers.find(register_names[i]);
-    if (entry != caller_registers.end()) {
+  for (int i = 0; i < kRegisterCount; i++) {
+    if ((caller_valid >> i) & 1) {
       // We recovered the value of this register; fill the context with the
       // value from caller_registers.
       frame->context_validity |= StackFrameARM::RegisterValidFlag(i);
-      frame->context.iregs[i] = entry->second;
+      frame->context.iregs[i] = caller_registers[i];
     } else if (4 <= i && i <= 11 && (last_frame->context_validity &
                                      StackFrameARM::RegisterValidFlag(i))) {
       // If the STACK CFI data doesn't mention some callee-saves register, and
@@ -123,18 +139,16 @@ StackFrameARM* StackwalkerARM::GetCallerByCFIFrameInfo(
   }
   // If the CFI doesn't recover the PC explicitly, then use .ra.
   if (!(frame->context_validity & StackFrameARM::CONTEXT_VALID_PC)) {
-    CFIFrameInfo::RegisterValueMap<u_int32_t>::iterator entry =
-      caller_registers.find(".ra");
-    if (entry != caller_registers.end()) {
+    if ((caller_valid >> kRA) & 1) {
       if (fp_register_ == -1) {
         frame->context_validity |= StackFrameARM::CONTEXT_VALID_PC;
-        frame->context.iregs[MD_CONTEXT_ARM_REG_PC] = entry->second;
+        frame->context.iregs[MD_CONTEXT_ARM_REG_PC] = caller_registers[kRA];
       } else {
         // The CFI updated the link register and not the program counter.
         // Handle getting the program counter from the link register.
         frame->context_validity |= StackFrameARM::CONTEXT_VALID_PC;
         frame->context_validity |= StackFrameARM::CONTEXT_VALID_LR;
-        frame->context.iregs[MD_CONTEXT_ARM_REG_LR] = entry->second;
+        frame->context.iregs[MD_CONTEXT_ARM_REG_LR] = caller_registers[kRA];
         frame->context.iregs[MD_CONTEXT_ARM_REG_PC] =
             last_frame->context.iregs[MD_CONTEXT_ARM_REG_LR];
       }
@@ -142,11 +156,9 @@ StackFrameARM* StackwalkerARM::GetCallerByCFIFrameInfo(
   }
   // If the CFI doesn't recover the SP explicitly, then use .cfa.
   if (!(frame->context_validity & StackFrameARM::CONTEXT_VALID_SP)) {
-    CFIFrameInfo::RegisterValueMap<u_int32_t>::iterator entry =
-      caller_registers.find(".cfa");
-    if (entry != caller_registers.end()) {
+    if ((caller_valid >> kCFA) & 1) {
       frame->context_validity |= StackFrameARM::CONTEXT_VALID_SP;
-      frame->context.iregs[MD_CONTEXT_ARM_REG_SP] = entry->second;
+      frame->context.iregs[MD_CONTEXT_ARM_REG_SP] = caller_registers[kCFA];
     }
   }
 
@@ -43,6 +43,7 @@
 #include "google_breakpad/common/breakpad_types.h"
 #include "google_breakpad/common/minidump_format.h"
 #include "google_breakpad/processor/stackwalker.h"
+#include "processor/cfi_frame_info.h"
 
 namespace google_breakpad {
 
@@ -97,6 +98,9 @@ class StackwalkerARM : public Stackwalker {
   // CONTEXT_VALID_ALL in real use; it is only changeable for the sake of
   // unit tests.
   int context_frame_validity_;
+
+  // The names of the registers GetCallerByCFIFrameInfo deals in.
+  CFIFrameInfo::RegisterNames cfi_register_names_;
 };
 
 
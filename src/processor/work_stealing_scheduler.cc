@@ -0,0 +1,154 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// work_stealing_scheduler.cc: Runs a fixed set of independent tasks on a
+// pool of worker threads, balancing them by work stealing.
+//
+// See work_stealing_scheduler.h for documentation.
+
+#include "processor/work_stealing_scheduler.h"
+
+#include <pthread.h>
+
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+struct WorkStealingScheduler::Worker {
+  WorkStealingScheduler* scheduler;
+  int index;
+
+  // The tasks not yet taken from this worker, guarded by mutex.
+  std::deque<size_t> tasks;
+  Mutex mutex;
+};
+
+WorkStealingScheduler::WorkStealingScheduler(int worker_count)
+    : workers_(),
+      handler_(NULL),
+      steal_count_(0),
+      steal_count_mutex_() {
+  if (worker_count < 1)
+    worker_count = 1;
+  for (int i = 0; i < worker_count; ++i) {
+    Worker* worker = new Worker();
+    worker->scheduler = this;
+    worker->index = i;
+    workers_.push_back(worker);
+  }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler() {
+  for (size_t i = 0; i < workers_.size(); ++i)
+    delete workers_[i];
+}
+
+void WorkStealingScheduler::Run(size_t task_count, Handler* handler) {
+  handler_ = handler;
+  steal_count_ = 0;
+
+  // Deal the tasks out in contiguous blocks, so that each worker starts
+  // on a different part of the list.
+  size_t worker_count = workers_.size();
+  for (size_t i = 0; i < worker_count; ++i) {
+    size_t begin = task_count * i / worker_count;
+    size_t end = task_count * (i + 1) / worker_count;
+    for (size_t task = begin; task < end; ++task)
+      workers_[i]->tasks.push_back(task);
+  }
+
+  if (worker_count == 1) {
+    WorkerThread(workers_[0]);
+    handler_ = NULL;
+    return;
+  }
+
+  std::vector<pthread_t> threads;
+  for (size_t i = 0; i < worker_count; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, WorkerThread, workers_[i]) != 0) {
+      BPLOG(ERROR) << "Could not start worker thread " << i;
+      break;
+    }
+    threads.push_back(thread);
+  }
+
+  // Workers that couldn't be started leave their tasks to be stolen.  If
+  // none started at all, run the first worker here, and it will steal
+  // everything else.
+  if (threads.empty())
+    WorkerThread(workers_[0]);
+
+  for (size_t i = 0; i < threads.size(); ++i)
+    pthread_join(threads[i], NULL);
+
+  handler_ = NULL;
+}
+
+bool WorkStealingScheduler::NextTask(int worker, size_t* task) {
+  {
+    Worker* own = workers_[worker];
+    AutoMutexLock lock(&own->mutex);
+    if (!own->tasks.empty()) {
+      *task = own->tasks.front();
+      own->tasks.pop_front();
+      return true;
+    }
+  }
+
+  // Steal from the back of the other workers' queues, starting with the
+  // next worker along so that thieves spread out over their victims.
+  // Tasks are never added once Run has started, so finding every queue
+  // empty means there is nothing left to do.
+  int worker_count = static_cast<int>(workers_.size());
+  for (int i = 1; i < worker_count; ++i) {
+    Worker* victim = workers_[(worker + i) % worker_count];
+    AutoMutexLock lock(&victim->mutex);
+    if (!victim->tasks.empty()) {
+      *task = victim->tasks.back();
+      victim->tasks.pop_back();
+      AutoMutexLock steal_lock(&steal_count_mutex_);
+      ++steal_count_;
+      return true;
+    }
+  }
+  return false;
+}
+
+// static
+void* WorkStealingScheduler::WorkerThread(void* context) {
+  Worker* worker = static_cast<Worker*>(context);
+  WorkStealingScheduler* scheduler = worker->scheduler;
+  size_t task;
+  while (scheduler->NextTask(worker->index, &task))
+    scheduler->handler_->RunTask(task, worker->index);
+  return NULL;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,108 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// work_stealing_scheduler.h: Runs a fixed set of independent tasks on a
+// pool of worker threads, balancing them by work stealing.
+//
+// Each worker starts with its own contiguous share of the tasks, kept in
+// a double-ended queue.  It runs tasks from the front of its own queue,
+// and once that is empty, steals from the back of another worker's.  A
+// worker that draws a run of slow tasks therefore doesn't hold up the
+// others: they take its remaining tasks from it instead of going idle.
+// Each queue has its own lock, so workers only contend when one of them
+// is stealing.
+
+#ifndef PROCESSOR_WORK_STEALING_SCHEDULER_H__
+#define PROCESSOR_WORK_STEALING_SCHEDULER_H__
+
+#include <stddef.h>
+
+#include <deque>
+#include <vector>
+
+#include "google_breakpad/common/breakpad_types.h"
+#include "processor/mutex.h"
+
+namespace google_breakpad {
+
+class WorkStealingScheduler {
+ public:
+  class Handler {
+   public:
+    virtual ~Handler() {}
+
+    // Runs task number task on the worker numbered worker, from 0 to
+    // one less than the worker count.  Called concurrently for different
+    // workers, but never concurrently for the same one, so per-worker
+    // state indexed by worker needs no lock.
+    virtual void RunTask(size_t task, int worker) = 0;
+  };
+
+  // Creates a scheduler that runs tasks on worker_count threads.  With a
+  // worker_count of 1 or less, tasks are run in order on the calling
+  // thread.
+  explicit WorkStealingScheduler(int worker_count);
+  ~WorkStealingScheduler();
+
+  // Runs tasks 0 through task_count - 1, each exactly once, by calling
+  // handler->RunTask.  Returns once every task has finished.  If worker
+  // threads can't be started, the calling thread stands in for them.
+  void Run(size_t task_count, Handler* handler);
+
+  int worker_count() const { return static_cast<int>(workers_.size()); }
+
+  // The number of tasks run by a worker other than the one they were
+  // first assigned to, during the last Run.
+  u_int64_t steal_count() const { return steal_count_; }
+
+ private:
+  struct Worker;
+
+  // Takes a task for the worker numbered worker, from its own queue if
+  // possible, or otherwise by stealing from another worker.  Returns
+  // false once there are no tasks left anywhere.
+  bool NextTask(int worker, size_t* task);
+
+  static void* WorkerThread(void* context);
+
+  std::vector<Worker*> workers_;
+  Handler* handler_;
+  u_int64_t steal_count_;
+
+  // Guards steal_count_.
+  Mutex steal_count_mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  WorkStealingScheduler(const WorkStealingScheduler&);
+  void operator=(const WorkStealingScheduler&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_WORK_STEALING_SCHEDULER_H__
@@ -0,0 +1,182 @@
+// Copyright (c) 2012, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// work_stealing_scheduler_unittest.cc: Unit tests for
+// WorkStealingScheduler.
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "processor/mutex.h"
+#include "processor/work_stealing_scheduler.h"
+
+namespace {
+
+using google_breakpad::AutoMutexLock;
+using google_breakpad::Mutex;
+using google_breakpad::WorkStealingScheduler;
+using std::vector;
+
+// Records which worker ran each task, and in what order.
+class RecordingHandler : public WorkStealingScheduler::Handler {
+ public:
+  explicit RecordingHandler(size_t task_count)
+      : runs_(task_count, 0), workers_(task_count, -1), max_worker_(-1) {}
+
+  virtual void RunTask(size_t task, int worker) {
+    Wait(task);
+    AutoMutexLock lock(&mutex_);
+    ++runs_[task];
+    workers_[task] = worker;
+    order_.push_back(task);
+    if (worker > max_worker_)
+      max_worker_ = worker;
+  }
+
+  // Called before recording task; lets subclasses hold tasks up.
+  virtual void Wait(size_t task) {}
+
+  size_t completed() {
+    AutoMutexLock lock(&mutex_);
+    return order_.size();
+  }
+
+  const vector<int>& runs() const { return runs_; }
+  const vector<int>& workers() const { return workers_; }
+  const vector<size_t>& order() const { return order_; }
+  int max_worker() const { return max_worker_; }
+
+ private:
+  Mutex mutex_;
+  vector<int> runs_;
+  vector<int> workers_;
+  vector<size_t> order_;
+  int max_worker_;
+};
+
+// Holds task 0 up until every other task has finished.
+class SlowFirstTaskHandler : public RecordingHandler {
+ public:
+  explicit SlowFirstTaskHandler(size_t task_count)
+      : RecordingHandler(task_count), task_count_(task_count) {}
+
+  virtual void Wait(size_t task) {
+    if (task != 0)
+      return;
+    while (completed() != task_count_ - 1)
+      usleep(1000);
+  }
+
+ private:
+  size_t task_count_;
+};
+
+TEST(WorkStealingScheduler, NoTasks) {
+  WorkStealingScheduler scheduler(4);
+  RecordingHandler handler(0);
+  scheduler.Run(0, &handler);
+  EXPECT_TRUE(handler.order().empty());
+  EXPECT_EQ(0U, scheduler.steal_count());
+}
+
+TEST(WorkStealingScheduler, OneWorkerRunsTasksInOrder) {
+  WorkStealingScheduler scheduler(1);
+  EXPECT_EQ(1, scheduler.worker_count());
+  RecordingHandler handler(100);
+  scheduler.Run(100, &handler);
+  ASSERT_EQ(100U, handler.order().size());
+  for (size_t i = 0; i < 100; ++i) {
+    EXPECT_EQ(i, handler.order()[i]);
+    EXPECT_EQ(0, handler.workers()[i]);
+  }
+  EXPECT_EQ(0U, scheduler.steal_count());
+}
+
+TEST(WorkStealingScheduler, NonPositiveWorkerCount) {
+  WorkStealingScheduler scheduler(0);
+  EXPECT_EQ(1, scheduler.worker_count());
+}
+
+TEST(WorkStealingScheduler, RunsEveryTaskOnce) {
+  const size_t kTasks = 1000;
+  WorkStealingScheduler scheduler(4);
+  RecordingHandler handler(kTasks);
+  scheduler.Run(kTasks, &handler);
+  ASSERT_EQ(kTasks, handler.order().size());
+  for (size_t i = 0; i < kTasks; ++i)
+    EXPECT_EQ(1, handler.runs()[i]) << "task " << i;
+  EXPECT_GE(handler.max_worker(), 0);
+  EXPECT_LT(handler.max_worker(), 4);
+}
+
+TEST(WorkStealingScheduler, FewerTasksThanWorkers) {
+  WorkStealingScheduler scheduler(8);
+  RecordingHandler handler(3);
+  scheduler.Run(3, &handler);
+  ASSERT_EQ(3U, handler.order().size());
+  for (size_t i = 0; i < 3; ++i)
+    EXPECT_EQ(1, handler.runs()[i]);
+}
+
+// While worker 0 is stuck on task 0, worker 1 should finish its own share
+// and then take over the rest of worker 0's.
+TEST(WorkStealingScheduler, IdleWorkerSteals) {
+  const size_t kTasks = 100;
+  WorkStealingScheduler scheduler(2);
+  SlowFirstTaskHandler handler(kTasks);
+  scheduler.Run(kTasks, &handler);
+  ASSERT_EQ(kTasks, handler.order().size());
+  EXPECT_EQ(0U, handler.order()[kTasks - 1]);
+  for (size_t i = 1; i < kTasks; ++i) {
+    EXPECT_EQ(1, handler.runs()[i]);
+    EXPECT_EQ(1, handler.workers()[i]) << "task " << i;
+  }
+  EXPECT_GE(scheduler.steal_count(), kTasks / 2 - 1);
+}
+
+// A scheduler can be run more than once.
+TEST(WorkStealingScheduler, RunTwice) {
+  WorkStealingScheduler scheduler(3);
+  RecordingHandler handler1(50);
+  scheduler.Run(50, &handler1);
+  RecordingHandler handler2(70);
+  scheduler.Run(70, &handler2);
+  EXPECT_EQ(50U, handler1.order().size());
+  EXPECT_EQ(70U, handler2.order().size());
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
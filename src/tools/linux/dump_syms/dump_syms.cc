@@ -28,6 +28,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <cstring>
 #include <iostream>
@@ -35,39 +36,49 @@
 
 #include "common/linux/dump_symbols.h"
 
+using google_breakpad::DumpOptions;
 using google_breakpad::WriteSymbolFile;
 
 int usage(const char* self) {
   fprintf(stderr, "Usage: %s [OPTION] <binary-with-debugging-info> "
           "[directory-for-debug-file]\n\n", self);
   fprintf(stderr, "Options:\n");
-  fprintf(stderr, "  -c    Do not generate CFI section\n");
+  fprintf(stderr, "  -c      Do not generate CFI section\n");
+  fprintf(stderr, "  -i      Index DWARF declarations first, to resolve "
+          "references to later ones\n");
+  fprintf(stderr, "  -j N    Process DWARF compilation units on N threads\n");
+  fprintf(stderr, "  -s DIR  Keep functions in temporary files in DIR, "
+          "to bound memory use\n");
   return 1;
 }
 
 int main(int argc, char **argv) {
-  if (argc < 2 || argc > 4)
-    return usage(argv[0]);
-
-  bool cfi = true;
-  if (strcmp("-c", argv[1]) == 0)
-    cfi = false;
-  if (!cfi && argc == 2)
+  DumpOptions options;
+  int arg_index = 1;
+  while (arg_index < argc && argv[arg_index][0] == '-') {
+    if (strcmp("-c", argv[arg_index]) == 0) {
+      options.cfi = false;
+    } else if (strcmp("-i", argv[arg_index]) == 0) {
+      options.dwarf_index = true;
+    } else if (strcmp("-j", argv[arg_index]) == 0 && arg_index + 1 < argc &&
+               (options.dwarf_threads = atoi(argv[arg_index + 1])) > 0) {
+      ++arg_index;
+    } else if (strcmp("-s", argv[arg_index]) == 0 && arg_index + 1 < argc) {
+      options.spill_directory = argv[++arg_index];
+    } else {
+      return usage(argv[0]);
+    }
+    ++arg_index;
+  }
+  if (arg_index == argc || argc - arg_index > 2)
     return usage(argv[0]);
 
-  const char *binary;
+  const char *binary = argv[arg_index];
   std::string debug_dir;
-  if (cfi) {
-    binary = argv[1];
-    if (argc == 3)
-      debug_dir = argv[2];
-  } else {
-    binary = argv[2];
-    if (argc == 4)
-      debug_dir = argv[3];
-  }
+  if (arg_index + 1 < argc)
+    debug_dir = argv[arg_index + 1];
 
-  if (!WriteSymbolFile(binary, debug_dir, cfi, std::cout)) {
+  if (!WriteSymbolFile(binary, debug_dir, options, std::cout)) {
     fprintf(stderr, "Failed to write symbol file.\n");
     return 1;
   }